@@ -0,0 +1,159 @@
+# cmake/modules/name_index.cmake
+#
+# Generates the name indexes of the builtin tables of libharu.
+#
+# usage: cmake -DSRC_DIR=<src> -DINC_DIR=<include> -DOUT_DIR=<dir>
+#              [-DCHECK_DIR=<dir>] -P name_index.cmake
+#
+# Each index lists the positions of the entries of a table in the order of
+# their names, so that the lookups can do a binary search instead of scanning
+# the whole table. Entries with the same name keep the order of the table.
+#
+# The indexes are checked in under src/ for the builds which do not use
+# cmake (script/Makefile.*). The cmake build generates them again and fails
+# when the copies in CHECK_DIR are out of date; update them with
+#   cmake -DSRC_DIR=src -DINC_DIR=include -DOUT_DIR=src
+#         -P cmake/modules/name_index.cmake
+# =======================================================================
+
+# collect the string macros which are used as names in the tables
+macro(read_defines file)
+  file(STRINGS ${file} _lines REGEX "^#define[ \t]+[A-Za-z0-9_]+[ \t]+\"")
+  foreach(_line ${_lines})
+    string(REGEX REPLACE "^#define[ \t]+([A-Za-z0-9_]+)[ \t]+\"([^\"]*)\".*"
+        "\\1;\\2" _def "${_line}")
+    list(GET _def 0 _key)
+    list(GET _def 1 _value)
+    set(DEF_${_key} "${_value}")
+  endforeach()
+endmacro()
+
+# the text of the initializer of the array 'table' in 'content'
+function(get_table content table result)
+  string(FIND "${content}" "${table}[] = {" _begin)
+  if(_begin EQUAL -1)
+    message(FATAL_ERROR "name_index: ${table} not found")
+  endif()
+  string(SUBSTRING "${content}" ${_begin} -1 _text)
+  string(FIND "${_text}" "\n};" _end)
+  string(SUBSTRING "${_text}" 0 ${_end} _text)
+  set(${result} "${_text}" PARENT_SCOPE)
+endfunction()
+
+# sort the names and write the positions as a C array named 'array'
+function(write_index names array result)
+  set(_keys)
+  set(_i 0)
+  foreach(_name ${names})
+    set(_pos "0000${_i}")
+    string(LENGTH "${_pos}" _len)
+    math(EXPR _len "${_len} - 5")
+    string(SUBSTRING "${_pos}" ${_len} 5 _pos)
+    list(APPEND _keys "${_name} ${_pos}")
+    math(EXPR _i "${_i} + 1")
+  endforeach()
+  list(SORT _keys)
+
+  set(_text "static const HPDF_UINT16 ${array}[${_i}] = {")
+  set(_col 0)
+  set(_n 0)
+  foreach(_key ${_keys})
+    string(REGEX REPLACE ".* ([0-9]+)$" "\\1" _pos "${_key}")
+    math(EXPR _pos "${_pos}")
+    math(EXPR _n "${_n} + 1")
+    if(_col EQUAL 0)
+      set(_text "${_text}\n   ")
+    endif()
+    if(_n LESS _i)
+      set(_text "${_text} ${_pos},")
+    else()
+      set(_text "${_text} ${_pos}")
+    endif()
+    math(EXPR _col "(${_col} + 1) % 12")
+  endforeach()
+  set(${result} "${_text}\n};\n" PARENT_SCOPE)
+endfunction()
+
+# the names of the entries of a table whose first member is a name macro
+function(get_macro_names text result)
+  string(REGEX MATCHALL "{[ \t\r\n]*[A-Za-z_][A-Za-z0-9_]*," _entries "${text}")
+  set(_names)
+  foreach(_entry ${_entries})
+    string(REGEX REPLACE "^{[ \t\r\n]*([A-Za-z0-9_]+),$" "\\1" _key "${_entry}")
+    if(NOT _key STREQUAL "NULL")
+      if(NOT DEFINED DEF_${_key})
+        message(FATAL_ERROR "name_index: unknown name ${_key}")
+      endif()
+      list(APPEND _names "${DEF_${_key}}")
+    endif()
+  endforeach()
+  set(${result} "${_names}" PARENT_SCOPE)
+endfunction()
+
+function(write_header file text)
+  set(_text "/*\n * << Haru Free PDF Library >> -- ${file}\n *\n")
+  set(_text "${_text} * generated by cmake/modules/name_index.cmake, do not edit.\n")
+  string(TOUPPER "_${file}" _guard)
+  string(REPLACE "." "_" _guard "${_guard}")
+  set(_text "${_text} *\n */\n\n#ifndef ${_guard}\n#define ${_guard}\n\n${text}")
+  set(_text "${_text}\n#endif /* ${_guard} */\n")
+  if(DEFINED CHECK_DIR)
+    set(_checked)
+    if(EXISTS ${CHECK_DIR}/${file})
+      file(READ ${CHECK_DIR}/${file} _checked)
+    endif()
+    if(NOT _checked STREQUAL _text)
+      message(FATAL_ERROR "name_index: ${CHECK_DIR}/${file} is out of date, "
+          "regenerate it with -DOUT_DIR=${CHECK_DIR}")
+    endif()
+  endif()
+  if(EXISTS ${OUT_DIR}/${file})
+    file(READ ${OUT_DIR}/${file} _old)
+    if(_old STREQUAL _text)
+      return()
+    endif()
+  endif()
+  file(WRITE ${OUT_DIR}/${file} "${_text}")
+endfunction()
+
+read_defines(${INC_DIR}/hpdf_encoder.h)
+read_defines(${SRC_DIR}/hpdf_fontdef_base14.c)
+
+# =======================================================================
+# glyph names and builtin encodings
+# =======================================================================
+file(READ ${SRC_DIR}/hpdf_encoder.c _content)
+
+get_table("${_content}" HPDF_UNICODE_GRYPH_NAME_MAP _text)
+string(REGEX MATCHALL "{0x[0-9A-Fa-f]+, [^}]*}" _entries "${_text}")
+set(_names)
+foreach(_entry ${_entries})
+  string(REGEX REPLACE "^{0x[0-9A-Fa-f]+, (.*)}$" "\\1" _name "${_entry}")
+  if(_name MATCHES "^\"(.*)\"$")
+    list(APPEND _names "${CMAKE_MATCH_1}")
+  elseif(DEFINED DEF_${_name})
+    list(APPEND _names "${DEF_${_name}}")
+  elseif(NOT _name STREQUAL "NULL")
+    message(FATAL_ERROR "name_index: unknown glyph name ${_name}")
+  endif()
+endforeach()
+write_index("${_names}" HPDF_GRYPH_NAME_INDEX _gryph)
+
+get_table("${_content}" HPDF_BUILTIN_ENCODINGS _text)
+get_macro_names("${_text}" _names)
+write_index("${_names}" HPDF_BUILTIN_ENCODING_INDEX _encoding)
+
+write_header(hpdf_encoder_index.h
+    "/* HPDF_UNICODE_GRYPH_NAME_MAP by gryph_name */\n${_gryph}\n/* HPDF_BUILTIN_ENCODINGS by encoding_name */\n${_encoding}")
+
+# =======================================================================
+# base14 fonts
+# =======================================================================
+file(READ ${SRC_DIR}/hpdf_fontdef_base14.c _content)
+
+get_table("${_content}" HPDF_BUILTIN_FONTS _text)
+get_macro_names("${_text}" _names)
+write_index("${_names}" HPDF_BUILTIN_FONT_INDEX _font)
+
+write_header(hpdf_fontdef_base14_index.h
+    "/* HPDF_BUILTIN_FONTS by font_name */\n${_font}")
@@ -39,6 +39,8 @@ Library options:
 LIBHPDF_SHARED:		${LIBHPDF_SHARED}
 LIBHPDF_STATIC:		${LIBHPDF_STATIC}
 LIBHPDF_EXAMPLES:	${LIBHPDF_EXAMPLES}
+LIBHPDF_TESTS:		${LIBHPDF_TESTS}
+LIBHPDF_TSAN:		${LIBHPDF_TSAN}
 DEVPAK:			${DEVPAK}
 
 Optional libraries:
@@ -0,0 +1,212 @@
+/*
+ * << Haru Free PDF Library >> -- cmap_bench.c
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+/*
+ *  Measures the lookups of the CMap encoders over the texts of mbtext/,
+ *  through the public API: the unicode of each code
+ *  (HPDF_Encoder_GetUnicode) and the width of the whole text in a CID font
+ *  (HPDF_Font_TextWidth, which looks up the CID of each code). Each text is
+ *  repeated to BENCH_TEXT_SIZE bytes, and each measure runs for at least the
+ *  given time.
+ *
+ *  usage: cmap_bench [seconds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "hpdf.h"
+
+#define BENCH_TEXT_SIZE     65536
+
+jmp_buf env;
+
+typedef struct _BenchText {
+    const char  *file_name;
+    const char  *encoding_name;
+    const char  *font_name;
+} BenchText;
+
+static const BenchText texts[] = {
+    {"cp932.txt", "90ms-RKSJ-H", "MS-Mincho"},
+    {"sjis.txt", "90ms-RKSJ-H", "MS-Mincho"},
+    {"EUC_JP.txt", "EUC-H", "MS-Mincho"},
+    {"euc.txt", "EUC-H", "MS-Mincho"},
+    {"cp936.txt", "GBK-EUC-H", "SimSun"},
+    {"cp949.txt", "KSCms-UHC-H", "DotumChe"},
+    {"euc_kr.txt", "KSC-EUC-H", "DotumChe"},
+    {NULL, NULL, NULL}
+};
+
+#ifdef HPDF_DLL
+void  __stdcall
+#else
+void
+#endif
+error_handler (HPDF_STATUS   error_no,
+               HPDF_STATUS   detail_no,
+               void         *user_data)
+{
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+                (HPDF_UINT)detail_no);
+    longjmp(env, 1);
+}
+
+static HPDF_UINT
+read_text (const char  *file_name,
+           char        *buf,
+           HPDF_UINT    size)
+{
+    char path[256];
+    FILE *f;
+    HPDF_UINT len;
+
+#ifdef __WIN32__
+    sprintf (path, "mbtext\\%s", file_name);
+#else
+    sprintf (path, "mbtext/%s", file_name);
+#endif
+
+    f = fopen (path, "rb");
+    if (!f) {
+        printf ("error: cannot open '%s'\n", path);
+        return 0;
+    }
+
+    len = (HPDF_UINT)fread (buf, 1, size - 1, f);
+    buf[len] = 0;
+    fclose (f);
+
+    return len;
+}
+
+/* repeat the first len elements of buf as long as they fit in size */
+static HPDF_UINT
+repeat (void       *buf,
+        HPDF_UINT   len,
+        HPDF_UINT   size,
+        HPDF_UINT   elem_size)
+{
+    HPDF_UINT total;
+
+    for (total = len; total + len <= size; total += len)
+        memcpy ((char *)buf + total * elem_size, buf, len * elem_size);
+
+    return total;
+}
+
+static double
+seconds (clock_t start)
+{
+    double t = (double)(clock () - start) / CLOCKS_PER_SEC;
+
+    return t > 0 ? t : 1e-9;
+}
+
+int main (int argc, char **argv)
+{
+    HPDF_Doc  pdf;
+    static char text[BENCH_TEXT_SIZE];
+    static HPDF_UINT16 codes[BENCH_TEXT_SIZE];
+    double min_time = (argc > 1) ? atof (argv[1]) : 0.5;
+    int i;
+
+    pdf = HPDF_New (error_handler, NULL);
+    if (!pdf) {
+        printf ("error: cannot create PdfDoc object\n");
+        return 1;
+    }
+
+    if (setjmp(env)) {
+        HPDF_Free (pdf);
+        return 1;
+    }
+
+    HPDF_UseJPEncodings (pdf);
+    HPDF_UseJPFonts (pdf);
+    HPDF_UseCNSEncodings (pdf);
+    HPDF_UseCNSFonts (pdf);
+    HPDF_UseKREncodings (pdf);
+    HPDF_UseKRFonts (pdf);
+
+    printf ("%-12s %-12s %8s %16s %16s\n", "text", "encoding", "codes",
+            "GetUnicode M/s", "TextWidth M/s");
+
+    for (i = 0; texts[i].file_name; i++) {
+        HPDF_Encoder encoder = HPDF_GetEncoder (pdf, texts[i].encoding_name);
+        HPDF_Font font = HPDF_GetFont (pdf, texts[i].font_name,
+                texts[i].encoding_name);
+        HPDF_UINT len = read_text (texts[i].file_name, text, sizeof(text));
+        HPDF_UINT sample_len = len;
+        HPDF_UINT ncodes = 0;
+        HPDF_UINT j;
+        HPDF_UINT32 sum = 0;
+        double unicode_rate;
+        double width_rate;
+        double t;
+        clock_t start;
+        long n;
+
+        if (len == 0) {
+            HPDF_Free (pdf);
+            return 1;
+        }
+
+        /* split the text into the codes of the encoding */
+        for (j = 0; j < len; j++) {
+            HPDF_ByteType btype = HPDF_Encoder_GetByteType (encoder, text, j);
+
+            if (btype == HPDF_BYTE_TYPE_LEAD && j + 1 < len) {
+                codes[ncodes++] = (HPDF_UINT16)(((HPDF_BYTE)text[j] << 8) |
+                        (HPDF_BYTE)text[j + 1]);
+                j++;
+            } else if (btype != HPDF_BYTE_TYPE_TRAIL)
+                codes[ncodes++] = (HPDF_BYTE)text[j];
+        }
+
+        len = repeat (text, sample_len, sizeof(text) - 1, 1);
+        text[len] = 0;
+        ncodes = repeat (codes, ncodes, len / sample_len * ncodes,
+                sizeof(codes[0]));
+
+        start = clock ();
+        n = 0;
+        do {
+            for (j = 0; j < ncodes; j++)
+                sum += HPDF_Encoder_GetUnicode (encoder, codes[j]);
+            n++;
+        } while ((t = seconds (start)) < min_time);
+        unicode_rate = (double)ncodes * n / t / 1e6;
+
+        start = clock ();
+        n = 0;
+        do {
+            sum += (HPDF_UINT32)HPDF_Font_TextWidth (font,
+                    (const HPDF_BYTE *)text, len).width;
+            n++;
+        } while ((t = seconds (start)) < min_time);
+        width_rate = (double)ncodes * n / t / 1e6;
+
+        /* sum keeps the lookups from being optimized away */
+        printf ("%-12s %-12s %8u %16.1f %16.1f%s\n", texts[i].file_name,
+                texts[i].encoding_name, ncodes, unicode_rate, width_rate,
+                sum ? "" : " ");
+    }
+
+    HPDF_Free (pdf);
+
+    return 0;
+}
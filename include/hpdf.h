@@ -79,6 +79,8 @@ typedef HPDF_HANDLE   HPDF_EmbeddedFile;
 typedef HPDF_HANDLE   HPDF_OutputIntent;
 typedef HPDF_HANDLE   HPDF_Xref;
 typedef HPDF_HANDLE   HPDF_Shading;
+typedef HPDF_HANDLE   HPDF_PreparedImage;
+typedef HPDF_HANDLE   HPDF_Batch;
 
 #else
 
@@ -90,6 +92,7 @@ typedef HPDF_HANDLE   HPDF_Shading;
 #include "hpdf_doc.h"
 #include "hpdf_error.h"
 #include "hpdf_pdfa.h"
+#include "hpdf_batch.h"
 
 #endif /* HPDF_SHARED */
 
@@ -121,6 +124,13 @@ HPDF_SetErrorHandler  (HPDF_Doc            pdf,
 HPDF_EXPORT(void)
 HPDF_Free  (HPDF_Doc  pdf);
 
+
+/* frees the encoding tables which are shared by all documents. no document
+ * may exist, or be created on another thread, during the call.
+ */
+HPDF_EXPORT(void)
+HPDF_FreeGlobalCaches  (void);
+
 HPDF_EXPORT(HPDF_MMgr)
 HPDF_GetDocMMgr  (HPDF_Doc doc);
 
@@ -297,6 +307,12 @@ HPDF_LoadType1FontFromFile  (HPDF_Doc     pdf,
                              const char  *afm_file_name,
                              const char  *data_file_name);
 
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SaveType1FontMetrics  (HPDF_Doc     pdf,
+                            const char  *font_name,
+                            const char  *file_name);
+
 HPDF_EXPORT(HPDF_FontDef)
 HPDF_GetTTFontDefFromFile (HPDF_Doc     pdf,
                            const char  *file_name,
@@ -827,6 +843,12 @@ HPDF_EXPORT(HPDF_Image)
 HPDF_LoadJpegImageFromFile (HPDF_Doc      pdf,
                             const char    *filename);
 
+
+/* the file is read when the document is saved and must exist until then */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJpegImageFromFile2 (HPDF_Doc      pdf,
+                             const char    *filename);
+
 #if defined(WIN32)
 HPDF_EXPORT(HPDF_Image)
 HPDF_LoadPngImageFromFileW (HPDF_Doc       pdf,
@@ -851,6 +873,24 @@ HPDF_LoadJpegImageFromMem   (HPDF_Doc      pdf,
                       const HPDF_BYTE     *buffer,
                             HPDF_UINT      size);
 
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJpxImageFromFile   (HPDF_Doc      pdf,
+                             const char    *filename);
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJpxImageFromMem    (HPDF_Doc          pdf,
+                             const HPDF_BYTE  *buffer,
+                             HPDF_UINT         size);
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJbig2ImageFromFile (HPDF_Doc      pdf,
+                             const char    *filename);
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJbig2ImageFromMem  (HPDF_Doc          pdf,
+                             const HPDF_BYTE  *buffer,
+                             HPDF_UINT         size);
+
 HPDF_EXPORT(HPDF_Image)
 HPDF_LoadU3DFromFile (HPDF_Doc      pdf,
                             const char    *filename);
@@ -870,6 +910,16 @@ HPDF_Image_LoadRaw1BitImageFromMem  (HPDF_Doc           pdf,
                           HPDF_BOOL          top_is_first);
 
 
+HPDF_EXPORT(HPDF_Image)
+HPDF_Image_LoadRaw1BitImageFromMem2  (HPDF_Doc           pdf,
+                           const HPDF_BYTE   *buf,
+                          HPDF_UINT          width,
+                          HPDF_UINT          height,
+                          HPDF_UINT          line_width,
+                          HPDF_BOOL          black_is1,
+                          HPDF_BOOL          top_is_first);
+
+
 HPDF_EXPORT(HPDF_Image)
 HPDF_LoadRawImageFromFile  (HPDF_Doc           pdf,
                             const char         *filename,
@@ -877,6 +927,15 @@ HPDF_LoadRawImageFromFile  (HPDF_Doc           pdf,
                             HPDF_UINT          height,
                             HPDF_ColorSpace    color_space);
 
+
+/* the file is read when the document is saved and must exist until then */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadRawImageFromFile2  (HPDF_Doc           pdf,
+                             const char         *filename,
+                             HPDF_UINT          width,
+                             HPDF_UINT          height,
+                             HPDF_ColorSpace    color_space);
+
 #if defined(WIN32)
 HPDF_EXPORT(HPDF_Image)
 HPDF_LoadRawImageFromFile  (HPDF_Doc           pdf,
@@ -894,6 +953,19 @@ HPDF_LoadRawImageFromMem  (HPDF_Doc           pdf,
                            HPDF_ColorSpace    color_space,
                            HPDF_UINT          bits_per_component);
 
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadRawImageFromUserMem  (HPDF_Doc            pdf,
+                               const HPDF_BYTE    *buf,
+                               HPDF_UINT           size,
+                               HPDF_UINT           width,
+                               HPDF_UINT           height,
+                               HPDF_ColorSpace     color_space,
+                               HPDF_UINT           bits_per_component,
+                               HPDF_BOOL           deflated,
+                               HPDF_Release_Func   release_fn,
+                               void               *user_data);
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_Image_AddSMask  (HPDF_Image    image,
                       HPDF_Image    smask);
@@ -937,6 +1009,112 @@ HPDF_Image_SetMaskImage  (HPDF_Image   image,
                           HPDF_Image   mask_image);
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Image_Downsample  (HPDF_Image            image,
+                        HPDF_UINT             width,
+                        HPDF_UINT             height,
+                        HPDF_ResampleFilter   filter);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Image_DownsampleToDPI  (HPDF_Image            image,
+                             HPDF_REAL             box_width,
+                             HPDF_REAL             box_height,
+                             HPDF_REAL             max_dpi,
+                             HPDF_ResampleFilter   filter);
+
+
+/*---------------------------------------------------------------------------*/
+/*----- prepared images -----------------------------------------------------*/
+
+HPDF_EXPORT(HPDF_PreparedImage)
+HPDF_PreparePngImageFromFile  (const char          *filename,
+                               HPDF_BOOL            compress,
+                               HPDF_Error_Handler   user_error_fn,
+                               void                *user_data);
+
+
+HPDF_EXPORT(HPDF_PreparedImage)
+HPDF_PrepareJpegImageFromFile  (const char          *filename,
+                                HPDF_Error_Handler   user_error_fn,
+                                void                *user_data);
+
+
+HPDF_EXPORT(HPDF_PreparedImage)
+HPDF_PrepareRaw1BitImageFromMem  (const HPDF_BYTE     *buf,
+                                  HPDF_UINT            width,
+                                  HPDF_UINT            height,
+                                  HPDF_UINT            line_width,
+                                  HPDF_BOOL            black_is1,
+                                  HPDF_BOOL            top_is_first,
+                                  HPDF_Error_Handler   user_error_fn,
+                                  void                *user_data);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_PreparedImage_Downsample  (HPDF_PreparedImage    image,
+                                HPDF_UINT             width,
+                                HPDF_UINT             height,
+                                HPDF_ResampleFilter   filter);
+
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_AttachPreparedImage  (HPDF_Doc             pdf,
+                           HPDF_PreparedImage   image);
+
+
+HPDF_EXPORT(void)
+HPDF_FreePreparedImage  (HPDF_PreparedImage  image);
+
+
+/*--------------------------------------------------------------------------*/
+/*----- batch --------------------------------------------------------------*/
+
+typedef HPDF_STATUS
+(HPDF_STDCALL *HPDF_Batch_Setup_Func)  (HPDF_Doc   pdf,
+                                        void      *user_data);
+
+
+typedef HPDF_STATUS
+(HPDF_STDCALL *HPDF_Batch_Fill_Func)  (HPDF_Doc   pdf,
+                                       void      *job_data);
+
+
+typedef HPDF_STATUS
+(HPDF_STDCALL *HPDF_Batch_Write_Func)  (const HPDF_BYTE  *buf,
+                                        HPDF_UINT         siz,
+                                        void             *job_data);
+
+
+typedef void
+(HPDF_STDCALL *HPDF_Batch_Done_Func)  (HPDF_STATUS   status,
+                                       void         *job_data);
+
+
+HPDF_EXPORT(HPDF_Batch)
+HPDF_Batch_New  (HPDF_UINT               num_workers,
+                 HPDF_Batch_Setup_Func   setup_fn,
+                 HPDF_Batch_Done_Func    done_fn,
+                 HPDF_Error_Handler      user_error_fn,
+                 void                   *user_data);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Batch_Submit  (HPDF_Batch              batch,
+                    HPDF_Batch_Fill_Func    fill_fn,
+                    HPDF_Batch_Write_Func   write_fn,
+                    void                   *job_data);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Batch_Wait  (HPDF_Batch         batch,
+                  HPDF_BatchStats   *stats);
+
+
+HPDF_EXPORT(void)
+HPDF_Batch_Free  (HPDF_Batch  batch);
+
+
 /*--------------------------------------------------------------------------*/
 /*----- info dictionary ----------------------------------------------------*/
 
@@ -986,6 +1164,26 @@ HPDF_SetCompressionMode  (HPDF_Doc    pdf,
                           HPDF_UINT   mode);
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetFontCacheSize  (HPDF_Doc    pdf,
+                        HPDF_UINT   max_size);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetDedupMode  (HPDF_Doc    pdf,
+                    HPDF_BOOL   mode);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetConcurrentPages  (HPDF_Doc    pdf,
+                          HPDF_BOOL   mode);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_MergePage  (HPDF_Doc    pdf,
+                 HPDF_Page   page);
+
+
 /*--------------------------------------------------------------------------*/
 /*----- font ---------------------------------------------------------------*/
 
@@ -0,0 +1,39 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_batch.h
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#ifndef _HPDF_BATCH_H
+#define _HPDF_BATCH_H
+
+#include "hpdf_doc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HPDF_BATCH_SIG_BYTES 0x42415443L
+
+/* the record holds the threads and locks of the platform, it is defined in
+ * hpdf_batch.c.
+ */
+typedef struct _HPDF_Batch_Rec  *HPDF_Batch;
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _HPDF_BATCH_H */
+
@@ -58,6 +58,16 @@
 /*----- parameters in relation to performance --------------------------------*/
 
 /* default buffer size of memory-stream-object */
+/* the pointers of the loops over pixels are not aliased */
+#if defined(_MSC_VER)
+#define HPDF_RESTRICT               __restrict
+#elif defined(__GNUC__) || defined(__clang__)
+#define HPDF_RESTRICT               __restrict__
+#else
+#define HPDF_RESTRICT
+#endif
+
+
 #define HPDF_STREAM_BUF_SIZ         4096
 
 /* default array size of list-object */
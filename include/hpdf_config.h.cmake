@@ -25,6 +25,18 @@
 /* Define to 1 if you have the <string.h> header file. */
 #cmakedefine LIBHPDF_HAVE_STRING_H
 
+/* Define to 1 if you have the POSIX threads library. */
+#cmakedefine LIBHPDF_HAVE_PTHREAD
+
+/* Define to 1 if you have the <sys/mman.h> header file. */
+#cmakedefine LIBHPDF_HAVE_SYS_MMAN_H
+
+/* Define to 1 if you have the <sys/random.h> header file. */
+#cmakedefine LIBHPDF_HAVE_SYS_RANDOM_H
+
+/* Define to 1 if you have the <sys/sendfile.h> header file. */
+#cmakedefine LIBHPDF_HAVE_SYS_SENDFILE_H
+
 /* Define to 1 if you have the <sys/stat.h> header file. */
 #cmakedefine LIBHPDF_HAVE_SYS_STAT_H
 
@@ -55,6 +55,9 @@ typedef struct _HPDF_Doc_Rec {
     /* list for loaded fontdefs */
     HPDF_List         fontdef_list;
 
+    /* cache of embedded font programs */
+    HPDF_FontCache    font_cache;
+
     /* list for loaded encodings */
     HPDF_List         encoder_list;
 
@@ -63,6 +66,14 @@ typedef struct _HPDF_Doc_Rec {
     /* default compression mode */
     HPDF_BOOL         compression_mode;
 
+    /* deduplication of images and extgstates */
+    HPDF_BOOL         dedup_mode;
+    HPDF_List         dedup_list;
+
+    /* pages which are built concurrently */
+    HPDF_BOOL         concurrent_pages;
+    HPDF_List         page_arenas;
+
     HPDF_BOOL         encrypt_on;
     HPDF_EncryptDict  encrypt_dict;
 
@@ -154,6 +165,45 @@ HPDF_Doc_SetEncryptOff (HPDF_Doc  pdf);
 HPDF_STATUS
 HPDF_Doc_PrepareEncryption (HPDF_Doc  pdf);
 
+
+HPDF_STATUS
+HPDF_Doc_SaveToStream  (HPDF_Doc     pdf,
+                        HPDF_Stream  stream);
+
+
+/*----- deduplication -------------------------------------------------------*/
+
+HPDF_Image
+HPDF_Doc_DedupImage  (HPDF_Doc    pdf,
+                      HPDF_Image  image,
+                      HPDF_UINT   obj_count);
+
+
+HPDF_STATUS
+HPDF_Doc_MarkDuplicates  (HPDF_Doc  pdf);
+
+
+void
+HPDF_Doc_UnmarkDuplicates  (HPDF_Doc  pdf);
+
+
+void
+HPDF_Doc_ClearDedupList  (HPDF_Doc  pdf);
+
+
+/*----- concurrent pages ----------------------------------------------------*/
+
+HPDF_Page
+HPDF_Doc_NewConcurrentPage  (HPDF_Doc  pdf);
+
+
+HPDF_STATUS
+HPDF_Doc_MergePages  (HPDF_Doc  pdf);
+
+
+void
+HPDF_Doc_FreePageArenas  (HPDF_Doc  pdf);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
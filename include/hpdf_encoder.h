@@ -80,6 +80,14 @@ typedef struct _HPDF_ParseText_Rec {
     HPDF_UINT        index;
     HPDF_UINT        len;
     HPDF_ByteType    byte_type;
+
+    /* the state of an encoder which decodes the characters itself (UTF-8),
+     * and the unicode of the last character it decoded. it is kept here
+     * and not in the encoder, so that an encoder can parse several texts
+     * at the same time.
+     */
+    HPDF_BYTE        encoder_state[16];
+    HPDF_UNICODE     unicode;
 } HPDF_ParseText_Rec;
 
 
@@ -161,6 +169,12 @@ HPDF_Encoder_ToUnicode  (HPDF_Encoder     encoder,
                          HPDF_UINT16      code);
 
 
+HPDF_UNICODE
+HPDF_Encoder_ParsedToUnicode  (HPDF_Encoder        encoder,
+                               HPDF_ParseText_Rec  *state,
+                               HPDF_UINT16         code);
+
+
 void
 HPDF_Encoder_Free  (HPDF_Encoder  encoder);
 
@@ -215,11 +229,26 @@ typedef struct _HPDF_UnicodeMap_Rec {
     HPDF_UINT16  unicode;
 } HPDF_UnicodeMap_Rec;
 
+typedef struct _HPDF_CMapTable_Rec  *HPDF_CMapTable;
+
+/* undefined characters are replaced to square */
+#define HPDF_CMAP_UNDEF_UNICODE  0x25A1
+
+typedef struct  _HPDF_CMapTable_Rec {
+      char                             name[HPDF_LIMIT_MAX_NAME_LEN + 1];
+      const HPDF_UNICODE              *unicode_map[256];
+      const HPDF_UINT16               *cid_map[256];
+      HPDF_CMapTable                   next;
+} HPDF_CMapTable_Rec;
+
+
 typedef struct _HPDF_CMapEncoderAttr_Rec  *HPDF_CMapEncoderAttr;
 
 typedef struct  _HPDF_CMapEncoderAttr_Rec {
-      HPDF_UNICODE                     unicode_map[256][256];
-      HPDF_UINT16                      cid_map[256][256];
+      const HPDF_UNICODE * const      *unicode_map;
+      const HPDF_UINT16 * const       *cid_map;
+      HPDF_CMapTable                   table;
+      HPDF_Encoder_Init_Func           init_fn;
       HPDF_UINT16                      jww_line_head[HPDF_MAX_JWW_NUM];
       HPDF_List                        cmap_range;
       HPDF_List                        notdef_range;
@@ -288,7 +317,7 @@ HPDF_CMapEncoder_AddCodeSpaceRange  (HPDF_Encoder        encoder,
                                      HPDF_CidRange_Rec   range);
 
 
-void
+HPDF_STATUS
 HPDF_CMapEncoder_SetUnicodeArray  (HPDF_Encoder                 encoder,
                                    const HPDF_UnicodeMap_Rec  *array1);
 
@@ -54,6 +54,12 @@ extern "C" {
 #define HPDF_MD5_KEY_LEN         16
 #define HPDF_PERMISSION_PAD      0xFFFFFFC0
 #define HPDF_ARC4_BUF_SIZE       256
+#define HPDF_FILE_KEY_MAX        32
+#define HPDF_SALTED_KEY_LEN      48
+#define HPDF_UTF8_PASSWD_LEN     127
+#define HPDF_AES_BLOCK_LEN       16
+#define HPDF_AES_MAX_ROUNDS      14
+#define HPDF_ENCRYPT_OVERHEAD    (HPDF_AES_BLOCK_LEN * 2)
 
 
 typedef struct HPDF_MD5Context
@@ -71,6 +77,18 @@ typedef struct _HPDF_ARC4_Ctx_Rec {
 } HPDF_ARC4_Ctx_Rec;
 
 
+/* the round keys are kept as words for the tables and as bytes for the
+ * AES instructions of the processor (AES-NI or the ARMv8 crypto extension),
+ * which are used when hw is set.
+ */
+typedef struct _HPDF_AES_Ctx_Rec {
+    HPDF_UINT    rounds;
+    HPDF_BOOL    hw;
+    HPDF_UINT32  rk[4 * (HPDF_AES_MAX_ROUNDS + 1)];
+    HPDF_BYTE    rk_bytes[HPDF_AES_BLOCK_LEN * (HPDF_AES_MAX_ROUNDS + 1)];
+} HPDF_AES_Ctx_Rec;
+
+
 typedef struct _HPDF_Encrypt_Rec  *HPDF_Encrypt;
 
 typedef struct _HPDF_Encrypt_Rec {
@@ -85,20 +103,62 @@ typedef struct _HPDF_Encrypt_Rec {
     /* user-password (not encrypted) */
     HPDF_BYTE          user_passwd[HPDF_PASSWD_LEN];
 
+    /* passwords of revision 6 (not padded) */
+    HPDF_BYTE          owner_passwd_utf8[HPDF_UTF8_PASSWD_LEN];
+    HPDF_UINT          owner_passwd_len;
+    HPDF_BYTE          user_passwd_utf8[HPDF_UTF8_PASSWD_LEN];
+    HPDF_UINT          user_passwd_len;
+
     /* owner-password (encrypted) */
-    HPDF_BYTE          owner_key[HPDF_PASSWD_LEN];
+    HPDF_BYTE          owner_key[HPDF_SALTED_KEY_LEN];
 
     /* user-password (encrypted) */
-    HPDF_BYTE          user_key[HPDF_PASSWD_LEN];
+    HPDF_BYTE          user_key[HPDF_SALTED_KEY_LEN];
+
+    /* file encryption key encrypted by the passwords (revision 6) */
+    HPDF_BYTE          owner_enc_key[HPDF_FILE_KEY_MAX];
+    HPDF_BYTE          user_enc_key[HPDF_FILE_KEY_MAX];
+    HPDF_BYTE          perms[HPDF_AES_BLOCK_LEN];
 
     HPDF_INT           permission;
     HPDF_BYTE          encrypt_id[HPDF_ID_LEN];
-    HPDF_BYTE          encryption_key[HPDF_MD5_KEY_LEN + 5];
-    HPDF_BYTE          md5_encryption_key[HPDF_MD5_KEY_LEN];
-    HPDF_ARC4_Ctx_Rec  arc4ctx;
+    HPDF_BYTE          encryption_key[HPDF_FILE_KEY_MAX];
+
+    /* key schedules of the file key (revision 6) and of the
+     * initialization vectors of AES.
+     */
+    HPDF_AES_Ctx_Rec   aesctx;
+    HPDF_AES_Ctx_Rec   ivctx;
 } HPDF_Encrypt_Rec;
 
 
+/* the cipher state of one object. HPDF_Encrypt_Rec is only read while
+ * the document is written, so each object can have its own context.
+ */
+typedef struct _HPDF_CryptCtx_Rec  *HPDF_CryptCtx;
+
+typedef struct _HPDF_CryptCtx_Rec {
+    const HPDF_Encrypt_Rec  *key;
+    HPDF_UINT32             obj_id;
+    HPDF_UINT16             gen_no;
+
+    /* number of strings and streams started in the object */
+    HPDF_UINT32             count;
+
+    /* ARC4 state after the key schedule of the object */
+    HPDF_ARC4_Ctx_Rec       arc4init;
+    HPDF_ARC4_Ctx_Rec       arc4ctx;
+
+    /* AES-CBC state of the string or stream being encrypted */
+    const HPDF_AES_Ctx_Rec  *aes;
+    HPDF_AES_Ctx_Rec        aesctx;
+    HPDF_BYTE               cbc[HPDF_AES_BLOCK_LEN];
+    HPDF_BYTE               cbc_buf[HPDF_AES_BLOCK_LEN];
+    HPDF_UINT               cbc_buf_len;
+    HPDF_BOOL               iv_pending;
+} HPDF_CryptCtx_Rec;
+
+
 void
 HPDF_MD5Init  (struct HPDF_MD5Context  *ctx);
 
@@ -119,36 +179,62 @@ HPDF_PadOrTrancatePasswd  (const char  *pwd,
 
 
 void
-HPDF_Encrypt_Init  (HPDF_Encrypt  attr);
+HPDF_AES_KeyExpand  (HPDF_AES_Ctx_Rec  *ctx,
+                     const HPDF_BYTE   *key,
+                     HPDF_UINT         key_len);
 
 
 void
-HPDF_Encrypt_CreateUserKey  (HPDF_Encrypt  attr);
+HPDF_AES_EncryptBlock  (const HPDF_AES_Ctx_Rec  *ctx,
+                        const HPDF_BYTE         *in,
+                        HPDF_BYTE               *out);
 
 
 void
-HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr);
+HPDF_AES_EncryptCBC  (const HPDF_AES_Ctx_Rec  *ctx,
+                      const HPDF_BYTE         *iv,
+                      const HPDF_BYTE         *in,
+                      HPDF_BYTE               *out,
+                      HPDF_UINT               len);
 
 
 void
+HPDF_Encrypt_Init  (HPDF_Encrypt  attr);
+
+
+HPDF_STATUS
+HPDF_Encrypt_CreateUserKey  (HPDF_Encrypt  attr);
+
+
+HPDF_STATUS
+HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr);
+
+
+HPDF_STATUS
 HPDF_Encrypt_CreateEncryptionKey  (HPDF_Encrypt  attr);
 
 
 void
-HPDF_Encrypt_InitKey  (HPDF_Encrypt  attr,
-                       HPDF_UINT32       object_id,
-                       HPDF_UINT16       gen_no);
+HPDF_CryptCtx_Init  (HPDF_CryptCtx           ctx,
+                     const HPDF_Encrypt_Rec  *key,
+                     HPDF_UINT32             object_id,
+                     HPDF_UINT16             gen_no);
 
 
 void
-HPDF_Encrypt_Reset  (HPDF_Encrypt  attr);
+HPDF_CryptCtx_Reset  (HPDF_CryptCtx  ctx);
 
 
-void
-HPDF_Encrypt_CryptBuf  (HPDF_Encrypt  attr,
-                        const HPDF_BYTE   *src,
-                        HPDF_BYTE         *dst,
-                        HPDF_UINT         len);
+HPDF_UINT
+HPDF_CryptCtx_CryptBuf  (HPDF_CryptCtx    ctx,
+                         const HPDF_BYTE  *src,
+                         HPDF_BYTE        *dst,
+                         HPDF_UINT        len);
+
+
+HPDF_UINT
+HPDF_CryptCtx_CryptFinal  (HPDF_CryptCtx  ctx,
+                           HPDF_BYTE      *dst);
 
 #ifdef __cplusplus
 }
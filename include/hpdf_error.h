@@ -148,6 +148,10 @@ extern "C" {
 #define HPDF_PAGE_INVALID_BOUNDARY                0x1086
 /*                                                0x1087 */
 #define HPDF_INVALID_SHADING_TYPE                 0x1088
+#define HPDF_INVALID_JPX_DATA                     0x1089
+#define HPDF_INVALID_JBIG2_DATA                   0x108A
+#define HPDF_THREAD_CREATE_ERROR                  0x108B
+#define HPDF_RANDOM_SOURCE_ERROR                  0x108C
 
 /*---------------------------------------------------------------------------*/
 
@@ -46,7 +46,9 @@ typedef HPDF_Dict HPDF_Font;
 typedef HPDF_TextWidth
 (*HPDF_Font_TextWidths_Func)  (HPDF_Font        font,
                              const HPDF_BYTE  *text,
-                             HPDF_UINT        len);
+                             HPDF_UINT        len,
+                             HPDF_BYTE        *used,
+                             HPDF_Error       error);
 
 
 typedef HPDF_UINT
@@ -58,7 +60,14 @@ typedef HPDF_UINT
                               HPDF_REAL        charspace,
                               HPDF_REAL        wordspace,
                               HPDF_BOOL        wordwrap,
-                              HPDF_REAL        *real_width);
+                              HPDF_REAL        *real_width,
+                              HPDF_BYTE        *used,
+                              HPDF_Error       error);
+
+
+typedef void
+(*HPDF_Font_MergeUsed_Func)  (HPDF_Font         font,
+                            const HPDF_BYTE  *used);
 
 
 typedef struct _HPDF_FontAttr_Rec  *HPDF_FontAttr;
@@ -68,6 +77,7 @@ typedef struct _HPDF_FontAttr_Rec {
     HPDF_WritingMode            writing_mode;
     HPDF_Font_TextWidths_Func   text_width_fn;
     HPDF_Font_MeasureText_Func  measure_text_fn;
+    HPDF_Font_MergeUsed_Func    merge_used_fn;
     HPDF_FontDef                fontdef;
     HPDF_Encoder                encoder;
 
@@ -78,10 +88,19 @@ typedef struct _HPDF_FontAttr_Rec {
     HPDF_INT16*                 widths;
     HPDF_BYTE*                  used;
 
+    /* the size of the bitmap in which the codes used by a concurrent page
+     * are recorded (see HPDF_Font_TextWidthEx), 0 if none is needed.
+     */
+    HPDF_UINT                   used_size;
+
     HPDF_Xref                   xref;
     HPDF_Font                   descendant_font;
     HPDF_Dict                   map_stream;
     HPDF_Dict                   cmap_stream;
+    HPDF_Dict                   to_unicode_stream;
+    HPDF_BOOL                   map_subsetted;
+    HPDF_UINT16*                cid_to_gid;
+    HPDF_UINT                   cid_count;
 } HPDF_FontAttr_Rec;
 
 
@@ -107,6 +126,33 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
 HPDF_BOOL
 HPDF_Font_Validate  (HPDF_Font font);
 
+
+HPDF_TextWidth
+HPDF_Font_TextWidthEx  (HPDF_Font        font,
+                        const HPDF_BYTE  *text,
+                        HPDF_UINT        len,
+                        HPDF_BYTE        *used,
+                        HPDF_Error       error);
+
+
+HPDF_UINT
+HPDF_Font_MeasureTextEx  (HPDF_Font          font,
+                          const HPDF_BYTE   *text,
+                          HPDF_UINT          len,
+                          HPDF_REAL          width,
+                          HPDF_REAL          font_size,
+                          HPDF_REAL          char_space,
+                          HPDF_REAL          word_space,
+                          HPDF_BOOL          wordwrap,
+                          HPDF_REAL         *real_width,
+                          HPDF_BYTE         *used,
+                          HPDF_Error         error);
+
+
+void
+HPDF_Font_MergeUsed  (HPDF_Font         font,
+                      const HPDF_BYTE  *used);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
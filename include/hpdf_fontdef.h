@@ -131,6 +131,68 @@ HPDF_BOOL
 HPDF_FontDef_Validate  (HPDF_FontDef  fontdef);
 
 
+/*----------------------------------------------------------------------------*/
+/*----- HPDF_FontCache  ------------------------------------------------------*/
+
+typedef struct _HPDF_FontCacheEntry_Rec  *HPDF_FontCacheEntry;
+
+typedef struct _HPDF_FontCacheEntry_Rec {
+    HPDF_FontDef   fontdef;
+    HPDF_UINT32    hash;
+    HPDF_BOOL      subset;
+    HPDF_UINT      filter;
+    HPDF_BYTE     *glyphs;       /* glyph-usage bitmap */
+    HPDF_UINT      glyphs_len;
+    HPDF_BYTE     *data;
+    HPDF_UINT      len;
+    HPDF_UINT      length1;
+} HPDF_FontCacheEntry_Rec;
+
+
+typedef struct _HPDF_FontCache_Rec  *HPDF_FontCache;
+
+typedef struct _HPDF_FontCache_Rec {
+    HPDF_MMgr      mmgr;
+    HPDF_List      entries;      /* most recently used first */
+    HPDF_UINT      size;
+    HPDF_UINT      max_size;
+} HPDF_FontCache_Rec;
+
+
+HPDF_FontCache
+HPDF_FontCache_New  (HPDF_MMgr  mmgr,
+                     HPDF_UINT  max_size);
+
+
+void
+HPDF_FontCache_Free  (HPDF_FontCache  cache);
+
+
+void
+HPDF_FontCache_SetMaxSize  (HPDF_FontCache  cache,
+                            HPDF_UINT       max_size);
+
+
+HPDF_FontCacheEntry
+HPDF_FontCache_Find  (HPDF_FontCache    cache,
+                      HPDF_FontDef      fontdef,
+                      HPDF_BOOL         subset,
+                      HPDF_UINT         filter,
+                      const HPDF_BYTE  *glyphs,
+                      HPDF_UINT         glyphs_len);
+
+
+HPDF_STATUS
+HPDF_FontCache_Add  (HPDF_FontCache    cache,
+                     HPDF_FontDef      fontdef,
+                     HPDF_BOOL         subset,
+                     HPDF_UINT         filter,
+                     const HPDF_BYTE  *glyphs,
+                     HPDF_UINT         glyphs_len,
+                     HPDF_Stream       data,
+                     HPDF_UINT         length1);
+
+
 /*----------------------------------------------------------------------------*/
 /*----- HPDF_Type1FontDef  ---------------------------------------------------*/
 
@@ -141,6 +203,7 @@ typedef struct _HPDF_Type1FontDefAttrRec {
     HPDF_BYTE       last_char;                                /* Required */
     HPDF_CharData  *widths;                                   /* Required */
     HPDF_UINT       widths_count;
+    HPDF_BOOL       widths_shared;
 
     HPDF_INT16      leading;
     char      *char_set;
@@ -166,6 +229,11 @@ HPDF_Type1FontDef_Load  (HPDF_MMgr         mmgr,
                          HPDF_Stream       font_data);
 
 
+HPDF_STATUS
+HPDF_Type1FontDef_SaveMetrics  (HPDF_FontDef  fontdef,
+                                HPDF_Stream   stream);
+
+
 HPDF_FontDef
 HPDF_Type1FontDef_Duplicate  (HPDF_MMgr     mmgr,
                               HPDF_FontDef  src);
@@ -176,6 +244,11 @@ HPDF_Type1FontDef_SetWidths  (HPDF_FontDef         fontdef,
                               const HPDF_CharData  *widths);
 
 
+HPDF_STATUS
+HPDF_Type1FontDef_SetSharedWidths  (HPDF_FontDef          fontdef,
+                                    const HPDF_CharData  *widths);
+
+
 HPDF_INT16
 HPDF_Type1FontDef_GetWidthByName  (HPDF_FontDef     fontdef,
                                    const char  *gryph_name);
@@ -312,6 +385,17 @@ typedef struct _HPDF_TTFontDefAttr_Rec {
 
     HPDF_BOOL                embedding;
     HPDF_BOOL                is_cidfont;
+    HPDF_BOOL                keep_gids;
+
+    /* OpenType fonts with CFF outlines */
+    HPDF_BOOL                is_cff;
+    HPDF_UINT32              cff_offset;
+    HPDF_UINT32              cff_length;
+
+    HPDF_UINT16             *subset_gids;   /* original gid -> subset gid */
+    HPDF_UINT16              num_subset_glyphs;
+
+    HPDF_FontCache           cache;
 
     HPDF_Stream              stream;
 } HPDF_TTFontDefAttr_Rec;
@@ -355,11 +439,30 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
                               HPDF_Stream    stream);
 
 
+HPDF_STATUS
+HPDF_TTFontDef_SaveFontFile  (HPDF_FontDef   fontdef,
+                              HPDF_Dict      font_data);
+
+
 HPDF_Box
 HPDF_TTFontDef_GetCharBBox  (HPDF_FontDef   fontdef,
                              HPDF_UINT16    unicode);
 
 
+HPDF_STATUS
+HPDF_TTFontDef_ValidateCFF  (HPDF_FontDef   fontdef);
+
+
+HPDF_STATUS
+HPDF_TTFontDef_SaveCFFData  (HPDF_FontDef        fontdef,
+                             HPDF_Stream         stream,
+                             const HPDF_UINT16  *cid_to_gid,
+                             HPDF_UINT           cid_count,
+                             const char         *registry,
+                             const char         *ordering,
+                             HPDF_INT            supplement);
+
+
 void
 HPDF_TTFontDef_SetTagName  (HPDF_FontDef   fontdef,
                             char     *tag);
@@ -24,6 +24,44 @@
 extern "C" {
 #endif
 
+#define HPDF_PREPARED_IMAGE_SIG_BYTES 0x50494D47L
+
+/*----- HPDF_PreparedImage --------------------------------------------------*/
+
+typedef struct _HPDF_PreparedImage_Rec  *HPDF_PreparedImage;
+
+typedef struct _HPDF_PreparedImage_Rec {
+    HPDF_UINT32     sig_bytes;
+    HPDF_MMgr       mmgr;
+    HPDF_Error_Rec  error;
+    HPDF_Xref       xref;
+    HPDF_Image      image;
+} HPDF_PreparedImage_Rec;
+
+
+typedef HPDF_STATUS
+(*HPDF_Image_LoadDataFunc)  (HPDF_Image  image,
+                             void        *param);
+
+
+HPDF_STATUS
+HPDF_Image_SetDelayedLoading  (HPDF_Image               image,
+                               HPDF_Image_LoadDataFunc  load_fn,
+                               const void              *param,
+                               HPDF_UINT                param_len);
+
+
+HPDF_STATUS
+HPDF_Image_LoadDelayedData  (HPDF_Image  image);
+
+
+HPDF_BOOL
+HPDF_Image_GetDelayedLoading  (HPDF_Image                image,
+                               HPDF_Image_LoadDataFunc  *load_fn,
+                               const void              **param,
+                               HPDF_UINT                *param_len);
+
+
 HPDF_Image
 HPDF_Image_Load1BitImageFromMem  (HPDF_MMgr  mmgr,
                           const HPDF_BYTE   *buf,
@@ -31,7 +69,9 @@ HPDF_Image_Load1BitImageFromMem  (HPDF_MMgr  mmgr,
                           HPDF_UINT          width,
                           HPDF_UINT          height,
                           HPDF_UINT          line_width,
-                          HPDF_BOOL          top_is_first
+                          HPDF_BOOL          black_is1,
+                          HPDF_BOOL          top_is_first,
+                          HPDF_BOOL          delayed_loading
                           );
 
 
@@ -50,12 +90,39 @@ HPDF_Image_LoadJpegImage  (HPDF_MMgr        mmgr,
                            HPDF_Stream      jpeg_data,
                            HPDF_Xref        xref);
 
+HPDF_Image
+HPDF_Image_LoadJpegImageFromFile  (HPDF_MMgr        mmgr,
+                                   const char      *filename,
+                                   HPDF_Xref        xref);
+
 HPDF_Image
 HPDF_Image_LoadJpegImageFromMem  (HPDF_MMgr        mmgr,
                             const HPDF_BYTE       *buf,
                                   HPDF_UINT        size,
                                   HPDF_Xref        xref);
 
+HPDF_Image
+HPDF_Image_LoadJpxImageFromFile  (HPDF_MMgr        mmgr,
+                                  const char      *filename,
+                                  HPDF_Xref        xref);
+
+HPDF_Image
+HPDF_Image_LoadJpxImageFromMem  (HPDF_MMgr          mmgr,
+                                 const HPDF_BYTE   *buf,
+                                 HPDF_UINT          size,
+                                 HPDF_Xref          xref);
+
+HPDF_Image
+HPDF_Image_LoadJbig2ImageFromFile  (HPDF_MMgr        mmgr,
+                                    const char      *filename,
+                                    HPDF_Xref        xref);
+
+HPDF_Image
+HPDF_Image_LoadJbig2ImageFromMem  (HPDF_MMgr          mmgr,
+                                   const HPDF_BYTE   *buf,
+                                   HPDF_UINT          size,
+                                   HPDF_Xref          xref);
+
 HPDF_Image
 HPDF_Image_LoadRawImage  (HPDF_MMgr          mmgr,
                           HPDF_Stream        stream,
@@ -65,6 +132,15 @@ HPDF_Image_LoadRawImage  (HPDF_MMgr          mmgr,
                           HPDF_ColorSpace    color_space);
 
 
+HPDF_Image
+HPDF_Image_LoadRawImageFromFile  (HPDF_MMgr          mmgr,
+                                  const char        *filename,
+                                  HPDF_Xref          xref,
+                                  HPDF_UINT          width,
+                                  HPDF_UINT          height,
+                                  HPDF_ColorSpace    color_space);
+
+
 HPDF_Image
 HPDF_Image_LoadRawImageFromMem  (HPDF_MMgr          mmgr,
                                  const HPDF_BYTE   *buf,
@@ -75,6 +151,20 @@ HPDF_Image_LoadRawImageFromMem  (HPDF_MMgr          mmgr,
                                  HPDF_UINT          bits_per_component);
 
 
+HPDF_Image
+HPDF_Image_LoadRawImageFromUserMem  (HPDF_MMgr           mmgr,
+                                     const HPDF_BYTE    *buf,
+                                     HPDF_UINT           size,
+                                     HPDF_Xref           xref,
+                                     HPDF_UINT           width,
+                                     HPDF_UINT           height,
+                                     HPDF_ColorSpace     color_space,
+                                     HPDF_UINT           bits_per_component,
+                                     HPDF_BOOL           deflated,
+                                     HPDF_Release_Func   release_fn,
+                                     void               *user_data);
+
+
 HPDF_BOOL
 HPDF_Image_Validate (HPDF_Image  image);
 
@@ -97,13 +97,13 @@ typedef struct _HPDF_Obj_Header {
 HPDF_STATUS
 HPDF_Obj_WriteValue  (void          *obj,
                       HPDF_Stream   stream,
-                      HPDF_Encrypt  e);
+                      HPDF_CryptCtx e);
 
 
 HPDF_STATUS
 HPDF_Obj_Write  (void          *obj,
                  HPDF_Stream   stream,
-                 HPDF_Encrypt  e);
+                 HPDF_CryptCtx e);
 
 
 void
@@ -280,7 +280,7 @@ HPDF_String_Free  (HPDF_String  obj);
 HPDF_STATUS
 HPDF_String_Write  (HPDF_String  obj,
                     HPDF_Stream  stream,
-                    HPDF_Encrypt e);
+                    HPDF_CryptCtx e);
 
 HPDF_INT32
 HPDF_String_Cmp  (HPDF_String s1,
@@ -325,7 +325,7 @@ HPDF_Binary_Free  (HPDF_Binary  obj);
 HPDF_STATUS
 HPDF_Binary_Write  (HPDF_Binary  obj,
                     HPDF_Stream  stream,
-                    HPDF_Encrypt e);
+                    HPDF_CryptCtx e);
 
 
 HPDF_UINT
@@ -361,7 +361,7 @@ HPDF_Array_Free  (HPDF_Array  array);
 HPDF_STATUS
 HPDF_Array_Write  (HPDF_Array   array,
                    HPDF_Stream  stream,
-                   HPDF_Encrypt e);
+                   HPDF_CryptCtx e);
 
 
 HPDF_STATUS
@@ -465,7 +465,7 @@ HPDF_Dict_Free  (HPDF_Dict  dict);
 HPDF_STATUS
 HPDF_Dict_Write  (HPDF_Dict     dict,
                   HPDF_Stream   stream,
-                  HPDF_Encrypt  e);
+                  HPDF_CryptCtx e);
 
 
 const char*
@@ -571,6 +571,16 @@ HPDF_Xref_Add  (HPDF_Xref  xref,
                 void       *obj);
 
 
+void
+HPDF_Xref_Truncate  (HPDF_Xref  xref,
+                     HPDF_UINT  count);
+
+
+HPDF_STATUS
+HPDF_Xref_Merge  (HPDF_Xref  xref,
+                  HPDF_Xref  src);
+
+
 HPDF_XrefEntry
 HPDF_Xref_GetEntry  (HPDF_Xref  xref,
                      HPDF_UINT  index);
@@ -48,6 +48,31 @@ HPDF_Page_InsertBefore  (HPDF_Page   page,
                          HPDF_Page   target);
 
 
+/* a page which is built concurrently with the other pages of its document
+ * allocates its objects from its own mmgr and numbers them in its own xref
+ * until it is merged into the document.
+ */
+typedef struct _HPDF_PageArena_Rec  *HPDF_PageArena;
+
+typedef struct _HPDF_PageArena_Rec {
+    HPDF_MMgr          doc_mmgr;
+    HPDF_MMgr          mmgr;
+    HPDF_Error_Rec     error;
+    HPDF_Xref          xref;
+    HPDF_List          fonts_used;
+    HPDF_BOOL          merged;
+} HPDF_PageArena_Rec;
+
+
+/* the characters of a font which are used by a concurrent page */
+typedef struct _HPDF_PageFontUsed_Rec  *HPDF_PageFontUsed;
+
+typedef struct _HPDF_PageFontUsed_Rec {
+    HPDF_Font          font;
+    HPDF_BYTE         *used;
+} HPDF_PageFontUsed_Rec;
+
+
 typedef struct _HPDF_PageAttr_Rec  *HPDF_PageAttr;
 
 typedef struct _HPDF_PageAttr_Rec {
@@ -65,6 +90,7 @@ typedef struct _HPDF_PageAttr_Rec {
     HPDF_Dict          contents;
     HPDF_Stream        stream;
     HPDF_Xref          xref;
+    HPDF_PageArena     arena;
     HPDF_UINT          compression_mode;
 	HPDF_PDFVer       *ver; 
 } HPDF_PageAttr_Rec;
@@ -128,6 +154,16 @@ HPDF_Page_CheckState  (HPDF_Page  page,
                        HPDF_UINT  mode);
 
 
+HPDF_MMgr
+HPDF_Page_GetDocMMgr  (HPDF_Page  page);
+
+
+HPDF_STATUS
+HPDF_Page_GetFontUsed  (HPDF_Page    page,
+                        HPDF_Font    font,
+                        HPDF_BYTE  **used);
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -34,7 +34,10 @@ typedef enum _HPDF_StreamType {
     HPDF_STREAM_UNKNOWN = 0,
     HPDF_STREAM_CALLBACK,
     HPDF_STREAM_FILE,
-    HPDF_STREAM_MEMORY
+    HPDF_STREAM_MEMORY,
+    HPDF_STREAM_MAPPED,
+    HPDF_STREAM_DEFERRED,
+    HPDF_STREAM_BORROWED
 } HPDF_StreamType;
 
 #define HPDF_STREAM_FILTER_NONE          0x0000
@@ -43,6 +46,9 @@ typedef enum _HPDF_StreamType {
 #define HPDF_STREAM_FILTER_FLATE_DECODE  0x0400
 #define HPDF_STREAM_FILTER_DCT_DECODE    0x0800
 #define HPDF_STREAM_FILTER_CCITT_DECODE  0x1000
+#define HPDF_STREAM_FILTER_PREENCODED    0x2000
+#define HPDF_STREAM_FILTER_JPX_DECODE    0x4000
+#define HPDF_STREAM_FILTER_JBIG2_DECODE  0x8000
 
 typedef enum _HPDF_WhenceMode {
     HPDF_SEEK_SET = 0,
@@ -96,6 +102,16 @@ typedef struct _HPDF_MemStreamAttr_Rec {
 } HPDF_MemStreamAttr_Rec;
 
 
+typedef struct _HPDF_MappedStreamAttr_Rec  *HPDF_MappedStreamAttr;
+
+
+typedef struct _HPDF_MappedStreamAttr_Rec {
+    HPDF_BYTE  *buf;
+    HPDF_UINT  buf_siz;
+    HPDF_UINT  r_pos;
+} HPDF_MappedStreamAttr_Rec;
+
+
 typedef struct _HPDF_Stream_Rec {
     HPDF_UINT32               sig_bytes;
     HPDF_StreamType           type;
@@ -146,7 +162,7 @@ HPDF_STATUS
 HPDF_Stream_WriteToStream  (HPDF_Stream   src,
                             HPDF_Stream   dst,
                             HPDF_UINT     filter,
-                            HPDF_Encrypt  e);
+                            HPDF_CryptCtx e);
 
 
 HPDF_Stream
@@ -157,6 +173,36 @@ HPDF_Stream
 HPDF_FileWriter_New  (HPDF_MMgr    mmgr,
                       const char  *fname);
 
+
+HPDF_Stream
+HPDF_MappedReader_New  (HPDF_MMgr    mmgr,
+                        const char  *fname);
+
+const HPDF_BYTE*
+HPDF_MappedReader_GetBufPtr  (HPDF_Stream  stream,
+                              HPDF_UINT    offset,
+                              HPDF_UINT    len);
+
+
+HPDF_Stream
+HPDF_BorrowedReader_New  (HPDF_MMgr           mmgr,
+                          const HPDF_BYTE    *buf,
+                          HPDF_UINT           size,
+                          HPDF_Release_Func   release_fn,
+                          void               *user_data);
+
+
+HPDF_Stream
+HPDF_DeferredReader_New  (HPDF_MMgr    mmgr,
+                          const char  *fname);
+
+void
+HPDF_DeferredReader_Release  (HPDF_Stream  stream);
+
+const char*
+HPDF_DeferredReader_GetFileName  (HPDF_Stream  stream);
+
+
 #if defined(WIN32)
 HPDF_Stream
 HPDF_FileReader_NewW (HPDF_MMgr       mmgr,
@@ -275,7 +321,12 @@ HPDF_STATUS
 HPDF_Stream_WriteBinary  (HPDF_Stream      stream,
                           const HPDF_BYTE  *data,
                           HPDF_UINT        len,
-                          HPDF_Encrypt     e);
+                          HPDF_CryptCtx    e);
+
+
+HPDF_STATUS
+HPDF_Stream_WriteBinaryFinal  (HPDF_Stream   stream,
+                               HPDF_CryptCtx e);
 
 
 HPDF_STATUS
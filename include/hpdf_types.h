@@ -177,7 +177,9 @@ typedef enum _HPDF_PdfVer {
 
 typedef enum  _HPDF_EncryptMode {
     HPDF_ENCRYPT_R2    = 2,
-    HPDF_ENCRYPT_R3    = 3
+    HPDF_ENCRYPT_R3    = 3,
+    HPDF_ENCRYPT_R4    = 4,
+    HPDF_ENCRYPT_R6    = 6
 } HPDF_EncryptMode;
 
 
@@ -194,6 +196,31 @@ typedef void
 (HPDF_STDCALL *HPDF_Free_Func)  (void  *aptr);
 
 
+typedef void
+(HPDF_STDCALL *HPDF_Release_Func)  (const HPDF_BYTE  *buf,
+                                    void             *user_data);
+
+
+/*---------------------------------------------------------------------------*/
+/*------ batch statistics ---------------------------------------------------*/
+
+/* the jobs which were finished since the previous HPDF_Batch_Wait. the
+ * times are in seconds, the latency of a job is the time from its submit
+ * to its end.
+ */
+typedef struct _HPDF_BatchStats {
+    HPDF_UINT     jobs;
+    HPDF_UINT     failed;
+    HPDF_UINT     steals;
+    HPDF_UINT64   bytes;
+    HPDF_DOUBLE   elapsed;
+    HPDF_DOUBLE   jobs_per_sec;
+    HPDF_DOUBLE   min_latency;
+    HPDF_DOUBLE   avg_latency;
+    HPDF_DOUBLE   max_latency;
+} HPDF_BatchStats;
+
+
 /*---------------------------------------------------------------------------*/
 /*------ text width struct --------------------------------------------------*/
 
@@ -266,6 +293,16 @@ typedef enum _HPDF_ColorSpace {
     HPDF_CS_EOF
 } HPDF_ColorSpace;
 
+/*---------------------------------------------------------------------------*/
+/*----- filters to downsample images ----------------------------------------*/
+
+typedef enum _HPDF_ResampleFilter {
+    HPDF_RESAMPLE_BOX = 0,
+    HPDF_RESAMPLE_BILINEAR,
+    HPDF_RESAMPLE_LANCZOS,
+    HPDF_RESAMPLE_EOF
+} HPDF_ResampleFilter;
+
 /*---------------------------------------------------------------------------*/
 /*----- HPDF_RGBColor struct ------------------------------------------------*/
 
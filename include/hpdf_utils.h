@@ -114,6 +114,14 @@ void
 HPDF_UInt16Swap  (HPDF_UINT16  *value);
 
 
+void
+HPDF_GlobalLock  (void);
+
+
+void
+HPDF_GlobalUnlock  (void);
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
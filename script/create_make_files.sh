@@ -1,5 +1,10 @@
 #/bin/sh
 
+# the makefiles do not generate the name indexes of the builtin tables,
+# they use the copies checked in under src/
+cmake -DSRC_DIR=src -DINC_DIR=include -DOUT_DIR=src \
+    -P cmake/modules/name_index.cmake || exit 1
+
 ./configure --system-name=GCC
 mv Makefile script/Makefile.gcc
 ./configure --system-name=GCC --shared
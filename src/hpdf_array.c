@@ -91,7 +91,7 @@ HPDF_Array_Free  (HPDF_Array  array)
 HPDF_STATUS
 HPDF_Array_Write  (HPDF_Array    array,
                    HPDF_Stream   stream,
-                   HPDF_Encrypt  e)
+                   HPDF_CryptCtx e)
 {
     HPDF_UINT i;
     HPDF_STATUS ret;
@@ -0,0 +1,855 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_batch.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <time.h>
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf.h"
+
+#if defined(WIN32)
+#include <windows.h>
+#define HPDF_BATCH_THREADS
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+#define HPDF_BATCH_THREADS
+#endif
+
+/*
+ *  A batch makes many small documents on a pool of worker threads.
+ *
+ *  Each worker owns one document, which is created and passed to setup_fn
+ *  when the batch is created. The fonts and encodings loaded by setup_fn
+ *  stay loaded in the document: before each job the document is emptied
+ *  with HPDF_NewDoc, which keeps the loaded fontdefs, the encoders and the
+ *  cache of embedded font programs. The images which are used by all jobs
+ *  should be made once with the HPDF_Prepare* functions, and attached to
+ *  the document of each job with HPDF_AttachPreparedImage.
+ *
+ *  The submitted jobs are distributed over the queues of the workers. A
+ *  worker takes the oldest job of its own queue, and when its queue is
+ *  empty it steals the newest job of the queue of another worker.
+ *
+ *  When the platform has no threads, the jobs are run by HPDF_Batch_Wait
+ *  on the calling thread.
+ */
+
+#define HPDF_BATCH_MAX_WORKERS      256
+#define HPDF_BATCH_DEF_QUEUE_SIZE   16
+
+#if defined(WIN32)
+typedef SRWLOCK             HPDF_BatchLock;
+typedef CONDITION_VARIABLE  HPDF_BatchCond;
+typedef HANDLE              HPDF_BatchThread;
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+typedef pthread_mutex_t     HPDF_BatchLock;
+typedef pthread_cond_t      HPDF_BatchCond;
+typedef pthread_t           HPDF_BatchThread;
+#else
+typedef int                 HPDF_BatchLock;
+typedef int                 HPDF_BatchCond;
+typedef int                 HPDF_BatchThread;
+#endif
+
+
+typedef struct _HPDF_BatchJob_Rec {
+    HPDF_Batch_Fill_Func    fill_fn;
+    HPDF_Batch_Write_Func   write_fn;
+    void                   *job_data;
+    HPDF_DOUBLE             submit_time;
+} HPDF_BatchJob_Rec;
+
+
+/* a ring buffer of the jobs of a worker. */
+typedef struct _HPDF_BatchQueue_Rec {
+    HPDF_BatchLock          lock;
+    HPDF_BatchJob_Rec      *jobs;
+    HPDF_UINT               size;
+    HPDF_UINT               head;
+    HPDF_UINT               count;
+} HPDF_BatchQueue_Rec;
+
+
+typedef struct _HPDF_BatchWorker_Rec  *HPDF_BatchWorker;
+
+typedef struct _HPDF_BatchWorker_Rec {
+    HPDF_Batch              batch;
+    HPDF_UINT               index;
+    HPDF_BatchQueue_Rec     queue;
+    HPDF_Doc                pdf;
+    HPDF_BatchThread        thread;
+    HPDF_BOOL               started;
+    HPDF_UINT               victim;
+
+    /* statistics of the jobs since the previous HPDF_Batch_Wait */
+    HPDF_UINT               jobs;
+    HPDF_UINT               failed;
+    HPDF_UINT               steals;
+    HPDF_UINT64             bytes;
+    HPDF_DOUBLE             latency_sum;
+    HPDF_DOUBLE             latency_min;
+    HPDF_DOUBLE             latency_max;
+    HPDF_DOUBLE             last_end;
+} HPDF_BatchWorker_Rec;
+
+
+typedef struct _HPDF_Batch_Rec {
+    HPDF_UINT32             sig_bytes;
+    HPDF_MMgr               mmgr;
+    HPDF_Error_Rec          error;
+    HPDF_Batch_Done_Func    done_fn;
+
+    HPDF_BatchWorker_Rec   *workers;
+    HPDF_UINT               num_workers;
+    HPDF_UINT               next_worker;
+
+    /* guards queued, pending and stop */
+    HPDF_BatchLock          lock;
+    HPDF_BatchCond          work_cond;
+    HPDF_BatchCond          done_cond;
+    HPDF_UINT               queued;
+    HPDF_UINT               pending;
+    HPDF_BOOL               stop;
+
+    /* the time of the first submit since the previous HPDF_Batch_Wait */
+    HPDF_DOUBLE             start_time;
+} HPDF_Batch_Rec;
+
+
+/* passed to the writer stream of a job */
+typedef struct _HPDF_BatchOutput_Rec {
+    HPDF_BatchWorker        worker;
+    HPDF_BatchJob_Rec      *job;
+} HPDF_BatchOutput_Rec;
+
+
+static HPDF_BOOL
+TakeJob  (HPDF_BatchWorker    worker,
+          HPDF_BatchJob_Rec  *job);
+
+
+static void
+RunJob  (HPDF_BatchWorker    worker,
+         HPDF_BatchJob_Rec  *job);
+
+
+static void
+ResetStats  (HPDF_BatchWorker  worker);
+
+
+/*---------------------------------------------------------------------------*/
+/*----- platform ------------------------------------------------------------*/
+
+static void
+LockInit  (HPDF_BatchLock  *lock)
+{
+#if defined(WIN32)
+    InitializeSRWLock (lock);
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+    pthread_mutex_init (lock, NULL);
+#else
+    HPDF_UNUSED (lock);
+#endif
+}
+
+
+static void
+LockFree  (HPDF_BatchLock  *lock)
+{
+#if defined(LIBHPDF_HAVE_PTHREAD) && !defined(WIN32)
+    pthread_mutex_destroy (lock);
+#else
+    HPDF_UNUSED (lock);
+#endif
+}
+
+
+static void
+Lock  (HPDF_BatchLock  *lock)
+{
+#if defined(WIN32)
+    AcquireSRWLockExclusive (lock);
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+    pthread_mutex_lock (lock);
+#else
+    HPDF_UNUSED (lock);
+#endif
+}
+
+
+static void
+Unlock  (HPDF_BatchLock  *lock)
+{
+#if defined(WIN32)
+    ReleaseSRWLockExclusive (lock);
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+    pthread_mutex_unlock (lock);
+#else
+    HPDF_UNUSED (lock);
+#endif
+}
+
+
+static void
+CondInit  (HPDF_BatchCond  *cond)
+{
+#if defined(WIN32)
+    InitializeConditionVariable (cond);
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+    pthread_cond_init (cond, NULL);
+#else
+    HPDF_UNUSED (cond);
+#endif
+}
+
+
+static void
+CondFree  (HPDF_BatchCond  *cond)
+{
+#if defined(LIBHPDF_HAVE_PTHREAD) && !defined(WIN32)
+    pthread_cond_destroy (cond);
+#else
+    HPDF_UNUSED (cond);
+#endif
+}
+
+
+#ifdef HPDF_BATCH_THREADS
+static void
+CondWait  (HPDF_BatchCond  *cond,
+           HPDF_BatchLock  *lock)
+{
+#if defined(WIN32)
+    SleepConditionVariableSRW (cond, lock, INFINITE, 0);
+#else
+    pthread_cond_wait (cond, lock);
+#endif
+}
+
+
+static void
+CondSignal  (HPDF_BatchCond  *cond)
+{
+#if defined(WIN32)
+    WakeConditionVariable (cond);
+#else
+    pthread_cond_signal (cond);
+#endif
+}
+
+
+static void
+CondBroadcast  (HPDF_BatchCond  *cond)
+{
+#if defined(WIN32)
+    WakeAllConditionVariable (cond);
+#else
+    pthread_cond_broadcast (cond);
+#endif
+}
+#endif /* HPDF_BATCH_THREADS */
+
+
+/* seconds from an arbitrary point, not affected by changes of the clock. */
+static HPDF_DOUBLE
+Now  (void)
+{
+#if defined(WIN32)
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+
+    QueryPerformanceCounter (&count);
+    QueryPerformanceFrequency (&freq);
+
+    return (HPDF_DOUBLE)count.QuadPart / (HPDF_DOUBLE)freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (HPDF_DOUBLE)ts.tv_sec + (HPDF_DOUBLE)ts.tv_nsec / 1e9;
+#else
+    return (HPDF_DOUBLE)time (NULL);
+#endif
+}
+
+
+static HPDF_UINT
+CountProcessors  (void)
+{
+#if defined(WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo (&info);
+
+    return (HPDF_UINT)info.dwNumberOfProcessors;
+#elif defined(HPDF_BATCH_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+    return (n > 0) ? (HPDF_UINT)n : 1;
+#else
+    return 1;
+#endif
+}
+
+
+#ifdef HPDF_BATCH_THREADS
+
+static void
+WorkerLoop  (HPDF_BatchWorker  worker)
+{
+    HPDF_Batch batch = worker->batch;
+    HPDF_BatchJob_Rec job;
+
+    for (;;) {
+        if (TakeJob (worker, &job)) {
+            RunJob (worker, &job);
+
+            Lock (&batch->lock);
+            if (--batch->pending == 0)
+                CondBroadcast (&batch->done_cond);
+            Unlock (&batch->lock);
+
+            continue;
+        }
+
+        Lock (&batch->lock);
+        while (batch->queued == 0 && !batch->stop)
+            CondWait (&batch->work_cond, &batch->lock);
+
+        /* the jobs which are still queued are run before the end. */
+        if (batch->queued == 0 && batch->stop) {
+            Unlock (&batch->lock);
+            return;
+        }
+        Unlock (&batch->lock);
+    }
+}
+
+
+#if defined(WIN32)
+static DWORD WINAPI
+WorkerThread  (LPVOID  param)
+{
+    WorkerLoop ((HPDF_BatchWorker)param);
+    return 0;
+}
+#else
+static void*
+WorkerThread  (void  *param)
+{
+    WorkerLoop ((HPDF_BatchWorker)param);
+    return NULL;
+}
+#endif
+
+
+static HPDF_BOOL
+StartThread  (HPDF_BatchWorker  worker)
+{
+#if defined(WIN32)
+    worker->thread = CreateThread (NULL, 0, WorkerThread, worker, 0, NULL);
+    return (worker->thread != NULL);
+#else
+    return (pthread_create (&worker->thread, NULL, WorkerThread,
+                worker) == 0);
+#endif
+}
+
+
+static void
+JoinThread  (HPDF_BatchWorker  worker)
+{
+#if defined(WIN32)
+    WaitForSingleObject (worker->thread, INFINITE);
+    CloseHandle (worker->thread);
+#else
+    pthread_join (worker->thread, NULL);
+#endif
+}
+
+#endif /* HPDF_BATCH_THREADS */
+
+
+/*---------------------------------------------------------------------------*/
+/*----- queue ---------------------------------------------------------------*/
+
+/* called by the thread which submits the jobs, with the lock held. */
+static HPDF_STATUS
+PushJob  (HPDF_Batch           batch,
+          HPDF_BatchQueue_Rec  *queue,
+          HPDF_BatchJob_Rec    *job)
+{
+    if (queue->count == queue->size) {
+        HPDF_UINT size = queue->size ? queue->size * 2 :
+                HPDF_BATCH_DEF_QUEUE_SIZE;
+        HPDF_BatchJob_Rec *jobs;
+        HPDF_UINT i;
+
+        jobs = HPDF_GetMem (batch->mmgr, sizeof(HPDF_BatchJob_Rec) * size);
+        if (!jobs)
+            return HPDF_Error_GetCode (&batch->error);
+
+        for (i = 0; i < queue->count; i++)
+            jobs[i] = queue->jobs[(queue->head + i) % queue->size];
+
+        HPDF_FreeMem (batch->mmgr, queue->jobs);
+        queue->jobs = jobs;
+        queue->size = size;
+        queue->head = 0;
+    }
+
+    queue->jobs[(queue->head + queue->count) % queue->size] = *job;
+    queue->count++;
+
+    return HPDF_OK;
+}
+
+
+static HPDF_BOOL
+TakeJob  (HPDF_BatchWorker    worker,
+          HPDF_BatchJob_Rec  *job)
+{
+    HPDF_Batch batch = worker->batch;
+    HPDF_BatchQueue_Rec *queue = &worker->queue;
+    HPDF_BOOL found = HPDF_FALSE;
+    HPDF_UINT i;
+
+    /* the oldest job of the own queue */
+    Lock (&queue->lock);
+    if (queue->count > 0) {
+        *job = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % queue->size;
+        queue->count--;
+        found = HPDF_TRUE;
+    }
+    Unlock (&queue->lock);
+
+    /* the newest job of the queue of another worker */
+    for (i = 1; !found && i < batch->num_workers; i++) {
+        HPDF_BatchQueue_Rec *victim;
+
+        worker->victim = (worker->victim + 1) % batch->num_workers;
+        if (worker->victim == worker->index)
+            continue;
+
+        victim = &batch->workers[worker->victim].queue;
+
+        Lock (&victim->lock);
+        if (victim->count > 0) {
+            victim->count--;
+            *job = victim->jobs[(victim->head + victim->count) %
+                    victim->size];
+            found = HPDF_TRUE;
+            worker->steals++;
+        }
+        Unlock (&victim->lock);
+    }
+
+    if (found) {
+        Lock (&batch->lock);
+        batch->queued--;
+        Unlock (&batch->lock);
+    }
+
+    return found;
+}
+
+
+/*---------------------------------------------------------------------------*/
+/*----- jobs ----------------------------------------------------------------*/
+
+static HPDF_STATUS
+WriteOutput  (HPDF_Stream      stream,
+              const HPDF_BYTE  *ptr,
+              HPDF_UINT        siz)
+{
+    HPDF_BatchOutput_Rec *output = (HPDF_BatchOutput_Rec *)stream->attr;
+    HPDF_STATUS ret;
+
+    ret = output->job->write_fn (ptr, siz, output->job->job_data);
+    if (ret != HPDF_OK)
+        return HPDF_SetError (stream->error, HPDF_FILE_IO_ERROR, ret);
+
+    output->worker->bytes += siz;
+
+    return HPDF_OK;
+}
+
+
+static void
+RunJob  (HPDF_BatchWorker    worker,
+         HPDF_BatchJob_Rec  *job)
+{
+    HPDF_Batch batch = worker->batch;
+    HPDF_Doc pdf = worker->pdf;
+    HPDF_BatchOutput_Rec output;
+    HPDF_DOUBLE latency;
+    HPDF_STATUS ret;
+
+    /* the errors of the job are reported with its data. */
+    pdf->error.user_data = job->job_data;
+
+    ret = HPDF_NewDoc (pdf);
+
+    if (ret == HPDF_OK)
+        ret = job->fill_fn (pdf, job->job_data);
+
+    if (ret == HPDF_OK) {
+        HPDF_Stream stream;
+
+        output.worker = worker;
+        output.job = job;
+
+        stream = HPDF_CallbackWriter_New (pdf->mmgr, WriteOutput, &output);
+        if (stream) {
+            ret = HPDF_Doc_SaveToStream (pdf, stream);
+            HPDF_Stream_Free (stream);
+        } else
+            ret = HPDF_CheckError (&pdf->error);
+    }
+
+    if (ret != HPDF_OK) {
+        worker->failed++;
+        HPDF_ResetError (pdf);
+    }
+
+    if (batch->done_fn)
+        batch->done_fn (ret, job->job_data);
+
+    worker->last_end = Now ();
+    latency = worker->last_end - job->submit_time;
+
+    worker->jobs++;
+    worker->latency_sum += latency;
+    if (latency < worker->latency_min)
+        worker->latency_min = latency;
+    if (latency > worker->latency_max)
+        worker->latency_max = latency;
+}
+
+
+static void
+ResetStats  (HPDF_BatchWorker  worker)
+{
+    worker->jobs = 0;
+    worker->failed = 0;
+    worker->steals = 0;
+    worker->bytes = 0;
+    worker->latency_sum = 0;
+    worker->latency_min = 1e30;
+    worker->latency_max = 0;
+    worker->last_end = 0;
+}
+
+
+/*---------------------------------------------------------------------------*/
+/*----- HPDF_Batch ----------------------------------------------------------*/
+
+HPDF_EXPORT(HPDF_Batch)
+HPDF_Batch_New  (HPDF_UINT               num_workers,
+                 HPDF_Batch_Setup_Func   setup_fn,
+                 HPDF_Batch_Done_Func    done_fn,
+                 HPDF_Error_Handler      user_error_fn,
+                 void                   *user_data)
+{
+    HPDF_Batch batch;
+    HPDF_MMgr mmgr;
+    HPDF_Error_Rec tmp_error;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Batch_New\n"));
+
+    /* initialize temporary-error object */
+    HPDF_Error_Init (&tmp_error, user_data);
+
+    mmgr = HPDF_MMgr_New (&tmp_error, 0, NULL, NULL);
+    if (!mmgr) {
+        HPDF_CheckError (&tmp_error);
+        return NULL;
+    }
+
+    batch = HPDF_GetMem (mmgr, sizeof(HPDF_Batch_Rec));
+    if (!batch) {
+        HPDF_MMgr_Free (mmgr);
+        HPDF_CheckError (&tmp_error);
+        return NULL;
+    }
+
+    HPDF_MemSet (batch, 0, sizeof(HPDF_Batch_Rec));
+    batch->sig_bytes = HPDF_BATCH_SIG_BYTES;
+    batch->mmgr = mmgr;
+    batch->error = tmp_error;
+    batch->error.error_fn = user_error_fn;
+    batch->done_fn = done_fn;
+    batch->start_time = -1;
+
+    mmgr->error = &batch->error;
+
+    if (num_workers == 0)
+        num_workers = CountProcessors ();
+
+    if (num_workers > HPDF_BATCH_MAX_WORKERS)
+        num_workers = HPDF_BATCH_MAX_WORKERS;
+
+#ifndef HPDF_BATCH_THREADS
+    num_workers = 1;
+#endif
+
+    LockInit (&batch->lock);
+    CondInit (&batch->work_cond);
+    CondInit (&batch->done_cond);
+
+    batch->workers = HPDF_GetMem (mmgr, sizeof(HPDF_BatchWorker_Rec) *
+            num_workers);
+    if (!batch->workers)
+        goto Fail;
+
+    HPDF_MemSet (batch->workers, 0, sizeof(HPDF_BatchWorker_Rec) *
+            num_workers);
+    batch->num_workers = num_workers;
+
+    for (i = 0; i < num_workers; i++) {
+        HPDF_BatchWorker worker = &batch->workers[i];
+
+        worker->batch = batch;
+        worker->index = i;
+        worker->victim = i;
+        LockInit (&worker->queue.lock);
+        ResetStats (worker);
+    }
+
+    /* the documents are set up on this thread, one after another. */
+    for (i = 0; i < num_workers; i++) {
+        HPDF_BatchWorker worker = &batch->workers[i];
+        HPDF_STATUS ret;
+
+        worker->pdf = HPDF_New (user_error_fn, user_data);
+        if (!worker->pdf) {
+            HPDF_SetError (&batch->error, HPDF_FAILD_TO_ALLOC_MEM, 0);
+            goto Fail;
+        }
+
+        if (setup_fn && (ret = setup_fn (worker->pdf, user_data)) != HPDF_OK) {
+            HPDF_STATUS detail = HPDF_GetError (worker->pdf);
+
+            HPDF_SetError (&batch->error, ret, detail);
+            goto Fail;
+        }
+    }
+
+#ifdef HPDF_BATCH_THREADS
+    for (i = 0; i < num_workers; i++) {
+        HPDF_BatchWorker worker = &batch->workers[i];
+
+        if (!StartThread (worker)) {
+            HPDF_SetError (&batch->error, HPDF_THREAD_CREATE_ERROR, 0);
+            goto Fail;
+        }
+
+        worker->started = HPDF_TRUE;
+    }
+#endif
+
+    return batch;
+
+Fail:
+    HPDF_CheckError (&batch->error);
+    HPDF_Batch_Free (batch);
+    return NULL;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Batch_Submit  (HPDF_Batch              batch,
+                    HPDF_Batch_Fill_Func    fill_fn,
+                    HPDF_Batch_Write_Func   write_fn,
+                    void                   *job_data)
+{
+    HPDF_BatchJob_Rec job;
+    HPDF_BatchWorker worker;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_Batch_Submit\n"));
+
+    if (!batch || batch->sig_bytes != HPDF_BATCH_SIG_BYTES)
+        return HPDF_INVALID_OBJECT;
+
+    if (!fill_fn || !write_fn)
+        return HPDF_RaiseError (&batch->error, HPDF_INVALID_PARAMETER, 0);
+
+    job.fill_fn = fill_fn;
+    job.write_fn = write_fn;
+    job.job_data = job_data;
+    job.submit_time = Now ();
+
+    worker = &batch->workers[batch->next_worker];
+    batch->next_worker = (batch->next_worker + 1) % batch->num_workers;
+
+    /* the lock of the batch is held until the job is counted, so that a
+     * worker which takes the job cannot uncount it before.
+     */
+    Lock (&batch->lock);
+
+    Lock (&worker->queue.lock);
+    ret = PushJob (batch, &worker->queue, &job);
+    Unlock (&worker->queue.lock);
+
+    if (ret == HPDF_OK) {
+        if (batch->start_time < 0)
+            batch->start_time = job.submit_time;
+        batch->queued++;
+        batch->pending++;
+#ifdef HPDF_BATCH_THREADS
+        CondSignal (&batch->work_cond);
+#endif
+    }
+
+    Unlock (&batch->lock);
+
+    if (ret != HPDF_OK)
+        return HPDF_CheckError (&batch->error);
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  HPDF_Batch_Wait
+ *
+ *  Wait until all the submitted jobs are finished, and return the
+ *  statistics of the jobs which were finished since the previous call.
+ *
+ */
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Batch_Wait  (HPDF_Batch         batch,
+                  HPDF_BatchStats   *stats)
+{
+    HPDF_BatchStats s;
+    HPDF_DOUBLE latency_sum = 0;
+    HPDF_DOUBLE end_time = 0;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Batch_Wait\n"));
+
+    if (!batch || batch->sig_bytes != HPDF_BATCH_SIG_BYTES)
+        return HPDF_INVALID_OBJECT;
+
+#ifdef HPDF_BATCH_THREADS
+    Lock (&batch->lock);
+    while (batch->pending > 0)
+        CondWait (&batch->done_cond, &batch->lock);
+    Unlock (&batch->lock);
+#else
+    {
+        HPDF_BatchJob_Rec job;
+
+        while (TakeJob (&batch->workers[0], &job)) {
+            RunJob (&batch->workers[0], &job);
+            batch->pending--;
+        }
+    }
+#endif
+
+    HPDF_MemSet (&s, 0, sizeof(HPDF_BatchStats));
+
+    for (i = 0; i < batch->num_workers; i++) {
+        HPDF_BatchWorker worker = &batch->workers[i];
+
+        if (worker->jobs == 0)
+            continue;
+
+        if (s.jobs == 0 || worker->latency_min < s.min_latency)
+            s.min_latency = worker->latency_min;
+        if (worker->latency_max > s.max_latency)
+            s.max_latency = worker->latency_max;
+        if (worker->last_end > end_time)
+            end_time = worker->last_end;
+
+        s.jobs += worker->jobs;
+        s.failed += worker->failed;
+        s.steals += worker->steals;
+        s.bytes += worker->bytes;
+        latency_sum += worker->latency_sum;
+
+        ResetStats (worker);
+    }
+
+    if (s.jobs > 0) {
+        s.elapsed = end_time - batch->start_time;
+        s.avg_latency = latency_sum / s.jobs;
+        if (s.elapsed > 0)
+            s.jobs_per_sec = s.jobs / s.elapsed;
+    }
+
+    batch->start_time = -1;
+
+    if (stats)
+        *stats = s;
+
+    return HPDF_OK;
+}
+
+
+HPDF_EXPORT(void)
+HPDF_Batch_Free  (HPDF_Batch  batch)
+{
+    HPDF_MMgr mmgr;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Batch_Free\n"));
+
+    if (!batch || batch->sig_bytes != HPDF_BATCH_SIG_BYTES)
+        return;
+
+#ifdef HPDF_BATCH_THREADS
+    /* the workers finish the queued jobs before they end. */
+    Lock (&batch->lock);
+    batch->stop = HPDF_TRUE;
+    CondBroadcast (&batch->work_cond);
+    Unlock (&batch->lock);
+
+    for (i = 0; i < batch->num_workers; i++)
+        if (batch->workers[i].started)
+            JoinThread (&batch->workers[i]);
+#else
+    HPDF_Batch_Wait (batch, NULL);
+#endif
+
+    for (i = 0; i < batch->num_workers; i++) {
+        HPDF_BatchWorker worker = &batch->workers[i];
+
+        if (worker->pdf)
+            HPDF_Free (worker->pdf);
+
+        HPDF_FreeMem (batch->mmgr, worker->queue.jobs);
+        LockFree (&worker->queue.lock);
+    }
+
+    HPDF_FreeMem (batch->mmgr, batch->workers);
+
+    CondFree (&batch->done_cond);
+    CondFree (&batch->work_cond);
+    LockFree (&batch->lock);
+
+    mmgr = batch->mmgr;
+    batch->sig_bytes = 0;
+    HPDF_FreeMem (mmgr, batch);
+    HPDF_MMgr_Free (mmgr);
+}
+
@@ -49,23 +49,26 @@ HPDF_Binary_New  (HPDF_MMgr  mmgr,
 HPDF_STATUS
 HPDF_Binary_Write  (HPDF_Binary   obj,
                     HPDF_Stream   stream,
-                    HPDF_Encrypt  e)
+                    HPDF_CryptCtx e)
 {
     HPDF_STATUS ret;
 
-    if (obj->len == 0)
+    if (obj->len == 0 && !e)
         return HPDF_Stream_WriteStr (stream, "<>");
 
     if ((ret = HPDF_Stream_WriteChar (stream, '<')) != HPDF_OK)
         return ret;
 
     if (e)
-        HPDF_Encrypt_Reset (e);
+        HPDF_CryptCtx_Reset (e);
 
     if ((ret = HPDF_Stream_WriteBinary (stream, obj->value, obj->len, e)) !=
                     HPDF_OK)
         return ret;
 
+    if (e && (ret = HPDF_Stream_WriteBinaryFinal (stream, e)) != HPDF_OK)
+        return ret;
+
     return HPDF_Stream_WriteChar (stream, '>');
 }
 
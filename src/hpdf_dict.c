@@ -96,6 +96,11 @@ HPDF_Dict_Free  (HPDF_Dict  dict)
     if (dict->free_fn)
         dict->free_fn (dict);
 
+    /* the parameters of a stream which has never been written */
+    if (dict->filterParams &&
+            !HPDF_Dict_GetItem (dict, "DecodeParms", HPDF_OCLASS_ARRAY))
+        HPDF_Dict_Free (dict->filterParams);
+
     for (i = 0; i < dict->list->count; i++) {
         HPDF_DictElement element =
                 (HPDF_DictElement)HPDF_List_ItemAt (dict->list, i);
@@ -139,7 +144,7 @@ HPDF_Dict_Add_FilterParams(HPDF_Dict    dict, HPDF_Dict filterParam)
 HPDF_STATUS
 HPDF_Dict_Write  (HPDF_Dict     dict,
                   HPDF_Stream   stream,
-                  HPDF_Encrypt  e)
+                  HPDF_CryptCtx e)
 {
     HPDF_UINT i;
     HPDF_STATUS ret;
@@ -188,7 +193,17 @@ HPDF_Dict_Write  (HPDF_Dict     dict,
             if(dict->filter & HPDF_STREAM_FILTER_CCITT_DECODE)
                 HPDF_Array_AddName (array, "CCITTFaxDecode");
 
-            if(dict->filterParams!=NULL)
+            if (dict->filter & HPDF_STREAM_FILTER_JPX_DECODE)
+                HPDF_Array_AddName (array, "JPXDecode");
+
+            if (dict->filter & HPDF_STREAM_FILTER_JBIG2_DECODE)
+                HPDF_Array_AddName (array, "JBIG2Decode");
+
+            /* the parameters are owned by DecodeParms once they are
+             * added, they must be added only once.
+             */
+            if(dict->filterParams!=NULL &&
+                    !HPDF_Dict_GetItem (dict, "DecodeParms", HPDF_OCLASS_ARRAY))
             {
                 HPDF_Dict_Add_FilterParams(dict, dict->filterParams);
             }
@@ -257,7 +272,7 @@ HPDF_Dict_Write  (HPDF_Dict     dict,
         strptr = stream->size;
 
         if (e)
-            HPDF_Encrypt_Reset (e);
+            HPDF_CryptCtx_Reset (e);
 
         if ((ret = HPDF_Stream_WriteToStream (dict->stream, stream,
                         dict->filter, e)) != HPDF_OK)
@@ -289,6 +289,8 @@ HPDF_FreeDoc  (HPDF_Doc  pdf)
            pdf->xref = NULL;
         }
 
+        HPDF_Doc_FreePageArenas (pdf);
+
         if (pdf->font_mgr) {
             HPDF_List_Free (pdf->font_mgr);
             pdf->font_mgr = NULL;
@@ -297,6 +299,8 @@ HPDF_FreeDoc  (HPDF_Doc  pdf)
         if (pdf->fontdef_list)
             CleanupFontDefList (pdf);
 
+        HPDF_Doc_ClearDedupList (pdf);
+
         HPDF_MemSet(pdf->ttfont_tag, 0, 6);
 
         pdf->pdf_version = HPDF_VER_13;
@@ -343,7 +347,24 @@ HPDF_FreeDocAll  (HPDF_Doc  pdf)
         if (pdf->encoder_list)
             FreeEncoderList (pdf);
 
+        if (pdf->font_cache) {
+            HPDF_FontCache_Free (pdf->font_cache);
+            pdf->font_cache = NULL;
+        }
+
+        if (pdf->dedup_list) {
+            HPDF_List_Free (pdf->dedup_list);
+            pdf->dedup_list = NULL;
+        }
+
+        if (pdf->page_arenas) {
+            HPDF_List_Free (pdf->page_arenas);
+            pdf->page_arenas = NULL;
+        }
+
         pdf->compression_mode = HPDF_COMP_NONE;
+        pdf->dedup_mode = HPDF_FALSE;
+        pdf->concurrent_pages = HPDF_FALSE;
 
         HPDF_Error_Reset (&pdf->error);
     }
@@ -500,7 +521,27 @@ HPDF_SetEncryptionMode  (HPDF_Doc           pdf,
     else {
         if (mode == HPDF_ENCRYPT_R2)
             e->key_len = 5;
-        else {
+        else if (mode == HPDF_ENCRYPT_R4) {
+            /* AESV2 crypt filter requires pdf-1.6 */
+            if (pdf->pdf_version < HPDF_VER_16)
+                pdf->pdf_version = HPDF_VER_16;
+
+            if (key_len == 0 || key_len == 16)
+                e->key_len = 16;
+            else
+                return HPDF_RaiseError (&pdf->error,
+                        HPDF_INVALID_ENCRYPT_KEY_LEN, 0);
+        } else if (mode == HPDF_ENCRYPT_R6) {
+            /* AESV3 crypt filter is written as an extension of pdf-1.7 */
+            if (pdf->pdf_version < HPDF_VER_17)
+                pdf->pdf_version = HPDF_VER_17;
+
+            if (key_len == 0 || key_len == 32)
+                e->key_len = 32;
+            else
+                return HPDF_RaiseError (&pdf->error,
+                        HPDF_INVALID_ENCRYPT_KEY_LEN, 0);
+        } else {
             /* if encryption mode is specified revision-3, the version of
              * pdf file is set to 1.4
              */
@@ -584,6 +625,24 @@ HPDF_Doc_PrepareEncryption  (HPDF_Doc   pdf)
             HPDF_OK)
         return pdf->error.error_no;
 
+    /* AESV3 crypt filter is the extension level 8 of pdf-1.7 */
+    if (e->mode == HPDF_ENCRYPT_R6 &&
+            !HPDF_Dict_GetItem (pdf->catalog, "Extensions", HPDF_OCLASS_DICT)) {
+        HPDF_Dict ext = HPDF_Dict_New (pdf->mmgr);
+        HPDF_Dict adbe;
+
+        if (!ext || HPDF_Dict_Add (pdf->catalog, "Extensions", ext) != HPDF_OK)
+            return pdf->error.error_no;
+
+        adbe = HPDF_Dict_New (pdf->mmgr);
+        if (!adbe || HPDF_Dict_Add (ext, "ADBE", adbe) != HPDF_OK)
+            return pdf->error.error_no;
+
+        if (HPDF_Dict_AddName (adbe, "BaseVersion", "1.7") != HPDF_OK ||
+                HPDF_Dict_AddNumber (adbe, "ExtensionLevel", 8) != HPDF_OK)
+            return pdf->error.error_no;
+    }
+
     /* reset 'ID' to trailer-dictionary */
     id = HPDF_Dict_GetItem (pdf->trailer, "ID", HPDF_OCLASS_ARRAY);
     if (!id) {
@@ -612,6 +671,10 @@ InternalSaveToStream  (HPDF_Doc      pdf,
 {
     HPDF_STATUS ret;
 
+    /* move the objects of concurrent pages into the document */
+    if ((ret = HPDF_Doc_MergePages (pdf)) != HPDF_OK)
+        return ret;
+
     if ((ret = WriteHeader (pdf, stream)) != HPDF_OK)
         return ret;
 
@@ -621,20 +684,24 @@ InternalSaveToStream  (HPDF_Doc      pdf,
 
     /* prepare encryption */
     if (pdf->encrypt_on) {
-        HPDF_Encrypt e= HPDF_EncryptDict_GetAttr (pdf->encrypt_dict);
-
         if ((ret = HPDF_Doc_PrepareEncryption (pdf)) != HPDF_OK)
             return ret;
-
-        if ((ret = HPDF_Xref_WriteToStream (pdf->xref, stream, e)) != HPDF_OK)
-            return ret;
-    } else {
-        if ((ret = HPDF_Xref_WriteToStream (pdf->xref, stream, NULL)) !=
-                HPDF_OK)
-            return ret;
     }
 
-    return HPDF_OK;
+    /* merge identical images and extgstates */
+    if ((ret = HPDF_Doc_MarkDuplicates (pdf)) != HPDF_OK)
+        return ret;
+
+    if (pdf->encrypt_on) {
+        HPDF_Encrypt e= HPDF_EncryptDict_GetAttr (pdf->encrypt_dict);
+
+        ret = HPDF_Xref_WriteToStream (pdf->xref, stream, e);
+    } else
+        ret = HPDF_Xref_WriteToStream (pdf->xref, stream, NULL);
+
+    HPDF_Doc_UnmarkDuplicates (pdf);
+
+    return ret;
 }
 
 
@@ -772,6 +839,21 @@ HPDF_SaveToFile  (HPDF_Doc     pdf,
     return HPDF_CheckError (&pdf->error);
 }
 
+/* save the document into a stream created by the caller. */
+HPDF_STATUS
+HPDF_Doc_SaveToStream  (HPDF_Doc     pdf,
+                        HPDF_Stream  stream)
+{
+    HPDF_PTRACE ((" HPDF_Doc_SaveToStream\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    InternalSaveToStream (pdf, stream);
+
+    return HPDF_CheckError (&pdf->error);
+}
+
 #if defined(WIN32)
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_SaveToFileW  (HPDF_Doc     pdf,
@@ -876,7 +958,7 @@ HPDF_Doc_SetCurrentPage  (HPDF_Doc    pdf,
         return HPDF_SetError (&pdf->error, HPDF_INVALID_PAGE, 0);
 
     /* check whether the page belong to the pdf */
-    if (pdf->mmgr != page->mmgr)
+    if (pdf->mmgr != HPDF_Page_GetDocMMgr (page))
         return HPDF_SetError (&pdf->error, HPDF_INVALID_PAGE, 0);
 
     pdf->cur_page = page;
@@ -905,7 +987,10 @@ HPDF_AddPage  (HPDF_Doc  pdf)
         }
     }
 
-    page = HPDF_Page_New (pdf->mmgr, pdf->xref);
+    if (pdf->concurrent_pages)
+        page = HPDF_Doc_NewConcurrentPage (pdf);
+    else
+        page = HPDF_Page_New (pdf->mmgr, pdf->xref);
     if (!page) {
         HPDF_CheckError (&pdf->error);
         return NULL;
@@ -983,12 +1068,15 @@ HPDF_InsertPage  (HPDF_Doc    pdf,
     }
 
     /* check whether the page belong to the pdf */
-    if (pdf->mmgr != target->mmgr) {
+    if (pdf->mmgr != HPDF_Page_GetDocMMgr (target)) {
         HPDF_RaiseError (&pdf->error, HPDF_INVALID_PAGE, 0);
         return NULL;
     }
 
-    page = HPDF_Page_New (pdf->mmgr, pdf->xref);
+    if (pdf->concurrent_pages)
+        page = HPDF_Doc_NewConcurrentPage (pdf);
+    else
+        page = HPDF_Page_New (pdf->mmgr, pdf->xref);
     if (!page) {
         HPDF_CheckError (&pdf->error);
         return NULL;
@@ -1535,6 +1623,45 @@ LoadType1FontFromStream  (HPDF_Doc      pdf,
     return NULL;
 }
 
+
+/*
+ *  HPDF_SaveType1FontMetrics
+ *
+ *  Save the metrics of a loaded Type1 font to a binary file. The file can be
+ *  passed to HPDF_LoadType1FontFromFile in place of the AFM file, which
+ *  avoids parsing the AFM file again for every document.
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SaveType1FontMetrics  (HPDF_Doc     pdf,
+                            const char  *font_name,
+                            const char  *file_name)
+{
+    HPDF_FontDef def;
+    HPDF_Stream stream;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_SaveType1FontMetrics\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    def = HPDF_Doc_FindFontDef (pdf, font_name);
+    if (!def || def->type != HPDF_FONTDEF_TYPE_TYPE1)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_FONT_NAME, 0);
+
+    stream = HPDF_FileWriter_New (pdf->mmgr, file_name);
+    if (!stream)
+        return HPDF_CheckError (&pdf->error);
+
+    ret = HPDF_Type1FontDef_SaveMetrics (def, stream);
+    HPDF_Stream_Free (stream);
+
+    if (ret != HPDF_OK)
+        return HPDF_CheckError (&pdf->error);
+
+    return HPDF_OK;
+}
+
 HPDF_EXPORT(HPDF_FontDef)
 HPDF_GetTTFontDefFromFile (HPDF_Doc      pdf,
                            const char   *file_name,
@@ -1546,7 +1673,7 @@ HPDF_GetTTFontDefFromFile (HPDF_Doc      pdf,
     HPDF_PTRACE ((" HPDF_GetTTFontDefFromFile\n"));
 
     /* create file stream */
-    font_data = HPDF_FileReader_New (pdf->mmgr, file_name);
+    font_data = HPDF_MappedReader_New (pdf->mmgr, file_name);
 
     if (HPDF_Stream_Validate (font_data)) {
         def = HPDF_TTFontDef_Load (pdf->mmgr, font_data, embedding);
@@ -1572,7 +1699,7 @@ HPDF_LoadTTFontFromFile (HPDF_Doc         pdf,
         return NULL;
 
     /* create file stream */
-    font_data = HPDF_FileReader_New (pdf->mmgr, file_name);
+    font_data = HPDF_MappedReader_New (pdf->mmgr, file_name);
 
     if (HPDF_Stream_Validate (font_data)) {
         ret = LoadTTFontFromStream (pdf, font_data, embedding);
@@ -1679,6 +1806,7 @@ LoadTTFontFromStream (HPDF_Doc         pdf,
         }
 
         HPDF_TTFontDef_SetTagName (def, (char *)pdf->ttfont_tag);
+        ((HPDF_TTFontDefAttr)def->attr)->cache = pdf->font_cache;
     }
 
     return def->base_font;
@@ -1699,7 +1827,7 @@ HPDF_LoadTTFontFromFile2 (HPDF_Doc         pdf,
         return NULL;
 
     /* create file stream */
-    font_data = HPDF_FileReader_New (pdf->mmgr, file_name);
+    font_data = HPDF_MappedReader_New (pdf->mmgr, file_name);
 
     if (HPDF_Stream_Validate (font_data)) {
         ret = LoadTTFontFromStream2 (pdf, font_data, index, embedding);
@@ -1785,6 +1913,7 @@ LoadTTFontFromStream2 (HPDF_Doc         pdf,
         }
 
         HPDF_TTFontDef_SetTagName (def, (char *)pdf->ttfont_tag);
+        ((HPDF_TTFontDefAttr)def->attr)->cache = pdf->font_cache;
     }
 
     return def->base_font;
@@ -1800,12 +1929,15 @@ HPDF_LoadRawImageFromFile  (HPDF_Doc          pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadRawImageFromFile\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_FileReader_New (pdf->mmgr, filename);
 
@@ -1824,7 +1956,41 @@ HPDF_LoadRawImageFromFile  (HPDF_Doc          pdf,
     if (image && pdf->compression_mode & HPDF_COMP_IMAGE)
         image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+/*
+ * the pixels are read from the file when the document is saved, so the file
+ * must not be changed nor removed before then.
+ */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadRawImageFromFile2  (HPDF_Doc          pdf,
+                             const char       *filename,
+                             HPDF_UINT         width,
+                             HPDF_UINT         height,
+                             HPDF_ColorSpace   color_space)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_LoadRawImageFromFile2\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_LoadRawImageFromFile (pdf->mmgr, filename, pdf->xref,
+                width, height, color_space);
+
+    if (!image)
+        HPDF_CheckError (&pdf->error);
+
+    if (image && pdf->compression_mode & HPDF_COMP_IMAGE)
+        image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 
 
@@ -1838,12 +2004,15 @@ HPDF_LoadRawImageFromFileW (HPDF_Doc          pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadRawImageFromFileW\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_FileReader_NewW (pdf->mmgr, filename);
 
@@ -1862,7 +2031,7 @@ HPDF_LoadRawImageFromFileW (HPDF_Doc          pdf,
     if (image && pdf->compression_mode & HPDF_COMP_IMAGE)
         image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 #endif
 
@@ -1876,12 +2045,15 @@ HPDF_LoadRawImageFromMem  (HPDF_Doc           pdf,
                            HPDF_UINT          bits_per_component)
 {
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadRawImageFromMem\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* Use directly HPDF_Image_LoadRaw1BitImageFromMem to save B/W images */
     if(color_space == HPDF_CS_DEVICE_GRAY && bits_per_component == 1) {
         return HPDF_Image_LoadRaw1BitImageFromMem (pdf, buf, width, height, (width+7)/8, HPDF_TRUE, HPDF_TRUE);
@@ -1896,6 +2068,46 @@ HPDF_LoadRawImageFromMem  (HPDF_Doc           pdf,
         image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
     }
 
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+/*
+ * the buffer is not copied nor read before the document is saved, so the
+ * image is not merged with identical images.
+ */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadRawImageFromUserMem  (HPDF_Doc            pdf,
+                               const HPDF_BYTE    *buf,
+                               HPDF_UINT           size,
+                               HPDF_UINT           width,
+                               HPDF_UINT           height,
+                               HPDF_ColorSpace     color_space,
+                               HPDF_UINT           bits_per_component,
+                               HPDF_BOOL           deflated,
+                               HPDF_Release_Func   release_fn,
+                               void               *user_data)
+{
+    HPDF_Image image;
+
+    HPDF_PTRACE ((" HPDF_LoadRawImageFromUserMem\n"));
+
+    if (!HPDF_HasDoc (pdf)) {
+        if (release_fn)
+            release_fn (buf, user_data);
+        return NULL;
+    }
+
+    image = HPDF_Image_LoadRawImageFromUserMem (pdf->mmgr, buf, size,
+            pdf->xref, width, height, color_space, bits_per_component,
+            deflated, release_fn, user_data);
+
+    if (!image)
+        HPDF_CheckError (&pdf->error);
+
+    if (image && !deflated && pdf->compression_mode & HPDF_COMP_IMAGE)
+        image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
+
     return image;
 }
 
@@ -1906,12 +2118,15 @@ HPDF_LoadJpegImageFromFile  (HPDF_Doc     pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadJpegImageFromFile\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_FileReader_New (pdf->mmgr, filename);
 
@@ -1926,7 +2141,35 @@ HPDF_LoadJpegImageFromFile  (HPDF_Doc     pdf,
     if (!image)
         HPDF_CheckError (&pdf->error);
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+/*
+ * the data is read from the file when the document is saved, so the file
+ * must not be changed nor removed before then.
+ */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJpegImageFromFile2  (HPDF_Doc     pdf,
+                              const char  *filename)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_LoadJpegImageFromFile2\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_LoadJpegImageFromFile (pdf->mmgr, filename,
+            pdf->xref);
+
+    if (!image)
+        HPDF_CheckError (&pdf->error);
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 
 
@@ -1937,12 +2180,15 @@ HPDF_LoadJpegImageFromFileW (HPDF_Doc       pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadJpegImageFromFileW\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_FileReader_NewW (pdf->mmgr, filename);
 
@@ -1957,7 +2203,7 @@ HPDF_LoadJpegImageFromFileW (HPDF_Doc       pdf,
     if (!image)
         HPDF_CheckError (&pdf->error);
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 #endif
 
@@ -1968,6 +2214,7 @@ HPDF_LoadJpegImageFromMem  (HPDF_Doc    pdf,
                            HPDF_UINT    size)
 {
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadJpegImageFromMem\n"));
 
@@ -1975,13 +2222,134 @@ HPDF_LoadJpegImageFromMem  (HPDF_Doc    pdf,
         return NULL;
     }
 
+    obj_count = pdf->xref->entries->count;
+
     image = HPDF_Image_LoadJpegImageFromMem (pdf->mmgr, buffer, size , pdf->xref);
 
     if (!image) {
         HPDF_CheckError (&pdf->error);
     }
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+/* the JPXDecode filter is supported by PDF 1.5 and later. */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJpxImageFromFile  (HPDF_Doc     pdf,
+                            const char  *filename)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_LoadJpxImageFromFile\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_LoadJpxImageFromFile (pdf->mmgr, filename, pdf->xref);
+
+    if (!image) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    if (pdf->pdf_version < HPDF_VER_15)
+        pdf->pdf_version = HPDF_VER_15;
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJpxImageFromMem  (HPDF_Doc          pdf,
+                           const HPDF_BYTE  *buffer,
+                           HPDF_UINT         size)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_LoadJpxImageFromMem\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_LoadJpxImageFromMem (pdf->mmgr, buffer, size,
+            pdf->xref);
+
+    if (!image) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    if (pdf->pdf_version < HPDF_VER_15)
+        pdf->pdf_version = HPDF_VER_15;
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+/* the JBIG2Decode filter is supported by PDF 1.4 and later. */
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJbig2ImageFromFile  (HPDF_Doc     pdf,
+                              const char  *filename)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_LoadJbig2ImageFromFile\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_LoadJbig2ImageFromFile (pdf->mmgr, filename,
+            pdf->xref);
+
+    if (!image) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    if (pdf->pdf_version < HPDF_VER_14)
+        pdf->pdf_version = HPDF_VER_14;
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadJbig2ImageFromMem  (HPDF_Doc          pdf,
+                             const HPDF_BYTE  *buffer,
+                             HPDF_UINT         size)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_LoadJbig2ImageFromMem\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_LoadJbig2ImageFromMem (pdf->mmgr, buffer, size,
+            pdf->xref);
+
+    if (!image) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    if (pdf->pdf_version < HPDF_VER_14)
+        pdf->pdf_version = HPDF_VER_14;
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 
 /*----- Catalog ------------------------------------------------------------*/
@@ -2420,6 +2788,42 @@ HPDF_SetCompressionMode  (HPDF_Doc    pdf,
 }
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetFontCacheSize  (HPDF_Doc    pdf,
+                        HPDF_UINT   max_size)
+{
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_SetFontCacheSize\n"));
+
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (max_size == 0) {
+        HPDF_FontCache_Free (pdf->font_cache);
+        pdf->font_cache = NULL;
+    } else if (pdf->font_cache)
+        HPDF_FontCache_SetMaxSize (pdf->font_cache, max_size);
+    else {
+        pdf->font_cache = HPDF_FontCache_New (pdf->mmgr, max_size);
+        if (!pdf->font_cache)
+            return HPDF_CheckError (&pdf->error);
+    }
+
+    /* attach the cache to the embedded fonts which are already loaded. */
+    for (i = 0; pdf->fontdef_list && i < pdf->fontdef_list->count; i++) {
+        HPDF_FontDef def = (HPDF_FontDef)HPDF_List_ItemAt (pdf->fontdef_list,
+                i);
+
+        if (def->type == HPDF_FONTDEF_TYPE_TRUETYPE &&
+                ((HPDF_TTFontDefAttr)def->attr)->embedding)
+            ((HPDF_TTFontDefAttr)def->attr)->cache = pdf->font_cache;
+    }
+
+    return HPDF_OK;
+}
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_GetError  (HPDF_Doc   pdf)
 {
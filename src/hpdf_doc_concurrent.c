@@ -0,0 +1,297 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_doc_concurrent.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf.h"
+
+/*
+ *  When the concurrent-pages mode of a document is on, each page which is
+ *  added to the document gets an arena: its own mmgr, error and xref. The
+ *  objects of the page (the page dictionary, the content streams, the
+ *  resource dictionaries, annotations...) are allocated from the mmgr of
+ *  the arena and numbered in its xref, so the pages can be filled on
+ *  different threads at the same time. The characters of the fonts which
+ *  are used by the page are marked in bitmaps of the page instead of the
+ *  fonts (see HPDF_Page_GetFontUsed). The errors raised while a page is
+ *  filled, also those of the shared fonts measuring its texts, are set in
+ *  the error of its arena, which is copied to the document when the page
+ *  is merged.
+ *
+ *  When a page is merged into the document, by HPDF_MergePage or when the
+ *  document is saved, the objects of the arena are moved to the xref of
+ *  the document and renumbered, and the bitmaps are merged into the fonts.
+ *  The memory of the arena is freed with the document.
+ */
+
+static HPDF_STATUS
+MergeArena  (HPDF_Doc       pdf,
+             HPDF_PageAttr  attr);
+
+
+static void
+MarkExtGStates  (HPDF_Dict  ext_gstates);
+
+
+static void
+FreeArena  (HPDF_Doc        pdf,
+            HPDF_PageArena  arena);
+
+
+/*---------------------------------------------------------------------------*/
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetConcurrentPages  (HPDF_Doc    pdf,
+                          HPDF_BOOL   mode)
+{
+    HPDF_PTRACE ((" HPDF_SetConcurrentPages\n"));
+
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (mode && !pdf->page_arenas) {
+        pdf->page_arenas = HPDF_List_New (pdf->mmgr, HPDF_DEF_ITEMS_PER_BLOCK);
+        if (!pdf->page_arenas)
+            return HPDF_CheckError (&pdf->error);
+    }
+
+    /* the pages which were added before keep their arenas. */
+    pdf->concurrent_pages = mode ? HPDF_TRUE : HPDF_FALSE;
+
+    return HPDF_OK;
+}
+
+
+HPDF_Page
+HPDF_Doc_NewConcurrentPage  (HPDF_Doc  pdf)
+{
+    HPDF_PageArena arena;
+    HPDF_Page page;
+
+    HPDF_PTRACE ((" HPDF_Doc_NewConcurrentPage\n"));
+
+    arena = HPDF_GetMem (pdf->mmgr, sizeof(HPDF_PageArena_Rec));
+    if (!arena)
+        return NULL;
+
+    HPDF_MemSet (arena, 0, sizeof(HPDF_PageArena_Rec));
+    arena->doc_mmgr = pdf->mmgr;
+
+    /* the errors of the page are reported to the handler of the document,
+     * on the thread which fills the page.
+     */
+    HPDF_Error_Init (&arena->error, pdf->error.user_data);
+    arena->error.error_fn = pdf->error.error_fn;
+
+    if (HPDF_List_Add (pdf->page_arenas, arena) != HPDF_OK) {
+        HPDF_FreeMem (pdf->mmgr, arena);
+        return NULL;
+    }
+
+    arena->mmgr = HPDF_MMgr_New (&arena->error, pdf->mmgr->buf_size,
+            pdf->mmgr->alloc_fn, pdf->mmgr->free_fn);
+    if (!arena->mmgr)
+        goto Fail;
+
+    /* the object numbers of the arena are provisional, the objects are
+     * renumbered when the page is merged.
+     */
+    arena->xref = HPDF_Xref_New (arena->mmgr, 1);
+    if (!arena->xref)
+        goto Fail;
+
+    arena->fonts_used = HPDF_List_New (arena->mmgr, HPDF_DEF_ITEMS_PER_BLOCK);
+    if (!arena->fonts_used)
+        goto Fail;
+
+    page = HPDF_Page_New (arena->mmgr, arena->xref);
+    if (!page)
+        goto Fail;
+
+    ((HPDF_PageAttr)page->attr)->arena = arena;
+
+    return page;
+
+Fail:
+    HPDF_SetError (&pdf->error, HPDF_Error_GetCode (&arena->error),
+            HPDF_Error_GetDetailCode (&arena->error));
+    return NULL;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_MergePage  (HPDF_Doc    pdf,
+                 HPDF_Page   page)
+{
+    HPDF_PageAttr attr;
+
+    HPDF_PTRACE ((" HPDF_MergePage\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_PAGE, 0);
+
+    /* check whether the page belong to the pdf */
+    if (HPDF_Page_GetDocMMgr (page) != pdf->mmgr)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_PAGE, 0);
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!attr->arena || attr->arena->merged)
+        return HPDF_OK;
+
+    if (MergeArena (pdf, attr) != HPDF_OK)
+        return HPDF_CheckError (&pdf->error);
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  HPDF_Doc_MergePages
+ *
+ *  Called when the document is saved. The pages which are not merged yet
+ *  are merged, and the extgstates used by the concurrent pages are made
+ *  read-only.
+ *
+ */
+
+HPDF_STATUS
+HPDF_Doc_MergePages  (HPDF_Doc  pdf)
+{
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Doc_MergePages\n"));
+
+    if (!pdf->page_arenas || pdf->page_arenas->count == 0)
+        return HPDF_OK;
+
+    for (i = 0; i < pdf->page_list->count; i++) {
+        HPDF_Page page = (HPDF_Page)HPDF_List_ItemAt (pdf->page_list, i);
+        HPDF_PageAttr attr = (HPDF_PageAttr)page->attr;
+
+        if (!attr->arena)
+            continue;
+
+        if (!attr->arena->merged &&
+                (ret = MergeArena (pdf, attr)) != HPDF_OK)
+            return ret;
+
+        if (attr->ext_gstates)
+            MarkExtGStates (attr->ext_gstates);
+    }
+
+    return HPDF_OK;
+}
+
+
+void
+HPDF_Doc_FreePageArenas  (HPDF_Doc  pdf)
+{
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Doc_FreePageArenas\n"));
+
+    if (!pdf->page_arenas)
+        return;
+
+    for (i = 0; i < pdf->page_arenas->count; i++)
+        FreeArena (pdf, (HPDF_PageArena)HPDF_List_ItemAt (pdf->page_arenas,
+                    i));
+
+    HPDF_List_Clear (pdf->page_arenas);
+}
+
+
+static HPDF_STATUS
+MergeArena  (HPDF_Doc       pdf,
+             HPDF_PageAttr  attr)
+{
+    HPDF_PageArena arena = attr->arena;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    if ((ret = HPDF_Xref_Merge (pdf->xref, arena->xref)) != HPDF_OK)
+        return ret;
+
+    for (i = 0; i < arena->fonts_used->count; i++) {
+        HPDF_PageFontUsed rec =
+                (HPDF_PageFontUsed)HPDF_List_ItemAt (arena->fonts_used, i);
+
+        HPDF_Font_MergeUsed (rec->font, rec->used);
+    }
+
+    /* the objects which are added to the page from now on are numbered in
+     * the xref of the document.
+     */
+    attr->xref = pdf->xref;
+    arena->merged = HPDF_TRUE;
+
+    /* an error of the page is an error of the document. */
+    if (arena->error.error_no != HPDF_NOERROR)
+        return HPDF_SetError (&pdf->error, arena->error.error_no,
+                arena->error.detail_no);
+
+    return HPDF_OK;
+}
+
+
+static void
+MarkExtGStates  (HPDF_Dict  ext_gstates)
+{
+    HPDF_UINT i;
+
+    for (i = 0; i < ext_gstates->list->count; i++) {
+        HPDF_DictElement element =
+                (HPDF_DictElement)HPDF_List_ItemAt (ext_gstates->list, i);
+        HPDF_Obj_Header *header = (HPDF_Obj_Header *)element->value;
+
+        if (header->obj_class == HPDF_OCLASS_PROXY)
+            header = (HPDF_Obj_Header *)((HPDF_Proxy)element->value)->obj;
+
+        header->obj_class = (HPDF_OSUBCLASS_EXT_GSTATE_R | HPDF_OCLASS_DICT);
+    }
+}
+
+
+static void
+FreeArena  (HPDF_Doc        pdf,
+            HPDF_PageArena  arena)
+{
+    HPDF_UINT i;
+
+    /* the objects of a merged page were freed with the xref of the
+     * document.
+     */
+    if (arena->xref)
+        HPDF_Xref_Free (arena->xref);
+
+    if (arena->fonts_used) {
+        for (i = 0; i < arena->fonts_used->count; i++)
+            HPDF_FreeMem (arena->mmgr,
+                    HPDF_List_ItemAt (arena->fonts_used, i));
+
+        HPDF_List_Free (arena->fonts_used);
+    }
+
+    if (arena->mmgr)
+        HPDF_MMgr_Free (arena->mmgr);
+
+    HPDF_FreeMem (pdf->mmgr, arena);
+}
@@ -0,0 +1,729 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_doc_dedup.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_encrypt.h"
+#include "hpdf.h"
+
+/*
+ *  When the dedup-mode of a document is on, an image which is loaded again
+ *  is not created again, the loader returns the image which was loaded
+ *  before. And when the document is saved, the images and extgstates which
+ *  are identical to a previous one are not written, the references to them
+ *  are written as references to the previous one.
+ *
+ *  Objects are looked up by the MD5 digest of their contents, and the
+ *  objects whose digests are the same are compared byte by byte before
+ *  they are merged. The data of images which are read from a file at save
+ *  time is identified by the name of the file.
+ */
+
+#define HPDF_DEDUP_MAX_DEPTH  16
+
+typedef struct _HPDF_DedupEntry_Rec  *HPDF_DedupEntry;
+
+typedef struct _HPDF_DedupEntry_Rec {
+    HPDF_BYTE   digest[HPDF_MD5_KEY_LEN];
+    void        *obj;
+} HPDF_DedupEntry_Rec;
+
+
+static HPDF_BOOL
+DigestObject  (HPDF_MD5_CTX  *ctx,
+               void          *obj,
+               HPDF_UINT     depth);
+
+
+static HPDF_BOOL
+GetDigest  (void       *obj,
+            HPDF_BYTE  *digest);
+
+
+static HPDF_BOOL
+EqualObjects  (void       *obj1,
+               void       *obj2,
+               HPDF_UINT  depth);
+
+
+static HPDF_DedupEntry
+FindEntry  (HPDF_List         list,
+            const HPDF_BYTE  *digest,
+            void             *obj);
+
+
+static HPDF_STATUS
+AddEntry  (HPDF_Doc          pdf,
+           HPDF_List         list,
+           const HPDF_BYTE  *digest,
+           void             *obj);
+
+
+static void
+FreeEntries  (HPDF_MMgr  mmgr,
+              HPDF_List  list);
+
+
+/*---------------------------------------------------------------------------*/
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetDedupMode  (HPDF_Doc    pdf,
+                    HPDF_BOOL   mode)
+{
+    HPDF_PTRACE ((" HPDF_SetDedupMode\n"));
+
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (mode && !pdf->dedup_list) {
+        pdf->dedup_list = HPDF_List_New (pdf->mmgr, HPDF_DEF_ITEMS_PER_BLOCK);
+        if (!pdf->dedup_list)
+            return HPDF_CheckError (&pdf->error);
+    }
+
+    if (!mode && pdf->dedup_list) {
+        HPDF_Doc_ClearDedupList (pdf);
+        HPDF_List_Free (pdf->dedup_list);
+        pdf->dedup_list = NULL;
+    }
+
+    pdf->dedup_mode = mode ? HPDF_TRUE : HPDF_FALSE;
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  HPDF_Doc_DedupImage
+ *
+ *  Called by the loaders with the image which was just loaded, and the
+ *  number of the xref entries before it was loaded. If an identical image
+ *  was loaded before, the objects of the new image are freed and the
+ *  previous image is returned.
+ *
+ */
+
+HPDF_Image
+HPDF_Doc_DedupImage  (HPDF_Doc    pdf,
+                      HPDF_Image  image,
+                      HPDF_UINT   obj_count)
+{
+    HPDF_BYTE digest[HPDF_MD5_KEY_LEN];
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Doc_DedupImage\n"));
+
+    if (!image || !pdf->dedup_mode || !GetDigest (image, digest))
+        return image;
+
+    for (i = 0; i < pdf->dedup_list->count; i++) {
+        HPDF_DedupEntry entry =
+                (HPDF_DedupEntry)HPDF_List_ItemAt (pdf->dedup_list, i);
+
+        if (HPDF_MemCmp (entry->digest, digest, HPDF_MD5_KEY_LEN) != 0)
+            continue;
+
+        /* the image may have been changed after it was loaded. */
+        if (!GetDigest (entry->obj, entry->digest))
+            HPDF_MemSet (entry->digest, 0, HPDF_MD5_KEY_LEN);
+
+        if (HPDF_MemCmp (entry->digest, digest, HPDF_MD5_KEY_LEN) == 0 &&
+                EqualObjects (entry->obj, image, 0)) {
+            HPDF_PTRACE ((" HPDF_Doc_DedupImage found obj_id=%u\n",
+                    (HPDF_UINT)(((HPDF_Image)entry->obj)->header.obj_id &
+                    0x00FFFFFF)));
+
+            HPDF_Xref_Truncate (pdf->xref, obj_count);
+            return (HPDF_Image)entry->obj;
+        }
+    }
+
+    if (AddEntry (pdf, pdf->dedup_list, digest, image) != HPDF_OK) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    return image;
+}
+
+
+void
+HPDF_Doc_ClearDedupList  (HPDF_Doc  pdf)
+{
+    HPDF_PTRACE ((" HPDF_Doc_ClearDedupList\n"));
+
+    if (pdf->dedup_list)
+        FreeEntries (pdf->mmgr, pdf->dedup_list);
+}
+
+
+/* the objects which are merged when the document is saved. */
+static HPDF_BOOL
+IsDedupTarget  (void  *obj)
+{
+    HPDF_Dict dict = (HPDF_Dict)obj;
+    HPDF_UINT16 obj_class = dict->header.obj_class;
+    HPDF_Name subtype;
+
+    if ((obj_class & HPDF_OCLASS_ANY) != HPDF_OCLASS_DICT)
+        return HPDF_FALSE;
+
+    if ((obj_class & ~HPDF_OCLASS_ANY) == HPDF_OSUBCLASS_EXT_GSTATE ||
+            (obj_class & ~HPDF_OCLASS_ANY) == HPDF_OSUBCLASS_EXT_GSTATE_R)
+        return HPDF_TRUE;
+
+    if (!dict->stream)
+        return HPDF_FALSE;
+
+    subtype = HPDF_Dict_GetItem (dict, "Subtype", HPDF_OCLASS_NAME);
+
+    return (subtype && HPDF_StrCmp (subtype->value, "Image") == 0);
+}
+
+
+/*
+ *  HPDF_Doc_MarkDuplicates
+ *
+ *  Marks the xref entries of the images and extgstates which are identical
+ *  to a previous one as free entries, and gives them the object id of the
+ *  previous one, so that the references to them are written as references
+ *  to the previous one. HPDF_Doc_UnmarkDuplicates() restores them after the
+ *  document is written.
+ *
+ */
+
+HPDF_STATUS
+HPDF_Doc_MarkDuplicates  (HPDF_Doc  pdf)
+{
+    HPDF_Xref xref = pdf->xref;
+    HPDF_List list;
+    HPDF_UINT i;
+    HPDF_STATUS ret = HPDF_OK;
+
+    HPDF_PTRACE ((" HPDF_Doc_MarkDuplicates\n"));
+
+    if (!pdf->dedup_mode)
+        return HPDF_OK;
+
+    list = HPDF_List_New (pdf->mmgr, HPDF_DEF_ITEMS_PER_BLOCK);
+    if (!list)
+        return HPDF_Error_GetCode (&pdf->error);
+
+    for (i = 1; i < xref->entries->count; i++) {
+        HPDF_XrefEntry entry = HPDF_Xref_GetEntry (xref, i);
+        HPDF_BYTE digest[HPDF_MD5_KEY_LEN];
+        HPDF_DedupEntry found;
+
+        if (entry->entry_typ != HPDF_IN_USE_ENTRY || !IsDedupTarget (entry->obj)
+                || !GetDigest (entry->obj, digest))
+            continue;
+
+        found = FindEntry (list, digest, entry->obj);
+        if (found) {
+            HPDF_Dict dict = (HPDF_Dict)entry->obj;
+            HPDF_Number length = HPDF_Dict_GetItem (dict, "Length",
+                    HPDF_OCLASS_NUMBER);
+
+            entry->entry_typ = HPDF_FREE_ENTRY;
+            dict->header.obj_id = ((HPDF_Obj_Header *)found->obj)->obj_id;
+
+            /* the length object is only referred by the stream. */
+            if (length && (length->header.obj_id & HPDF_OTYPE_INDIRECT)) {
+                HPDF_UINT idx = (length->header.obj_id & 0x00FFFFFF) -
+                        xref->start_offset;
+
+                if (idx > i && idx < xref->entries->count)
+                    HPDF_Xref_GetEntry (xref, idx)->entry_typ =
+                            HPDF_FREE_ENTRY;
+            }
+        } else if ((ret = AddEntry (pdf, list, digest, entry->obj)) != HPDF_OK)
+            break;
+    }
+
+    FreeEntries (pdf->mmgr, list);
+    HPDF_List_Free (list);
+
+    if (ret != HPDF_OK)
+        HPDF_Doc_UnmarkDuplicates (pdf);
+
+    return ret;
+}
+
+
+void
+HPDF_Doc_UnmarkDuplicates  (HPDF_Doc  pdf)
+{
+    HPDF_Xref xref = pdf->xref;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Doc_UnmarkDuplicates\n"));
+
+    if (!pdf->dedup_mode)
+        return;
+
+    for (i = 1; i < xref->entries->count; i++) {
+        HPDF_XrefEntry entry = HPDF_Xref_GetEntry (xref, i);
+        HPDF_Obj_Header *header = (HPDF_Obj_Header *)entry->obj;
+
+        if (entry->entry_typ == HPDF_IN_USE_ENTRY)
+            continue;
+
+        entry->entry_typ = HPDF_IN_USE_ENTRY;
+        header->obj_id = (header->obj_id & 0xFF000000) +
+                xref->start_offset + i;
+    }
+}
+
+
+static HPDF_BOOL
+GetDigest  (void       *obj,
+            HPDF_BYTE  *digest)
+{
+    HPDF_MD5_CTX ctx;
+
+    HPDF_MD5Init (&ctx);
+
+    if (!DigestObject (&ctx, obj, 0))
+        return HPDF_FALSE;
+
+    HPDF_MD5Final (digest, &ctx);
+
+    return HPDF_TRUE;
+}
+
+
+static HPDF_BOOL
+DigestStream  (HPDF_MD5_CTX  *ctx,
+               HPDF_Stream   stream)
+{
+    HPDF_UINT size = HPDF_Stream_Size (stream);
+
+    HPDF_MD5Update (ctx, (HPDF_BYTE *)&size, sizeof(size));
+
+    if (stream->type == HPDF_STREAM_MEMORY) {
+        HPDF_UINT count = HPDF_MemStream_GetBufCount (stream);
+        HPDF_UINT i;
+
+        for (i = 0; i < count; i++) {
+            HPDF_UINT len;
+            HPDF_BYTE *buf = HPDF_MemStream_GetBufPtr (stream, i, &len);
+
+            if (!buf)
+                return HPDF_FALSE;
+
+            HPDF_MD5Update (ctx, buf, len);
+        }
+
+        return HPDF_TRUE;
+    }
+
+    /* the data is read from the file when the document is saved. */
+    if (stream->type == HPDF_STREAM_DEFERRED) {
+        const char *fname = HPDF_DeferredReader_GetFileName (stream);
+
+        HPDF_MD5Update (ctx, (const HPDF_BYTE *)fname,
+                HPDF_StrLen (fname, -1) + 1);
+
+        return HPDF_TRUE;
+    }
+
+    return HPDF_FALSE;
+}
+
+
+static HPDF_BOOL
+DigestDict  (HPDF_MD5_CTX  *ctx,
+             HPDF_Dict     dict,
+             HPDF_UINT     depth)
+{
+    HPDF_UINT16 obj_class = dict->header.obj_class;
+    HPDF_UINT i;
+
+    /* the contents of the object may be created when it is written. only
+     * the images whose data is loaded at that time are known.
+     */
+    if (dict->before_write_fn || dict->write_fn || dict->after_write_fn) {
+        HPDF_Image_LoadDataFunc load_fn;
+        const void *param;
+        HPDF_UINT param_len;
+
+        if (!HPDF_Image_GetDelayedLoading (dict, &load_fn, &param,
+                    &param_len))
+            return HPDF_FALSE;
+
+        HPDF_MD5Update (ctx, (HPDF_BYTE *)&load_fn, sizeof(load_fn));
+        if (param_len > 0)
+            HPDF_MD5Update (ctx, (const HPDF_BYTE *)param, param_len);
+    }
+
+    /* an extgstate becomes read only when it is used. */
+    if ((obj_class & ~HPDF_OCLASS_ANY) == HPDF_OSUBCLASS_EXT_GSTATE_R)
+        obj_class = HPDF_OSUBCLASS_EXT_GSTATE | HPDF_OCLASS_DICT;
+
+    HPDF_MD5Update (ctx, (HPDF_BYTE *)&obj_class, sizeof(obj_class));
+    HPDF_MD5Update (ctx, (HPDF_BYTE *)&dict->filter, sizeof(dict->filter));
+    HPDF_MD5Update (ctx, (HPDF_BYTE *)&dict->list->count,
+            sizeof(dict->list->count));
+
+    for (i = 0; i < dict->list->count; i++) {
+        HPDF_DictElement element =
+                (HPDF_DictElement)HPDF_List_ItemAt (dict->list, i);
+
+        /* the value of the length is set when the stream is written. */
+        if (dict->stream && HPDF_StrCmp (element->key, "Length") == 0)
+            continue;
+
+        HPDF_MD5Update (ctx, (const HPDF_BYTE *)element->key,
+                HPDF_StrLen (element->key, -1) + 1);
+
+        if (!DigestObject (ctx, element->value, depth + 1))
+            return HPDF_FALSE;
+    }
+
+    if (dict->filterParams && !DigestDict (ctx, dict->filterParams, depth + 1))
+        return HPDF_FALSE;
+
+    if (dict->stream)
+        return DigestStream (ctx, dict->stream);
+
+    return HPDF_TRUE;
+}
+
+
+static HPDF_BOOL
+DigestObject  (HPDF_MD5_CTX  *ctx,
+               void          *obj,
+               HPDF_UINT     depth)
+{
+    HPDF_Obj_Header *header = (HPDF_Obj_Header *)obj;
+    HPDF_BYTE obj_class = (HPDF_BYTE)(header->obj_class & HPDF_OCLASS_ANY);
+    HPDF_UINT i;
+
+    if (depth > HPDF_DEDUP_MAX_DEPTH)
+        return HPDF_FALSE;
+
+    if (obj_class == HPDF_OCLASS_PROXY)
+        return DigestObject (ctx, ((HPDF_Proxy)obj)->obj, depth + 1);
+
+    HPDF_MD5Update (ctx, &obj_class, 1);
+
+    switch (obj_class) {
+        case HPDF_OCLASS_NULL:
+            break;
+        case HPDF_OCLASS_BOOLEAN:
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&((HPDF_Boolean)obj)->value,
+                    sizeof(HPDF_BOOL));
+            break;
+        case HPDF_OCLASS_NUMBER:
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&((HPDF_Number)obj)->value,
+                    sizeof(HPDF_INT32));
+            break;
+        case HPDF_OCLASS_REAL:
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&((HPDF_Real)obj)->value,
+                    sizeof(HPDF_REAL));
+            break;
+        case HPDF_OCLASS_NAME:
+            HPDF_MD5Update (ctx, (const HPDF_BYTE *)((HPDF_Name)obj)->value,
+                    HPDF_StrLen (((HPDF_Name)obj)->value, -1) + 1);
+            break;
+        case HPDF_OCLASS_STRING:
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&((HPDF_String)obj)->encoder,
+                    sizeof(HPDF_Encoder));
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&((HPDF_String)obj)->len,
+                    sizeof(HPDF_UINT));
+            HPDF_MD5Update (ctx, ((HPDF_String)obj)->value,
+                    ((HPDF_String)obj)->len);
+            break;
+        case HPDF_OCLASS_BINARY:
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&((HPDF_Binary)obj)->len,
+                    sizeof(HPDF_UINT));
+            HPDF_MD5Update (ctx, ((HPDF_Binary)obj)->value,
+                    ((HPDF_Binary)obj)->len);
+            break;
+        case HPDF_OCLASS_ARRAY: {
+            HPDF_List list = ((HPDF_Array)obj)->list;
+
+            HPDF_MD5Update (ctx, (HPDF_BYTE *)&list->count, sizeof(HPDF_UINT));
+            for (i = 0; i < list->count; i++)
+                if (!DigestObject (ctx, HPDF_List_ItemAt (list, i), depth + 1))
+                    return HPDF_FALSE;
+            break;
+        }
+        case HPDF_OCLASS_DICT:
+            return DigestDict (ctx, (HPDF_Dict)obj, depth);
+        default:
+            return HPDF_FALSE;
+    }
+
+    return HPDF_TRUE;
+}
+
+
+static HPDF_BOOL
+EqualStreams  (HPDF_Stream  stream1,
+               HPDF_Stream  stream2)
+{
+    HPDF_UINT count1;
+    HPDF_UINT count2;
+    HPDF_UINT i1 = 0;
+    HPDF_UINT i2 = 0;
+    HPDF_UINT len1 = 0;
+    HPDF_UINT len2 = 0;
+    HPDF_BYTE *buf1 = NULL;
+    HPDF_BYTE *buf2 = NULL;
+
+    if (stream1->type != stream2->type ||
+            HPDF_Stream_Size (stream1) != HPDF_Stream_Size (stream2))
+        return HPDF_FALSE;
+
+    if (stream1->type == HPDF_STREAM_DEFERRED)
+        return HPDF_StrCmp (HPDF_DeferredReader_GetFileName (stream1),
+                HPDF_DeferredReader_GetFileName (stream2)) == 0;
+
+    if (stream1->type != HPDF_STREAM_MEMORY)
+        return HPDF_FALSE;
+
+    /* the data of the streams may be split in buffers of other sizes */
+    count1 = HPDF_MemStream_GetBufCount (stream1);
+    count2 = HPDF_MemStream_GetBufCount (stream2);
+
+    for (;;) {
+        HPDF_UINT n;
+
+        while (len1 == 0 && i1 < count1)
+            if (!(buf1 = HPDF_MemStream_GetBufPtr (stream1, i1++, &len1)))
+                return HPDF_FALSE;
+
+        while (len2 == 0 && i2 < count2)
+            if (!(buf2 = HPDF_MemStream_GetBufPtr (stream2, i2++, &len2)))
+                return HPDF_FALSE;
+
+        if (len1 == 0 || len2 == 0)
+            return (len1 == len2);
+
+        n = (len1 < len2) ? len1 : len2;
+        if (HPDF_MemCmp (buf1, buf2, n) != 0)
+            return HPDF_FALSE;
+
+        buf1 += n;
+        buf2 += n;
+        len1 -= n;
+        len2 -= n;
+    }
+}
+
+
+static HPDF_BOOL
+EqualDicts  (HPDF_Dict  dict1,
+             HPDF_Dict  dict2,
+             HPDF_UINT  depth)
+{
+    HPDF_UINT16 obj_class1 = dict1->header.obj_class;
+    HPDF_UINT16 obj_class2 = dict2->header.obj_class;
+    HPDF_UINT i;
+
+    if (dict1->before_write_fn || dict1->write_fn || dict1->after_write_fn ||
+            dict2->before_write_fn || dict2->write_fn ||
+            dict2->after_write_fn) {
+        HPDF_Image_LoadDataFunc load_fn1;
+        HPDF_Image_LoadDataFunc load_fn2;
+        const void *param1;
+        const void *param2;
+        HPDF_UINT param_len1;
+        HPDF_UINT param_len2;
+
+        if (!HPDF_Image_GetDelayedLoading (dict1, &load_fn1, &param1,
+                    &param_len1) ||
+                !HPDF_Image_GetDelayedLoading (dict2, &load_fn2, &param2,
+                    &param_len2) ||
+                load_fn1 != load_fn2 || param_len1 != param_len2)
+            return HPDF_FALSE;
+
+        if (param_len1 > 0 && HPDF_MemCmp ((const HPDF_BYTE *)param1,
+                    (const HPDF_BYTE *)param2, param_len1) != 0)
+            return HPDF_FALSE;
+    }
+
+    if ((obj_class1 & ~HPDF_OCLASS_ANY) == HPDF_OSUBCLASS_EXT_GSTATE_R)
+        obj_class1 = HPDF_OSUBCLASS_EXT_GSTATE | HPDF_OCLASS_DICT;
+    if ((obj_class2 & ~HPDF_OCLASS_ANY) == HPDF_OSUBCLASS_EXT_GSTATE_R)
+        obj_class2 = HPDF_OSUBCLASS_EXT_GSTATE | HPDF_OCLASS_DICT;
+
+    if (obj_class1 != obj_class2 || dict1->filter != dict2->filter ||
+            dict1->list->count != dict2->list->count ||
+            !dict1->stream != !dict2->stream ||
+            !dict1->filterParams != !dict2->filterParams)
+        return HPDF_FALSE;
+
+    for (i = 0; i < dict1->list->count; i++) {
+        HPDF_DictElement element1 =
+                (HPDF_DictElement)HPDF_List_ItemAt (dict1->list, i);
+        HPDF_DictElement element2 =
+                (HPDF_DictElement)HPDF_List_ItemAt (dict2->list, i);
+
+        if (HPDF_StrCmp (element1->key, element2->key) != 0)
+            return HPDF_FALSE;
+
+        /* the value of the length is set when the stream is written. */
+        if (dict1->stream && HPDF_StrCmp (element1->key, "Length") == 0)
+            continue;
+
+        if (!EqualObjects (element1->value, element2->value, depth + 1))
+            return HPDF_FALSE;
+    }
+
+    if (dict1->filterParams && !EqualDicts (dict1->filterParams,
+                dict2->filterParams, depth + 1))
+        return HPDF_FALSE;
+
+    if (dict1->stream)
+        return EqualStreams (dict1->stream, dict2->stream);
+
+    return HPDF_TRUE;
+}
+
+
+/* compare the contents of two objects, as DigestObject reads them. */
+static HPDF_BOOL
+EqualObjects  (void       *obj1,
+               void       *obj2,
+               HPDF_UINT  depth)
+{
+    HPDF_Obj_Header *header1 = (HPDF_Obj_Header *)obj1;
+    HPDF_Obj_Header *header2 = (HPDF_Obj_Header *)obj2;
+    HPDF_BYTE obj_class = (HPDF_BYTE)(header1->obj_class & HPDF_OCLASS_ANY);
+    HPDF_UINT i;
+
+    if (depth > HPDF_DEDUP_MAX_DEPTH)
+        return HPDF_FALSE;
+
+    if (obj_class == HPDF_OCLASS_PROXY)
+        return EqualObjects (((HPDF_Proxy)obj1)->obj, obj2, depth + 1);
+
+    if ((header2->obj_class & HPDF_OCLASS_ANY) == HPDF_OCLASS_PROXY)
+        return EqualObjects (obj1, ((HPDF_Proxy)obj2)->obj, depth + 1);
+
+    if (obj1 == obj2)
+        return HPDF_TRUE;
+
+    if (obj_class != (header2->obj_class & HPDF_OCLASS_ANY))
+        return HPDF_FALSE;
+
+    switch (obj_class) {
+        case HPDF_OCLASS_NULL:
+            return HPDF_TRUE;
+        case HPDF_OCLASS_BOOLEAN:
+            return ((HPDF_Boolean)obj1)->value == ((HPDF_Boolean)obj2)->value;
+        case HPDF_OCLASS_NUMBER:
+            return ((HPDF_Number)obj1)->value == ((HPDF_Number)obj2)->value;
+        case HPDF_OCLASS_REAL:
+            return HPDF_MemCmp ((HPDF_BYTE *)&((HPDF_Real)obj1)->value,
+                    (HPDF_BYTE *)&((HPDF_Real)obj2)->value,
+                    sizeof(HPDF_REAL)) == 0;
+        case HPDF_OCLASS_NAME:
+            return HPDF_StrCmp (((HPDF_Name)obj1)->value,
+                    ((HPDF_Name)obj2)->value) == 0;
+        case HPDF_OCLASS_STRING: {
+            HPDF_String str1 = (HPDF_String)obj1;
+            HPDF_String str2 = (HPDF_String)obj2;
+
+            return str1->encoder == str2->encoder && str1->len == str2->len &&
+                    (str1->len == 0 || HPDF_MemCmp (str1->value, str2->value,
+                    str1->len) == 0);
+        }
+        case HPDF_OCLASS_BINARY: {
+            HPDF_Binary bin1 = (HPDF_Binary)obj1;
+            HPDF_Binary bin2 = (HPDF_Binary)obj2;
+
+            return bin1->len == bin2->len && (bin1->len == 0 ||
+                    HPDF_MemCmp (bin1->value, bin2->value, bin1->len) == 0);
+        }
+        case HPDF_OCLASS_ARRAY: {
+            HPDF_List list1 = ((HPDF_Array)obj1)->list;
+            HPDF_List list2 = ((HPDF_Array)obj2)->list;
+
+            if (list1->count != list2->count)
+                return HPDF_FALSE;
+
+            for (i = 0; i < list1->count; i++)
+                if (!EqualObjects (HPDF_List_ItemAt (list1, i),
+                            HPDF_List_ItemAt (list2, i), depth + 1))
+                    return HPDF_FALSE;
+
+            return HPDF_TRUE;
+        }
+        case HPDF_OCLASS_DICT:
+            return EqualDicts ((HPDF_Dict)obj1, (HPDF_Dict)obj2, depth);
+        default:
+            return HPDF_FALSE;
+    }
+}
+
+
+static HPDF_DedupEntry
+FindEntry  (HPDF_List         list,
+            const HPDF_BYTE  *digest,
+            void             *obj)
+{
+    HPDF_UINT i;
+
+    for (i = 0; i < list->count; i++) {
+        HPDF_DedupEntry entry = (HPDF_DedupEntry)HPDF_List_ItemAt (list, i);
+
+        if (HPDF_MemCmp (entry->digest, digest, HPDF_MD5_KEY_LEN) == 0 &&
+                EqualObjects (entry->obj, obj, 0))
+            return entry;
+    }
+
+    return NULL;
+}
+
+
+static HPDF_STATUS
+AddEntry  (HPDF_Doc          pdf,
+           HPDF_List         list,
+           const HPDF_BYTE  *digest,
+           void             *obj)
+{
+    HPDF_DedupEntry entry;
+    HPDF_STATUS ret;
+
+    entry = HPDF_GetMem (pdf->mmgr, sizeof(HPDF_DedupEntry_Rec));
+    if (!entry)
+        return HPDF_Error_GetCode (&pdf->error);
+
+    HPDF_MemCpy (entry->digest, digest, HPDF_MD5_KEY_LEN);
+    entry->obj = obj;
+
+    if ((ret = HPDF_List_Add (list, entry)) != HPDF_OK)
+        HPDF_FreeMem (pdf->mmgr, entry);
+
+    return ret;
+}
+
+
+static void
+FreeEntries  (HPDF_MMgr  mmgr,
+              HPDF_List  list)
+{
+    HPDF_UINT i;
+
+    for (i = 0; i < list->count; i++)
+        HPDF_FreeMem (mmgr, HPDF_List_ItemAt (list, i));
+
+    HPDF_List_Clear (list);
+}
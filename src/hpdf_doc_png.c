@@ -35,6 +35,7 @@ HPDF_LoadPngImageFromMem  (HPDF_Doc     pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadPngImageFromMem\n"));
 
@@ -42,6 +43,8 @@ HPDF_LoadPngImageFromMem  (HPDF_Doc     pdf,
         return NULL;
     }
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_MemStream_New (pdf->mmgr, size);
 
@@ -64,7 +67,7 @@ HPDF_LoadPngImageFromMem  (HPDF_Doc     pdf,
         HPDF_CheckError (&pdf->error);
     }
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 
 }
 
@@ -75,12 +78,15 @@ HPDF_LoadPngImageFromFile  (HPDF_Doc     pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadPngImageFromFile\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_FileReader_New (pdf->mmgr, filename);
 
@@ -96,7 +102,7 @@ HPDF_LoadPngImageFromFile  (HPDF_Doc     pdf,
     if (!image)
         HPDF_CheckError (&pdf->error);
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 
 /* delaied loading version of HPDF_LoadPngImageFromFile */
@@ -106,6 +112,7 @@ HPDF_LoadPngImageFromFile2  (HPDF_Doc     pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
     HPDF_String fname;
 
     HPDF_PTRACE ((" HPDF_LoadPngImageFromFile2\n"));
@@ -113,6 +120,8 @@ HPDF_LoadPngImageFromFile2  (HPDF_Doc     pdf,
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* check whether file name is valid or not. */
     imagedata = HPDF_FileReader_New (pdf->mmgr, filename);
 
@@ -146,7 +155,7 @@ HPDF_LoadPngImageFromFile2  (HPDF_Doc     pdf,
         return NULL;
     }
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 
 
@@ -157,12 +166,15 @@ HPDF_LoadPngImageFromFileW (HPDF_Doc       pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
 
     HPDF_PTRACE ((" HPDF_LoadPngImageFromFile\n"));
 
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* create file stream */
     imagedata = HPDF_FileReader_NewW(pdf->mmgr, filename);
 
@@ -178,7 +190,7 @@ HPDF_LoadPngImageFromFileW (HPDF_Doc       pdf,
     if (!image)
         HPDF_CheckError (&pdf->error);
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 
 /* delaied loading version of HPDF_LoadPngImageFromFile */
@@ -188,6 +200,7 @@ HPDF_LoadPngImageFromFile2W (HPDF_Doc       pdf,
 {
     HPDF_Stream imagedata;
     HPDF_Image image;
+    HPDF_UINT obj_count;
     HPDF_String fname;
 
     HPDF_PTRACE ((" HPDF_LoadPngImageFromFile\n"));
@@ -195,6 +208,8 @@ HPDF_LoadPngImageFromFile2W (HPDF_Doc       pdf,
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
+    obj_count = pdf->xref->entries->count;
+
     /* check whether file name is valid or not. */
     imagedata = HPDF_FileReader_NewW(pdf->mmgr, filename);
 
@@ -228,7 +243,7 @@ HPDF_LoadPngImageFromFile2W (HPDF_Doc       pdf,
         return NULL;
     }
 
-    return image;
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
 }
 #endif
 
@@ -247,7 +262,8 @@ LoadPngImageFromStream (HPDF_Doc      pdf,
                 delayed_loading);
 
     if (image && (pdf->compression_mode & HPDF_COMP_IMAGE)) {
-        image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
+        /* the data of the image may be compressed already */
+        image->filter |= HPDF_STREAM_FILTER_FLATE_DECODE;
 
     // is there an alpha layer? then compress it also
     smask = HPDF_Dict_GetItem(image, "SMask", HPDF_OCLASS_DICT);
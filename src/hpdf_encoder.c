@@ -19,6 +19,7 @@
 #include "hpdf_utils.h"
 #include "hpdf_encoder.h"
 #include "hpdf.h"
+#include "hpdf_encoder_index.h"
 
 typedef struct _HPDF_UnicodeGryphPair {
     HPDF_UNICODE     unicode;
@@ -2200,6 +2201,81 @@ HPDF_BasicEncoder_OverrideMap  (HPDF_Encoder        encoder,
                                 const HPDF_UNICODE  *map);
 
 
+/* the maps of the builtin encodings which have been built so far, indexed
+ * like HPDF_BUILTIN_ENCODINGS. they are shared by all documents of the
+ * process and never changed. they are allocated with HPDF_MALLOC, not by
+ * the allocator of a document, and freed by HPDF_FreeGlobalCaches.
+ */
+static HPDF_BasicEncoderAttr basic_encoder_attrs
+        [sizeof(HPDF_BUILTIN_ENCODINGS) / sizeof(HPDF_BUILTIN_ENCODINGS[0])];
+
+
+static HPDF_BasicEncoderAttr
+GetBasicEncoderAttr  (HPDF_Encoder                     encoder,
+                      const HPDF_BuiltinEncodingData  *data)
+{
+    HPDF_UINT index = (HPDF_UINT)(data - HPDF_BUILTIN_ENCODINGS);
+    HPDF_BasicEncoderAttr attr;
+    char *eptr;
+
+    HPDF_GlobalLock ();
+
+    attr = basic_encoder_attrs[index];
+    if (attr) {
+        HPDF_GlobalUnlock ();
+        return attr;
+    }
+
+    attr = HPDF_MALLOC (sizeof(HPDF_BasicEncoderAttr_Rec));
+    if (!attr) {
+        HPDF_GlobalUnlock ();
+        HPDF_SetError (encoder->error, HPDF_FAILD_TO_ALLOC_MEM, HPDF_NOERROR);
+        return NULL;
+    }
+
+    HPDF_MemSet (attr, 0, sizeof(HPDF_BasicEncoderAttr_Rec));
+    encoder->attr = attr;
+
+    attr->first_char = HPDF_BASIC_ENCODER_FIRST_CHAR;
+    attr->last_char = HPDF_BASIC_ENCODER_LAST_CHAR;
+    attr->has_differences = HPDF_FALSE;
+
+    eptr = attr->base_encoding + HPDF_LIMIT_MAX_NAME_LEN;
+
+    switch (data->base_encoding) {
+        case HPDF_BASE_ENCODING_STANDARD:
+            HPDF_StrCpy (attr->base_encoding,
+                     HPDF_ENCODING_STANDARD,  eptr);
+            HPDF_BasicEncoder_CopyMap (encoder, HPDF_UNICODE_MAP_STANDARD);
+            break;
+        case HPDF_BASE_ENCODING_WIN_ANSI:
+            HPDF_StrCpy (attr->base_encoding,
+                     HPDF_ENCODING_WIN_ANSI,  eptr);
+            HPDF_BasicEncoder_CopyMap (encoder, HPDF_UNICODE_MAP_WIN_ANSI);
+            break;
+        case HPDF_BASE_ENCODING_MAC_ROMAN:
+            HPDF_StrCpy (attr->base_encoding,
+                     HPDF_ENCODING_MAC_ROMAN,  eptr);
+            HPDF_BasicEncoder_CopyMap (encoder, HPDF_UNICODE_MAP_MAC_ROMAN);
+            break;
+        default:
+            HPDF_StrCpy (attr->base_encoding,
+                     HPDF_ENCODING_FONT_SPECIFIC,  eptr);
+            HPDF_BasicEncoder_CopyMap (encoder,
+                    HPDF_UNICODE_MAP_FONT_SPECIFIC);
+    }
+
+    if (data->ovewrride_map)
+        HPDF_BasicEncoder_OverrideMap  (encoder, data->ovewrride_map);
+
+    basic_encoder_attrs[index] = attr;
+
+    HPDF_GlobalUnlock ();
+
+    return attr;
+}
+
+
 /*-- HPDF_Encoder ---------------------------------------*/
 
 HPDF_Encoder
@@ -2207,7 +2283,6 @@ HPDF_BasicEncoder_New  (HPDF_MMgr        mmgr,
                         const char  *encoding_name)
 {
     HPDF_Encoder encoder;
-    HPDF_BasicEncoderAttr encoder_attr;
     const HPDF_BuiltinEncodingData *data;
     char *eptr;
 
@@ -2239,48 +2314,13 @@ HPDF_BasicEncoder_New  (HPDF_MMgr        mmgr,
     encoder->write_fn = HPDF_BasicEncoder_Write;
     encoder->free_fn = HPDF_BasicEncoder_Free;
 
-    encoder_attr = HPDF_GetMem(mmgr, sizeof(HPDF_BasicEncoderAttr_Rec));
-    if (!encoder_attr) {
+    encoder->sig_bytes = HPDF_ENCODER_SIG_BYTES;
+    encoder->attr = GetBasicEncoderAttr (encoder, data);
+    if (!encoder->attr) {
         HPDF_FreeMem (encoder->mmgr, encoder);
         return NULL;
     }
 
-    encoder->sig_bytes = HPDF_ENCODER_SIG_BYTES;
-    encoder->attr = encoder_attr;
-    HPDF_MemSet (encoder_attr, 0, sizeof(HPDF_BasicEncoderAttr_Rec));
-
-    encoder_attr->first_char = HPDF_BASIC_ENCODER_FIRST_CHAR;
-    encoder_attr->last_char = HPDF_BASIC_ENCODER_LAST_CHAR;
-    encoder_attr->has_differences = HPDF_FALSE;
-
-    eptr = encoder_attr->base_encoding + HPDF_LIMIT_MAX_NAME_LEN;
-
-    switch (data->base_encoding) {
-        case HPDF_BASE_ENCODING_STANDARD:
-            HPDF_StrCpy (encoder_attr->base_encoding,
-                     HPDF_ENCODING_STANDARD,  eptr);
-            HPDF_BasicEncoder_CopyMap (encoder, HPDF_UNICODE_MAP_STANDARD);
-            break;
-        case HPDF_BASE_ENCODING_WIN_ANSI:
-            HPDF_StrCpy (encoder_attr->base_encoding,
-                     HPDF_ENCODING_WIN_ANSI,  eptr);
-            HPDF_BasicEncoder_CopyMap (encoder, HPDF_UNICODE_MAP_WIN_ANSI);
-            break;
-        case HPDF_BASE_ENCODING_MAC_ROMAN:
-            HPDF_StrCpy (encoder_attr->base_encoding,
-                     HPDF_ENCODING_MAC_ROMAN,  eptr);
-            HPDF_BasicEncoder_CopyMap (encoder, HPDF_UNICODE_MAP_MAC_ROMAN);
-            break;
-        default:
-            HPDF_StrCpy (encoder_attr->base_encoding,
-                     HPDF_ENCODING_FONT_SPECIFIC,  eptr);
-            HPDF_BasicEncoder_CopyMap (encoder,
-                    HPDF_UNICODE_MAP_FONT_SPECIFIC);
-    }
-
-    if (data->ovewrride_map)
-        HPDF_BasicEncoder_OverrideMap  (encoder, data->ovewrride_map);
-
     return encoder;
 }
 
@@ -2290,19 +2330,30 @@ HPDF_BasicEncoder_New  (HPDF_MMgr        mmgr,
 const HPDF_BuiltinEncodingData*
 HPDF_BasicEncoder_FindBuiltinData  (const char  *encoding_name)
 {
-    HPDF_UINT i = 0;
+    const HPDF_UINT count = sizeof(HPDF_BUILTIN_ENCODING_INDEX) /
+            sizeof(HPDF_BUILTIN_ENCODING_INDEX[0]);
+    HPDF_UINT low = 0;
+    HPDF_UINT high = count;
 
     HPDF_PTRACE((" HPDF_BasicEncoder_FindBuiltinData\n"));
 
-    while (HPDF_BUILTIN_ENCODINGS[i].encoding_name) {
-        if (HPDF_StrCmp (HPDF_BUILTIN_ENCODINGS[i].encoding_name,
-                encoding_name) == 0)
-            break;
+    while (low < high) {
+        HPDF_UINT mid = (low + high) / 2;
 
-        i++;
+        if (HPDF_StrCmp (HPDF_BUILTIN_ENCODINGS[HPDF_BUILTIN_ENCODING_INDEX
+                [mid]].encoding_name, encoding_name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
-    return &HPDF_BUILTIN_ENCODINGS[i];
+    if (low < count && HPDF_StrCmp (HPDF_BUILTIN_ENCODINGS
+            [HPDF_BUILTIN_ENCODING_INDEX[low]].encoding_name,
+            encoding_name) == 0)
+        return &HPDF_BUILTIN_ENCODINGS[HPDF_BUILTIN_ENCODING_INDEX[low]];
+
+    /* the terminating entry */
+    return &HPDF_BUILTIN_ENCODINGS[count];
 }
 
 
@@ -2327,6 +2378,20 @@ HPDF_Encoder_ToUnicode  (HPDF_Encoder     encoder,
 }
 
 
+/* the unicode of the character whose code was parsed last with state. */
+HPDF_UNICODE
+HPDF_Encoder_ParsedToUnicode  (HPDF_Encoder        encoder,
+                               HPDF_ParseText_Rec  *state,
+                               HPDF_UINT16         code)
+{
+    /* the UTF-8 encoder decodes the characters while parsing. */
+    if (encoder->encode_text_fn)
+        return state->unicode;
+
+    return encoder->to_unicode_fn (encoder, code);
+}
+
+
 void
 HPDF_BasicEncoder_CopyMap  (HPDF_Encoder        encoder,
                             const HPDF_UNICODE  *map)
@@ -2388,17 +2453,30 @@ HPDF_Encoder_Free  (HPDF_Encoder  encoder)
 }
 
 
+/* HPDF_UNICODE_GRYPH_NAME_MAP is sorted by unicode, and
+ * HPDF_GRYPH_NAME_INDEX lists its entries by name. both lookups return the
+ * first matching entry, as there are names for more than one unicode.
+ */
 const char*
 HPDF_UnicodeToGryphName  (HPDF_UNICODE  unicode)
 {
-    const HPDF_UnicodeGryphPair* map = HPDF_UNICODE_GRYPH_NAME_MAP;
+    HPDF_UINT low = 0;
+    HPDF_UINT high = sizeof(HPDF_GRYPH_NAME_INDEX) /
+            sizeof(HPDF_GRYPH_NAME_INDEX[0]);
 
     HPDF_PTRACE ((" HPDF_UnicodeToGryphName\n"));
 
-    while (map->unicode <= unicode) {
-        if (map->unicode == unicode)
-            return map->gryph_name;
-        map++;
+    while (low < high) {
+        HPDF_UINT mid = (low + high) / 2;
+        HPDF_UNICODE u = HPDF_UNICODE_GRYPH_NAME_MAP[mid].unicode;
+
+        if (u == unicode)
+            return HPDF_UNICODE_GRYPH_NAME_MAP[mid].gryph_name;
+
+        if (u < unicode)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
     return HPDF_UNICODE_GRYPH_NAME_MAP[0].gryph_name;
@@ -2407,16 +2485,27 @@ HPDF_UnicodeToGryphName  (HPDF_UNICODE  unicode)
 HPDF_UNICODE
 HPDF_GryphNameToUnicode  (const char  *gryph_name)
 {
-    const HPDF_UnicodeGryphPair* map = HPDF_UNICODE_GRYPH_NAME_MAP;
+    const HPDF_UINT count = sizeof(HPDF_GRYPH_NAME_INDEX) /
+            sizeof(HPDF_GRYPH_NAME_INDEX[0]);
+    HPDF_UINT low = 0;
+    HPDF_UINT high = count;
 
     HPDF_PTRACE ((" HPDF_GryphNameToUnicode\n"));
 
-    while (map->unicode != 0xFFFF) {
-        if (HPDF_StrCmp (gryph_name, map->gryph_name) == 0)
-            return map->unicode;
-        map++;
+    while (low < high) {
+        HPDF_UINT mid = (low + high) / 2;
+
+        if (HPDF_StrCmp (HPDF_UNICODE_GRYPH_NAME_MAP[HPDF_GRYPH_NAME_INDEX
+                [mid]].gryph_name, gryph_name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
+    if (low < count && HPDF_StrCmp (HPDF_UNICODE_GRYPH_NAME_MAP
+            [HPDF_GRYPH_NAME_INDEX[low]].gryph_name, gryph_name) == 0)
+        return HPDF_UNICODE_GRYPH_NAME_MAP[HPDF_GRYPH_NAME_INDEX[low]].unicode;
+
     return 0x0000;
 }
 
@@ -2425,7 +2514,7 @@ HPDF_BasicEncoder_Free (HPDF_Encoder  encoder)
 {
     HPDF_PTRACE ((" HPDF_BasicEncoder_Free\n"));
 
-    HPDF_FreeMem (encoder->mmgr, encoder->attr);
+    /* the map is shared with the other encoders of the same name */
     encoder->attr = NULL;
 }
 
@@ -2515,6 +2604,177 @@ HPDF_Encoder_Validate  (HPDF_Encoder  encoder)
 }
 
 
+/* the tables of the CMap encoders which have been initialized so far. they
+ * are shared by all documents of the process and never changed. like the
+ * maps above, they are freed by HPDF_FreeGlobalCaches.
+ */
+static HPDF_CMapTable cmap_tables = NULL;
+
+/* the pages of the maps which contain no codes point to these. */
+#define UNDEF_UNICODE_4    HPDF_CMAP_UNDEF_UNICODE, HPDF_CMAP_UNDEF_UNICODE, \
+                           HPDF_CMAP_UNDEF_UNICODE, HPDF_CMAP_UNDEF_UNICODE
+#define UNDEF_UNICODE_32   UNDEF_UNICODE_4, UNDEF_UNICODE_4, UNDEF_UNICODE_4, \
+                           UNDEF_UNICODE_4, UNDEF_UNICODE_4, UNDEF_UNICODE_4, \
+                           UNDEF_UNICODE_4, UNDEF_UNICODE_4
+
+static const HPDF_UNICODE UNDEF_UNICODE_PAGE[256] = {
+    UNDEF_UNICODE_32, UNDEF_UNICODE_32, UNDEF_UNICODE_32, UNDEF_UNICODE_32,
+    UNDEF_UNICODE_32, UNDEF_UNICODE_32, UNDEF_UNICODE_32, UNDEF_UNICODE_32
+};
+
+static const HPDF_UINT16 UNDEF_CID_PAGE[256] = { 0 };
+
+
+static void
+FreeCMapTable  (HPDF_CMapTable  table)
+{
+    HPDF_UINT i;
+
+    for (i = 0; i < 256; i++) {
+        if (table->unicode_map[i] != UNDEF_UNICODE_PAGE)
+            HPDF_FREE ((HPDF_UNICODE *)table->unicode_map[i]);
+        if (table->cid_map[i] != UNDEF_CID_PAGE)
+            HPDF_FREE ((HPDF_UINT16 *)table->cid_map[i]);
+    }
+
+    HPDF_FREE (table);
+}
+
+
+/* the maps are indexed by the high byte of the code first. a page of 256
+ * entries is only allocated, when a code of it is set.
+ */
+static HPDF_UNICODE*
+GetUnicodePage  (HPDF_Encoder  encoder,
+                 HPDF_UINT     h)
+{
+    HPDF_CMapTable table = ((HPDF_CMapEncoderAttr)encoder->attr)->table;
+
+    if (table->unicode_map[h] == UNDEF_UNICODE_PAGE) {
+        HPDF_UNICODE *page = HPDF_MALLOC (sizeof(UNDEF_UNICODE_PAGE));
+
+        if (!page) {
+            HPDF_SetError (encoder->error, HPDF_FAILD_TO_ALLOC_MEM,
+                    HPDF_NOERROR);
+            return NULL;
+        }
+
+        HPDF_MemCpy ((HPDF_BYTE *)page, (const HPDF_BYTE *)UNDEF_UNICODE_PAGE,
+                sizeof(UNDEF_UNICODE_PAGE));
+        table->unicode_map[h] = page;
+    }
+
+    return (HPDF_UNICODE *)table->unicode_map[h];
+}
+
+
+static HPDF_UINT16*
+GetCIDPage  (HPDF_Encoder  encoder,
+             HPDF_UINT     h)
+{
+    HPDF_CMapTable table = ((HPDF_CMapEncoderAttr)encoder->attr)->table;
+
+    if (table->cid_map[h] == UNDEF_CID_PAGE) {
+        HPDF_UINT16 *page = HPDF_MALLOC (sizeof(UNDEF_CID_PAGE));
+
+        if (!page) {
+            HPDF_SetError (encoder->error, HPDF_FAILD_TO_ALLOC_MEM,
+                    HPDF_NOERROR);
+            return NULL;
+        }
+
+        HPDF_MemSet (page, 0, sizeof(UNDEF_CID_PAGE));
+        table->cid_map[h] = page;
+    }
+
+    return (HPDF_UINT16 *)table->cid_map[h];
+}
+
+
+static HPDF_CMapTable
+FindCMapTable  (const char  *name)
+{
+    HPDF_CMapTable table = cmap_tables;
+
+    while (table) {
+        if (HPDF_StrCmp (table->name, name) == 0)
+            return table;
+        table = table->next;
+    }
+
+    return NULL;
+}
+
+
+/* call init_fn of the encoder, and publish the tables it has built so that
+ * the next encoder of the same name can use them without building again.
+ */
+static HPDF_STATUS
+CMapEncoder_Init  (HPDF_Encoder  encoder)
+{
+    HPDF_CMapEncoderAttr attr = (HPDF_CMapEncoderAttr)encoder->attr;
+    HPDF_CMapTable table;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" CMapEncoder_Init\n"));
+
+    if (!attr->init_fn)
+        return HPDF_INVALID_ENCODER;
+
+    if ((ret = attr->init_fn (encoder)) != HPDF_OK || !attr->table)
+        return ret;
+
+    HPDF_GlobalLock ();
+
+    table = FindCMapTable (encoder->name);
+    if (!table) {
+        table = attr->table;
+        table->next = cmap_tables;
+        cmap_tables = table;
+    } else
+        FreeCMapTable (attr->table);
+
+    HPDF_GlobalUnlock ();
+
+    attr->table = NULL;
+    attr->unicode_map = table->unicode_map;
+    attr->cid_map = table->cid_map;
+
+    return HPDF_OK;
+}
+
+
+/* free the tables shared by the documents. they are built again by the
+ * next encoder which needs them.
+ */
+HPDF_EXPORT(void)
+HPDF_FreeGlobalCaches  (void)
+{
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_FreeGlobalCaches\n"));
+
+    HPDF_GlobalLock ();
+
+    for (i = 0; i < sizeof(basic_encoder_attrs) /
+            sizeof(basic_encoder_attrs[0]); i++) {
+        if (basic_encoder_attrs[i]) {
+            HPDF_FREE (basic_encoder_attrs[i]);
+            basic_encoder_attrs[i] = NULL;
+        }
+    }
+
+    while (cmap_tables) {
+        HPDF_CMapTable table = cmap_tables;
+
+        cmap_tables = table->next;
+        FreeCMapTable (table);
+    }
+
+    HPDF_GlobalUnlock ();
+}
+
+
 /* At first, CMAP encoder is create as 'virtual' object.
  * When init_fn is called, cmap-data is loaded and it becomes to be available
  */
@@ -2525,6 +2785,7 @@ HPDF_CMapEncoder_New  (HPDF_MMgr                mmgr,
                        HPDF_Encoder_Init_Func   init_fn)
 {
     HPDF_Encoder encoder;
+    HPDF_CMapEncoderAttr encoder_attr;
 
     HPDF_PTRACE ((" HPDF_CMapEncoder_New\n"));
 
@@ -2537,6 +2798,15 @@ HPDF_CMapEncoder_New  (HPDF_MMgr                mmgr,
 
     HPDF_MemSet (encoder, 0, sizeof(HPDF_Encoder_Rec));
 
+    encoder_attr = HPDF_GetMem (mmgr, sizeof(HPDF_CMapEncoderAttr_Rec));
+    if (!encoder_attr) {
+        HPDF_FreeMem (mmgr, encoder);
+        return NULL;
+    }
+
+    HPDF_MemSet (encoder_attr, 0, sizeof(HPDF_CMapEncoderAttr_Rec));
+    encoder_attr->init_fn = init_fn;
+
     HPDF_StrCpy (encoder->name, name, encoder->name + HPDF_LIMIT_MAX_NAME_LEN);
     encoder->mmgr = mmgr;
     encoder->error = mmgr->error;
@@ -2545,7 +2815,8 @@ HPDF_CMapEncoder_New  (HPDF_MMgr                mmgr,
     encoder->to_unicode_fn = HPDF_CMapEncoder_ToUnicode;
     encoder->write_fn = HPDF_CMapEncoder_Write;
     encoder->free_fn = HPDF_CMapEncoder_Free;
-    encoder->init_fn = init_fn;
+    encoder->init_fn = CMapEncoder_Init;
+    encoder->attr = encoder_attr;
     encoder->sig_bytes = HPDF_ENCODER_SIG_BYTES;
 
     return encoder;
@@ -2555,33 +2826,46 @@ HPDF_CMapEncoder_New  (HPDF_MMgr                mmgr,
 HPDF_STATUS
 HPDF_CMapEncoder_InitAttr  (HPDF_Encoder  encoder)
 {
-    HPDF_CMapEncoderAttr encoder_attr;
+    HPDF_CMapEncoderAttr encoder_attr =
+                (HPDF_CMapEncoderAttr)encoder->attr;
+    HPDF_CMapTable table;
     HPDF_UINT i;
-    HPDF_UINT j;
 
     HPDF_PTRACE ((" HPDF_CMapEncoder_InitAttr\n"));
 
-    if (encoder->attr)
+    if (!encoder_attr || encoder_attr->cmap_range)
         return HPDF_INVALID_ENCODER;
 
-    encoder_attr = HPDF_GetMem(encoder->mmgr,
-            sizeof(HPDF_CMapEncoderAttr_Rec));
-
-    if (!encoder_attr)
-        return encoder->error->error_no;
-
-    HPDF_MemSet (encoder_attr, 0, sizeof(HPDF_CMapEncoderAttr_Rec));
-    encoder->attr = encoder_attr;
-
     encoder_attr->writing_mode = HPDF_WMODE_HORIZONTAL;
 
-    for (i = 0; i <= 255; i++) {
-        for (j = 0; j <= 255; j++) {
-            /* undefined characters are replaced to square */
-            encoder_attr->unicode_map[i][j] = 0x25A1;
+    /* the tables of an encoder are the same in every document, so they are
+     * built only by the first encoder of each name.
+     */
+    HPDF_GlobalLock ();
+    table = FindCMapTable (encoder->name);
+    HPDF_GlobalUnlock ();
+
+    if (!table) {
+        table = HPDF_MALLOC (sizeof(HPDF_CMapTable_Rec));
+        if (!table)
+            return HPDF_SetError (encoder->error, HPDF_FAILD_TO_ALLOC_MEM,
+                    HPDF_NOERROR);
+
+        HPDF_MemSet (table, 0, sizeof(HPDF_CMapTable_Rec));
+        HPDF_StrCpy (table->name, encoder->name,
+                table->name + HPDF_LIMIT_MAX_NAME_LEN);
+
+        for (i = 0; i < 256; i++) {
+            table->unicode_map[i] = UNDEF_UNICODE_PAGE;
+            table->cid_map[i] = UNDEF_CID_PAGE;
         }
+
+        encoder_attr->table = table;
     }
 
+    encoder_attr->unicode_map = table->unicode_map;
+    encoder_attr->cid_map = table->cid_map;
+
     /* create cmap range */
     encoder_attr->cmap_range = HPDF_List_New (encoder->mmgr,
                 HPDF_DEF_RANGE_TBL_NUM);
@@ -2606,11 +2890,9 @@ HPDF_UNICODE
 HPDF_CMapEncoder_ToUnicode  (HPDF_Encoder  encoder,
                              HPDF_UINT16   code)
 {
-    HPDF_BYTE l = (HPDF_BYTE)code;
-    HPDF_BYTE h = (HPDF_BYTE)(code >> 8);
     HPDF_CMapEncoderAttr attr = (HPDF_CMapEncoderAttr)encoder->attr;
 
-    return attr->unicode_map[l][h];
+    return attr->unicode_map[code >> 8][code & 0xFF];
 }
 
 
@@ -2618,12 +2900,9 @@ HPDF_UINT16
 HPDF_CMapEncoder_ToCID  (HPDF_Encoder  encoder,
                          HPDF_UINT16   code)
 {
-    HPDF_BYTE l = (HPDF_BYTE)code;
-    HPDF_BYTE h = (HPDF_BYTE)(code >> 8);
-
     HPDF_CMapEncoderAttr attr = (HPDF_CMapEncoderAttr)encoder->attr;
 
-    return attr->cid_map[l][h];
+    return attr->cid_map[code >> 8][code & 0xFF];
 }
 
 void
@@ -2637,15 +2916,13 @@ HPDF_CMapEncoder_Free  (HPDF_Encoder  encoder)
 
     attr = (HPDF_CMapEncoderAttr)encoder->attr;
 
-    if (attr && attr->cmap_range) {
-        for (i = 0; i < attr->cmap_range->count; i++) {
-            data = HPDF_List_ItemAt (attr->cmap_range, i);
-
-            HPDF_FreeMem (encoder->mmgr, data);
-        }
-
+    /* the items of cmap_range point into the constant range arrays. */
+    if (attr && attr->cmap_range)
         HPDF_List_Free (attr->cmap_range);
-    }
+
+    /* the tables were not published, because init_fn has failed. */
+    if (attr && attr->table)
+        FreeCMapTable (attr->table);
 
     if (attr && attr->notdef_range) {
         for (i = 0; i < attr->notdef_range->count; i++) {
@@ -2697,6 +2974,8 @@ HPDF_Encoder_SetParseText  (HPDF_Encoder        encoder,
     state->index = 0;
     state->len = len;
     state->byte_type = HPDF_BYTE_TYPE_SINGLE;
+    HPDF_MemSet (state->encoder_state, 0, sizeof(state->encoder_state));
+    state->unicode = 0;
 }
 
 
@@ -2750,40 +3029,36 @@ HPDF_CMapEncoder_AddCMap  (HPDF_Encoder             encoder,
 
     HPDF_PTRACE ((" HPDF_CMapEncoder_AddCMap\n"));
 
-    /* Copy specified pdf_cid_range array to fRangeArray. */
+    /* Add the elements of specified pdf_cid_range array to fRangeArray.
+     * the array is constant data, so the elements are not copied.
+     */
     while (range->from != 0xffff || range->to != 0xffff) {
-	HPDF_CidRange_Rec *prange;
 	HPDF_STATUS ret;
 
 	/*
-	 * Only if we have the default to_unicode_fn
+	 * Only if we have the default to_unicode_fn, and the tables are
+	 * not shared yet.
 	 */
-	if (encoder->to_unicode_fn == HPDF_CMapEncoder_ToUnicode) {
+	if (attr->table &&
+		encoder->to_unicode_fn == HPDF_CMapEncoder_ToUnicode) {
 	    HPDF_UINT16 code = range->from;
 	    HPDF_UINT16 cid = range->cid;
 
 	    while (code <= range->to) {
-		HPDF_BYTE l = (HPDF_BYTE) (code & 0xFF);
-		HPDF_BYTE h = code >> 8;
+		HPDF_UINT16 *page = GetCIDPage (encoder, code >> 8);
+
+		if (!page)
+		    return encoder->error->error_no;
 
-		attr->cid_map[l][h] = cid;
+		page[code & 0xFF] = cid;
 		code++;
 		cid++;
 	    }
 	}
 
-        prange = HPDF_GetMem (encoder->mmgr, sizeof(HPDF_CidRange_Rec));
-        if (!prange)
-            return encoder->error->error_no;
-
-        prange->from = range->from;
-        prange->to = range->to;
-        prange->cid = range->cid;
-
-        if ((ret = HPDF_List_Add (attr->cmap_range, prange)) != HPDF_OK) {
-            HPDF_FreeMem (encoder->mmgr, prange);
+        if ((ret = HPDF_List_Add (attr->cmap_range,
+                        (HPDF_CidRange_Rec *)range)) != HPDF_OK)
             return ret;
-        }
 
         range++;
     }
@@ -2842,7 +3117,7 @@ HPDF_CMapEncoder_AddCodeSpaceRange  (HPDF_Encoder        encoder,
 }
 
 
-void
+HPDF_STATUS
 HPDF_CMapEncoder_SetUnicodeArray  (HPDF_Encoder                 encoder,
                                    const HPDF_UnicodeMap_Rec   *array)
 {
@@ -2850,13 +3125,18 @@ HPDF_CMapEncoder_SetUnicodeArray  (HPDF_Encoder                 encoder,
 
     HPDF_PTRACE ((" HPDF_CMapEncoder_SetUnicodeArray\n"));
 
-    if (array != NULL)
+    if (array != NULL && attr->table)
         while (array->unicode != 0xffff) {
-            HPDF_BYTE l = (HPDF_BYTE)array->code;
-            HPDF_BYTE h = (HPDF_BYTE)(array->code >> 8);
-            attr->unicode_map[l][h] = array->unicode;
+            HPDF_UNICODE *page = GetUnicodePage (encoder, array->code >> 8);
+
+            if (!page)
+                return encoder->error->error_no;
+
+            page[array->code & 0xFF] = array->unicode;
             array++;
         }
+
+    return HPDF_OK;
 }
 
 
@@ -36130,7 +36130,9 @@ GBK_EUC_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP936_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP936_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = GBK_EUC_IsLeadByte;
     attr->is_trial_byte_fn = GBK_EUC_IsTrialByte;
@@ -36176,7 +36178,9 @@ GBK_EUC_V_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP936_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP936_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = GBK_EUC_IsLeadByte;
     attr->is_trial_byte_fn = GBK_EUC_IsTrialByte;
@@ -36255,7 +36259,9 @@ GB_EUC_H_Init  (HPDF_Encoder  encoder)
                 HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_CN_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_CN_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = GB_EUC_IsLeadByte;
     attr->is_trial_byte_fn = GB_EUC_IsTrialByte;
@@ -36299,7 +36305,9 @@ GB_EUC_V_Init  (HPDF_Encoder  encoder)
                 HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_CN_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_CN_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = GB_EUC_IsLeadByte;
     attr->is_trial_byte_fn = GB_EUC_IsTrialByte;
@@ -15211,7 +15211,9 @@ ETen_B5_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP950_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP950_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = ETen_B5_IsLeadByte;
     attr->is_trial_byte_fn = ETen_B5_IsTrialByte;
@@ -15257,7 +15259,9 @@ ETen_B5_V_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP950_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP950_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = ETen_B5_IsLeadByte;
     attr->is_trial_byte_fn = ETen_B5_IsTrialByte;
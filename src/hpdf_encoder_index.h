@@ -0,0 +1,110 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_encoder_index.h
+ *
+ * generated by cmake/modules/name_index.cmake, do not edit.
+ *
+ */
+
+#ifndef _HPDF_ENCODER_INDEX_H
+#define _HPDF_ENCODER_INDEX_H
+
+/* HPDF_UNICODE_GRYPH_NAME_MAP by gryph_name */
+static const HPDF_UINT16 HPDF_GRYPH_NAME_INDEX[1052] = {
+    0, 34, 134, 329, 991, 129, 986, 194, 130, 987, 882, 982,
+    132, 989, 128, 985, 364, 355, 192, 196, 133, 327, 990, 952,
+    131, 988, 35, 365, 925, 953, 36, 198, 883, 926, 204, 135,
+    992, 200, 202, 983, 385, 927, 954, 37, 206, 208, 367, 753,
+    884, 885, 886, 980, 928, 955, 38, 137, 994, 212, 218, 138,
+    995, 139, 996, 214, 136, 993, 210, 266, 216, 368, 357, 956,
+    370, 358, 144, 1001, 718, 39, 957, 40, 366, 222, 325, 220,
+    226, 224, 887, 951, 958, 41, 856, 847, 848, 846, 230, 228,
+    959, 888, 929, 42, 242, 141, 998, 236, 142, 999, 143, 1000,
+    240, 720, 140, 997, 234, 238, 372, 388, 359, 960, 232, 43,
+    244, 961, 44, 373, 246, 962, 45, 872, 249, 374, 253, 251,
+    255, 257, 930, 963, 46, 889, 981, 964, 375, 47, 259, 263,
+    261, 965, 145, 1002, 376, 48, 274, 931, 147, 1004, 270, 148,
+    1005, 150, 1007, 932, 146, 1003, 321, 272, 268, 387, 727, 362,
+    378, 360, 152, 331, 1008, 966, 149, 1006, 49, 384, 379, 386,
+    967, 50, 968, 51, 276, 280, 278, 724, 380, 933, 969, 52,
+    799, 801, 800, 802, 807, 805, 806, 803, 804, 797, 798, 825,
+    826, 814, 813, 827, 809, 815, 821, 820, 819, 822, 823, 818,
+    812, 833, 830, 824, 808, 836, 831, 832, 828, 829, 817, 816,
+    810, 811, 835, 834, 282, 288, 934, 286, 874, 284, 333, 381,
+    970, 53, 382, 294, 292, 290, 335, 371, 158, 1014, 935, 971,
+    54, 154, 1010, 300, 155, 1011, 156, 1012, 153, 1009, 323, 304,
+    298, 306, 383, 426, 389, 361, 302, 972, 296, 55, 973, 56,
+    652, 308, 654, 650, 974, 57, 377, 975, 58, 157, 1013, 310,
+    312, 1015, 656, 976, 59, 313, 317, 936, 315, 369, 977, 66,
+    161, 195, 162, 116, 349, 164, 166, 330, 665, 443, 444, 445,
+    446, 447, 448, 429, 449, 450, 451, 452, 453, 454, 455, 456,
+    457, 458, 459, 460, 461, 462, 463, 464, 465, 466, 467, 468,
+    469, 470, 471, 472, 473, 474, 527, 430, 431, 432, 433, 434,
+    435, 436, 437, 438, 439, 440, 441, 877, 878, 475, 476, 477,
+    478, 479, 480, 507, 481, 482, 483, 484, 485, 486, 487, 488,
+    489, 490, 491, 492, 493, 494, 495, 496, 497, 498, 499, 500,
+    501, 502, 503, 504, 505, 506, 528, 508, 509, 510, 511, 512,
+    513, 514, 515, 516, 517, 518, 519, 442, 521, 523, 525, 879,
+    520, 522, 524, 526, 880, 881, 529, 660, 661, 659, 637, 579,
+    627, 628, 629, 630, 631, 632, 633, 634, 635, 636, 580, 581,
+    582, 583, 584, 585, 586, 587, 588, 589, 590, 591, 592, 593,
+    594, 595, 596, 597, 598, 599, 600, 601, 602, 603, 604, 605,
+    606, 607, 608, 609, 610, 611, 612, 613, 614, 616, 617, 618,
+    619, 620, 621, 622, 623, 624, 625, 626, 615, 645, 640, 641,
+    644, 646, 639, 642, 643, 647, 648, 649, 716, 543, 548, 549,
+    550, 551, 552, 553, 554, 555, 556, 557, 558, 559, 560, 561,
+    562, 563, 564, 565, 566, 567, 568, 569, 570, 571, 572, 573,
+    574, 575, 1048, 1049, 1051, 1047, 576, 577, 578, 1050, 534, 535,
+    536, 540, 538, 537, 530, 532, 531, 533, 547, 546, 539, 541,
+    542, 544, 545, 337, 719, 721, 722, 680, 681, 682, 658, 638,
+    338, 160, 729, 395, 390, 193, 7, 939, 768, 795, 796, 356,
+    197, 777, 165, 328, 740, 748, 747, 744, 746, 745, 739, 1018,
+    736, 738, 737, 741, 742, 1017, 63, 95, 11, 762, 914, 33,
+    163, 67, 61, 93, 396, 839, 1031, 92, 1030, 1029, 1028, 94,
+    1041, 1040, 1039, 60, 1027, 1026, 1025, 62, 1038, 1037, 1036, 342,
+    102, 915, 676, 68, 199, 340, 743, 205, 167, 201, 203, 120,
+    98, 904, 979, 905, 417, 855, 788, 787, 339, 866, 27, 712,
+    13, 876, 906, 907, 776, 105, 1020, 898, 100, 890, 891, 893,
+    894, 69, 674, 675, 892, 895, 207, 209, 112, 398, 868, 104,
+    896, 897, 354, 183, 844, 838, 5, 908, 938, 909, 717, 343,
+    352, 241, 871, 790, 916, 70, 169, 213, 219, 170, 171, 215,
+    168, 25, 708, 948, 695, 755, 679, 211, 664, 752, 663, 267,
+    217, 399, 391, 30, 779, 728, 917, 401, 392, 176, 2, 688,
+    97, 978, 937, 751, 71, 863, 1042, 1045, 1046, 1043, 662, 845,
+    849, 22, 734, 705, 945, 692, 1044, 320, 21, 704, 944, 691,
+    689, 761, 713, 72, 397, 223, 326, 221, 227, 225, 159, 754,
+    65, 348, 31, 781, 107, 123, 686, 687, 73, 231, 229, 867,
+    351, 791, 347, 14, 109, 910, 911, 74, 173, 237, 174, 175,
+    172, 243, 235, 766, 773, 794, 1032, 793, 771, 857, 858, 861,
+    239, 403, 420, 363, 393, 918, 233, 75, 245, 76, 404, 247,
+    248, 77, 250, 405, 254, 252, 256, 29, 780, 840, 714, 873,
+    769, 108, 770, 319, 854, 258, 919, 842, 78, 111, 341, 864,
+    760, 684, 920, 117, 406, 151, 869, 870, 79, 260, 265, 264,
+    262, 26, 709, 949, 696, 756, 778, 784, 699, 177, 407, 4,
+    80, 179, 271, 180, 182, 275, 345, 178, 322, 273, 269, 419,
+    428, 424, 409, 422, 18, 677, 732, 901, 125, 701, 941, 124,
+    121, 730, 859, 106, 122, 767, 184, 332, 921, 181, 81, 118,
+    9, 1024, 1023, 710, 697, 1022, 10, 1035, 1034, 711, 698, 1033,
+    750, 6, 15, 119, 763, 912, 913, 789, 683, 715, 416, 427,
+    410, 12, 113, 725, 758, 782, 783, 765, 418, 82, 32, 127,
+    984, 950, 3, 673, 671, 672, 667, 670, 668, 669, 8, 83,
+    277, 764, 1016, 281, 279, 785, 786, 110, 1019, 899, 792, 411,
+    344, 922, 841, 902, 84, 283, 289, 287, 875, 285, 334, 685,
+    103, 28, 24, 735, 707, 947, 694, 843, 413, 412, 775, 23,
+    706, 946, 693, 16, 860, 1, 96, 865, 923, 99, 757, 759,
+    862, 85, 414, 295, 293, 291, 336, 774, 402, 425, 190, 20,
+    733, 703, 943, 126, 903, 115, 346, 350, 353, 726, 1021, 900,
+    852, 853, 851, 850, 924, 19, 678, 702, 942, 114, 731, 86,
+    186, 301, 187, 188, 185, 324, 305, 299, 64, 666, 772, 749,
+    307, 837, 415, 421, 394, 423, 303, 297, 87, 88, 653, 309,
+    655, 723, 651, 89, 408, 90, 189, 311, 191, 101, 657, 91,
+    314, 318, 316, 17, 700, 940, 690, 400
+};
+
+/* HPDF_BUILTIN_ENCODINGS by encoding_name */
+static const HPDF_UINT16 HPDF_BUILTIN_ENCODING_INDEX[28] = {
+    18, 19, 20, 21, 22, 23, 24, 25, 26, 0, 12, 13,
+    14, 15, 16, 17, 4, 5, 6, 7, 8, 9, 10, 11,
+    27, 2, 1, 3
+};
+
+#endif /* _HPDF_ENCODER_INDEX_H */
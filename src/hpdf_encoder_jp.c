@@ -15835,7 +15835,9 @@ MS_RKSJ_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP932_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP932_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = RKSJ_IsLeadByte;
     attr->is_trial_byte_fn = RKSJ_IsTrialByte;
@@ -15879,7 +15881,9 @@ MSP_RKSJ_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP932_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP932_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = RKSJ_IsLeadByte;
     attr->is_trial_byte_fn = RKSJ_IsTrialByte;
@@ -15927,7 +15931,9 @@ MS_RKSJ_V_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP932_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP932_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = RKSJ_IsLeadByte;
     attr->is_trial_byte_fn = RKSJ_IsTrialByte;
@@ -16012,7 +16018,9 @@ EUC_H_Init  (HPDF_Encoder  encoder)
     if (HPDF_CMapEncoder_AddNotDefRange (encoder, EUC_NOTDEF_RANGE) != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = EUC_IsLeadByte;
     attr->is_trial_byte_fn = EUC_IsTrialByte;
@@ -16057,7 +16065,9 @@ EUC_V_Init  (HPDF_Encoder  encoder)
     if (HPDF_CMapEncoder_AddNotDefRange (encoder, EUC_NOTDEF_RANGE) != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, EUC_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = EUC_IsLeadByte;
     attr->is_trial_byte_fn = EUC_IsTrialByte;
@@ -27695,7 +27695,9 @@ KSCms_UHC_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP949_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP949_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = KSCms_UHC_IsLeadByte;
     attr->is_trial_byte_fn = KSCms_UHC_IsTrialByte;
@@ -27737,7 +27739,9 @@ KSCms_UHC_HW_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP949_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP949_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = KSCms_UHC_IsLeadByte;
     attr->is_trial_byte_fn = KSCms_UHC_IsTrialByte;
@@ -27783,7 +27787,9 @@ KSCms_UHC_HW_V_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, CP949_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, CP949_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = KSCms_UHC_IsLeadByte;
     attr->is_trial_byte_fn = KSCms_UHC_IsTrialByte;
@@ -27862,7 +27868,9 @@ KSC_EUC_H_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, KSC_EUC_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, KSC_EUC_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = KSC_EUC_IsLeadByte;
     attr->is_trial_byte_fn = KSC_EUC_IsTrialByte;
@@ -27906,7 +27914,9 @@ KSC_EUC_V_Init  (HPDF_Encoder  encoder)
                 != HPDF_OK)
         return encoder->error->error_no;
 
-    HPDF_CMapEncoder_SetUnicodeArray (encoder, KSC_EUC_UNICODE_ARRAY);
+    if (HPDF_CMapEncoder_SetUnicodeArray (encoder, KSC_EUC_UNICODE_ARRAY)
+                != HPDF_OK)
+        return encoder->error->error_no;
 
     attr->is_lead_byte_fn = KSC_EUC_IsLeadByte;
     attr->is_trial_byte_fn = KSC_EUC_IsTrialByte;
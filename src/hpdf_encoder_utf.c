@@ -22,12 +22,13 @@
 #include "hpdf_encoder.h"
 #include "hpdf.h"
 
-typedef struct _UTF8_EncoderAttr_Rec  *UTF8_EncoderAttr;
-typedef struct  _UTF8_EncoderAttr_Rec {
+/* kept in the encoder_state of HPDF_ParseText_Rec */
+typedef struct _UTF8_ParseState_Rec  *UTF8_ParseState;
+typedef struct  _UTF8_ParseState_Rec {
       HPDF_BYTE           current_byte;
       HPDF_BYTE           end_byte;
       HPDF_BYTE           utf8_bytes[8];
-} UTF8_EncoderAttr_Rec;
+} UTF8_ParseState_Rec;
 
 static const HPDF_CidRange_Rec UTF8_NOTDEF_RANGE = {0x0000, 0x001F, 1};
 static const HPDF_CidRange_Rec UTF8_SPACE_RANGE =  {0x0000, 0xFFFF, 0};
@@ -44,6 +45,9 @@ static HPDF_UNICODE
 UTF8_Encoder_ToUnicode_Func  (HPDF_Encoder   encoder,
                               HPDF_UINT16    code);
 
+static HPDF_UNICODE
+UTF8_Decode  (UTF8_ParseState  utf8_attr);
+
 static char *
 UTF8_Encoder_EncodeText_Func  (HPDF_Encoder        encoder,
                    const char         *text,
@@ -73,12 +77,12 @@ UTF8_Encoder_ByteType_Func  (HPDF_Encoder        encoder,
     //   next byte (lsb) is the CODE argument in call ToUnicodeFunc
     // When HPDF_BYTE_TYPE_TRAIL is returned, the current byte is ignored
 
-    HPDF_CMapEncoderAttr  encoder_attr;
     HPDF_BYTE             byte;
-    UTF8_EncoderAttr      utf8_attr;
+    UTF8_ParseState       utf8_attr;
 
-    encoder_attr = (HPDF_CMapEncoderAttr) encoder->attr;
-    utf8_attr = (UTF8_EncoderAttr) ((void *)encoder_attr->cid_map[0]);
+    HPDF_UNUSED(encoder);
+
+    utf8_attr = (UTF8_ParseState) ((void *)state->encoder_state);
 
     if (state->index == 0) {
     //First byte, initialize.
@@ -100,6 +104,7 @@ UTF8_Encoder_ByteType_Func  (HPDF_Encoder        encoder,
     if (!(byte & 0x80)) {
         utf8_attr->current_byte = 0;
         utf8_attr->end_byte = 0;
+        state->unicode = UTF8_Decode (utf8_attr);
         return HPDF_BYTE_TYPE_SINGLE;
     }
 
@@ -115,6 +120,7 @@ UTF8_Encoder_ByteType_Func  (HPDF_Encoder        encoder,
     utf8_attr->utf8_bytes[utf8_attr->current_byte] = byte;
     if (utf8_attr->current_byte == utf8_attr->end_byte) {
         utf8_attr->current_byte = 0;
+        state->unicode = UTF8_Decode (utf8_attr);
         return HPDF_BYTE_TYPE_SINGLE;
     }
 
@@ -132,17 +138,18 @@ static HPDF_UNICODE
 UTF8_Encoder_ToUnicode_Func  (HPDF_Encoder   encoder,
                               HPDF_UINT16    code)
 {
-    // Supposed to convert CODE to unicode.
-    // This function is always called after ByteType_Func.
-    // ByteType_Func recognizes the utf-8 bytes belonging to one character.
-    HPDF_UNUSED(code);
+    // The codes of this encoder are unicode values. The unicode of a
+    // character of a text is decoded by ByteType_Func, and is taken
+    // from the parse state (see HPDF_Encoder_ParsedToUnicode).
+    HPDF_UNUSED(encoder);
 
-    HPDF_CMapEncoderAttr encoder_attr;
-    UTF8_EncoderAttr     utf8_attr;
-    unsigned int         val;
+    return (HPDF_UNICODE) code;
+}
 
-    encoder_attr = (HPDF_CMapEncoderAttr) encoder->attr;
-    utf8_attr = (UTF8_EncoderAttr) ((void *)encoder_attr->cid_map[0]);
+static HPDF_UNICODE
+UTF8_Decode  (UTF8_ParseState  utf8_attr)
+{
+    unsigned int         val;
 
     switch (utf8_attr->end_byte) {
     case 3:
@@ -192,7 +199,7 @@ UTF8_Encoder_EncodeText_Func  (HPDF_Encoder        encoder,
     HPDF_ByteType btype = HPDF_Encoder_ByteType (encoder, &parse_state);
 
     if (btype != HPDF_BYTE_TYPE_TRAIL) {
-        tmp_unicode = HPDF_Encoder_ToUnicode (encoder, 0);
+        tmp_unicode = parse_state.unicode;
 
         HPDF_UInt16Swap (&tmp_unicode);
         HPDF_MemCpy ((HPDF_BYTE *)c, (const HPDF_BYTE*)&tmp_unicode, 2);
@@ -41,6 +41,14 @@
 #include "hpdf_utils.h"
 #include "hpdf_encrypt.h"
 
+#if defined(WIN32)
+#include <windows.h>
+#include <bcrypt.h>
+#elif defined(LIBHPDF_HAVE_SYS_RANDOM_H)
+#include <errno.h>
+#include <sys/random.h>
+#endif
+
 static const HPDF_BYTE HPDF_PADDING_STRING[] = {
     0x28, 0xBF, 0x4E, 0x5E, 0x4E, 0x75, 0x8A, 0x41,
     0x64, 0x00, 0x4E, 0x56, 0xFF, 0xFA, 0x01, 0x08,
@@ -290,6 +298,947 @@ MD5ByteReverse  (HPDF_BYTE    *buf,
     while (--longs);
 }
 
+/*---------------------------------------------------------------------------*/
+/*------ SHA-2 message-digest algorithms (revision 6) -----------------------*/
+
+typedef struct _SHA256_CTX {
+    HPDF_UINT32  h[8];
+    HPDF_UINT64  len;
+    HPDF_BYTE    in[64];
+} SHA256_CTX;
+
+
+typedef struct _SHA512_CTX {
+    HPDF_UINT64  h[8];
+    HPDF_UINT64  len;
+    HPDF_BYTE    in[128];
+} SHA512_CTX;
+
+
+static const HPDF_UINT32 SHA256_K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+    0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+    0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+    0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+
+static const HPDF_UINT64 SHA512_K[80] = {
+    0x428A2F98D728AE22ULL, 0x7137449123EF65CDULL,
+    0xB5C0FBCFEC4D3B2FULL, 0xE9B5DBA58189DBBCULL,
+    0x3956C25BF348B538ULL, 0x59F111F1B605D019ULL,
+    0x923F82A4AF194F9BULL, 0xAB1C5ED5DA6D8118ULL,
+    0xD807AA98A3030242ULL, 0x12835B0145706FBEULL,
+    0x243185BE4EE4B28CULL, 0x550C7DC3D5FFB4E2ULL,
+    0x72BE5D74F27B896FULL, 0x80DEB1FE3B1696B1ULL,
+    0x9BDC06A725C71235ULL, 0xC19BF174CF692694ULL,
+    0xE49B69C19EF14AD2ULL, 0xEFBE4786384F25E3ULL,
+    0x0FC19DC68B8CD5B5ULL, 0x240CA1CC77AC9C65ULL,
+    0x2DE92C6F592B0275ULL, 0x4A7484AA6EA6E483ULL,
+    0x5CB0A9DCBD41FBD4ULL, 0x76F988DA831153B5ULL,
+    0x983E5152EE66DFABULL, 0xA831C66D2DB43210ULL,
+    0xB00327C898FB213FULL, 0xBF597FC7BEEF0EE4ULL,
+    0xC6E00BF33DA88FC2ULL, 0xD5A79147930AA725ULL,
+    0x06CA6351E003826FULL, 0x142929670A0E6E70ULL,
+    0x27B70A8546D22FFCULL, 0x2E1B21385C26C926ULL,
+    0x4D2C6DFC5AC42AEDULL, 0x53380D139D95B3DFULL,
+    0x650A73548BAF63DEULL, 0x766A0ABB3C77B2A8ULL,
+    0x81C2C92E47EDAEE6ULL, 0x92722C851482353BULL,
+    0xA2BFE8A14CF10364ULL, 0xA81A664BBC423001ULL,
+    0xC24B8B70D0F89791ULL, 0xC76C51A30654BE30ULL,
+    0xD192E819D6EF5218ULL, 0xD69906245565A910ULL,
+    0xF40E35855771202AULL, 0x106AA07032BBD1B8ULL,
+    0x19A4C116B8D2D0C8ULL, 0x1E376C085141AB53ULL,
+    0x2748774CDF8EEB99ULL, 0x34B0BCB5E19B48A8ULL,
+    0x391C0CB3C5C95A63ULL, 0x4ED8AA4AE3418ACBULL,
+    0x5B9CCA4F7763E373ULL, 0x682E6FF3D6B2B8A3ULL,
+    0x748F82EE5DEFB2FCULL, 0x78A5636F43172F60ULL,
+    0x84C87814A1F0AB72ULL, 0x8CC702081A6439ECULL,
+    0x90BEFFFA23631E28ULL, 0xA4506CEBDE82BDE9ULL,
+    0xBEF9A3F7B2C67915ULL, 0xC67178F2E372532BULL,
+    0xCA273ECEEA26619CULL, 0xD186B8C721C0C207ULL,
+    0xEADA7DD6CDE0EB1EULL, 0xF57D4F7FEE6ED178ULL,
+    0x06F067AA72176FBAULL, 0x0A637DC5A2C898A6ULL,
+    0x113F9804BEF90DAEULL, 0x1B710B35131C471BULL,
+    0x28DB77F523047D84ULL, 0x32CAAB7B40C72493ULL,
+    0x3C9EBE0A15C9BEBCULL, 0x431D67C49C100D4CULL,
+    0x4CC5D4BECB3E42B6ULL, 0x597F299CFC657E2AULL,
+    0x5FCB6FAB3AD6FAECULL, 0x6C44198C4A475817ULL
+};
+
+
+static const HPDF_UINT32 SHA256_H[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+
+static const HPDF_UINT64 SHA384_H[8] = {
+    0xCBBB9D5DC1059ED8ULL, 0x629A292A367CD507ULL,
+    0x9159015A3070DD17ULL, 0x152FECD8F70E5939ULL,
+    0x67332667FFC00B31ULL, 0x8EB44A8768581511ULL,
+    0xDB0C2E0D64F98FA7ULL, 0x47B5481DBEFA4FA4ULL
+};
+
+
+static const HPDF_UINT64 SHA512_H[8] = {
+    0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL,
+    0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+    0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL,
+    0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+#define ROR32(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n)  (((x) >> (n)) | ((x) << (64 - (n))))
+
+static void
+SHA256Transform  (HPDF_UINT32      h[8],
+                  const HPDF_BYTE  *in)
+{
+    HPDF_UINT32 w[64];
+    HPDF_UINT32 a, b, c, d, e, f, g, k;
+    HPDF_UINT i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = (HPDF_UINT32)in[i * 4] << 24 | (HPDF_UINT32)in[i * 4 + 1] << 16 |
+               (HPDF_UINT32)in[i * 4 + 2] << 8 | in[i * 4 + 3];
+
+    for (i = 16; i < 64; i++)
+        w[i] = w[i - 16] + w[i - 7] +
+            (ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+            (ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3];
+    e = h[4]; f = h[5]; g = h[6]; k = h[7];
+
+    for (i = 0; i < 64; i++) {
+        HPDF_UINT32 t1 = k + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) +
+                ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        HPDF_UINT32 t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) +
+                ((a & b) ^ (a & c) ^ (b & c));
+
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+
+static void
+SHA256Init  (SHA256_CTX  *ctx)
+{
+    HPDF_MemCpy ((HPDF_BYTE *)ctx->h, (const HPDF_BYTE *)SHA256_H,
+            sizeof(ctx->h));
+    ctx->len = 0;
+}
+
+
+static void
+SHA256Update  (SHA256_CTX       *ctx,
+               const HPDF_BYTE  *buf,
+               HPDF_UINT        len)
+{
+    HPDF_UINT idx = (HPDF_UINT)(ctx->len & 63);
+
+    ctx->len += len;
+
+    if (idx > 0) {
+        HPDF_UINT n = (len < 64 - idx) ? len : 64 - idx;
+
+        HPDF_MemCpy (ctx->in + idx, buf, n);
+        buf += n;
+        len -= n;
+        if (idx + n < 64)
+            return;
+        SHA256Transform (ctx->h, ctx->in);
+    }
+
+    while (len >= 64) {
+        SHA256Transform (ctx->h, buf);
+        buf += 64;
+        len -= 64;
+    }
+
+    if (len > 0)
+        HPDF_MemCpy (ctx->in, buf, len);
+}
+
+
+static void
+SHA256Final  (HPDF_BYTE   digest[32],
+              SHA256_CTX  *ctx)
+{
+    HPDF_UINT64 bits = ctx->len * 8;
+    HPDF_UINT idx = (HPDF_UINT)(ctx->len & 63);
+    HPDF_UINT i;
+
+    ctx->in[idx++] = 0x80;
+    if (idx > 56) {
+        HPDF_MemSet (ctx->in + idx, 0, 64 - idx);
+        SHA256Transform (ctx->h, ctx->in);
+        idx = 0;
+    }
+    HPDF_MemSet (ctx->in + idx, 0, 56 - idx);
+    for (i = 0; i < 8; i++)
+        ctx->in[56 + i] = (HPDF_BYTE)(bits >> (56 - i * 8));
+    SHA256Transform (ctx->h, ctx->in);
+
+    for (i = 0; i < 32; i++)
+        digest[i] = (HPDF_BYTE)(ctx->h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+
+static void
+SHA512Transform  (HPDF_UINT64      h[8],
+                  const HPDF_BYTE  *in)
+{
+    HPDF_UINT64 w[80];
+    HPDF_UINT64 a, b, c, d, e, f, g, k;
+    HPDF_UINT i, j;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = 0;
+        for (j = 0; j < 8; j++)
+            w[i] = (w[i] << 8) | in[i * 8 + j];
+    }
+
+    for (i = 16; i < 80; i++)
+        w[i] = w[i - 16] + w[i - 7] +
+            (ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^ (w[i - 15] >> 7)) +
+            (ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^ (w[i - 2] >> 6));
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3];
+    e = h[4]; f = h[5]; g = h[6]; k = h[7];
+
+    for (i = 0; i < 80; i++) {
+        HPDF_UINT64 t1 = k + (ROR64(e, 14) ^ ROR64(e, 18) ^ ROR64(e, 41)) +
+                ((e & f) ^ (~e & g)) + SHA512_K[i] + w[i];
+        HPDF_UINT64 t2 = (ROR64(a, 28) ^ ROR64(a, 34) ^ ROR64(a, 39)) +
+                ((a & b) ^ (a & c) ^ (b & c));
+
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+
+/* SHA-384 is SHA-512 with other initial values and a truncated digest */
+static void
+SHA512Init  (SHA512_CTX  *ctx,
+             HPDF_BOOL   sha384)
+{
+    HPDF_MemCpy ((HPDF_BYTE *)ctx->h,
+            (const HPDF_BYTE *)(sha384 ? SHA384_H : SHA512_H), sizeof(ctx->h));
+    ctx->len = 0;
+}
+
+
+static void
+SHA512Update  (SHA512_CTX       *ctx,
+               const HPDF_BYTE  *buf,
+               HPDF_UINT        len)
+{
+    HPDF_UINT idx = (HPDF_UINT)(ctx->len & 127);
+
+    ctx->len += len;
+
+    if (idx > 0) {
+        HPDF_UINT n = (len < 128 - idx) ? len : 128 - idx;
+
+        HPDF_MemCpy (ctx->in + idx, buf, n);
+        buf += n;
+        len -= n;
+        if (idx + n < 128)
+            return;
+        SHA512Transform (ctx->h, ctx->in);
+    }
+
+    while (len >= 128) {
+        SHA512Transform (ctx->h, buf);
+        buf += 128;
+        len -= 128;
+    }
+
+    if (len > 0)
+        HPDF_MemCpy (ctx->in, buf, len);
+}
+
+
+static void
+SHA512Final  (HPDF_BYTE   *digest,
+              HPDF_UINT   digest_len,
+              SHA512_CTX  *ctx)
+{
+    HPDF_UINT64 bits = ctx->len * 8;
+    HPDF_UINT idx = (HPDF_UINT)(ctx->len & 127);
+    HPDF_UINT i;
+
+    ctx->in[idx++] = 0x80;
+    if (idx > 112) {
+        HPDF_MemSet (ctx->in + idx, 0, 128 - idx);
+        SHA512Transform (ctx->h, ctx->in);
+        idx = 0;
+    }
+    /* the upper 64 bits of the 128-bit length are always zero here */
+    HPDF_MemSet (ctx->in + idx, 0, 120 - idx);
+    for (i = 0; i < 8; i++)
+        ctx->in[120 + i] = (HPDF_BYTE)(bits >> (56 - i * 8));
+    SHA512Transform (ctx->h, ctx->in);
+
+    for (i = 0; i < digest_len; i++)
+        digest[i] = (HPDF_BYTE)(ctx->h[i / 8] >> (56 - (i % 8) * 8));
+}
+
+/*---------------------------------------------------------------------------*/
+/*------ AES block cipher (AESV2 and AESV3 crypt filters) -------------------*/
+
+static const HPDF_BYTE AES_SBOX[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5,
+    0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0,
+    0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC,
+    0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A,
+    0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0,
+    0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B,
+    0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85,
+    0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5,
+    0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17,
+    0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88,
+    0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C,
+    0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9,
+    0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6,
+    0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E,
+    0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94,
+    0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68,
+    0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+
+static const HPDF_UINT32 AES_TE0[256] = {
+    0xC66363A5, 0xF87C7C84, 0xEE777799, 0xF67B7B8D,
+    0xFFF2F20D, 0xD66B6BBD, 0xDE6F6FB1, 0x91C5C554,
+    0x60303050, 0x02010103, 0xCE6767A9, 0x562B2B7D,
+    0xE7FEFE19, 0xB5D7D762, 0x4DABABE6, 0xEC76769A,
+    0x8FCACA45, 0x1F82829D, 0x89C9C940, 0xFA7D7D87,
+    0xEFFAFA15, 0xB25959EB, 0x8E4747C9, 0xFBF0F00B,
+    0x41ADADEC, 0xB3D4D467, 0x5FA2A2FD, 0x45AFAFEA,
+    0x239C9CBF, 0x53A4A4F7, 0xE4727296, 0x9BC0C05B,
+    0x75B7B7C2, 0xE1FDFD1C, 0x3D9393AE, 0x4C26266A,
+    0x6C36365A, 0x7E3F3F41, 0xF5F7F702, 0x83CCCC4F,
+    0x6834345C, 0x51A5A5F4, 0xD1E5E534, 0xF9F1F108,
+    0xE2717193, 0xABD8D873, 0x62313153, 0x2A15153F,
+    0x0804040C, 0x95C7C752, 0x46232365, 0x9DC3C35E,
+    0x30181828, 0x379696A1, 0x0A05050F, 0x2F9A9AB5,
+    0x0E070709, 0x24121236, 0x1B80809B, 0xDFE2E23D,
+    0xCDEBEB26, 0x4E272769, 0x7FB2B2CD, 0xEA75759F,
+    0x1209091B, 0x1D83839E, 0x582C2C74, 0x341A1A2E,
+    0x361B1B2D, 0xDC6E6EB2, 0xB45A5AEE, 0x5BA0A0FB,
+    0xA45252F6, 0x763B3B4D, 0xB7D6D661, 0x7DB3B3CE,
+    0x5229297B, 0xDDE3E33E, 0x5E2F2F71, 0x13848497,
+    0xA65353F5, 0xB9D1D168, 0x00000000, 0xC1EDED2C,
+    0x40202060, 0xE3FCFC1F, 0x79B1B1C8, 0xB65B5BED,
+    0xD46A6ABE, 0x8DCBCB46, 0x67BEBED9, 0x7239394B,
+    0x944A4ADE, 0x984C4CD4, 0xB05858E8, 0x85CFCF4A,
+    0xBBD0D06B, 0xC5EFEF2A, 0x4FAAAAE5, 0xEDFBFB16,
+    0x864343C5, 0x9A4D4DD7, 0x66333355, 0x11858594,
+    0x8A4545CF, 0xE9F9F910, 0x04020206, 0xFE7F7F81,
+    0xA05050F0, 0x783C3C44, 0x259F9FBA, 0x4BA8A8E3,
+    0xA25151F3, 0x5DA3A3FE, 0x804040C0, 0x058F8F8A,
+    0x3F9292AD, 0x219D9DBC, 0x70383848, 0xF1F5F504,
+    0x63BCBCDF, 0x77B6B6C1, 0xAFDADA75, 0x42212163,
+    0x20101030, 0xE5FFFF1A, 0xFDF3F30E, 0xBFD2D26D,
+    0x81CDCD4C, 0x180C0C14, 0x26131335, 0xC3ECEC2F,
+    0xBE5F5FE1, 0x359797A2, 0x884444CC, 0x2E171739,
+    0x93C4C457, 0x55A7A7F2, 0xFC7E7E82, 0x7A3D3D47,
+    0xC86464AC, 0xBA5D5DE7, 0x3219192B, 0xE6737395,
+    0xC06060A0, 0x19818198, 0x9E4F4FD1, 0xA3DCDC7F,
+    0x44222266, 0x542A2A7E, 0x3B9090AB, 0x0B888883,
+    0x8C4646CA, 0xC7EEEE29, 0x6BB8B8D3, 0x2814143C,
+    0xA7DEDE79, 0xBC5E5EE2, 0x160B0B1D, 0xADDBDB76,
+    0xDBE0E03B, 0x64323256, 0x743A3A4E, 0x140A0A1E,
+    0x924949DB, 0x0C06060A, 0x4824246C, 0xB85C5CE4,
+    0x9FC2C25D, 0xBDD3D36E, 0x43ACACEF, 0xC46262A6,
+    0x399191A8, 0x319595A4, 0xD3E4E437, 0xF279798B,
+    0xD5E7E732, 0x8BC8C843, 0x6E373759, 0xDA6D6DB7,
+    0x018D8D8C, 0xB1D5D564, 0x9C4E4ED2, 0x49A9A9E0,
+    0xD86C6CB4, 0xAC5656FA, 0xF3F4F407, 0xCFEAEA25,
+    0xCA6565AF, 0xF47A7A8E, 0x47AEAEE9, 0x10080818,
+    0x6FBABAD5, 0xF0787888, 0x4A25256F, 0x5C2E2E72,
+    0x381C1C24, 0x57A6A6F1, 0x73B4B4C7, 0x97C6C651,
+    0xCBE8E823, 0xA1DDDD7C, 0xE874749C, 0x3E1F1F21,
+    0x964B4BDD, 0x61BDBDDC, 0x0D8B8B86, 0x0F8A8A85,
+    0xE0707090, 0x7C3E3E42, 0x71B5B5C4, 0xCC6666AA,
+    0x904848D8, 0x06030305, 0xF7F6F601, 0x1C0E0E12,
+    0xC26161A3, 0x6A35355F, 0xAE5757F9, 0x69B9B9D0,
+    0x17868691, 0x99C1C158, 0x3A1D1D27, 0x279E9EB9,
+    0xD9E1E138, 0xEBF8F813, 0x2B9898B3, 0x22111133,
+    0xD26969BB, 0xA9D9D970, 0x078E8E89, 0x339494A7,
+    0x2D9B9BB6, 0x3C1E1E22, 0x15878792, 0xC9E9E920,
+    0x87CECE49, 0xAA5555FF, 0x50282878, 0xA5DFDF7A,
+    0x038C8C8F, 0x59A1A1F8, 0x09898980, 0x1A0D0D17,
+    0x65BFBFDA, 0xD7E6E631, 0x844242C6, 0xD06868B8,
+    0x824141C3, 0x299999B0, 0x5A2D2D77, 0x1E0F0F11,
+    0x7BB0B0CB, 0xA85454FC, 0x6DBBBBD6, 0x2C16163A
+};
+
+
+static const HPDF_BYTE AES_RCON[10] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36
+};
+
+#define AES_GETU32(p)  ((HPDF_UINT32)(p)[0] << 24 | (HPDF_UINT32)(p)[1] << 16 | \
+                        (HPDF_UINT32)(p)[2] << 8 | (HPDF_UINT32)(p)[3])
+#define AES_SUBWORD(t) ((HPDF_UINT32)AES_SBOX[(t) >> 24] << 24 | \
+                        (HPDF_UINT32)AES_SBOX[((t) >> 16) & 0xFF] << 16 | \
+                        (HPDF_UINT32)AES_SBOX[((t) >> 8) & 0xFF] << 8 | \
+                        AES_SBOX[(t) & 0xFF])
+
+/* the other three round tables are rotations of AES_TE0 */
+#define AES_TE(x, n)   ROR32(AES_TE0[x], (n))
+
+/* the blocks are encrypted with the AES instructions of the processor when
+ * it has them: AES-NI (detected with cpuid) or the ARMv8 crypto extension
+ * (detected with getauxval on Linux). the tables below are the fallback.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+        (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define HPDF_AES_NI
+#define HPDF_AES_HW_FUNC     __attribute__((target("aes,sse2")))
+
+static HPDF_BOOL
+HasAESHardware  (void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx))
+        return HPDF_FALSE;
+
+    return (ecx & bit_AES) ? HPDF_TRUE : HPDF_FALSE;
+}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <wmmintrin.h>
+#define HPDF_AES_NI
+#define HPDF_AES_HW_FUNC
+
+static HPDF_BOOL
+HasAESHardware  (void)
+{
+    int info[4];
+
+    __cpuid (info, 1);
+    return (info[2] >> 25) & 1 ? HPDF_TRUE : HPDF_FALSE;
+}
+#elif defined(__aarch64__) && defined(__linux__) && \
+        (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO) || \
+        (defined(__GNUC__) && !defined(__clang__)))
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define HPDF_AES_ARMV8
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+#define HPDF_AES_HW_FUNC
+#else
+#define HPDF_AES_HW_FUNC     __attribute__((target("+crypto")))
+#endif
+#ifndef HWCAP_AES
+#define HWCAP_AES            (1 << 3)
+#endif
+#define HasAESHardware()     ((getauxval (AT_HWCAP) & HWCAP_AES) ? \
+                                HPDF_TRUE : HPDF_FALSE)
+#elif defined(_M_ARM64)
+#include <windows.h>
+#include <arm64_neon.h>
+#define HPDF_AES_ARMV8
+#define HPDF_AES_HW_FUNC
+#define HasAESHardware()     (IsProcessorFeaturePresent ( \
+                                PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) ? \
+                                HPDF_TRUE : HPDF_FALSE)
+#elif defined(__aarch64__) && \
+        (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define HPDF_AES_ARMV8
+#define HPDF_AES_HW_FUNC
+#define HasAESHardware()     HPDF_TRUE
+#else
+#define HasAESHardware()     HPDF_FALSE
+#endif
+
+
+void
+HPDF_AES_KeyExpand  (HPDF_AES_Ctx_Rec  *ctx,
+                     const HPDF_BYTE   *key,
+                     HPDF_UINT         key_len)
+{
+    HPDF_UINT nk = key_len / 4;
+    HPDF_UINT i;
+
+    ctx->rounds = nk + 6;
+    ctx->hw = HasAESHardware ();
+
+    for (i = 0; i < nk; i++)
+        ctx->rk[i] = AES_GETU32(key + i * 4);
+
+    for (i = nk; i < 4 * (ctx->rounds + 1); i++) {
+        HPDF_UINT32 t = ctx->rk[i - 1];
+
+        if (i % nk == 0) {
+            t = (t << 8) | (t >> 24);
+            t = AES_SUBWORD(t) ^ ((HPDF_UINT32)AES_RCON[i / nk - 1] << 24);
+        } else if (nk > 6 && i % nk == 4) {
+            t = AES_SUBWORD(t);
+        }
+
+        ctx->rk[i] = ctx->rk[i - nk] ^ t;
+    }
+
+    for (i = 0; i < 4 * (ctx->rounds + 1); i++) {
+        ctx->rk_bytes[i * 4] = (HPDF_BYTE)(ctx->rk[i] >> 24);
+        ctx->rk_bytes[i * 4 + 1] = (HPDF_BYTE)(ctx->rk[i] >> 16);
+        ctx->rk_bytes[i * 4 + 2] = (HPDF_BYTE)(ctx->rk[i] >> 8);
+        ctx->rk_bytes[i * 4 + 3] = (HPDF_BYTE)ctx->rk[i];
+    }
+}
+
+
+static void
+AESEncryptBlockTable  (const HPDF_AES_Ctx_Rec  *ctx,
+                       const HPDF_BYTE         *in,
+                       HPDF_BYTE               *out)
+{
+    const HPDF_UINT32 *rk = ctx->rk;
+    HPDF_UINT32 s0, s1, s2, s3;
+    HPDF_UINT32 t0, t1, t2, t3;
+    HPDF_UINT r;
+
+    s0 = AES_GETU32(in) ^ rk[0];
+    s1 = AES_GETU32(in + 4) ^ rk[1];
+    s2 = AES_GETU32(in + 8) ^ rk[2];
+    s3 = AES_GETU32(in + 12) ^ rk[3];
+
+    for (r = 1; r < ctx->rounds; r++) {
+        rk += 4;
+        t0 = AES_TE0[s0 >> 24] ^ AES_TE((s1 >> 16) & 0xFF, 8) ^
+             AES_TE((s2 >> 8) & 0xFF, 16) ^ AES_TE(s3 & 0xFF, 24) ^ rk[0];
+        t1 = AES_TE0[s1 >> 24] ^ AES_TE((s2 >> 16) & 0xFF, 8) ^
+             AES_TE((s3 >> 8) & 0xFF, 16) ^ AES_TE(s0 & 0xFF, 24) ^ rk[1];
+        t2 = AES_TE0[s2 >> 24] ^ AES_TE((s3 >> 16) & 0xFF, 8) ^
+             AES_TE((s0 >> 8) & 0xFF, 16) ^ AES_TE(s1 & 0xFF, 24) ^ rk[2];
+        t3 = AES_TE0[s3 >> 24] ^ AES_TE((s0 >> 16) & 0xFF, 8) ^
+             AES_TE((s1 >> 8) & 0xFF, 16) ^ AES_TE(s2 & 0xFF, 24) ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    /* the last round has no MixColumns step */
+    rk += 4;
+    t0 = ((HPDF_UINT32)AES_SBOX[s0 >> 24] << 24 |
+          (HPDF_UINT32)AES_SBOX[(s1 >> 16) & 0xFF] << 16 |
+          (HPDF_UINT32)AES_SBOX[(s2 >> 8) & 0xFF] << 8 |
+          AES_SBOX[s3 & 0xFF]) ^ rk[0];
+    t1 = ((HPDF_UINT32)AES_SBOX[s1 >> 24] << 24 |
+          (HPDF_UINT32)AES_SBOX[(s2 >> 16) & 0xFF] << 16 |
+          (HPDF_UINT32)AES_SBOX[(s3 >> 8) & 0xFF] << 8 |
+          AES_SBOX[s0 & 0xFF]) ^ rk[1];
+    t2 = ((HPDF_UINT32)AES_SBOX[s2 >> 24] << 24 |
+          (HPDF_UINT32)AES_SBOX[(s3 >> 16) & 0xFF] << 16 |
+          (HPDF_UINT32)AES_SBOX[(s0 >> 8) & 0xFF] << 8 |
+          AES_SBOX[s1 & 0xFF]) ^ rk[2];
+    t3 = ((HPDF_UINT32)AES_SBOX[s3 >> 24] << 24 |
+          (HPDF_UINT32)AES_SBOX[(s0 >> 16) & 0xFF] << 16 |
+          (HPDF_UINT32)AES_SBOX[(s1 >> 8) & 0xFF] << 8 |
+          AES_SBOX[s2 & 0xFF]) ^ rk[3];
+
+    for (r = 0; r < 4; r++) {
+        out[r] = (HPDF_BYTE)(t0 >> (24 - r * 8));
+        out[4 + r] = (HPDF_BYTE)(t1 >> (24 - r * 8));
+        out[8 + r] = (HPDF_BYTE)(t2 >> (24 - r * 8));
+        out[12 + r] = (HPDF_BYTE)(t3 >> (24 - r * 8));
+    }
+}
+
+
+static void
+AESEncryptCBCTable  (const HPDF_AES_Ctx_Rec  *ctx,
+                     const HPDF_BYTE         *iv,
+                     const HPDF_BYTE         *in,
+                     HPDF_BYTE               *out,
+                     HPDF_UINT               len)
+{
+    const HPDF_BYTE *prev = iv;
+    HPDF_UINT i;
+
+    for (; len >= HPDF_AES_BLOCK_LEN; len -= HPDF_AES_BLOCK_LEN) {
+        for (i = 0; i < HPDF_AES_BLOCK_LEN; i++)
+            out[i] = (HPDF_BYTE)(in[i] ^ prev[i]);
+        AESEncryptBlockTable (ctx, out, out);
+        prev = out;
+        in += HPDF_AES_BLOCK_LEN;
+        out += HPDF_AES_BLOCK_LEN;
+    }
+}
+
+
+#if defined(HPDF_AES_NI)
+HPDF_AES_HW_FUNC static void
+AESEncryptCBCHW  (const HPDF_AES_Ctx_Rec  *ctx,
+                  const HPDF_BYTE         *iv,
+                  const HPDF_BYTE         *in,
+                  HPDF_BYTE               *out,
+                  HPDF_UINT               len)
+{
+    __m128i rk[HPDF_AES_MAX_ROUNDS + 1];
+    __m128i s = _mm_loadu_si128 ((const __m128i *)iv);
+    HPDF_UINT rounds = ctx->rounds;
+    HPDF_UINT r;
+
+    for (r = 0; r <= rounds; r++)
+        rk[r] = _mm_loadu_si128 ((const __m128i *)(ctx->rk_bytes +
+                    r * HPDF_AES_BLOCK_LEN));
+
+    for (; len >= HPDF_AES_BLOCK_LEN; len -= HPDF_AES_BLOCK_LEN) {
+        s = _mm_xor_si128 (s, _mm_loadu_si128 ((const __m128i *)in));
+        s = _mm_xor_si128 (s, rk[0]);
+        for (r = 1; r < rounds; r++)
+            s = _mm_aesenc_si128 (s, rk[r]);
+        s = _mm_aesenclast_si128 (s, rk[rounds]);
+        _mm_storeu_si128 ((__m128i *)out, s);
+        in += HPDF_AES_BLOCK_LEN;
+        out += HPDF_AES_BLOCK_LEN;
+    }
+}
+#elif defined(HPDF_AES_ARMV8)
+/* vaeseq_u8 adds the round key before SubBytes and ShiftRows, so the last
+ * round key is added after the last round.
+ */
+HPDF_AES_HW_FUNC static void
+AESEncryptCBCHW  (const HPDF_AES_Ctx_Rec  *ctx,
+                  const HPDF_BYTE         *iv,
+                  const HPDF_BYTE         *in,
+                  HPDF_BYTE               *out,
+                  HPDF_UINT               len)
+{
+    uint8x16_t rk[HPDF_AES_MAX_ROUNDS + 1];
+    uint8x16_t s = vld1q_u8 (iv);
+    HPDF_UINT rounds = ctx->rounds;
+    HPDF_UINT r;
+
+    for (r = 0; r <= rounds; r++)
+        rk[r] = vld1q_u8 (ctx->rk_bytes + r * HPDF_AES_BLOCK_LEN);
+
+    for (; len >= HPDF_AES_BLOCK_LEN; len -= HPDF_AES_BLOCK_LEN) {
+        s = veorq_u8 (s, vld1q_u8 (in));
+        for (r = 0; r < rounds - 1; r++)
+            s = vaesmcq_u8 (vaeseq_u8 (s, rk[r]));
+        s = veorq_u8 (vaeseq_u8 (s, rk[rounds - 1]), rk[rounds]);
+        vst1q_u8 (out, s);
+        in += HPDF_AES_BLOCK_LEN;
+        out += HPDF_AES_BLOCK_LEN;
+    }
+}
+#endif
+
+
+void
+HPDF_AES_EncryptBlock  (const HPDF_AES_Ctx_Rec  *ctx,
+                        const HPDF_BYTE         *in,
+                        HPDF_BYTE               *out)
+{
+#if defined(HPDF_AES_NI) || defined(HPDF_AES_ARMV8)
+    static const HPDF_BYTE zero_iv[HPDF_AES_BLOCK_LEN] = {0};
+
+    if (ctx->hw) {
+        AESEncryptCBCHW (ctx, zero_iv, in, out, HPDF_AES_BLOCK_LEN);
+        return;
+    }
+#endif
+
+    AESEncryptBlockTable (ctx, in, out);
+}
+
+
+/* encrypt whole blocks in CBC mode without padding. in and out may be the
+ * same buffer.
+ */
+void
+HPDF_AES_EncryptCBC  (const HPDF_AES_Ctx_Rec  *ctx,
+                      const HPDF_BYTE         *iv,
+                      const HPDF_BYTE         *in,
+                      HPDF_BYTE               *out,
+                      HPDF_UINT               len)
+{
+#if defined(HPDF_AES_NI) || defined(HPDF_AES_ARMV8)
+    if (ctx->hw) {
+        AESEncryptCBCHW (ctx, iv, in, out, len);
+        return;
+    }
+#endif
+
+    AESEncryptCBCTable (ctx, iv, in, out, len);
+}
+
+/*---------------------------------------------------------------------------*/
+/*------ security handler of revision 6 -------------------------------------*/
+
+#define R6_HASH_BUF_SIZ  (64 * (HPDF_UTF8_PASSWD_LEN + 64 + HPDF_SALTED_KEY_LEN))
+
+/* the file key and the salts of revision 6 must not be guessed, they are
+ * read from the random number generator of the operating system.
+ */
+static HPDF_STATUS
+GetRandomBytes  (HPDF_BYTE  *buf,
+                 HPDF_UINT  len)
+{
+#if defined(WIN32)
+    if (!BCRYPT_SUCCESS (BCryptGenRandom (NULL, buf, len,
+                BCRYPT_USE_SYSTEM_PREFERRED_RNG)))
+        return HPDF_RANDOM_SOURCE_ERROR;
+
+    return HPDF_OK;
+#else
+    HPDF_FILEP fp;
+    HPDF_UINT n;
+
+#ifdef LIBHPDF_HAVE_SYS_RANDOM_H
+    while (len > 0) {
+        ssize_t ret = getrandom (buf, len, 0);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        buf += ret;
+        len -= (HPDF_UINT)ret;
+    }
+
+    if (len == 0)
+        return HPDF_OK;
+#endif /* LIBHPDF_HAVE_SYS_RANDOM_H */
+
+    fp = HPDF_FOPEN ("/dev/urandom", "rb");
+    if (!fp)
+        return HPDF_RANDOM_SOURCE_ERROR;
+
+    n = (HPDF_UINT)HPDF_FREAD (buf, 1, len, fp);
+    HPDF_FCLOSE (fp);
+
+    return (n == len) ? HPDF_OK : HPDF_RANDOM_SOURCE_ERROR;
+#endif /* WIN32 */
+}
+
+
+/* Algorithm 2.B: hash of a password for revision 6 */
+static void
+R6ComputeHash  (const HPDF_BYTE  *pwd,
+                HPDF_UINT        pwd_len,
+                const HPDF_BYTE  *salt,
+                const HPDF_BYTE  *udata,
+                HPDF_BYTE        *hash)
+{
+    HPDF_BYTE e[R6_HASH_BUF_SIZ];
+    HPDF_BYTE k[64];
+    HPDF_UINT k_len = 32;
+    HPDF_UINT udata_len = udata ? HPDF_SALTED_KEY_LEN : 0;
+    HPDF_UINT round = 0;
+    SHA256_CTX ctx;
+
+    SHA256Init (&ctx);
+    SHA256Update (&ctx, pwd, pwd_len);
+    SHA256Update (&ctx, salt, 8);
+    if (udata)
+        SHA256Update (&ctx, udata, udata_len);
+    SHA256Final (k, &ctx);
+
+    for (;;) {
+        HPDF_AES_Ctx_Rec aes;
+        HPDF_UINT seq_len = pwd_len + k_len + udata_len;
+        HPDF_UINT sum = 0;
+        HPDF_UINT i;
+
+        HPDF_MemCpy (e, pwd, pwd_len);
+        HPDF_MemCpy (e + pwd_len, k, k_len);
+        if (udata)
+            HPDF_MemCpy (e + pwd_len + k_len, udata, udata_len);
+        for (i = 1; i < 64; i++)
+            HPDF_MemCpy (e + i * seq_len, e, seq_len);
+
+        HPDF_AES_KeyExpand (&aes, k, 16);
+        HPDF_AES_EncryptCBC (&aes, k + 16, e, e, seq_len * 64);
+
+        /* 256 mod 3 is 1, so the first 16 bytes as a big-endian number
+         * have the same remainder as the sum of them.
+         */
+        for (i = 0; i < 16; i++)
+            sum += e[i];
+
+        if (sum % 3 == 0) {
+            SHA256Init (&ctx);
+            SHA256Update (&ctx, e, seq_len * 64);
+            SHA256Final (k, &ctx);
+            k_len = 32;
+        } else {
+            SHA512_CTX ctx2;
+
+            k_len = (sum % 3 == 1) ? 48 : 64;
+            SHA512Init (&ctx2, k_len == 48);
+            SHA512Update (&ctx2, e, seq_len * 64);
+            SHA512Final (k, k_len, &ctx2);
+        }
+
+        round++;
+        if (round >= 64 && e[seq_len * 64 - 1] <= round - 32)
+            break;
+    }
+
+    HPDF_MemCpy (hash, k, 32);
+}
+
+
+/* encrypt the file key with the key of a password (UE and OE entries) */
+static void
+R6EncryptFileKey  (HPDF_Encrypt      attr,
+                   const HPDF_BYTE   *pwd,
+                   HPDF_UINT         pwd_len,
+                   const HPDF_BYTE   *salt,
+                   const HPDF_BYTE   *udata,
+                   HPDF_BYTE         *enc_key)
+{
+    HPDF_AES_Ctx_Rec aes;
+    HPDF_BYTE key[32];
+    HPDF_BYTE iv[HPDF_AES_BLOCK_LEN];
+
+    R6ComputeHash (pwd, pwd_len, salt, udata, key);
+    HPDF_AES_KeyExpand (&aes, key, 32);
+
+    HPDF_MemSet (iv, 0, HPDF_AES_BLOCK_LEN);
+    HPDF_MemCpy (enc_key, attr->encryption_key, HPDF_FILE_KEY_MAX);
+    HPDF_AES_EncryptCBC (&aes, iv, enc_key, enc_key, HPDF_FILE_KEY_MAX);
+}
+
+
+/* Algorithm 8 */
+static HPDF_STATUS
+R6CreateUserKey  (HPDF_Encrypt  attr)
+{
+    HPDF_BYTE *salt = attr->user_key + 32;
+    HPDF_STATUS ret;
+
+    if ((ret = GetRandomBytes (salt, 16)) != HPDF_OK)
+        return ret;
+
+    R6ComputeHash (attr->user_passwd_utf8, attr->user_passwd_len, salt,
+            NULL, attr->user_key);
+    R6EncryptFileKey (attr, attr->user_passwd_utf8, attr->user_passwd_len,
+            salt + 8, NULL, attr->user_enc_key);
+
+    return HPDF_OK;
+}
+
+
+/* Algorithm 9 */
+static HPDF_STATUS
+R6CreateOwnerKey  (HPDF_Encrypt  attr)
+{
+    HPDF_BYTE *salt = attr->owner_key + 32;
+    HPDF_STATUS ret;
+
+    if ((ret = GetRandomBytes (salt, 16)) != HPDF_OK)
+        return ret;
+
+    R6ComputeHash (attr->owner_passwd_utf8, attr->owner_passwd_len, salt,
+            attr->user_key, attr->owner_key);
+    R6EncryptFileKey (attr, attr->owner_passwd_utf8, attr->owner_passwd_len,
+            salt + 8, attr->user_key, attr->owner_enc_key);
+
+    return HPDF_OK;
+}
+
+
+/* Algorithm 10 */
+static HPDF_STATUS
+R6CreateEncryptionKey  (HPDF_Encrypt  attr)
+{
+    HPDF_BYTE *perms = attr->perms;
+    HPDF_STATUS ret;
+
+    if ((ret = GetRandomBytes (attr->encryption_key, HPDF_FILE_KEY_MAX)) !=
+            HPDF_OK)
+        return ret;
+
+    /* all objects are encrypted with the file key itself */
+    HPDF_AES_KeyExpand (&attr->aesctx, attr->encryption_key,
+            HPDF_FILE_KEY_MAX);
+
+    perms[0] = (HPDF_BYTE)(attr->permission);
+    perms[1] = (HPDF_BYTE)(attr->permission >> 8);
+    perms[2] = (HPDF_BYTE)(attr->permission >> 16);
+    perms[3] = (HPDF_BYTE)(attr->permission >> 24);
+    HPDF_MemSet (perms + 4, 0xFF, 4);
+    perms[8] = 'T';
+    perms[9] = 'a';
+    perms[10] = 'd';
+    perms[11] = 'b';
+    if ((ret = GetRandomBytes (perms + 12, 4)) != HPDF_OK)
+        return ret;
+
+    HPDF_AES_EncryptBlock (&attr->aesctx, perms, perms);
+
+    return HPDF_OK;
+}
+
+
+/* the initialization vectors of AES are the encrypted values of a counter
+ * (see HPDF_CryptCtx_Reset), so that they are unique and cannot be
+ * predicted without the key.
+ */
+static void
+InitIVGenerator  (HPDF_Encrypt  attr)
+{
+    HPDF_MD5_CTX ctx;
+    HPDF_BYTE digest[HPDF_MD5_KEY_LEN];
+
+    HPDF_MD5Init (&ctx);
+    HPDF_MD5Update (&ctx, attr->encryption_key, attr->key_len);
+    HPDF_MD5Update (&ctx, attr->encrypt_id, HPDF_ID_LEN);
+    HPDF_MD5Final (digest, &ctx);
+
+    HPDF_AES_KeyExpand (&attr->ivctx, digest, HPDF_MD5_KEY_LEN);
+}
+
+
 /*----- encrypt-obj ---------------------------------------------------------*/
 
 static void
@@ -304,6 +1253,9 @@ ARC4CryptBuf (HPDF_ARC4_Ctx_Rec   *ctx,
               HPDF_BYTE           *out,
               HPDF_UINT            len);
 
+#define ENCRYPT_IS_AES(attr)  ((attr)->mode == HPDF_ENCRYPT_R4 || \
+                               (attr)->mode == HPDF_ENCRYPT_R6)
+
 
 /*---------------------------------------------------------------------------*/
 
@@ -341,7 +1293,7 @@ HPDF_Encrypt_Init  (HPDF_Encrypt  attr)
 }
 
 
-void
+HPDF_STATUS
 HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr)
 {
     HPDF_ARC4_Ctx_Rec rc4_ctx;
@@ -351,6 +1303,9 @@ HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr)
 
     HPDF_PTRACE((" HPDF_Encrypt_CreateOwnerKey\n"));
 
+    if (attr->mode == HPDF_ENCRYPT_R6)
+        return R6CreateOwnerKey (attr);
+
     /* create md5-digest using the value of owner_passwd */
 
     /* Algorithm 3.3 step 2 */
@@ -361,8 +1316,8 @@ HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr)
 
     HPDF_MD5Final(digest, &md5_ctx);
 
-    /* Algorithm 3.3 step 3 (Revision 3 only) */
-    if (attr->mode == HPDF_ENCRYPT_R3) {
+    /* Algorithm 3.3 step 3 (Revision 3 or greater) */
+    if (attr->mode != HPDF_ENCRYPT_R2) {
         HPDF_UINT i;
 
         for (i = 0; i < 50; i++) {
@@ -389,7 +1344,7 @@ HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr)
 
     /* Algorithm 3.3 step 7 */
     HPDF_PTRACE(("@ Algorithm 3.3 step 7\n"));
-    if (attr->mode == HPDF_ENCRYPT_R3) {
+    if (attr->mode != HPDF_ENCRYPT_R2) {
         HPDF_BYTE tmppwd2[HPDF_PASSWD_LEN];
         HPDF_UINT i;
 
@@ -411,10 +1366,12 @@ HPDF_Encrypt_CreateOwnerKey  (HPDF_Encrypt  attr)
     /* Algorithm 3.3 step 8 */
     HPDF_PTRACE(("@ Algorithm 3.3 step 8\n"));
     HPDF_MemCpy (attr->owner_key, tmppwd, HPDF_PASSWD_LEN);
+
+    return HPDF_OK;
 }
 
 
-void
+HPDF_STATUS
 HPDF_Encrypt_CreateEncryptionKey  (HPDF_Encrypt  attr)
 {
     HPDF_MD5_CTX md5_ctx;
@@ -422,6 +1379,15 @@ HPDF_Encrypt_CreateEncryptionKey  (HPDF_Encrypt  attr)
 
     HPDF_PTRACE((" HPDF_Encrypt_CreateEncryptionKey\n"));
 
+    if (attr->mode == HPDF_ENCRYPT_R6) {
+        HPDF_STATUS ret = R6CreateEncryptionKey (attr);
+
+        if (ret == HPDF_OK)
+            InitIVGenerator (attr);
+
+        return ret;
+    }
+
     /* Algorithm3.2 step2 */
     HPDF_MD5Init(&md5_ctx);
     HPDF_MD5Update(&md5_ctx, attr->user_passwd, HPDF_PASSWD_LEN);
@@ -445,8 +1411,8 @@ HPDF_Encrypt_CreateEncryptionKey  (HPDF_Encrypt  attr)
     HPDF_MD5Update(&md5_ctx, attr->encrypt_id, HPDF_ID_LEN);
     HPDF_MD5Final(attr->encryption_key, &md5_ctx);
 
-    /* Algorithm 3.2 step6 (Revision 3 only) */
-    if (attr->mode == HPDF_ENCRYPT_R3) {
+    /* Algorithm 3.2 step6 (Revision 3 or greater) */
+    if (attr->mode != HPDF_ENCRYPT_R2) {
         HPDF_UINT i;
 
         for (i = 0; i < 50; i++) {
@@ -456,23 +1422,31 @@ HPDF_Encrypt_CreateEncryptionKey  (HPDF_Encrypt  attr)
             HPDF_MD5Final(attr->encryption_key, &md5_ctx);
         }
     }
+
+    if (attr->mode == HPDF_ENCRYPT_R4)
+        InitIVGenerator (attr);
+
+    return HPDF_OK;
 }
 
 
-void
+HPDF_STATUS
 HPDF_Encrypt_CreateUserKey  (HPDF_Encrypt  attr)
 {
     HPDF_ARC4_Ctx_Rec ctx;
 
     HPDF_PTRACE((" HPDF_Encrypt_CreateUserKey\n"));
 
+    if (attr->mode == HPDF_ENCRYPT_R6)
+        return R6CreateUserKey (attr);
+
     /* Algorithm 3.4/5 step1 */
 
     /* Algorithm 3.4 step2 */
     ARC4Init(&ctx, attr->encryption_key, attr->key_len);
     ARC4CryptBuf(&ctx, HPDF_PADDING_STRING, attr->user_key, HPDF_PASSWD_LEN);
 
-    if (attr->mode == HPDF_ENCRYPT_R3) {
+    if (attr->mode != HPDF_ENCRYPT_R2) {
         HPDF_MD5_CTX md5_ctx;
         HPDF_BYTE digest[HPDF_MD5_KEY_LEN];
         HPDF_BYTE digest2[HPDF_MD5_KEY_LEN];
@@ -514,6 +1488,8 @@ HPDF_Encrypt_CreateUserKey  (HPDF_Encrypt  attr)
         HPDF_MemSet (attr->user_key, 0, HPDF_PASSWD_LEN);
         HPDF_MemCpy (attr->user_key, digest2, HPDF_MD5_KEY_LEN);
     }
+
+    return HPDF_OK;
 }
 
 
@@ -555,78 +1531,228 @@ ARC4CryptBuf (HPDF_ARC4_Ctx_Rec  *ctx,
                            HPDF_BYTE          *out,
                            HPDF_UINT          len)
 {
+    HPDF_BYTE *state = ctx->state;
+    HPDF_BYTE idx1 = ctx->idx1;
+    HPDF_BYTE idx2 = ctx->idx2;
     HPDF_UINT i;
-    HPDF_UINT t;
-    HPDF_BYTE K;
 
     HPDF_PTRACE((" ARC4CryptBuf\n"));
 
+    /* the indexes are kept in locals, and wrap around as HPDF_BYTE */
     for (i = 0; i < len; i++) {
         HPDF_BYTE tmp;
 
-        ctx->idx1 = (HPDF_BYTE)((ctx->idx1 + 1) % 256);
-        ctx->idx2 = (HPDF_BYTE)((ctx->idx2 +  ctx->state[ctx->idx1]) % 256);
-
-        tmp = ctx->state[ctx->idx1];
-        ctx->state[ctx->idx1] = ctx->state[ctx->idx2];
-        ctx->state[ctx->idx2] = tmp;
+        idx1++;
+        idx2 = (HPDF_BYTE)(idx2 + state[idx1]);
 
-        t = (ctx->state[ctx->idx1] + ctx->state[ctx->idx2]) % 256;
-        K = ctx->state[t];
+        tmp = state[idx1];
+        state[idx1] = state[idx2];
+        state[idx2] = tmp;
 
-        out[i] = (HPDF_BYTE)(in[i] ^ K);
+        out[i] = (HPDF_BYTE)(in[i] ^ state[(HPDF_BYTE)(tmp + state[idx1])]);
     }
+
+    ctx->idx1 = idx1;
+    ctx->idx2 = idx2;
 }
 
 
+/* the key material of an object is computed once here; HPDF_CryptCtx_Reset
+ * only restores it for each string or stream of the object.
+ */
 void
-HPDF_Encrypt_InitKey  (HPDF_Encrypt  attr,
-                       HPDF_UINT32       object_id,
-                       HPDF_UINT16       gen_no)
+HPDF_CryptCtx_Init  (HPDF_CryptCtx           ctx,
+                     const HPDF_Encrypt_Rec  *key,
+                     HPDF_UINT32             object_id,
+                     HPDF_UINT16             gen_no)
 {
-    HPDF_MD5_CTX ctx;
+    HPDF_MD5_CTX md5_ctx;
+    HPDF_BYTE obj_key[HPDF_MD5_KEY_LEN + 9];
+    HPDF_BYTE digest[HPDF_MD5_KEY_LEN];
     HPDF_UINT key_len;
 
-    HPDF_PTRACE((" HPDF_Encrypt_Init\n"));
+    HPDF_PTRACE((" HPDF_CryptCtx_Init\n"));
 
-    attr->encryption_key[attr->key_len] = (HPDF_BYTE)object_id;
-    attr->encryption_key[attr->key_len + 1] = (HPDF_BYTE)(object_id >> 8);
-    attr->encryption_key[attr->key_len + 2] = (HPDF_BYTE)(object_id >> 16);
-    attr->encryption_key[attr->key_len + 3] = (HPDF_BYTE)gen_no;
-    attr->encryption_key[attr->key_len + 4] = (HPDF_BYTE)(gen_no >> 8);
+    ctx->key = key;
+    ctx->obj_id = object_id;
+    ctx->gen_no = gen_no;
+    ctx->count = 0;
+    ctx->cbc_buf_len = 0;
+    ctx->iv_pending = HPDF_FALSE;
+
+    /* revision 6 encrypts all objects with the file key itself */
+    if (key->mode == HPDF_ENCRYPT_R6) {
+        ctx->aes = &key->aesctx;
+        return;
+    }
+
+    HPDF_MemCpy (obj_key, key->encryption_key, key->key_len);
+    obj_key[key->key_len] = (HPDF_BYTE)object_id;
+    obj_key[key->key_len + 1] = (HPDF_BYTE)(object_id >> 8);
+    obj_key[key->key_len + 2] = (HPDF_BYTE)(object_id >> 16);
+    obj_key[key->key_len + 3] = (HPDF_BYTE)gen_no;
+    obj_key[key->key_len + 4] = (HPDF_BYTE)(gen_no >> 8);
+    key_len = key->key_len + 5;
 
     HPDF_PTRACE(("@@@ OID=%u, gen_no=%u\n", (HPDF_INT)object_id, gen_no));
 
-    HPDF_MD5Init(&ctx);
-    HPDF_MD5Update(&ctx, attr->encryption_key, attr->key_len + 5);
-    HPDF_MD5Final(attr->md5_encryption_key, &ctx);
+    /* Algorithm 1 step 2 for AESV2 */
+    if (key->mode == HPDF_ENCRYPT_R4) {
+        HPDF_MemCpy (obj_key + key_len, (const HPDF_BYTE *)"sAlT", 4);
+        key_len += 4;
+    }
 
-    key_len = (attr->key_len + 5 > HPDF_ENCRYPT_KEY_MAX) ?
-                    HPDF_ENCRYPT_KEY_MAX : attr->key_len + 5;
+    HPDF_MD5Init(&md5_ctx);
+    HPDF_MD5Update(&md5_ctx, obj_key, key_len);
+    HPDF_MD5Final(digest, &md5_ctx);
+
+    if (key->mode == HPDF_ENCRYPT_R4) {
+        HPDF_AES_KeyExpand (&ctx->aesctx, digest, HPDF_MD5_KEY_LEN);
+        ctx->aes = &ctx->aesctx;
+        return;
+    }
+
+    key_len = (key->key_len + 5 > HPDF_ENCRYPT_KEY_MAX) ?
+                    HPDF_ENCRYPT_KEY_MAX : key->key_len + 5;
 
-    ARC4Init(&attr->arc4ctx, attr->md5_encryption_key, key_len);
+    ARC4Init(&ctx->arc4init, digest, key_len);
 }
 
 
 void
-HPDF_Encrypt_Reset  (HPDF_Encrypt  attr)
+HPDF_CryptCtx_Reset  (HPDF_CryptCtx  ctx)
+{
+    HPDF_PTRACE((" HPDF_CryptCtx_Reset\n"));
+
+    if (ENCRYPT_IS_AES(ctx->key)) {
+        HPDF_BYTE count[HPDF_AES_BLOCK_LEN];
+
+        /* each string or stream starts with a new initialization vector,
+         * made of the object number and the number of the string in it.
+         */
+        HPDF_MemSet (count, 0, HPDF_AES_BLOCK_LEN);
+        count[0] = (HPDF_BYTE)(ctx->obj_id >> 24);
+        count[1] = (HPDF_BYTE)(ctx->obj_id >> 16);
+        count[2] = (HPDF_BYTE)(ctx->obj_id >> 8);
+        count[3] = (HPDF_BYTE)ctx->obj_id;
+        count[4] = (HPDF_BYTE)(ctx->gen_no >> 8);
+        count[5] = (HPDF_BYTE)ctx->gen_no;
+        count[12] = (HPDF_BYTE)(ctx->count >> 24);
+        count[13] = (HPDF_BYTE)(ctx->count >> 16);
+        count[14] = (HPDF_BYTE)(ctx->count >> 8);
+        count[15] = (HPDF_BYTE)ctx->count;
+        ctx->count++;
+
+        HPDF_AES_EncryptBlock (&ctx->key->ivctx, count, ctx->cbc);
+        ctx->cbc_buf_len = 0;
+        ctx->iv_pending = HPDF_TRUE;
+        return;
+    }
+
+    ctx->arc4ctx = ctx->arc4init;
+}
+
+
+/* dst must not overlap src, and must have room for len +
+ * HPDF_ENCRYPT_OVERHEAD bytes. returns the number of bytes written to dst;
+ * with AES, the bytes of an incomplete block are kept until the next call.
+ */
+HPDF_UINT
+HPDF_CryptCtx_CryptBuf  (HPDF_CryptCtx    ctx,
+                         const HPDF_BYTE  *src,
+                         HPDF_BYTE        *dst,
+                         HPDF_UINT        len)
 {
-    HPDF_UINT key_len = (attr->key_len + 5 > HPDF_ENCRYPT_KEY_MAX) ?
-                    HPDF_ENCRYPT_KEY_MAX : attr->key_len + 5;
+    const HPDF_BYTE *prev = ctx->cbc;
+    HPDF_BYTE *out = dst;
+    HPDF_UINT i;
+    HPDF_UINT n;
+
+    if (!ENCRYPT_IS_AES(ctx->key)) {
+        ARC4CryptBuf(&ctx->arc4ctx, src, dst, len);
+        return len;
+    }
+
+    if (ctx->iv_pending) {
+        HPDF_MemCpy (out, ctx->cbc, HPDF_AES_BLOCK_LEN);
+        out += HPDF_AES_BLOCK_LEN;
+        ctx->iv_pending = HPDF_FALSE;
+    }
+
+    if (ctx->cbc_buf_len > 0) {
+        n = HPDF_AES_BLOCK_LEN - ctx->cbc_buf_len;
 
-    HPDF_PTRACE((" HPDF_Encrypt_Reset\n"));
+        if (n > len)
+            n = len;
 
-    ARC4Init(&attr->arc4ctx, attr->md5_encryption_key, key_len);
+        HPDF_MemCpy (ctx->cbc_buf + ctx->cbc_buf_len, src, n);
+        ctx->cbc_buf_len += n;
+        src += n;
+        len -= n;
+
+        if (ctx->cbc_buf_len < HPDF_AES_BLOCK_LEN)
+            return (HPDF_UINT)(out - dst);
+
+        for (i = 0; i < HPDF_AES_BLOCK_LEN; i++)
+            out[i] = (HPDF_BYTE)(ctx->cbc_buf[i] ^ prev[i]);
+        HPDF_AES_EncryptBlock (ctx->aes, out, out);
+        prev = out;
+        out += HPDF_AES_BLOCK_LEN;
+        ctx->cbc_buf_len = 0;
+    }
+
+    n = len - len % HPDF_AES_BLOCK_LEN;
+    if (n > 0) {
+        HPDF_AES_EncryptCBC (ctx->aes, prev, src, out, n);
+        prev = out + n - HPDF_AES_BLOCK_LEN;
+        src += n;
+        out += n;
+        len -= n;
+    }
+
+    if (prev != ctx->cbc)
+        HPDF_MemCpy (ctx->cbc, prev, HPDF_AES_BLOCK_LEN);
+
+    if (len > 0) {
+        HPDF_MemCpy (ctx->cbc_buf, src, len);
+        ctx->cbc_buf_len = len;
+    }
+
+    return (HPDF_UINT)(out - dst);
 }
 
 
-void
-HPDF_Encrypt_CryptBuf  (HPDF_Encrypt  attr,
-                        const HPDF_BYTE   *src,
-                        HPDF_BYTE         *dst,
-                        HPDF_UINT         len)
+/* pad the last block of a string or stream encrypted with AES (PKCS#5).
+ * dst must have room for HPDF_ENCRYPT_OVERHEAD bytes.
+ */
+HPDF_UINT
+HPDF_CryptCtx_CryptFinal  (HPDF_CryptCtx  ctx,
+                           HPDF_BYTE      *dst)
 {
-    ARC4CryptBuf(&attr->arc4ctx, src, dst, len);
+    HPDF_BYTE *out = dst;
+    HPDF_BYTE pad;
+    HPDF_UINT i;
+
+    if (!ENCRYPT_IS_AES(ctx->key))
+        return 0;
+
+    if (ctx->iv_pending) {
+        HPDF_MemCpy (out, ctx->cbc, HPDF_AES_BLOCK_LEN);
+        out += HPDF_AES_BLOCK_LEN;
+        ctx->iv_pending = HPDF_FALSE;
+    }
+
+    pad = (HPDF_BYTE)(HPDF_AES_BLOCK_LEN - ctx->cbc_buf_len);
+    HPDF_MemSet (ctx->cbc_buf + ctx->cbc_buf_len, pad, pad);
+
+    for (i = 0; i < HPDF_AES_BLOCK_LEN; i++)
+        out[i] = (HPDF_BYTE)(ctx->cbc_buf[i] ^ ctx->cbc[i]);
+    HPDF_AES_EncryptBlock (ctx->aes, out, out);
+    HPDF_MemCpy (ctx->cbc, out, HPDF_AES_BLOCK_LEN);
+    out += HPDF_AES_BLOCK_LEN;
+    ctx->cbc_buf_len = 0;
+
+    return (HPDF_UINT)(out - dst);
 }
 
 
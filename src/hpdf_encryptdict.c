@@ -123,6 +123,58 @@ HPDF_EncryptDict_CreateID  (HPDF_EncryptDict  dict,
 }
 
 
+static HPDF_STATUS
+AddCryptFilter  (HPDF_EncryptDict  dict,
+                 const char        *cfm,
+                 HPDF_UINT         key_len)
+{
+    HPDF_STATUS ret;
+    HPDF_Dict cf;
+    HPDF_Dict std_cf;
+
+    cf = HPDF_Dict_New (dict->mmgr);
+    if (!cf)
+        return HPDF_Error_GetCode (dict->error);
+
+    if ((ret = HPDF_Dict_Add (dict, "CF", cf)) != HPDF_OK)
+        return ret;
+
+    std_cf = HPDF_Dict_New (dict->mmgr);
+    if (!std_cf)
+        return HPDF_Error_GetCode (dict->error);
+
+    if ((ret = HPDF_Dict_Add (cf, "StdCF", std_cf)) != HPDF_OK)
+        return ret;
+
+    ret += HPDF_Dict_AddName (std_cf, "Type", "CryptFilter");
+    ret += HPDF_Dict_AddName (std_cf, "CFM", cfm);
+    ret += HPDF_Dict_AddName (std_cf, "AuthEvent", "DocOpen");
+    ret += HPDF_Dict_AddNumber (std_cf, "Length", key_len);
+    ret += HPDF_Dict_AddName (dict, "StmF", "StdCF");
+    ret += HPDF_Dict_AddName (dict, "StrF", "StdCF");
+
+    if (ret != HPDF_OK)
+        return HPDF_Error_GetCode (dict->error);
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+AddBinary  (HPDF_EncryptDict  dict,
+            const char        *key,
+            HPDF_BYTE         *value,
+            HPDF_UINT         len)
+{
+    HPDF_Binary obj = HPDF_Binary_New (dict->mmgr, value, len);
+
+    if (!obj)
+        return HPDF_Error_GetCode (dict->error);
+
+    return HPDF_Dict_Add (dict, key, obj);
+}
+
+
 HPDF_STATUS
 HPDF_EncryptDict_Prepare  (HPDF_EncryptDict  dict,
                            HPDF_Dict         info,
@@ -132,22 +184,33 @@ HPDF_EncryptDict_Prepare  (HPDF_EncryptDict  dict,
     HPDF_Encrypt attr = (HPDF_Encrypt)dict->attr;
     HPDF_Binary user_key;
     HPDF_Binary owner_key;
+    HPDF_UINT key_len = HPDF_PASSWD_LEN;
 
     HPDF_PTRACE((" HPDF_EncryptDict_Prepare\n"));
 
     HPDF_EncryptDict_CreateID (dict, info, xref);
-    HPDF_Encrypt_CreateOwnerKey (attr);
-    HPDF_Encrypt_CreateEncryptionKey (attr);
-    HPDF_Encrypt_CreateUserKey (attr);
 
-    owner_key = HPDF_Binary_New (dict->mmgr, attr->owner_key, HPDF_PASSWD_LEN);
+    if (attr->mode == HPDF_ENCRYPT_R6) {
+        /* the owner key of revision 6 depends on the user key */
+        if ((ret = HPDF_Encrypt_CreateEncryptionKey (attr)) != HPDF_OK ||
+                (ret = HPDF_Encrypt_CreateUserKey (attr)) != HPDF_OK ||
+                (ret = HPDF_Encrypt_CreateOwnerKey (attr)) != HPDF_OK)
+            return HPDF_SetError (dict->error, ret, 0);
+        key_len = HPDF_SALTED_KEY_LEN;
+    } else {
+        HPDF_Encrypt_CreateOwnerKey (attr);
+        HPDF_Encrypt_CreateEncryptionKey (attr);
+        HPDF_Encrypt_CreateUserKey (attr);
+    }
+
+    owner_key = HPDF_Binary_New (dict->mmgr, attr->owner_key, key_len);
     if (!owner_key)
         return HPDF_Error_GetCode (dict->error);
 
     if ((ret = HPDF_Dict_Add (dict, "O", owner_key)) != HPDF_OK)
         return ret;
 
-    user_key = HPDF_Binary_New (dict->mmgr, attr->user_key, HPDF_PASSWD_LEN);
+    user_key = HPDF_Binary_New (dict->mmgr, attr->user_key, key_len);
     if (!user_key)
         return HPDF_Error_GetCode (dict->error);
 
@@ -163,6 +226,19 @@ HPDF_EncryptDict_Prepare  (HPDF_EncryptDict  dict,
         ret += HPDF_Dict_AddNumber (dict, "V", 2);
         ret += HPDF_Dict_AddNumber (dict, "R", 3);
         ret += HPDF_Dict_AddNumber (dict, "Length", attr->key_len * 8);
+    } else if (attr->mode == HPDF_ENCRYPT_R4) {
+        ret += HPDF_Dict_AddNumber (dict, "V", 4);
+        ret += HPDF_Dict_AddNumber (dict, "R", 4);
+        ret += HPDF_Dict_AddNumber (dict, "Length", attr->key_len * 8);
+        ret += AddCryptFilter (dict, "AESV2", attr->key_len);
+    } else if (attr->mode == HPDF_ENCRYPT_R6) {
+        ret += HPDF_Dict_AddNumber (dict, "V", 5);
+        ret += HPDF_Dict_AddNumber (dict, "R", 6);
+        ret += HPDF_Dict_AddNumber (dict, "Length", attr->key_len * 8);
+        ret += AddCryptFilter (dict, "AESV3", attr->key_len);
+        ret += AddBinary (dict, "OE", attr->owner_enc_key, HPDF_FILE_KEY_MAX);
+        ret += AddBinary (dict, "UE", attr->user_enc_key, HPDF_FILE_KEY_MAX);
+        ret += AddBinary (dict, "Perms", attr->perms, HPDF_AES_BLOCK_LEN);
     }
 
     ret += HPDF_Dict_AddNumber (dict, "P", attr->permission);
@@ -205,6 +281,14 @@ HPDF_EncryptDict_SetPassword  (HPDF_EncryptDict  dict,
     HPDF_PadOrTrancatePasswd (owner_passwd, attr->owner_passwd);
     HPDF_PadOrTrancatePasswd (user_passwd, attr->user_passwd);
 
+    /* revision 6 uses the passwords as they are, up to 127 bytes */
+    attr->owner_passwd_len = HPDF_StrLen (owner_passwd, HPDF_UTF8_PASSWD_LEN);
+    HPDF_MemCpy (attr->owner_passwd_utf8, (const HPDF_BYTE *)owner_passwd,
+            attr->owner_passwd_len);
+    attr->user_passwd_len = HPDF_StrLen (user_passwd, HPDF_UTF8_PASSWD_LEN);
+    HPDF_MemCpy (attr->user_passwd_utf8, (const HPDF_BYTE *)user_passwd,
+            attr->user_passwd_len);
+
     return HPDF_OK;
 }
 
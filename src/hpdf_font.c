@@ -24,28 +24,55 @@ HPDF_EXPORT(HPDF_TextWidth)
 HPDF_Font_TextWidth  (HPDF_Font        font,
                       const HPDF_BYTE  *text,
                       HPDF_UINT        len)
+{
+    HPDF_PTRACE ((" HPDF_Font_TextWidth\n"));
+
+    return HPDF_Font_TextWidthEx (font, text, len, NULL, font->error);
+}
+
+
+/*
+ *  HPDF_Font_TextWidthEx, HPDF_Font_MeasureTextEx
+ *
+ *  When used is NULL, the codes of the text are marked as used in the font
+ *  itself. Otherwise the font is only read, and the codes are recorded in
+ *  the bitmap used (of attr->used_size bytes) instead, so that pages of a
+ *  document can be built on several threads at the same time. The bitmap
+ *  is merged into the font later by HPDF_Font_MergeUsed.
+ *
+ *  The errors are set in error, which is the error of the page measuring
+ *  the text, because the error of the font is the one of the document.
+ *
+ */
+
+HPDF_TextWidth
+HPDF_Font_TextWidthEx  (HPDF_Font        font,
+                        const HPDF_BYTE  *text,
+                        HPDF_UINT        len,
+                        HPDF_BYTE        *used,
+                        HPDF_Error       error)
 {
     HPDF_TextWidth tw = {0, 0, 0, 0};
     HPDF_FontAttr attr;
 
-    HPDF_PTRACE ((" HPDF_Font_TextWidth\n"));
+    HPDF_PTRACE ((" HPDF_Font_TextWidthEx\n"));
 
     if (!HPDF_Font_Validate(font))
         return tw;
 
     if (len > HPDF_LIMIT_MAX_STRING_LEN) {
-        HPDF_RaiseError (font->error, HPDF_STRING_OUT_OF_RANGE, 0);
+        HPDF_RaiseError (error, HPDF_STRING_OUT_OF_RANGE, 0);
         return tw;
     }
 
     attr = (HPDF_FontAttr)font->attr;
 
     if (!attr->text_width_fn) {
-        HPDF_SetError (font->error, HPDF_INVALID_OBJECT, 0);
+        HPDF_SetError (error, HPDF_INVALID_OBJECT, 0);
         return tw;
     }
 
-    tw = attr->text_width_fn (font, text, len);
+    tw = attr->text_width_fn (font, text, len, used, error);
 
     return tw;
 }
@@ -61,28 +88,63 @@ HPDF_Font_MeasureText (HPDF_Font          font,
                        HPDF_REAL          word_space,
                        HPDF_BOOL          wordwrap,
                        HPDF_REAL         *real_width)
+{
+    HPDF_PTRACE ((" HPDF_Font_MeasureText\n"));
+
+    return HPDF_Font_MeasureTextEx (font, text, len, width, font_size,
+            char_space, word_space, wordwrap, real_width, NULL, font->error);
+}
+
+
+HPDF_UINT
+HPDF_Font_MeasureTextEx  (HPDF_Font          font,
+                          const HPDF_BYTE   *text,
+                          HPDF_UINT          len,
+                          HPDF_REAL          width,
+                          HPDF_REAL          font_size,
+                          HPDF_REAL          char_space,
+                          HPDF_REAL          word_space,
+                          HPDF_BOOL          wordwrap,
+                          HPDF_REAL         *real_width,
+                          HPDF_BYTE         *used,
+                          HPDF_Error         error)
 {
     HPDF_FontAttr attr;
 
-    HPDF_PTRACE ((" HPDF_Font_MeasureText\n"));
+    HPDF_PTRACE ((" HPDF_Font_MeasureTextEx\n"));
 
     if (!HPDF_Font_Validate(font))
         return 0;
 
     if (len > HPDF_LIMIT_MAX_STRING_LEN) {
-        HPDF_RaiseError (font->error, HPDF_STRING_OUT_OF_RANGE, 0);
+        HPDF_RaiseError (error, HPDF_STRING_OUT_OF_RANGE, 0);
         return 0;
     }
 
     attr = (HPDF_FontAttr)font->attr;
 
     if (!attr->measure_text_fn) {
-        HPDF_RaiseError (font->error, HPDF_INVALID_OBJECT, 0);
+        HPDF_RaiseError (error, HPDF_INVALID_OBJECT, 0);
         return 0;
     }
 
     return attr->measure_text_fn (font, text, len, width, font_size,
-                            char_space, word_space, wordwrap, real_width);
+                            char_space, word_space, wordwrap, real_width,
+                            used, error);
+}
+
+
+/* mark the codes recorded by HPDF_Font_TextWidthEx as used in the font. */
+void
+HPDF_Font_MergeUsed  (HPDF_Font         font,
+                      const HPDF_BYTE  *used)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+
+    HPDF_PTRACE ((" HPDF_Font_MergeUsed\n"));
+
+    if (attr->merge_used_fn)
+        attr->merge_used_fn (font, used);
 }
 
 
@@ -138,14 +200,15 @@ HPDF_Font_GetUnicodeWidth  (HPDF_Font       font,
     } else if (fontdef->type == HPDF_FONTDEF_TYPE_TRUETYPE) {
         return HPDF_TTFontDef_GetCharWidth (fontdef, code);
     } else if (fontdef->type == HPDF_FONTDEF_TYPE_CID) {
-        HPDF_CMapEncoderAttr encoder_attr =
-            (HPDF_CMapEncoderAttr)attr->encoder->attr;
         HPDF_UINT l, h;
 
         for (l = 0; l <= 255; l++) {
             for (h = 0; h < 255; h++) {
-                if (code == encoder_attr->unicode_map[l][h]) {
-                    HPDF_UINT16 cid = encoder_attr->cid_map[l][h];
+                HPDF_UINT16 c = (HPDF_UINT16)(h << 8 | l);
+
+                if (code == HPDF_CMapEncoder_ToUnicode (attr->encoder, c)) {
+                    HPDF_UINT16 cid = HPDF_CMapEncoder_ToCID (attr->encoder,
+                            c);
 
                     return HPDF_CIDFontDef_GetCIDWidth (fontdef, cid);
                 }
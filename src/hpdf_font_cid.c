@@ -19,6 +19,16 @@
 #include "hpdf_utils.h"
 #include "hpdf_font.h"
 
+#ifndef HPDF_UNUSED
+#define HPDF_UNUSED(a) ((void)(a))
+#endif
+
+/* one bit for each code of a type0 font */
+#define HPDF_TYPE0_USED_SIZ  (65536 / 8)
+
+/* the number of entries of a bfrange or bfchar block of a CMap */
+#define HPDF_CMAP_MAX_BLOCK_ENTRIES  100
+
 static HPDF_Font
 CIDFontType0_New (HPDF_Font parent,
                   HPDF_Xref xref);
@@ -32,7 +42,9 @@ CIDFontType2_New (HPDF_Font parent,
 static HPDF_TextWidth
 TextWidth  (HPDF_Font         font,
             const HPDF_BYTE  *text,
-            HPDF_UINT         len);
+            HPDF_UINT         len,
+            HPDF_BYTE        *used,
+            HPDF_Error        error);
 
 
 static HPDF_UINT
@@ -44,7 +56,14 @@ MeasureText  (HPDF_Font         font,
               HPDF_REAL         char_space,
               HPDF_REAL         word_space,
               HPDF_BOOL         wordwrap,
-              HPDF_REAL        *real_width);
+              HPDF_REAL        *real_width,
+              HPDF_BYTE        *used,
+              HPDF_Error        error);
+
+
+static void
+MergeUsed  (HPDF_Font         font,
+            const HPDF_BYTE  *used);
 
 
 static char*
@@ -68,10 +87,30 @@ static void
 OnFree_Func  (HPDF_Dict  obj);
 
 
+static HPDF_STATUS
+CIDFontType0_BeforeWrite_Func  (HPDF_Dict   obj);
+
+
 static HPDF_STATUS
 CIDFontType2_BeforeWrite_Func  (HPDF_Dict   obj);
 
 
+static HPDF_STATUS
+WriteToUnicode  (HPDF_Dict   obj);
+
+
+static HPDF_STATUS
+WriteWidths  (HPDF_Dict   obj);
+
+
+static HPDF_Dict
+CreateDescriptor  (HPDF_Dict   obj);
+
+
+static HPDF_STATUS
+SubsetCIDToGIDMap  (HPDF_FontAttr   font_attr);
+
+
 /*--------------------------------------------------------------------------*/
 
 HPDF_Font
@@ -124,6 +163,8 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
     attr->writing_mode = encoder_attr->writing_mode;
     attr->text_width_fn = TextWidth;
     attr->measure_text_fn = MeasureText;
+    attr->merge_used_fn = MergeUsed;
+    attr->used_size = HPDF_TYPE0_USED_SIZ;
     attr->fontdef = fontdef;
     attr->encoder = encoder;
     attr->xref = xref;
@@ -141,20 +182,10 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
         /*
      * Handle the Unicode encoding, see hpdf_encoding_utf.c For some
      * reason, xpdf-based readers cannot deal with our cmap but work
-     * fine when using the predefined "Identity-H"
-     * encoding. However, text selection does not work, unless we
-     * add a ToUnicode cmap. This CMap should also be "Identity",
-     * but that does not work -- specifying our cmap as a stream however
-     * does work. Who can understand that ?
+     * fine when using the predefined "Identity-H" encoding.
      */
         if (HPDF_StrCmp(encoder_attr->ordering, "Identity-H") == 0) {
         ret += HPDF_Dict_AddName (font, "Encoding", "Identity-H");
-        attr->cmap_stream = CreateCMap (encoder, xref);
-
-        if (attr->cmap_stream) {
-            ret += HPDF_Dict_Add (font, "ToUnicode", attr->cmap_stream);
-        } else
-            return NULL;
     } else {
             attr->cmap_stream = CreateCMap (encoder, xref);
 
@@ -168,6 +199,22 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
     if (ret != HPDF_OK)
         return NULL;
 
+    /* the codes which are shown with the font are recorded in 'used', and
+     * the ToUnicode CMap is made of them when the font is written.
+     */
+    attr->used = HPDF_GetMem (mmgr, HPDF_TYPE0_USED_SIZ);
+    if (!attr->used)
+        return NULL;
+
+    HPDF_MemSet (attr->used, 0, HPDF_TYPE0_USED_SIZ);
+
+    attr->to_unicode_stream = HPDF_DictStream_New (mmgr, xref);
+    if (!attr->to_unicode_stream)
+        return NULL;
+
+    if (HPDF_Dict_Add (font, "ToUnicode", attr->to_unicode_stream) != HPDF_OK)
+        return NULL;
+
     descendant_fonts = HPDF_Array_New (mmgr);
     if (!descendant_fonts)
         return NULL;
@@ -200,8 +247,15 @@ OnFree_Func  (HPDF_Dict  obj)
 
     HPDF_PTRACE ((" HPDF_Type0Font_OnFree\n"));
 
-    if (attr)
+    if (attr) {
+        if (attr->cid_to_gid)
+            HPDF_FreeMem (obj->mmgr, attr->cid_to_gid);
+
+        if (attr->used)
+            HPDF_FreeMem (obj->mmgr, attr->used);
+
         HPDF_FreeMem (obj->mmgr, attr);
+    }
 }
 
 static HPDF_Font
@@ -215,11 +269,8 @@ CIDFontType0_New (HPDF_Font parent, HPDF_Xref xref)
     HPDF_CMapEncoderAttr encoder_attr =
                 (HPDF_CMapEncoderAttr)encoder->attr;
 
-    HPDF_UINT16 save_cid = 0;
     HPDF_Font font;
     HPDF_Array array;
-    HPDF_Array sub_array = NULL;
-    HPDF_UINT i;
 
     HPDF_Dict descriptor;
     HPDF_Dict cid_system_info;
@@ -233,6 +284,8 @@ CIDFontType0_New (HPDF_Font parent, HPDF_Xref xref)
     if (HPDF_Xref_Add (xref, font) != HPDF_OK)
         return NULL;
 
+    parent->before_write_fn = CIDFontType0_BeforeWrite_Func;
+
     ret += HPDF_Dict_AddName (font, "Type", "Font");
     ret += HPDF_Dict_AddName (font, "Subtype", "CIDFontType0");
     ret += HPDF_Dict_AddNumber (font, "DW", fontdef_attr->DW);
@@ -254,34 +307,7 @@ CIDFontType0_New (HPDF_Font parent, HPDF_Xref xref)
     if (ret != HPDF_OK)
         return NULL;
 
-    /* add 'W' element */
-    array = HPDF_Array_New (parent->mmgr);
-    if (!array)
-        return NULL;
-
-    if (HPDF_Dict_Add (font, "W", array) != HPDF_OK)
-        return NULL;
-
-    /* Create W array. */
-    for (i = 0; i< fontdef_attr->widths->count; i++) {
-        HPDF_CID_Width *w =
-                (HPDF_CID_Width *)HPDF_List_ItemAt (fontdef_attr->widths, i);
-
-        if (w->cid != save_cid + 1 || !sub_array) {
-            sub_array = HPDF_Array_New (parent->mmgr);
-            if (!sub_array)
-                return NULL;
-
-            ret += HPDF_Array_AddNumber (array, w->cid);
-            ret += HPDF_Array_Add (array, sub_array);
-        }
-
-        ret += HPDF_Array_AddNumber (sub_array, w->width);
-        save_cid = w->cid;
-
-        if (ret != HPDF_OK)
-            return NULL;
-    }
+    /* the 'W' element is added by WriteWidths */
 
     /* create descriptor */
     descriptor = HPDF_Dict_New (parent->mmgr);
@@ -370,8 +396,10 @@ CIDFontType2_New (HPDF_Font parent, HPDF_Xref xref)
 
     parent->before_write_fn = CIDFontType2_BeforeWrite_Func;
 
+    /* an OpenType font with CFF outlines is embedded as a CIDFontType0. */
     ret += HPDF_Dict_AddName (font, "Type", "Font");
-    ret += HPDF_Dict_AddName (font, "Subtype", "CIDFontType2");
+    ret += HPDF_Dict_AddName (font, "Subtype", fontdef_attr->is_cff ?
+                "CIDFontType0" : "CIDFontType2");
     ret += HPDF_Dict_AddNumber (font, "DW", fontdef->missing_width);
     if (ret != HPDF_OK)
         return NULL;
@@ -398,9 +426,10 @@ CIDFontType2_New (HPDF_Font parent, HPDF_Xref xref)
 
         for (j = 0; j < 256; j++) {
         if (encoder->to_unicode_fn == HPDF_CMapEncoder_ToUnicode) {
-        HPDF_UINT16 cid = encoder_attr->cid_map[i][j];
+        HPDF_UINT16 code = (HPDF_UINT16)(j << 8 | i);
+        HPDF_UINT16 cid = HPDF_CMapEncoder_ToCID (encoder, code);
         if (cid != 0) {
-            HPDF_UNICODE unicode = encoder_attr->unicode_map[i][j];
+            HPDF_UNICODE unicode = HPDF_CMapEncoder_ToUnicode (encoder, code);
             HPDF_UINT16 gid = HPDF_TTFontDef_GetGlyphid (fontdef,
                                  unicode);
             tmp_map[cid] = gid;
@@ -419,42 +448,24 @@ CIDFontType2_New (HPDF_Font parent, HPDF_Xref xref)
     }
 
     if (max > 0) {
-        HPDF_INT16 dw = fontdef->missing_width;
-        HPDF_UNICODE *ptmp_map = tmp_map;
-        HPDF_Array tmp_array = NULL;
-
-        /* add 'W' element */
-        array = HPDF_Array_New (font->mmgr);
-        if (!array)
-            return NULL;
-
-        if (HPDF_Dict_Add (font, "W", array) != HPDF_OK)
-            return NULL;
-
-        for (i = 0; i < max; i++, ptmp_map++) {
-            HPDF_INT w = HPDF_TTFontDef_GetGidWidth (fontdef, *ptmp_map);
-
-            if (w != dw) {
-                if (!tmp_array) {
-                    if (HPDF_Array_AddNumber (array, i) != HPDF_OK)
-                        return NULL;
-
-                    tmp_array = HPDF_Array_New (font->mmgr);
-                    if (!tmp_array)
-                        return NULL;
-
-                    if (HPDF_Array_Add (array, tmp_array) != HPDF_OK)
-                        return NULL;
-                }
+        /* the 'W' element is added by WriteWidths */
+
+        /* the glyphs of the CFF font program are selected by the CIDs, the
+         * mapping is kept until the font program is written.
+         */
+        if (fontdef_attr->embedding && fontdef_attr->is_cff) {
+            attr->cid_to_gid = HPDF_GetMem (font->mmgr,
+                    sizeof(HPDF_UINT16) * (max + 1));
+            if (!attr->cid_to_gid)
+                return NULL;
 
-                if ((ret = HPDF_Array_AddNumber (tmp_array, w)) != HPDF_OK)
-                    return NULL;
-            } else
-                  tmp_array = NULL;
+            HPDF_MemCpy ((HPDF_BYTE *)attr->cid_to_gid, (HPDF_BYTE *)tmp_map,
+                    sizeof(HPDF_UINT16) * (max + 1));
+            attr->cid_count = max + 1;
         }
 
         /* create "CIDToGIDMap" data */
-        if (fontdef_attr->embedding) {
+        if (fontdef_attr->embedding && !fontdef_attr->is_cff) {
             attr->map_stream = HPDF_DictStream_New (font->mmgr, xref);
             if (!attr->map_stream)
                 return NULL;
@@ -503,6 +514,20 @@ CIDFontType2_New (HPDF_Font parent, HPDF_Xref xref)
 }
 
 
+static HPDF_STATUS
+CIDFontType0_BeforeWrite_Func  (HPDF_Dict obj)
+{
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" CIDFontType0_BeforeWrite_Func\n"));
+
+    if ((ret = WriteWidths (obj)) != HPDF_OK)
+        return ret;
+
+    return WriteToUnicode (obj);
+}
+
+
 static HPDF_STATUS
 CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
 {
@@ -519,75 +544,197 @@ CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
     if (font_attr->cmap_stream)
         font_attr->cmap_stream->filter = obj->filter;
 
-    if (!font_attr->fontdef->descriptor) {
-        HPDF_Dict descriptor = HPDF_Dict_New (obj->mmgr);
-        HPDF_Array array;
+    if ((ret = WriteWidths (obj)) != HPDF_OK ||
+            (ret = WriteToUnicode (obj)) != HPDF_OK)
+        return ret;
 
-        if (!descriptor)
+    if (def_attr->is_cff) {
+        /* the CIDs of an embedded CFF font program depend on the encoder,
+         * so the descriptor cannot be shared with other fonts.
+         */
+        if (!HPDF_Dict_GetItem (font_attr->descendant_font, "FontDescriptor",
+                    HPDF_OCLASS_DICT)) {
+            HPDF_Dict descriptor = CreateDescriptor (obj);
+
+            if (!descriptor)
+                return HPDF_Error_GetCode (obj->error);
+
+            if ((ret = HPDF_Dict_Add (font_attr->descendant_font,
+                        "FontDescriptor", descriptor)) != HPDF_OK)
+                return ret;
+        }
+    } else if (!font_attr->fontdef->descriptor) {
+        font_attr->fontdef->descriptor = CreateDescriptor (obj);
+
+        if (!font_attr->fontdef->descriptor)
             return HPDF_Error_GetCode (obj->error);
+    }
 
-        if (def_attr->embedding) {
-            HPDF_Dict font_data = HPDF_DictStream_New (obj->mmgr,
-                    font_attr->xref);
+    /* the embedded font has been subsetted, so the glyph ids in the
+     * CIDToGIDMap have to be renumbered accordingly.
+     */
+    if (font_attr->map_stream && def_attr->subset_gids &&
+            !font_attr->map_subsetted) {
+        if ((ret = SubsetCIDToGIDMap (font_attr)) != HPDF_OK)
+            return ret;
 
-            if (!font_data)
-                return HPDF_Error_GetCode (obj->error);
+        font_attr->map_subsetted = HPDF_TRUE;
+    }
 
-            if (HPDF_TTFontDef_SaveFontData (font_attr->fontdef,
-                font_data->stream) != HPDF_OK)
-                return HPDF_Error_GetCode (obj->error);
+    if ((ret = HPDF_Dict_AddName (obj, "BaseFont",
+                def_attr->base_font)) != HPDF_OK)
+        return ret;
+
+    if ((ret = HPDF_Dict_AddName (font_attr->descendant_font, "BaseFont",
+                def_attr->base_font)) != HPDF_OK)
+        return ret;
+
+    if (def_attr->is_cff)
+        return HPDF_OK;
+
+    return HPDF_Dict_Add (font_attr->descendant_font, "FontDescriptor",
+                font_attr->fontdef->descriptor);
+}
+
+
+static HPDF_Dict
+CreateDescriptor  (HPDF_Dict obj)
+{
+    HPDF_FontAttr font_attr = (HPDF_FontAttr)obj->attr;
+    HPDF_FontDef def = font_attr->fontdef;
+    HPDF_TTFontDefAttr def_attr = (HPDF_TTFontDefAttr)def->attr;
+    HPDF_Dict descriptor = HPDF_Dict_New (obj->mmgr);
+    HPDF_Array array;
+    HPDF_STATUS ret = 0;
+
+    if (!descriptor)
+        return NULL;
+
+    if (def_attr->embedding) {
+        HPDF_Dict font_data = HPDF_DictStream_New (obj->mmgr,
+                font_attr->xref);
+
+        if (!font_data)
+            return NULL;
+
+        font_data->filter = obj->filter;
+
+        if (def_attr->is_cff) {
+            HPDF_CMapEncoderAttr encoder_attr =
+                    (HPDF_CMapEncoderAttr)font_attr->encoder->attr;
+
+            if (HPDF_TTFontDef_SaveCFFData (def, font_data->stream,
+                        font_attr->cid_to_gid, font_attr->cid_count,
+                        encoder_attr->registry, encoder_attr->ordering,
+                        encoder_attr->suppliment) != HPDF_OK)
+                return NULL;
+
+            ret += HPDF_Dict_Add (descriptor, "FontFile3", font_data);
+            ret += HPDF_Dict_AddName (font_data, "Subtype", "CIDFontType0C");
+        } else {
+            if (HPDF_TTFontDef_SaveFontFile (def, font_data) != HPDF_OK)
+                return NULL;
 
             ret += HPDF_Dict_Add (descriptor, "FontFile2", font_data);
             ret += HPDF_Dict_AddNumber (font_data, "Length1",
                     def_attr->length1);
             ret += HPDF_Dict_AddNumber (font_data, "Length2", 0);
             ret += HPDF_Dict_AddNumber (font_data, "Length3", 0);
+        }
+
+        if (ret != HPDF_OK)
+            return NULL;
+    }
 
-            font_data->filter = obj->filter;
+    ret += HPDF_Xref_Add (font_attr->xref, descriptor);
+    ret += HPDF_Dict_AddName (descriptor, "Type", "FontDescriptor");
+    ret += HPDF_Dict_AddNumber (descriptor, "Ascent", def->ascent);
+    ret += HPDF_Dict_AddNumber (descriptor, "Descent", def->descent);
+    ret += HPDF_Dict_AddNumber (descriptor, "CapHeight", def->cap_height);
+    ret += HPDF_Dict_AddNumber (descriptor, "Flags", def->flags);
 
-            if (ret != HPDF_OK)
-                return HPDF_Error_GetCode (obj->error);
-        }
+    array = HPDF_Box_Array_New (obj->mmgr, def->font_bbox);
+    ret += HPDF_Dict_Add (descriptor, "FontBBox", array);
 
-        ret += HPDF_Xref_Add (font_attr->xref, descriptor);
-        ret += HPDF_Dict_AddName (descriptor, "Type", "FontDescriptor");
-        ret += HPDF_Dict_AddNumber (descriptor, "Ascent", def->ascent);
-        ret += HPDF_Dict_AddNumber (descriptor, "Descent", def->descent);
-        ret += HPDF_Dict_AddNumber (descriptor, "CapHeight", def->cap_height);
-        ret += HPDF_Dict_AddNumber (descriptor, "Flags", def->flags);
+    ret += HPDF_Dict_AddName (descriptor, "FontName", def_attr->base_font);
+    ret += HPDF_Dict_AddNumber (descriptor, "ItalicAngle",
+            def->italic_angle);
+    ret += HPDF_Dict_AddNumber (descriptor, "StemV", def->stemv);
+    ret += HPDF_Dict_AddNumber (descriptor, "XHeight", def->x_height);
 
-        array = HPDF_Box_Array_New (obj->mmgr, def->font_bbox);
-        ret += HPDF_Dict_Add (descriptor, "FontBBox", array);
+    if (ret != HPDF_OK)
+        return NULL;
 
-        ret += HPDF_Dict_AddName (descriptor, "FontName", def_attr->base_font);
-        ret += HPDF_Dict_AddNumber (descriptor, "ItalicAngle",
-                def->italic_angle);
-        ret += HPDF_Dict_AddNumber (descriptor, "StemV", def->stemv);
-        ret += HPDF_Dict_AddNumber (descriptor, "XHeight", def->x_height);
+    return descriptor;
+}
 
-        if (ret != HPDF_OK)
-            return HPDF_Error_GetCode (obj->error);
 
-        font_attr->fontdef->descriptor = descriptor;
-    }
+static HPDF_STATUS
+SubsetCIDToGIDMap  (HPDF_FontAttr   font_attr)
+{
+    HPDF_TTFontDefAttr def_attr = (HPDF_TTFontDefAttr)font_attr->fontdef->attr;
+    HPDF_Stream stream = font_attr->map_stream->stream;
+    HPDF_UINT len = stream->size;
+    HPDF_BYTE *buf;
+    HPDF_UINT i;
+    HPDF_STATUS ret;
 
-    if ((ret = HPDF_Dict_AddName (obj, "BaseFont",
-                def_attr->base_font)) != HPDF_OK)
-        return ret;
+    HPDF_PTRACE ((" SubsetCIDToGIDMap\n"));
 
-    if ((ret = HPDF_Dict_AddName (font_attr->descendant_font, "BaseFont",
-                def_attr->base_font)) != HPDF_OK)
+    if (len == 0)
+        return HPDF_OK;
+
+    buf = HPDF_GetMem (stream->mmgr, len);
+    if (!buf)
+        return HPDF_Error_GetCode (stream->error);
+
+    if ((ret = HPDF_Stream_Seek (stream, 0, HPDF_SEEK_SET)) != HPDF_OK ||
+            (ret = HPDF_Stream_Read (stream, buf, &len)) != HPDF_OK) {
+        HPDF_FreeMem (stream->mmgr, buf);
         return ret;
+    }
 
-    return HPDF_Dict_Add (font_attr->descendant_font, "FontDescriptor",
-                font_attr->fontdef->descriptor);
+    for (i = 0; i + 1 < len; i += 2) {
+        HPDF_UINT16 gid = (HPDF_UINT16)(buf[i] << 8 | buf[i + 1]);
+
+        gid = (gid < def_attr->num_glyphs) ? def_attr->subset_gids[gid] : 0;
+
+        buf[i] = (HPDF_BYTE)(gid >> 8);
+        buf[i + 1] = (HPDF_BYTE)gid;
+    }
+
+    if ((ret = HPDF_Stream_Seek (stream, 0, HPDF_SEEK_SET)) == HPDF_OK)
+        ret = HPDF_MemStream_Rewrite (stream, buf, len);
+
+    HPDF_FreeMem (stream->mmgr, buf);
+
+    return ret;
+}
+
+
+/* the width of the glyph of a unicode-based font. the glyph is marked as
+ * used in the fontdef, unless the font must only be read because the codes
+ * are recorded for a concurrent page (see HPDF_Font_TextWidthEx).
+ */
+static HPDF_INT16
+UnicodeWidth  (HPDF_FontDef  fontdef,
+               HPDF_UNICODE  unicode,
+               HPDF_BOOL     mark)
+{
+    if (mark)
+        return HPDF_TTFontDef_GetCharWidth (fontdef, unicode);
+
+    return HPDF_TTFontDef_GetGidWidth (fontdef,
+            HPDF_TTFontDef_GetGlyphid (fontdef, unicode));
 }
 
 
 static HPDF_TextWidth
 TextWidth  (HPDF_Font         font,
             const HPDF_BYTE  *text,
-            HPDF_UINT         len)
+            HPDF_UINT         len,
+            HPDF_BYTE        *used,
+            HPDF_Error        error)
 {
     HPDF_TextWidth tw = {0, 0, 0, 0};
     HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
@@ -596,9 +743,12 @@ TextWidth  (HPDF_Font         font,
     HPDF_UINT i = 0;
     HPDF_INT dw2;
     HPDF_BYTE b = 0;
+    HPDF_BYTE *bits = used ? used : attr->used;
 
     HPDF_PTRACE ((" HPDF_Type0Font_TextWidth\n"));
 
+    HPDF_UNUSED (error);
+
     if (attr->fontdef->type == HPDF_FONTDEF_TYPE_CID) {
         HPDF_CIDFontDefAttr cid_fontdef_attr =
                     (HPDF_CIDFontDefAttr)attr->fontdef->attr;
@@ -626,6 +776,13 @@ TextWidth  (HPDF_Font         font,
         }
 
         if (btype != HPDF_BYTE_TYPE_TRAIL) {
+            /* the UTF-8 encoder writes the text as unicode values. */
+            HPDF_UINT16 c = (encoder->encode_text_fn) ?
+                    HPDF_Encoder_ParsedToUnicode (encoder, &parse_state,
+                    code) : code;
+
+            bits[c >> 3] |= (HPDF_BYTE)(0x80 >> (c & 7));
+
             if (attr->writing_mode == HPDF_WMODE_HORIZONTAL) {
                 if (attr->fontdef->type == HPDF_FONTDEF_TYPE_CID) {
                     /* cid-based font */
@@ -633,8 +790,9 @@ TextWidth  (HPDF_Font         font,
                     w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
                 } else {
                     /* unicode-based font */
-                    unicode = (encoder->to_unicode_fn)(encoder, code);
-                    w = HPDF_TTFontDef_GetCharWidth (attr->fontdef, unicode);
+                    unicode = HPDF_Encoder_ParsedToUnicode (encoder,
+                            &parse_state, code);
+                    w = UnicodeWidth (attr->fontdef, unicode, !used);
                 }
             } else {
                 w = -dw2;
@@ -662,6 +820,47 @@ TextWidth  (HPDF_Font         font,
 }
 
 
+/* merge the codes recorded by TextWidth into the font, and mark the glyphs
+ * of the codes which were not used before as TextWidth does.
+ */
+static void
+MergeUsed  (HPDF_Font         font,
+            const HPDF_BYTE  *used)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_Encoder encoder = attr->encoder;
+    HPDF_BOOL mark = (attr->fontdef->type == HPDF_FONTDEF_TYPE_TRUETYPE &&
+            attr->writing_mode == HPDF_WMODE_HORIZONTAL);
+    HPDF_UINT i;
+    HPDF_UINT j;
+
+    HPDF_PTRACE ((" HPDF_Type0Font_MergeUsed\n"));
+
+    for (i = 0; i < HPDF_TYPE0_USED_SIZ; i++) {
+        HPDF_BYTE b = (HPDF_BYTE)(used[i] & ~attr->used[i]);
+
+        if (!b)
+            continue;
+
+        attr->used[i] |= b;
+
+        if (!mark)
+            continue;
+
+        for (j = 0; j < 8; j++) {
+            HPDF_UINT16 c = (HPDF_UINT16)(i * 8 + j);
+
+            if (!(b & (0x80 >> j)))
+                continue;
+
+            HPDF_TTFontDef_GetCharWidth (attr->fontdef,
+                    (encoder->encode_text_fn) ? c :
+                    (encoder->to_unicode_fn)(encoder, c));
+        }
+    }
+}
+
+
 static HPDF_UINT
 MeasureText  (HPDF_Font          font,
               const HPDF_BYTE   *text,
@@ -671,7 +870,9 @@ MeasureText  (HPDF_Font          font,
               HPDF_REAL          char_space,
               HPDF_REAL          word_space,
               HPDF_BOOL          wordwrap,
-              HPDF_REAL         *real_width)
+              HPDF_REAL         *real_width,
+              HPDF_BYTE         *used,
+              HPDF_Error         error)
 {
     HPDF_REAL w = 0;
     HPDF_UINT tmp_len = 0;
@@ -684,6 +885,8 @@ MeasureText  (HPDF_Font          font,
 
     HPDF_PTRACE ((" HPDF_Type0Font_MeasureText\n"));
 
+    HPDF_UNUSED (error);
+
     if (attr->fontdef->type == HPDF_FONTDEF_TYPE_CID) {
         HPDF_CIDFontDefAttr cid_fontdef_attr =
                 (HPDF_CIDFontDefAttr)attr->fontdef->attr;
@@ -749,9 +952,9 @@ MeasureText  (HPDF_Font          font,
                     tmp_w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
                 } else {
                     /* unicode-based font */
-                    unicode = (encoder->to_unicode_fn)(encoder, code);
-                    tmp_w = HPDF_TTFontDef_GetCharWidth (attr->fontdef,
-                            unicode);
+                    unicode = HPDF_Encoder_ParsedToUnicode (encoder,
+                            &parse_state, code);
+                    tmp_w = UnicodeWidth (attr->fontdef, unicode, !used);
                 }
             } else {
                 tmp_w = (HPDF_UINT16)(-dw2);
@@ -1085,3 +1288,380 @@ CreateCMap  (HPDF_Encoder   encoder,
     return cmap;
 }
 
+
+static HPDF_UNICODE
+CodeToUnicode  (HPDF_FontAttr  attr,
+                HPDF_UINT      code)
+{
+    HPDF_Encoder encoder = attr->encoder;
+
+    if (encoder->encode_text_fn)
+        return (HPDF_UNICODE)code;
+
+    return (encoder->to_unicode_fn)(encoder, (HPDF_UINT16)code);
+}
+
+
+/* find the next run of used codes from *code on which map to consecutive
+ * unicode values. a run does not cross a boundary of the last byte of its
+ * codes or unicode values, as required for a bfrange. returns the length
+ * of the run, or 0 when there are no more used codes.
+ */
+static HPDF_UINT
+NextUnicodeRun  (HPDF_FontAttr  attr,
+                 HPDF_UINT     *code,
+                 HPDF_UNICODE  *unicode)
+{
+    HPDF_UINT c = *code;
+    HPDF_UINT len;
+
+    for (;;) {
+        while (c < 0x10000 && !attr->used[c >> 3]) {
+            c = (c + 8) & ~7u;
+        }
+
+        if (c >= 0x10000)
+            return 0;
+
+        if (attr->used[c >> 3] & (0x80 >> (c & 7))) {
+            *unicode = CodeToUnicode (attr, c);
+            if (*unicode != 0)
+                break;
+        }
+
+        c++;
+    }
+
+    *code = c;
+    len = 1;
+
+    while ((c & 0xFF) != 0xFF && (*unicode & 0xFF) + len <= 0xFF) {
+        c++;
+
+        if (!(attr->used[c >> 3] & (0x80 >> (c & 7))) ||
+                CodeToUnicode (attr, c) != *unicode + len)
+            break;
+
+        len++;
+    }
+
+    return len;
+}
+
+
+/* write the bfrange entries (ranges is true) or bfchar entries of the
+ * used codes in blocks of HPDF_CMAP_MAX_BLOCK_ENTRIES.
+ */
+static HPDF_STATUS
+WriteUnicodeRuns  (HPDF_FontAttr  attr,
+                   HPDF_Stream    stream,
+                   HPDF_BOOL      ranges)
+{
+    const char *name = (ranges) ? "bfrange\r\n" : "bfchar\r\n";
+    HPDF_BYTE width = (attr->encoder->encode_text_fn) ? 2 : 1;
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_UINT count = 0;
+    HPDF_UINT n = 0;
+    HPDF_UINT code = 0;
+    HPDF_UNICODE unicode;
+    HPDF_UINT len;
+    HPDF_STATUS ret = HPDF_OK;
+
+    while ((len = NextUnicodeRun (attr, &code, &unicode)) > 0) {
+        if ((len > 1) == ranges)
+            count++;
+        code += len;
+    }
+
+    code = 0;
+    while ((len = NextUnicodeRun (attr, &code, &unicode)) > 0) {
+        HPDF_BYTE w = (code > 255) ? 2 : width;
+
+        if ((len > 1) != ranges) {
+            code += len;
+            continue;
+        }
+
+        if (n % HPDF_CMAP_MAX_BLOCK_ENTRIES == 0) {
+            HPDF_UINT rest = count - n;
+
+            pbuf = buf;
+            if (n > 0) {
+                pbuf = (char *)HPDF_StrCpy (pbuf, "end", eptr);
+                pbuf = (char *)HPDF_StrCpy (pbuf, name, eptr);
+            }
+
+            pbuf = HPDF_IToA (pbuf, (rest < HPDF_CMAP_MAX_BLOCK_ENTRIES) ?
+                    rest : HPDF_CMAP_MAX_BLOCK_ENTRIES, eptr);
+            pbuf = (char *)HPDF_StrCpy (pbuf, " begin", eptr);
+            HPDF_StrCpy (pbuf, name, eptr);
+            ret += HPDF_Stream_WriteStr (stream, buf);
+        }
+
+        pbuf = UINT16ToHex (buf, (HPDF_UINT16)code, eptr, w);
+        *pbuf++ = ' ';
+        if (ranges) {
+            pbuf = UINT16ToHex (pbuf, (HPDF_UINT16)(code + len - 1), eptr, w);
+            *pbuf++ = ' ';
+        }
+        pbuf = UINT16ToHex (pbuf, unicode, eptr, 2);
+        HPDF_StrCpy (pbuf, "\r\n", eptr);
+        ret += HPDF_Stream_WriteStr (stream, buf);
+
+        if (ret != HPDF_OK)
+            return ret;
+
+        n++;
+        code += len;
+    }
+
+    if (n > 0) {
+        pbuf = (char *)HPDF_StrCpy (buf, "end", eptr);
+        pbuf = (char *)HPDF_StrCpy (pbuf, name, eptr);
+        HPDF_StrCpy (pbuf, "\r\n", eptr);
+        ret = HPDF_Stream_WriteStr (stream, buf);
+    }
+
+    return ret;
+}
+
+
+/* the ToUnicode CMap contains the codes which have been used only, so it is
+ * made again whenever the font is written.
+ */
+static HPDF_STATUS
+WriteToUnicode  (HPDF_Dict  obj)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)obj->attr;
+    HPDF_Encoder encoder = attr->encoder;
+    HPDF_CMapEncoderAttr encoder_attr = (HPDF_CMapEncoderAttr)encoder->attr;
+    HPDF_Stream stream = attr->to_unicode_stream->stream;
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_STATUS ret = HPDF_OK;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" WriteToUnicode\n"));
+
+    attr->to_unicode_stream->filter = obj->filter;
+    HPDF_MemStream_FreeData (stream);
+
+    ret += HPDF_Stream_WriteStr (stream,
+                "/CIDInit /ProcSet findresource begin\r\n"
+                "12 dict begin\r\n"
+                "begincmap\r\n"
+                "/CIDSystemInfo\r\n"
+                "<< /Registry (Adobe)\r\n"
+                "/Ordering (UCS)\r\n"
+                "/Supplement 0\r\n"
+                ">> def\r\n"
+                "/CMapName /Adobe-Identity-UCS def\r\n"
+                "/CMapType 2 def\r\n");
+
+    /* the codes of the UTF-8 encoder are written as two byte unicode
+     * values, the others use the code space of the encoder.
+     */
+    if (encoder->encode_text_fn) {
+        ret += HPDF_Stream_WriteStr (stream, "1 begincodespacerange\r\n"
+                    "<0000> <FFFF>\r\n");
+    } else {
+        pbuf = HPDF_IToA (buf, encoder_attr->code_space_range->count, eptr);
+        HPDF_StrCpy (pbuf, " begincodespacerange\r\n", eptr);
+        ret += HPDF_Stream_WriteStr (stream, buf);
+
+        for (i = 0; i < encoder_attr->code_space_range->count; i++) {
+            HPDF_CidRange_Rec *range = HPDF_List_ItemAt
+                    (encoder_attr->code_space_range, i);
+
+            pbuf = CidRangeToHex (buf, range->from, range->to, eptr);
+            HPDF_StrCpy (pbuf, "\r\n", eptr);
+            ret += HPDF_Stream_WriteStr (stream, buf);
+        }
+    }
+    ret += HPDF_Stream_WriteStr (stream, "endcodespacerange\r\n");
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    if ((ret = WriteUnicodeRuns (attr, stream, HPDF_TRUE)) != HPDF_OK ||
+            (ret = WriteUnicodeRuns (attr, stream, HPDF_FALSE)) != HPDF_OK)
+        return ret;
+
+    return HPDF_Stream_WriteStr (stream,
+                "endcmap\r\n"
+                "CMapName currentdict /CMap defineresource pop\r\n"
+                "end\r\n"
+                "end\r\n");
+}
+
+
+static HPDF_STATUS
+AddWidthsEntry  (HPDF_Array   array,
+                 HPDF_UINT    first,
+                 HPDF_UINT    last,
+                 HPDF_INT     width)
+{
+    HPDF_STATUS ret = HPDF_OK;
+
+    ret += HPDF_Array_AddNumber (array, first);
+    ret += HPDF_Array_AddNumber (array, last);
+    ret += HPDF_Array_AddNumber (array, width);
+
+    return ret;
+}
+
+
+/* the 'W' element of the descendant font is made of the CIDs which have been
+ * used. a run of three or more CIDs with the same width is written as
+ * "c_first c_last w", which may also span CIDs which are not used, the
+ * other widths are written in arrays of consecutive CIDs "c [w1 w2 ...]".
+ */
+static HPDF_STATUS
+WriteWidths  (HPDF_Dict  obj)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)obj->attr;
+    HPDF_FontDef fontdef = attr->fontdef;
+    HPDF_Encoder encoder = attr->encoder;
+    HPDF_BOOL is_cid = (fontdef->type == HPDF_FONTDEF_TYPE_CID);
+    HPDF_INT dw;
+    HPDF_BYTE *used;
+    HPDF_INT16 *widths;
+    HPDF_Array array;
+    HPDF_Array sub_array = NULL;
+    HPDF_UINT last_cid = 0;
+    HPDF_UINT cid;
+    HPDF_UINT i;
+    HPDF_STATUS ret = HPDF_OK;
+
+    HPDF_PTRACE ((" WriteWidths\n"));
+
+    array = HPDF_Array_New (obj->mmgr);
+    if (!array)
+        return HPDF_Error_GetCode (obj->error);
+
+    if ((ret = HPDF_Dict_Add (attr->descendant_font, "W", array)) != HPDF_OK)
+        return ret;
+
+    used = HPDF_GetMem (obj->mmgr, HPDF_TYPE0_USED_SIZ);
+    widths = HPDF_GetMem (obj->mmgr, sizeof(HPDF_INT16) * 65536);
+    if (!used || !widths) {
+        if (used)
+            HPDF_FreeMem (obj->mmgr, used);
+        return HPDF_Error_GetCode (obj->error);
+    }
+
+    HPDF_MemSet (used, 0, HPDF_TYPE0_USED_SIZ);
+
+    if (is_cid)
+        dw = ((HPDF_CIDFontDefAttr)fontdef->attr)->DW;
+    else
+        dw = fontdef->missing_width;
+
+    /* the width of each CID used */
+    for (i = 0; i < 0x10000; i++) {
+        HPDF_UNICODE unicode;
+        HPDF_INT16 w;
+
+        if (!attr->used[i >> 3]) {
+            i |= 7;
+            continue;
+        }
+
+        if (!(attr->used[i >> 3] & (0x80 >> (i & 7))))
+            continue;
+
+        if (encoder->encode_text_fn)
+            cid = i;
+        else
+            cid = HPDF_CMapEncoder_ToCID (encoder, (HPDF_UINT16)i);
+
+        if (is_cid) {
+            w = (HPDF_INT16)dw;
+        } else {
+            if (cid == 0)
+                continue;
+
+            unicode = CodeToUnicode (attr, i);
+            w = HPDF_TTFontDef_GetGidWidth (fontdef,
+                    HPDF_TTFontDef_GetGlyphid (fontdef, unicode));
+        }
+
+        used[cid >> 3] |= (HPDF_BYTE)(0x80 >> (cid & 7));
+        widths[cid] = w;
+    }
+
+    if (is_cid) {
+        HPDF_CIDFontDefAttr fontdef_attr = (HPDF_CIDFontDefAttr)fontdef->attr;
+
+        for (i = 0; i < fontdef_attr->widths->count; i++) {
+            HPDF_CID_Width *w = (HPDF_CID_Width *)HPDF_List_ItemAt
+                    (fontdef_attr->widths, i);
+
+            widths[w->cid] = w->width;
+        }
+    }
+
+    cid = 0;
+    while (ret == HPDF_OK && cid < 0x10000) {
+        HPDF_UINT first = cid;
+        HPDF_UINT last;
+        HPDF_UINT len = 1;
+        HPDF_INT w;
+
+        if (!(used[cid >> 3] & (0x80 >> (cid & 7)))) {
+            cid++;
+            continue;
+        }
+
+        /* the run of used CIDs which have the same width */
+        w = widths[first];
+        last = first;
+        for (cid = first + 1; cid < 0x10000; cid++) {
+            if (!(used[cid >> 3] & (0x80 >> (cid & 7))))
+                continue;
+
+            if (widths[cid] != w)
+                break;
+
+            last = cid;
+            len++;
+        }
+        cid = last + 1;
+
+        if (w == dw) {
+            sub_array = NULL;
+            continue;
+        }
+
+        if (len >= 3 || (len == 2 && (last != first + 1 || !sub_array ||
+                first != last_cid + 1))) {
+            sub_array = NULL;
+            ret = AddWidthsEntry (array, first, last, w);
+            continue;
+        }
+
+        for (i = first; i <= last; i++) {
+            if (!sub_array || i != last_cid + 1) {
+                sub_array = HPDF_Array_New (obj->mmgr);
+                if (!sub_array) {
+                    ret = HPDF_Error_GetCode (obj->error);
+                    break;
+                }
+
+                ret += HPDF_Array_AddNumber (array, i);
+                ret += HPDF_Array_Add (array, sub_array);
+            }
+
+            ret += HPDF_Array_AddNumber (sub_array, w);
+            last_cid = i;
+        }
+    }
+
+    HPDF_FreeMem (obj->mmgr, widths);
+    HPDF_FreeMem (obj->mmgr, used);
+
+    return ret;
+}
@@ -19,6 +19,10 @@
 #include "hpdf_utils.h"
 #include "hpdf_font.h"
 
+#ifndef HPDF_UNUSED
+#define HPDF_UNUSED(a) ((void)(a))
+#endif
+
 static HPDF_STATUS
 OnWrite  (HPDF_Dict    obj,
           HPDF_Stream  stream);
@@ -33,12 +37,20 @@ OnFree  (HPDF_Dict  obj);
 
 static HPDF_INT
 CharWidth (HPDF_Font  font,
-           HPDF_BYTE  code);
+           HPDF_BYTE  code,
+           HPDF_BYTE  *used);
+
+
+static void
+MergeUsed  (HPDF_Font         font,
+            const HPDF_BYTE  *used);
 
 static HPDF_TextWidth
 TextWidth  (HPDF_Font         font,
             const HPDF_BYTE  *text,
-            HPDF_UINT         len);
+            HPDF_UINT         len,
+            HPDF_BYTE        *used,
+            HPDF_Error        error);
 
 
 static HPDF_STATUS
@@ -54,7 +66,9 @@ MeasureText  (HPDF_Font          font,
               HPDF_REAL          char_space,
               HPDF_REAL          word_space,
               HPDF_BOOL          wordwrap,
-              HPDF_REAL         *real_width);
+              HPDF_REAL         *real_width,
+              HPDF_BYTE         *used,
+              HPDF_Error         error);
 
 
 HPDF_Font
@@ -88,6 +102,13 @@ HPDF_TTFont_New  (HPDF_MMgr        mmgr,
         return NULL;
     }
 
+    /* a CFF font program can only be embedded with a CID-keyed encoding. */
+    fontdef_attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    if (fontdef_attr->is_cff && fontdef_attr->embedding) {
+        HPDF_SetError(font->error, HPDF_INVALID_ENCODER_TYPE, 1);
+        return NULL;
+    }
+
     attr = HPDF_GetMem (mmgr, sizeof(HPDF_FontAttr_Rec));
     if (!attr) {
         HPDF_Dict_Free (font);
@@ -106,6 +127,8 @@ HPDF_TTFont_New  (HPDF_MMgr        mmgr,
     attr->writing_mode = HPDF_WMODE_HORIZONTAL;
     attr->text_width_fn = TextWidth;
     attr->measure_text_fn = MeasureText;
+    attr->merge_used_fn = MergeUsed;
+    attr->used_size = 256 / 8;
     attr->fontdef = fontdef;
     attr->encoder = encoder;
     attr->xref = xref;
@@ -133,7 +156,10 @@ HPDF_TTFont_New  (HPDF_MMgr        mmgr,
 
     HPDF_MemSet (attr->used, 0, sizeof(HPDF_BYTE) * 256);
 
-    fontdef_attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    /* a simple font addresses glyphs through the cmap of the embedded font,
+     * so the glyph ids must not be renumbered when the font is subsetted.
+     */
+    fontdef_attr->keep_gids = HPDF_TRUE;
 
     ret += HPDF_Dict_AddName (font, "Type", "Font");
     ret += HPDF_Dict_AddName (font, "BaseFont", fontdef_attr->base_font);
@@ -206,8 +232,10 @@ CreateDescriptor  (HPDF_Font  font)
             if (!font_data)
                 return HPDF_Error_GetCode (font->error);
 
-            if (HPDF_TTFontDef_SaveFontData (font_attr->fontdef,
-                font_data->stream) != HPDF_OK)
+            font_data->filter = font->filter;
+
+            if (HPDF_TTFontDef_SaveFontFile (font_attr->fontdef,
+                font_data) != HPDF_OK)
                 return HPDF_Error_GetCode (font->error);
 
             ret += HPDF_Dict_Add (descriptor, "FontFile2", font_data);
@@ -215,8 +243,6 @@ CreateDescriptor  (HPDF_Font  font)
                     def_attr->length1);
             ret += HPDF_Dict_AddNumber (font_data, "Length2", 0);
             ret += HPDF_Dict_AddNumber (font_data, "Length3", 0);
-
-            font_data->filter = font->filter;
         }
 
         if (ret != HPDF_OK)
@@ -232,10 +258,20 @@ CreateDescriptor  (HPDF_Font  font)
 
 static HPDF_INT
 CharWidth (HPDF_Font  font,
-           HPDF_BYTE  code)
+           HPDF_BYTE  code,
+           HPDF_BYTE  *used)
 {
     HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
 
+    /* the font is only read, the code is marked by MergeUsed later. */
+    if (used) {
+        HPDF_UNICODE unicode = HPDF_Encoder_ToUnicode (attr->encoder, code);
+
+        used[code >> 3] |= (HPDF_BYTE)(0x80 >> (code & 7));
+        return HPDF_TTFontDef_GetGidWidth (attr->fontdef,
+                HPDF_TTFontDef_GetGlyphid (attr->fontdef, unicode));
+    }
+
     if (attr->used[code] == 0) {
         HPDF_UNICODE unicode = HPDF_Encoder_ToUnicode (attr->encoder, code);
 
@@ -248,10 +284,24 @@ CharWidth (HPDF_Font  font,
 }
 
 
+static void
+MergeUsed  (HPDF_Font         font,
+            const HPDF_BYTE  *used)
+{
+    HPDF_UINT i;
+
+    for (i = 0; i < 256; i++)
+        if (used[i >> 3] & (0x80 >> (i & 7)))
+            CharWidth (font, (HPDF_BYTE)i, NULL);
+}
+
+
 static HPDF_TextWidth
 TextWidth  (HPDF_Font         font,
             const HPDF_BYTE  *text,
-            HPDF_UINT         len)
+            HPDF_UINT         len,
+            HPDF_BYTE        *used,
+            HPDF_Error        error)
 {
     HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
     HPDF_TextWidth ret = {0, 0, 0, 0};
@@ -264,7 +314,7 @@ TextWidth  (HPDF_Font         font,
         for (i = 0; i < len; i++) {
             b = text[i];
             ret.numchars++;
-            ret.width += CharWidth (font, b);
+            ret.width += CharWidth (font, b, used);
 
             if (HPDF_IS_WHITE_SPACE(b)) {
                 ret.numspace++;
@@ -272,7 +322,7 @@ TextWidth  (HPDF_Font         font,
             }
         }
     } else
-        HPDF_SetError (font->error, HPDF_FONT_INVALID_WIDTHS_TABLE, 0);
+        HPDF_SetError (error, HPDF_FONT_INVALID_WIDTHS_TABLE, 0);
 
     /* 2006.08.19 add. */
     if (HPDF_IS_WHITE_SPACE(b))
@@ -293,7 +343,9 @@ MeasureText (HPDF_Font          font,
              HPDF_REAL          char_space,
              HPDF_REAL          word_space,
              HPDF_BOOL          wordwrap,
-             HPDF_REAL         *real_width)
+             HPDF_REAL         *real_width,
+             HPDF_BYTE         *used,
+             HPDF_Error         error)
 {
     HPDF_DOUBLE w = 0;
     HPDF_UINT tmp_len = 0;
@@ -301,6 +353,8 @@ MeasureText (HPDF_Font          font,
 
     HPDF_PTRACE ((" HPDF_TTFont_MeasureText\n"));
 
+    HPDF_UNUSED (error);
+
     for (i = 0; i < len; i++) {
         HPDF_BYTE b = text[i];
 
@@ -318,7 +372,7 @@ MeasureText (HPDF_Font          font,
                 *real_width = (HPDF_REAL)w;
         }
 
-        w += (HPDF_DOUBLE)CharWidth (font, b) * font_size / 1000;
+        w += (HPDF_DOUBLE)CharWidth (font, b, used) * font_size / 1000;
 
         /* 2006.08.04 break when it encountered  line feed */
         if (w > width || b == 0x0A)
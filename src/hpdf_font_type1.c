@@ -19,6 +19,10 @@
 #include "hpdf_utils.h"
 #include "hpdf_font.h"
 
+#ifndef HPDF_UNUSED
+#define HPDF_UNUSED(a) ((void)(a))
+#endif
+
 static HPDF_STATUS
 Type1Font_OnWrite  (HPDF_Dict    obj,
           HPDF_Stream  stream);
@@ -31,7 +35,9 @@ Type1Font_OnFree  (HPDF_Dict  obj);
 static HPDF_TextWidth
 Type1Font_TextWidth  (HPDF_Font        font,
                       const HPDF_BYTE  *text,
-                      HPDF_UINT        len);
+                      HPDF_UINT        len,
+                      HPDF_BYTE       *used,
+                      HPDF_Error       error);
 
 
 static HPDF_UINT
@@ -43,7 +49,9 @@ Type1Font_MeasureText  (HPDF_Font          font,
                         HPDF_REAL          char_space,
                         HPDF_REAL          word_space,
                         HPDF_BOOL          wordwrap,
-                        HPDF_REAL         *real_width);
+                        HPDF_REAL         *real_width,
+                        HPDF_BYTE         *used,
+                        HPDF_Error         error);
 
 
 static HPDF_STATUS
@@ -227,7 +235,9 @@ Type1Font_CreateDescriptor  (HPDF_MMgr  mmgr,
 static HPDF_TextWidth
 Type1Font_TextWidth  (HPDF_Font        font,
                       const HPDF_BYTE  *text,
-                      HPDF_UINT        len)
+                      HPDF_UINT        len,
+                      HPDF_BYTE       *used,
+                      HPDF_Error       error)
 {
     HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
     HPDF_TextWidth ret = {0, 0, 0, 0};
@@ -236,6 +246,9 @@ Type1Font_TextWidth  (HPDF_Font        font,
 
     HPDF_PTRACE ((" HPDF_Type1Font_TextWidth\n"));
 
+    /* the widths are made in the constructor, nothing is marked as used */
+    HPDF_UNUSED (used);
+
     if (attr->widths) {
         for (i = 0; i < len; i++) {
             b = text[i];
@@ -248,7 +261,7 @@ Type1Font_TextWidth  (HPDF_Font        font,
             }
         }
     } else
-        HPDF_SetError (font->error, HPDF_FONT_INVALID_WIDTHS_TABLE, 0);
+        HPDF_SetError (error, HPDF_FONT_INVALID_WIDTHS_TABLE, 0);
 
     /* 2006.08.19 add. */
     if (HPDF_IS_WHITE_SPACE(b))
@@ -269,7 +282,9 @@ Type1Font_MeasureText (HPDF_Font          font,
                        HPDF_REAL          char_space,
                        HPDF_REAL          word_space,
                        HPDF_BOOL          wordwrap,
-                       HPDF_REAL         *real_width)
+                       HPDF_REAL         *real_width,
+                       HPDF_BYTE         *used,
+                       HPDF_Error         error)
 {
     HPDF_REAL w = 0;
     HPDF_UINT tmp_len = 0;
@@ -278,6 +293,9 @@ Type1Font_MeasureText (HPDF_Font          font,
 
     HPDF_PTRACE ((" HPDF_Type1Font_MeasureText\n"));
 
+    HPDF_UNUSED (used);
+    HPDF_UNUSED (error);
+
     for (i = 0; i < len; i++) {
         HPDF_BYTE b = text[i];
 
@@ -0,0 +1,264 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_fontcache.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_fontdef.h"
+
+static HPDF_UINT32
+GetHash  (HPDF_FontDef      fontdef,
+          HPDF_BOOL         subset,
+          HPDF_UINT         filter,
+          const HPDF_BYTE  *glyphs,
+          HPDF_UINT         glyphs_len);
+
+
+static void
+FreeEntry  (HPDF_FontCache       cache,
+            HPDF_FontCacheEntry  entry);
+
+
+static void
+Shrink  (HPDF_FontCache  cache,
+         HPDF_UINT       size);
+
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ *  HPDF_FontCache_New
+ *
+ *  The font cache keeps the finished font programs of embedded fonts, so
+ *  that a document which uses the same glyphs of a font as a previous one
+ *  does not have to rebuild (and compress) the font program again.
+ *  Entries are keyed by the fontdef and its glyph-usage, and the least
+ *  recently used ones are dropped when the total size exceeds max_size.
+ *
+ *  mmgr : Pointer to a HPDF_MMgr object.
+ *  max_size : The maximum number of bytes held by the cache.
+ *
+ */
+
+HPDF_FontCache
+HPDF_FontCache_New  (HPDF_MMgr  mmgr,
+                     HPDF_UINT  max_size)
+{
+    HPDF_FontCache cache;
+
+    HPDF_PTRACE ((" HPDF_FontCache_New\n"));
+
+    cache = HPDF_GetMem (mmgr, sizeof(HPDF_FontCache_Rec));
+    if (!cache)
+        return NULL;
+
+    HPDF_MemSet (cache, 0, sizeof(HPDF_FontCache_Rec));
+
+    cache->entries = HPDF_List_New (mmgr, HPDF_DEF_ITEMS_PER_BLOCK);
+    if (!cache->entries) {
+        HPDF_FreeMem (mmgr, cache);
+        return NULL;
+    }
+
+    cache->mmgr = mmgr;
+    cache->max_size = max_size;
+
+    return cache;
+}
+
+
+void
+HPDF_FontCache_Free  (HPDF_FontCache  cache)
+{
+    HPDF_PTRACE ((" HPDF_FontCache_Free\n"));
+
+    if (!cache)
+        return;
+
+    Shrink (cache, 0);
+
+    HPDF_List_Free (cache->entries);
+    HPDF_FreeMem (cache->mmgr, cache);
+}
+
+
+void
+HPDF_FontCache_SetMaxSize  (HPDF_FontCache  cache,
+                            HPDF_UINT       max_size)
+{
+    HPDF_PTRACE ((" HPDF_FontCache_SetMaxSize\n"));
+
+    cache->max_size = max_size;
+    Shrink (cache, max_size);
+}
+
+
+HPDF_FontCacheEntry
+HPDF_FontCache_Find  (HPDF_FontCache    cache,
+                      HPDF_FontDef      fontdef,
+                      HPDF_BOOL         subset,
+                      HPDF_UINT         filter,
+                      const HPDF_BYTE  *glyphs,
+                      HPDF_UINT         glyphs_len)
+{
+    HPDF_UINT32 hash = GetHash (fontdef, subset, filter, glyphs, glyphs_len);
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_FontCache_Find\n"));
+
+    for (i = 0; i < cache->entries->count; i++) {
+        HPDF_FontCacheEntry entry =
+                (HPDF_FontCacheEntry)HPDF_List_ItemAt (cache->entries, i);
+
+        if (entry->hash == hash && entry->fontdef == fontdef &&
+                entry->subset == subset && entry->filter == filter &&
+                entry->glyphs_len == glyphs_len &&
+                HPDF_MemCmp (entry->glyphs, glyphs, glyphs_len) == 0) {
+
+            /* move the entry to the head of the list. */
+            if (i > 0) {
+                HPDF_List_RemoveByIndex (cache->entries, i);
+                HPDF_List_Insert (cache->entries,
+                        HPDF_List_ItemAt (cache->entries, 0), entry);
+            }
+
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+
+HPDF_STATUS
+HPDF_FontCache_Add  (HPDF_FontCache    cache,
+                     HPDF_FontDef      fontdef,
+                     HPDF_BOOL         subset,
+                     HPDF_UINT         filter,
+                     const HPDF_BYTE  *glyphs,
+                     HPDF_UINT         glyphs_len,
+                     HPDF_Stream       data,
+                     HPDF_UINT         length1)
+{
+    HPDF_FontCacheEntry entry;
+    HPDF_UINT len = data->size;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_FontCache_Add\n"));
+
+    /* the font program does not fit into the cache at all. */
+    if (len + glyphs_len > cache->max_size)
+        return HPDF_OK;
+
+    Shrink (cache, cache->max_size - len - glyphs_len);
+
+    entry = HPDF_GetMem (cache->mmgr, sizeof(HPDF_FontCacheEntry_Rec));
+    if (!entry)
+        return HPDF_Error_GetCode (cache->mmgr->error);
+
+    HPDF_MemSet (entry, 0, sizeof(HPDF_FontCacheEntry_Rec));
+
+    entry->glyphs = HPDF_GetMem (cache->mmgr, glyphs_len);
+    entry->data = HPDF_GetMem (cache->mmgr, len);
+    if (!entry->glyphs || !entry->data) {
+        FreeEntry (cache, entry);
+        return HPDF_Error_GetCode (cache->mmgr->error);
+    }
+
+    if ((ret = HPDF_Stream_Seek (data, 0, HPDF_SEEK_SET)) != HPDF_OK ||
+            (ret = HPDF_Stream_Read (data, entry->data, &len)) != HPDF_OK) {
+        FreeEntry (cache, entry);
+        return ret;
+    }
+
+    HPDF_MemCpy (entry->glyphs, glyphs, glyphs_len);
+    entry->fontdef = fontdef;
+    entry->hash = GetHash (fontdef, subset, filter, glyphs, glyphs_len);
+    entry->subset = subset;
+    entry->filter = filter;
+    entry->glyphs_len = glyphs_len;
+    entry->len = len;
+    entry->length1 = length1;
+
+    if (cache->entries->count > 0)
+        ret = HPDF_List_Insert (cache->entries,
+                HPDF_List_ItemAt (cache->entries, 0), entry);
+    else
+        ret = HPDF_List_Add (cache->entries, entry);
+
+    if (ret != HPDF_OK) {
+        FreeEntry (cache, entry);
+        return ret;
+    }
+
+    cache->size += len + glyphs_len;
+
+    HPDF_PTRACE ((" HPDF_FontCache_Add len=%u size=%u count=%u\n", len,
+                cache->size, cache->entries->count));
+
+    return HPDF_OK;
+}
+
+
+/* FNV-1a hash of the cache key */
+static HPDF_UINT32
+GetHash  (HPDF_FontDef      fontdef,
+          HPDF_BOOL         subset,
+          HPDF_UINT         filter,
+          const HPDF_BYTE  *glyphs,
+          HPDF_UINT         glyphs_len)
+{
+    HPDF_UINT32 hash = 2166136261u;
+    HPDF_UINT i;
+
+    hash = (hash ^ (HPDF_UINT32)(HPDF_UINT)(size_t)fontdef) * 16777619u;
+    hash = (hash ^ (HPDF_UINT32)subset) * 16777619u;
+    hash = (hash ^ (HPDF_UINT32)filter) * 16777619u;
+
+    for (i = 0; i < glyphs_len; i++)
+        hash = (hash ^ glyphs[i]) * 16777619u;
+
+    return hash;
+}
+
+
+static void
+FreeEntry  (HPDF_FontCache       cache,
+            HPDF_FontCacheEntry  entry)
+{
+    if (entry->glyphs)
+        HPDF_FreeMem (cache->mmgr, entry->glyphs);
+
+    if (entry->data)
+        HPDF_FreeMem (cache->mmgr, entry->data);
+
+    HPDF_FreeMem (cache->mmgr, entry);
+}
+
+
+/* drop the least recently used entries until the cache fits into size. */
+static void
+Shrink  (HPDF_FontCache  cache,
+         HPDF_UINT       size)
+{
+    while (cache->size > size && cache->entries->count > 0) {
+        HPDF_FontCacheEntry entry = (HPDF_FontCacheEntry)HPDF_List_RemoveByIndex
+                (cache->entries, cache->entries->count - 1);
+
+        cache->size -= entry->len + entry->glyphs_len;
+        FreeEntry (cache, entry);
+    }
+}
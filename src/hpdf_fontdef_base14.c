@@ -18,6 +18,7 @@
 #include "hpdf_conf.h"
 #include "hpdf_utils.h"
 #include "hpdf_fontdef.h"
+#include "hpdf_fontdef_base14_index.h"
 
 static const HPDF_CharData CHAR_DATA_COURIER[316] = {
     {32, 0x0020, 600},
@@ -4444,16 +4445,27 @@ HPDF_Base14FontDef_FindBuiltinData  (const char  *font_name);
 const HPDF_Base14FontDefData*
 HPDF_Base14FontDef_FindBuiltinData  (const char  *font_name)
 {
-    HPDF_UINT i = 0;
+    const HPDF_UINT count = sizeof(HPDF_BUILTIN_FONT_INDEX) /
+            sizeof(HPDF_BUILTIN_FONT_INDEX[0]);
+    HPDF_UINT low = 0;
+    HPDF_UINT high = count;
 
-    while (HPDF_BUILTIN_FONTS[i].font_name) {
-        if (HPDF_StrCmp (HPDF_BUILTIN_FONTS[i].font_name, font_name) == 0)
-            break;
+    while (low < high) {
+        HPDF_UINT mid = (low + high) / 2;
 
-        i++;
+        if (HPDF_StrCmp (HPDF_BUILTIN_FONTS[HPDF_BUILTIN_FONT_INDEX[mid]].
+                font_name, font_name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
-    return &HPDF_BUILTIN_FONTS[i];
+    if (low < count && HPDF_StrCmp (HPDF_BUILTIN_FONTS
+            [HPDF_BUILTIN_FONT_INDEX[low]].font_name, font_name) == 0)
+        return &HPDF_BUILTIN_FONTS[HPDF_BUILTIN_FONT_INDEX[low]];
+
+    /* the terminating entry */
+    return &HPDF_BUILTIN_FONTS[count];
 }
 
 HPDF_FontDef
@@ -4488,7 +4500,7 @@ HPDF_Base14FontDef_New  (HPDF_MMgr        mmgr,
         HPDF_StrCpy (attr->encoding_scheme, HPDF_ENCODING_FONT_SPECIFIC,
                 attr->encoding_scheme + HPDF_LIMIT_MAX_NAME_LEN);
 
-    ret = HPDF_Type1FontDef_SetWidths (fontdef, data->widths_table);
+    ret = HPDF_Type1FontDef_SetSharedWidths (fontdef, data->widths_table);
 
     if (ret != HPDF_OK) {
         HPDF_FontDef_Free (fontdef);
@@ -0,0 +1,17 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_fontdef_base14_index.h
+ *
+ * generated by cmake/modules/name_index.cmake, do not edit.
+ *
+ */
+
+#ifndef _HPDF_FONTDEF_BASE14_INDEX_H
+#define _HPDF_FONTDEF_BASE14_INDEX_H
+
+/* HPDF_BUILTIN_FONTS by font_name */
+static const HPDF_UINT16 HPDF_BUILTIN_FONT_INDEX[14] = {
+    0, 1, 3, 2, 4, 5, 7, 6, 12, 9, 11, 10,
+    8, 13
+};
+
+#endif /* _HPDF_FONTDEF_BASE14_INDEX_H */
@@ -0,0 +1,1233 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_fontdef_cff.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_fontdef.h"
+
+/*
+ * The CFF table of an OpenType font is embedded as a CID-keyed CFF font
+ * program (FontFile3 /CIDFontType0C). Only the glyphs which are used in
+ * the document are written, and each of them is given the CID it is
+ * addressed with in the content streams, so that no CIDToGIDMap is needed.
+ * Subroutines which are not called by the written glyphs are replaced with
+ * an empty subroutine, which keeps the numbering of the others intact.
+ */
+
+#define HPDF_CFF_MAX_STACK          48
+#define HPDF_CFF_MAX_SUBR_DEPTH     10
+
+/* two-byte operators are numbered 1200 + the second byte */
+#define HPDF_CFF_OP_CHARSET         15
+#define HPDF_CFF_OP_ENCODING        16
+#define HPDF_CFF_OP_CHARSTRINGS     17
+#define HPDF_CFF_OP_PRIVATE         18
+#define HPDF_CFF_OP_SUBRS           19
+#define HPDF_CFF_OP_COPYRIGHT       1200
+#define HPDF_CFF_OP_CHARSTRINGTYPE  1206
+#define HPDF_CFF_OP_SYNTHETICBASE   1220
+#define HPDF_CFF_OP_POSTSCRIPT      1221
+#define HPDF_CFF_OP_BASEFONTNAME    1222
+#define HPDF_CFF_OP_ROS             1230
+#define HPDF_CFF_OP_CIDCOUNT        1234
+#define HPDF_CFF_OP_FDARRAY         1236
+#define HPDF_CFF_OP_FDSELECT        1237
+#define HPDF_CFF_OP_FONTNAME        1238
+
+/* the first SID of the String INDEX */
+#define HPDF_CFF_STD_STRINGS        391
+
+typedef struct _HPDF_CFF_Index {
+    HPDF_UINT          count;
+    HPDF_UINT          off_size;
+    const HPDF_BYTE   *offsets;
+    const HPDF_BYTE   *data;        /* the byte preceding the first object */
+    HPDF_UINT          end;         /* the position following the INDEX */
+} HPDF_CFF_Index;
+
+
+typedef struct _HPDF_CFF_DictOp {
+    const HPDF_BYTE   *start;       /* the first byte of the operands */
+    const HPDF_BYTE   *end;         /* the byte following the operator */
+    HPDF_UINT          op;
+    HPDF_UINT          num_args;
+    HPDF_INT32         args[HPDF_CFF_MAX_STACK];
+} HPDF_CFF_DictOp;
+
+
+typedef struct _HPDF_CFF_Private {
+    const HPDF_BYTE   *dict;
+    HPDF_UINT          dict_len;
+    HPDF_CFF_Index     subrs;
+    HPDF_BYTE         *used;
+    HPDF_UINT          out_offset;
+    HPDF_UINT          out_len;
+} HPDF_CFF_Private;
+
+
+typedef struct _HPDF_CFF_CharState {
+    HPDF_INT32         stack[HPDF_CFF_MAX_STACK];
+    HPDF_UINT          sp;
+    HPDF_UINT          num_stems;
+    HPDF_BOOL          done;
+} HPDF_CFF_CharState;
+
+
+typedef struct _HPDF_CFF_Writer {
+    HPDF_BYTE         *buf;         /* NULL: only count the bytes */
+    HPDF_UINT          pos;
+} HPDF_CFF_Writer;
+
+
+typedef struct _HPDF_CFF_Font {
+    HPDF_FontDef       fontdef;
+    const HPDF_BYTE   *buf;
+    HPDF_UINT          len;
+
+    const HPDF_BYTE   *top;
+    HPDF_UINT          top_len;
+    HPDF_CFF_Index     gsubrs;
+    HPDF_BYTE         *gsubrs_used;
+    HPDF_CFF_Index     char_strings;
+    HPDF_BOOL          cid;
+    HPDF_CFF_Index     fd_array;
+    HPDF_UINT          fd_select;
+    HPDF_UINT          num_fds;
+    HPDF_CFF_Private  *privates;
+
+    /* the subset to be written */
+    HPDF_UINT16       *gids;
+    HPDF_UINT16       *cids;
+    HPDF_BYTE         *fds;
+    HPDF_UINT          num_glyphs;
+    HPDF_UINT          cid_count;
+    const char        *registry;
+    const char        *ordering;
+    HPDF_INT           supplement;
+
+    /* the layout of the subset, recorded by the first pass of BuildCFF */
+    HPDF_UINT          out_charset;
+    HPDF_UINT          out_fd_select;
+    HPDF_UINT          out_char_strings;
+    HPDF_UINT          out_fd_array;
+} HPDF_CFF_Font;
+
+
+static HPDF_STATUS
+LoadCFF  (HPDF_FontDef     fontdef,
+          HPDF_CFF_Font   *cff,
+          HPDF_BYTE      **mem);
+
+
+static void
+FreeCFF  (HPDF_CFF_Font   *cff,
+          HPDF_BYTE       *mem);
+
+
+static HPDF_STATUS
+ReadIndex  (HPDF_CFF_Font    *cff,
+            HPDF_UINT         pos,
+            HPDF_CFF_Index   *idx);
+
+
+static const HPDF_BYTE*
+IndexItem  (const HPDF_CFF_Index  *idx,
+            HPDF_UINT              i,
+            HPDF_UINT             *len);
+
+
+static HPDF_BOOL
+NextDictOp  (const HPDF_BYTE  **p,
+             const HPDF_BYTE   *end,
+             HPDF_CFF_DictOp   *op);
+
+
+static HPDF_STATUS
+ParsePrivate  (HPDF_CFF_Font     *cff,
+               HPDF_UINT          size,
+               HPDF_UINT          offset,
+               HPDF_CFF_Private  *priv);
+
+
+static HPDF_UINT
+GetFD  (HPDF_CFF_Font  *cff,
+        HPDF_UINT16     gid);
+
+
+static HPDF_STATUS
+ScanCharString  (HPDF_CFF_Font       *cff,
+                 HPDF_CFF_Private    *priv,
+                 const HPDF_BYTE     *p,
+                 HPDF_UINT            len,
+                 HPDF_UINT            depth,
+                 HPDF_CFF_CharState  *state);
+
+
+static void
+BuildCFF  (HPDF_CFF_Font    *cff,
+           HPDF_CFF_Writer  *w);
+
+
+/*---------------------------------------------------------------------------*/
+
+HPDF_STATUS
+HPDF_TTFontDef_ValidateCFF  (HPDF_FontDef   fontdef)
+{
+    HPDF_CFF_Font cff;
+    HPDF_BYTE *mem;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_ValidateCFF\n"));
+
+    ret = LoadCFF (fontdef, &cff, &mem);
+    FreeCFF (&cff, mem);
+
+    return ret;
+}
+
+
+/*
+ *  HPDF_TTFontDef_SaveCFFData
+ *
+ *  Write the used glyphs of the CFF table as a CID-keyed CFF font program.
+ *
+ *  fontdef : A TrueType fontdef whose outlines are in a CFF table.
+ *  stream : The stream the font program is written to.
+ *  cid_to_gid : The glyph id of each CID used by the font.
+ *  cid_count : The number of elements of cid_to_gid.
+ *  registry, ordering, supplement : The character collection of the font.
+ *
+ */
+
+HPDF_STATUS
+HPDF_TTFontDef_SaveCFFData  (HPDF_FontDef        fontdef,
+                             HPDF_Stream         stream,
+                             const HPDF_UINT16  *cid_to_gid,
+                             HPDF_UINT           cid_count,
+                             const char         *registry,
+                             const char         *ordering,
+                             HPDF_INT            supplement)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_CFF_Font cff;
+    HPDF_CFF_Writer w;
+    HPDF_BYTE *mem;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_SaveCFFData\n"));
+
+    if ((ret = LoadCFF (fontdef, &cff, &mem)) != HPDF_OK) {
+        FreeCFF (&cff, mem);
+        return ret;
+    }
+
+    cff.cid_count = cid_count;
+    cff.registry = registry;
+    cff.ordering = ordering;
+    cff.supplement = supplement;
+
+    cff.gids = HPDF_GetMem (fontdef->mmgr, sizeof(HPDF_UINT16) * (cid_count + 1));
+    cff.cids = HPDF_GetMem (fontdef->mmgr, sizeof(HPDF_UINT16) * (cid_count + 1));
+    cff.fds = HPDF_GetMem (fontdef->mmgr, cid_count + 1);
+    if (!cff.gids || !cff.cids || !cff.fds) {
+        FreeCFF (&cff, mem);
+        return HPDF_Error_GetCode (fontdef->error);
+    }
+
+    /* the glyph 0 (.notdef) is always CID 0. the other glyphs are written
+     * in the order of their CIDs.
+     */
+    cff.gids[0] = 0;
+    cff.cids[0] = 0;
+    cff.num_glyphs = 1;
+
+    for (i = 1; i < cid_count; i++) {
+        HPDF_UINT16 gid = cid_to_gid[i];
+
+        if (gid != 0 && gid < attr->num_glyphs &&
+                attr->glyph_tbl.flgs[gid] == 1) {
+            cff.gids[cff.num_glyphs] = gid;
+            cff.cids[cff.num_glyphs] = (HPDF_UINT16)i;
+            cff.num_glyphs++;
+        }
+    }
+
+    /* mark the subroutines which are called by the glyphs. */
+    for (i = 0; i < cff.num_glyphs; i++) {
+        HPDF_CFF_CharState state;
+        const HPDF_BYTE *cs;
+        HPDF_UINT len;
+
+        cff.fds[i] = (HPDF_BYTE)GetFD (&cff, cff.gids[i]);
+        cs = IndexItem (&cff.char_strings, cff.gids[i], &len);
+
+        HPDF_MemSet (&state, 0, sizeof(HPDF_CFF_CharState));
+        if ((ret = ScanCharString (&cff, cff.privates + cff.fds[i], cs, len,
+                        0, &state)) != HPDF_OK) {
+            FreeCFF (&cff, mem);
+            return ret;
+        }
+    }
+
+    /* the first pass only records the layout of the font program. */
+    w.buf = NULL;
+    w.pos = 0;
+    BuildCFF (&cff, &w);
+
+    w.buf = HPDF_GetMem (fontdef->mmgr, w.pos);
+    if (!w.buf) {
+        FreeCFF (&cff, mem);
+        return HPDF_Error_GetCode (fontdef->error);
+    }
+
+    w.pos = 0;
+    BuildCFF (&cff, &w);
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_SaveCFFData glyphs=%u len=%u\n",
+                cff.num_glyphs, w.pos));
+
+    ret = HPDF_Stream_Write (stream, w.buf, w.pos);
+
+    HPDF_FreeMem (fontdef->mmgr, w.buf);
+    FreeCFF (&cff, mem);
+
+    return ret;
+}
+
+
+static HPDF_STATUS
+LoadCFF  (HPDF_FontDef     fontdef,
+          HPDF_CFF_Font   *cff,
+          HPDF_BYTE      **mem)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_CFF_Index idx;
+    HPDF_CFF_DictOp op;
+    const HPDF_BYTE *p;
+    const HPDF_BYTE *end;
+    HPDF_UINT private_size = 0;
+    HPDF_UINT private_offset = 0;
+    HPDF_UINT char_strings = 0;
+    HPDF_UINT fd_array = 0;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_LoadCFF\n"));
+
+    HPDF_MemSet (cff, 0, sizeof(HPDF_CFF_Font));
+    cff->fontdef = fontdef;
+    cff->len = attr->cff_length;
+    *mem = NULL;
+
+    cff->buf = HPDF_MappedReader_GetBufPtr (attr->stream, attr->cff_offset,
+            attr->cff_length);
+
+    if (!cff->buf) {
+        HPDF_UINT len = attr->cff_length;
+
+        *mem = HPDF_GetMem (fontdef->mmgr, len);
+        if (!*mem)
+            return HPDF_Error_GetCode (fontdef->error);
+
+        if ((ret = HPDF_Stream_Seek (attr->stream, attr->cff_offset,
+                        HPDF_SEEK_SET)) != HPDF_OK ||
+                (ret = HPDF_Stream_Read (attr->stream, *mem, &len)) != HPDF_OK)
+            return ret;
+
+        cff->buf = *mem;
+    }
+
+    /* header, Name INDEX, Top DICT INDEX, String INDEX and Global Subr
+     * INDEX follow each other.
+     */
+    if (cff->len < 4 || cff->buf[0] != 1)
+        return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_FOMAT, 20);
+
+    if ((ret = ReadIndex (cff, cff->buf[2], &idx)) != HPDF_OK ||
+            (ret = ReadIndex (cff, idx.end, &idx)) != HPDF_OK)
+        return ret;
+
+    cff->top = IndexItem (&idx, 0, &cff->top_len);
+    if (idx.count == 0)
+        return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_FOMAT, 21);
+
+    if ((ret = ReadIndex (cff, idx.end, &idx)) != HPDF_OK ||
+            (ret = ReadIndex (cff, idx.end, &cff->gsubrs)) != HPDF_OK)
+        return ret;
+
+    p = cff->top;
+    end = cff->top + cff->top_len;
+    while (NextDictOp (&p, end, &op)) {
+        switch (op.op) {
+            case HPDF_CFF_OP_CHARSTRINGS:
+                char_strings = (HPDF_UINT)op.args[0];
+                break;
+            case HPDF_CFF_OP_PRIVATE:
+                private_size = (HPDF_UINT)op.args[0];
+                private_offset = (HPDF_UINT)op.args[1];
+                break;
+            case HPDF_CFF_OP_CHARSTRINGTYPE:
+                if (op.args[0] != 2)
+                    return HPDF_SetError (fontdef->error,
+                            HPDF_TTF_INVALID_FOMAT, 22);
+                break;
+            case HPDF_CFF_OP_ROS:
+                cff->cid = HPDF_TRUE;
+                break;
+            case HPDF_CFF_OP_FDARRAY:
+                fd_array = (HPDF_UINT)op.args[0];
+                break;
+            case HPDF_CFF_OP_FDSELECT:
+                cff->fd_select = (HPDF_UINT)op.args[0];
+                break;
+        }
+    }
+
+    if (p != end || char_strings == 0)
+        return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_FOMAT, 23);
+
+    if ((ret = ReadIndex (cff, char_strings, &cff->char_strings)) != HPDF_OK)
+        return ret;
+
+    if (cff->char_strings.count != attr->num_glyphs)
+        return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_FOMAT, 24);
+
+    if (cff->cid) {
+        if (fd_array == 0 || cff->fd_select == 0 ||
+                cff->fd_select >= cff->len)
+            return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_FOMAT, 25);
+
+        if ((ret = ReadIndex (cff, fd_array, &cff->fd_array)) != HPDF_OK)
+            return ret;
+
+        cff->num_fds = cff->fd_array.count;
+    } else
+        cff->num_fds = 1;
+
+    if (cff->num_fds == 0 || cff->num_fds > 256)
+        return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_FOMAT, 26);
+
+    cff->privates = HPDF_GetMem (fontdef->mmgr,
+            sizeof(HPDF_CFF_Private) * cff->num_fds);
+    if (!cff->privates)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    HPDF_MemSet (cff->privates, 0, sizeof(HPDF_CFF_Private) * cff->num_fds);
+
+    for (i = 0; i < cff->num_fds; i++) {
+        if (cff->cid) {
+            HPDF_UINT len;
+
+            p = IndexItem (&cff->fd_array, i, &len);
+            end = p + len;
+            private_size = 0;
+            private_offset = 0;
+
+            while (NextDictOp (&p, end, &op)) {
+                if (op.op == HPDF_CFF_OP_PRIVATE) {
+                    private_size = (HPDF_UINT)op.args[0];
+                    private_offset = (HPDF_UINT)op.args[1];
+                }
+            }
+        }
+
+        if ((ret = ParsePrivate (cff, private_size, private_offset,
+                        cff->privates + i)) != HPDF_OK)
+            return ret;
+    }
+
+    cff->gsubrs_used = HPDF_GetMem (fontdef->mmgr, cff->gsubrs.count + 1);
+    if (!cff->gsubrs_used)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    HPDF_MemSet (cff->gsubrs_used, 0, cff->gsubrs.count + 1);
+
+    return HPDF_OK;
+}
+
+
+static void
+FreeCFF  (HPDF_CFF_Font   *cff,
+          HPDF_BYTE       *mem)
+{
+    HPDF_MMgr mmgr = cff->fontdef->mmgr;
+    HPDF_UINT i;
+
+    if (cff->privates) {
+        for (i = 0; i < cff->num_fds; i++) {
+            if (cff->privates[i].used)
+                HPDF_FreeMem (mmgr, cff->privates[i].used);
+        }
+
+        HPDF_FreeMem (mmgr, cff->privates);
+    }
+
+    if (cff->gsubrs_used)
+        HPDF_FreeMem (mmgr, cff->gsubrs_used);
+
+    if (cff->gids)
+        HPDF_FreeMem (mmgr, cff->gids);
+
+    if (cff->cids)
+        HPDF_FreeMem (mmgr, cff->cids);
+
+    if (cff->fds)
+        HPDF_FreeMem (mmgr, cff->fds);
+
+    if (mem)
+        HPDF_FreeMem (mmgr, mem);
+}
+
+
+static HPDF_UINT
+GetOffset  (const HPDF_BYTE  *p,
+            HPDF_UINT         off_size)
+{
+    HPDF_UINT value = 0;
+
+    while (off_size-- > 0)
+        value = (value << 8) | *p++;
+
+    return value;
+}
+
+
+static HPDF_STATUS
+ReadIndex  (HPDF_CFF_Font    *cff,
+            HPDF_UINT         pos,
+            HPDF_CFF_Index   *idx)
+{
+    HPDF_UINT last;
+
+    HPDF_MemSet (idx, 0, sizeof(HPDF_CFF_Index));
+
+    if (pos + 2 > cff->len)
+        return HPDF_SetError (cff->fontdef->error, HPDF_TTF_INVALID_FOMAT, 27);
+
+    idx->count = GetOffset (cff->buf + pos, 2);
+    if (idx->count == 0) {
+        idx->end = pos + 2;
+        return HPDF_OK;
+    }
+
+    if (pos + 3 > cff->len)
+        return HPDF_SetError (cff->fontdef->error, HPDF_TTF_INVALID_FOMAT, 27);
+
+    idx->off_size = cff->buf[pos + 2];
+    if (idx->off_size < 1 || idx->off_size > 4 ||
+            pos + 3 + (idx->count + 1) * idx->off_size > cff->len)
+        return HPDF_SetError (cff->fontdef->error, HPDF_TTF_INVALID_FOMAT, 27);
+
+    idx->offsets = cff->buf + pos + 3;
+    idx->data = idx->offsets + (idx->count + 1) * idx->off_size - 1;
+
+    last = GetOffset (idx->offsets + idx->count * idx->off_size,
+            idx->off_size);
+    idx->end = (HPDF_UINT)(idx->data - cff->buf) + last;
+
+    if (last < 1 || idx->end > cff->len)
+        return HPDF_SetError (cff->fontdef->error, HPDF_TTF_INVALID_FOMAT, 27);
+
+    return HPDF_OK;
+}
+
+
+static const HPDF_BYTE*
+IndexItem  (const HPDF_CFF_Index  *idx,
+            HPDF_UINT              i,
+            HPDF_UINT             *len)
+{
+    HPDF_UINT start;
+    HPDF_UINT end;
+    HPDF_UINT last;
+
+    *len = 0;
+    if (i >= idx->count)
+        return NULL;
+
+    start = GetOffset (idx->offsets + i * idx->off_size, idx->off_size);
+    end = GetOffset (idx->offsets + (i + 1) * idx->off_size, idx->off_size);
+    last = GetOffset (idx->offsets + idx->count * idx->off_size,
+            idx->off_size);
+
+    if (start < 1 || start > end || end > last)
+        return NULL;
+
+    *len = end - start;
+
+    return idx->data + start;
+}
+
+
+static HPDF_BOOL
+NextDictOp  (const HPDF_BYTE  **p,
+             const HPDF_BYTE   *end,
+             HPDF_CFF_DictOp   *op)
+{
+    const HPDF_BYTE *q = *p;
+
+    op->start = q;
+    op->num_args = 0;
+
+    while (q < end) {
+        HPDF_BYTE b0 = *q++;
+        HPDF_INT32 v;
+
+        if (b0 <= 21) {
+            if (b0 == 12) {
+                if (q >= end)
+                    return HPDF_FALSE;
+                op->op = 1200 + *q++;
+            } else
+                op->op = b0;
+
+            /* operators take at least one operand */
+            if (op->num_args == 0)
+                op->args[op->num_args++] = 0;
+
+            op->end = q;
+            *p = q;
+            return HPDF_TRUE;
+        }
+
+        if (b0 == 28) {
+            if (q + 2 > end)
+                return HPDF_FALSE;
+            v = (HPDF_INT16)(q[0] << 8 | q[1]);
+            q += 2;
+        } else if (b0 == 29) {
+            if (q + 4 > end)
+                return HPDF_FALSE;
+            v = (HPDF_INT32)((HPDF_UINT32)q[0] << 24 | (HPDF_UINT32)q[1] << 16 |
+                    (HPDF_UINT32)q[2] << 8 | q[3]);
+            q += 4;
+        } else if (b0 == 30) {
+            /* real numbers are only copied, their value is not needed. */
+            while (q < end && (*q & 0x0F) != 0x0F && (*q & 0xF0) != 0xF0)
+                q++;
+            if (q++ >= end)
+                return HPDF_FALSE;
+            v = 0;
+        } else if (b0 >= 32 && b0 <= 246) {
+            v = b0 - 139;
+        } else if (b0 >= 247 && b0 <= 250) {
+            if (q >= end)
+                return HPDF_FALSE;
+            v = (b0 - 247) * 256 + *q++ + 108;
+        } else if (b0 >= 251 && b0 <= 254) {
+            if (q >= end)
+                return HPDF_FALSE;
+            v = -(b0 - 251) * 256 - *q++ - 108;
+        } else
+            return HPDF_FALSE;
+
+        if (op->num_args < HPDF_CFF_MAX_STACK)
+            op->args[op->num_args++] = v;
+    }
+
+    return HPDF_FALSE;
+}
+
+
+static HPDF_STATUS
+ParsePrivate  (HPDF_CFF_Font     *cff,
+               HPDF_UINT          size,
+               HPDF_UINT          offset,
+               HPDF_CFF_Private  *priv)
+{
+    HPDF_CFF_DictOp op;
+    const HPDF_BYTE *p;
+    const HPDF_BYTE *end;
+    HPDF_STATUS ret;
+
+    if (offset > cff->len || size > cff->len - offset)
+        return HPDF_SetError (cff->fontdef->error, HPDF_TTF_INVALID_FOMAT, 28);
+
+    priv->dict = cff->buf + offset;
+    priv->dict_len = size;
+
+    p = priv->dict;
+    end = priv->dict + size;
+    while (NextDictOp (&p, end, &op)) {
+        if (op.op == HPDF_CFF_OP_SUBRS) {
+            /* the offset of local subrs is relative to the Private DICT. */
+            if ((ret = ReadIndex (cff, offset + (HPDF_UINT)op.args[0],
+                            &priv->subrs)) != HPDF_OK)
+                return ret;
+        }
+    }
+
+    priv->used = HPDF_GetMem (cff->fontdef->mmgr, priv->subrs.count + 1);
+    if (!priv->used)
+        return HPDF_Error_GetCode (cff->fontdef->error);
+
+    HPDF_MemSet (priv->used, 0, priv->subrs.count + 1);
+
+    return HPDF_OK;
+}
+
+
+static HPDF_UINT
+GetFD  (HPDF_CFF_Font  *cff,
+        HPDF_UINT16     gid)
+{
+    const HPDF_BYTE *p;
+    HPDF_UINT fd = 0;
+
+    if (!cff->cid)
+        return 0;
+
+    p = cff->buf + cff->fd_select;
+
+    if (p[0] == 0) {
+        if (cff->fd_select + 1 + gid < cff->len)
+            fd = p[1 + gid];
+    } else if (p[0] == 3 && cff->fd_select + 3 <= cff->len) {
+        HPDF_UINT num_ranges = GetOffset (p + 1, 2);
+        HPDF_UINT i;
+
+        p += 3;
+        for (i = 0; i < num_ranges; i++, p += 3) {
+            if ((HPDF_UINT)(p - cff->buf) + 5 > cff->len)
+                break;
+
+            if (gid >= GetOffset (p, 2) && gid < GetOffset (p + 3, 2)) {
+                fd = p[2];
+                break;
+            }
+        }
+    }
+
+    return (fd < cff->num_fds) ? fd : 0;
+}
+
+
+static HPDF_INT32
+GetSubrBias  (HPDF_UINT  count)
+{
+    if (count < 1240)
+        return 107;
+    else if (count < 33900)
+        return 1131;
+    else
+        return 32768;
+}
+
+
+/* walk through a Type 2 charstring to find the subroutines it calls. the
+ * hint operators are counted, because the length of the hintmask operator
+ * depends on the number of stems.
+ */
+static HPDF_STATUS
+ScanCharString  (HPDF_CFF_Font       *cff,
+                 HPDF_CFF_Private    *priv,
+                 const HPDF_BYTE     *p,
+                 HPDF_UINT            len,
+                 HPDF_UINT            depth,
+                 HPDF_CFF_CharState  *state)
+{
+    const HPDF_BYTE *end = p + len;
+
+    if (depth > HPDF_CFF_MAX_SUBR_DEPTH)
+        return HPDF_SetError (cff->fontdef->error, HPDF_TTF_INVALID_FOMAT, 29);
+
+    while (p < end && !state->done) {
+        HPDF_BYTE b0 = *p++;
+        HPDF_INT32 v;
+
+        if (b0 >= 32 || b0 == 28) {
+            if (b0 == 28) {
+                if (p + 2 > end)
+                    break;
+                v = (HPDF_INT16)(p[0] << 8 | p[1]);
+                p += 2;
+            } else if (b0 <= 246) {
+                v = b0 - 139;
+            } else if (b0 <= 250) {
+                if (p >= end)
+                    break;
+                v = (b0 - 247) * 256 + *p++ + 108;
+            } else if (b0 <= 254) {
+                if (p >= end)
+                    break;
+                v = -(b0 - 251) * 256 - *p++ - 108;
+            } else {
+                /* 16.16 fixed number, only the integer part is kept. */
+                if (p + 4 > end)
+                    break;
+                v = (HPDF_INT16)(p[0] << 8 | p[1]);
+                p += 4;
+            }
+
+            if (state->sp < HPDF_CFF_MAX_STACK)
+                state->stack[state->sp++] = v;
+            continue;
+        }
+
+        switch (b0) {
+            case 1:     /* hstem */
+            case 3:     /* vstem */
+            case 18:    /* hstemhm */
+            case 23:    /* vstemhm */
+                state->num_stems += state->sp / 2;
+                state->sp = 0;
+                break;
+
+            case 19:    /* hintmask */
+            case 20:    /* cntrmask */
+                state->num_stems += state->sp / 2;
+                state->sp = 0;
+                p += (state->num_stems + 7) / 8;
+                break;
+
+            case 10:    /* callsubr */
+            case 29: {  /* callgsubr */
+                HPDF_CFF_Index *subrs = (b0 == 10) ? &priv->subrs :
+                        &cff->gsubrs;
+                HPDF_BYTE *used = (b0 == 10) ? priv->used : cff->gsubrs_used;
+                const HPDF_BYTE *subr;
+                HPDF_UINT subr_len;
+                HPDF_INT32 i;
+                HPDF_STATUS ret;
+
+                if (state->sp == 0)
+                    return HPDF_SetError (cff->fontdef->error,
+                            HPDF_TTF_INVALID_FOMAT, 29);
+
+                i = state->stack[--state->sp] + GetSubrBias (subrs->count);
+                if (i < 0 || (HPDF_UINT)i >= subrs->count)
+                    return HPDF_SetError (cff->fontdef->error,
+                            HPDF_TTF_INVALID_FOMAT, 29);
+
+                used[i] = 1;
+                subr = IndexItem (subrs, (HPDF_UINT)i, &subr_len);
+
+                if ((ret = ScanCharString (cff, priv, subr, subr_len,
+                                depth + 1, state)) != HPDF_OK)
+                    return ret;
+                break;
+            }
+
+            case 11:    /* return */
+                return HPDF_OK;
+
+            case 14:    /* endchar */
+                state->done = HPDF_TRUE;
+                return HPDF_OK;
+
+            case 12:    /* escape */
+                p++;
+                state->sp = 0;
+                break;
+
+            default:
+                state->sp = 0;
+        }
+    }
+
+    return HPDF_OK;
+}
+
+
+static void
+PutByte  (HPDF_CFF_Writer  *w,
+          HPDF_UINT         value)
+{
+    if (w->buf)
+        w->buf[w->pos] = (HPDF_BYTE)value;
+    w->pos++;
+}
+
+
+static void
+PutBytes  (HPDF_CFF_Writer   *w,
+           const HPDF_BYTE   *p,
+           HPDF_UINT          len)
+{
+    if (w->buf && len > 0)
+        HPDF_MemCpy (w->buf + w->pos, p, len);
+    w->pos += len;
+}
+
+
+static void
+PutOffset  (HPDF_CFF_Writer  *w,
+            HPDF_UINT         off_size,
+            HPDF_UINT         value)
+{
+    while (off_size-- > 0)
+        PutByte (w, (value >> (off_size * 8)) & 0xFF);
+}
+
+
+static HPDF_UINT
+GetOffSize  (HPDF_UINT  max_offset)
+{
+    if (max_offset < 0x100)
+        return 1;
+    else if (max_offset < 0x10000)
+        return 2;
+    else if (max_offset < 0x1000000)
+        return 3;
+    else
+        return 4;
+}
+
+
+/* integer operand of a DICT, always 5 bytes long */
+static void
+PutInt5  (HPDF_CFF_Writer  *w,
+          HPDF_UINT         value)
+{
+    PutByte (w, 29);
+    PutOffset (w, 4, value);
+}
+
+
+/* integer operand of a DICT, in its shortest form */
+static void
+PutInt  (HPDF_CFF_Writer  *w,
+         HPDF_INT32        value)
+{
+    if (value >= -107 && value <= 107) {
+        PutByte (w, value + 139);
+    } else if (value >= 108 && value <= 1131) {
+        value -= 108;
+        PutByte (w, (value >> 8) + 247);
+        PutByte (w, value & 0xFF);
+    } else if (value >= -1131 && value <= -108) {
+        value = -value - 108;
+        PutByte (w, (value >> 8) + 251);
+        PutByte (w, value & 0xFF);
+    } else if (value >= -32768 && value <= 32767) {
+        PutByte (w, 28);
+        PutOffset (w, 2, (HPDF_UINT)value & 0xFFFF);
+    } else
+        PutInt5 (w, (HPDF_UINT)value);
+}
+
+
+static void
+PutOp  (HPDF_CFF_Writer  *w,
+        HPDF_UINT         op)
+{
+    if (op >= 1200) {
+        PutByte (w, 12);
+        PutByte (w, op - 1200);
+    } else
+        PutByte (w, op);
+}
+
+
+static void
+PutIndexHeader  (HPDF_CFF_Writer  *w,
+                 HPDF_UINT         count,
+                 HPDF_UINT         data_len)
+{
+    PutOffset (w, 2, count);
+    if (count > 0)
+        PutByte (w, GetOffSize (data_len + 1));
+}
+
+
+/* write an INDEX whose items are taken from src. if gids is not NULL, it
+ * lists the items to be written, otherwise all of them are written and
+ * those which are not marked in used are replaced with an empty subroutine.
+ */
+static void
+PutSubsetIndex  (HPDF_CFF_Writer        *w,
+                 const HPDF_CFF_Index   *src,
+                 const HPDF_UINT16      *gids,
+                 const HPDF_BYTE        *used,
+                 HPDF_UINT               count)
+{
+    static const HPDF_BYTE empty_subr[] = { 11 };    /* return */
+    HPDF_UINT data_len = 0;
+    HPDF_UINT off_size;
+    HPDF_UINT offset = 1;
+    HPDF_UINT pass;
+    HPDF_UINT i;
+
+    for (i = 0; i < count; i++) {
+        HPDF_UINT len;
+
+        if (used && !used[i])
+            len = sizeof(empty_subr);
+        else
+            IndexItem (src, gids ? gids[i] : i, &len);
+
+        data_len += len;
+    }
+
+    PutIndexHeader (w, count, data_len);
+    if (count == 0)
+        return;
+
+    off_size = GetOffSize (data_len + 1);
+    PutOffset (w, off_size, offset);
+
+    /* the offsets are written by the first pass, the data by the second. */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < count; i++) {
+            const HPDF_BYTE *item;
+            HPDF_UINT len;
+
+            if (used && !used[i]) {
+                item = empty_subr;
+                len = sizeof(empty_subr);
+            } else
+                item = IndexItem (src, gids ? gids[i] : i, &len);
+
+            if (pass == 0) {
+                offset += len;
+                PutOffset (w, off_size, offset);
+            } else
+                PutBytes (w, item, len);
+        }
+    }
+}
+
+
+static void
+PutTopDict  (HPDF_CFF_Font    *cff,
+             HPDF_CFF_Writer  *w)
+{
+    const HPDF_BYTE *p = cff->top;
+    const HPDF_BYTE *end = cff->top + cff->top_len;
+    HPDF_CFF_DictOp op;
+
+    /* ROS must be the first operator of a CIDFont. */
+    PutInt (w, HPDF_CFF_STD_STRINGS);
+    PutInt (w, HPDF_CFF_STD_STRINGS + 1);
+    PutInt (w, cff->supplement);
+    PutOp (w, HPDF_CFF_OP_ROS);
+
+    while (NextDictOp (&p, end, &op)) {
+        switch (op.op) {
+            /* the strings of the original font are not written. */
+            case 0: case 1: case 2: case 3: case 4:
+            case HPDF_CFF_OP_COPYRIGHT:
+            case HPDF_CFF_OP_POSTSCRIPT:
+            case HPDF_CFF_OP_BASEFONTNAME:
+            case HPDF_CFF_OP_FONTNAME:
+            case HPDF_CFF_OP_SYNTHETICBASE:
+            /* these are rewritten below. */
+            case HPDF_CFF_OP_CHARSET:
+            case HPDF_CFF_OP_ENCODING:
+            case HPDF_CFF_OP_CHARSTRINGS:
+            case HPDF_CFF_OP_PRIVATE:
+            case HPDF_CFF_OP_ROS:
+            case HPDF_CFF_OP_CIDCOUNT:
+            case HPDF_CFF_OP_FDARRAY:
+            case HPDF_CFF_OP_FDSELECT:
+                break;
+            default:
+                PutBytes (w, op.start, (HPDF_UINT)(op.end - op.start));
+        }
+    }
+
+    PutInt (w, cff->cid_count);
+    PutOp (w, HPDF_CFF_OP_CIDCOUNT);
+    PutInt5 (w, cff->out_charset);
+    PutOp (w, HPDF_CFF_OP_CHARSET);
+    PutInt5 (w, cff->out_fd_select);
+    PutOp (w, HPDF_CFF_OP_FDSELECT);
+    PutInt5 (w, cff->out_fd_array);
+    PutOp (w, HPDF_CFF_OP_FDARRAY);
+    PutInt5 (w, cff->out_char_strings);
+    PutOp (w, HPDF_CFF_OP_CHARSTRINGS);
+}
+
+
+static void
+PutFontDict  (HPDF_CFF_Font    *cff,
+              HPDF_CFF_Writer  *w,
+              HPDF_UINT         fd)
+{
+    HPDF_CFF_Private *priv = cff->privates + fd;
+
+    if (cff->cid) {
+        HPDF_CFF_DictOp op;
+        const HPDF_BYTE *p;
+        const HPDF_BYTE *end;
+        HPDF_UINT len;
+
+        p = IndexItem (&cff->fd_array, fd, &len);
+        end = p + len;
+
+        while (NextDictOp (&p, end, &op)) {
+            if (op.op != HPDF_CFF_OP_PRIVATE && op.op != HPDF_CFF_OP_FONTNAME)
+                PutBytes (w, op.start, (HPDF_UINT)(op.end - op.start));
+        }
+    }
+
+    PutInt5 (w, priv->out_len);
+    PutInt5 (w, priv->out_offset);
+    PutOp (w, HPDF_CFF_OP_PRIVATE);
+}
+
+
+static void
+PutPrivateDict  (HPDF_CFF_Writer   *w,
+                 HPDF_CFF_Private  *priv)
+{
+    const HPDF_BYTE *p = priv->dict;
+    const HPDF_BYTE *end = priv->dict + priv->dict_len;
+    HPDF_CFF_DictOp op;
+
+    while (NextDictOp (&p, end, &op)) {
+        if (op.op != HPDF_CFF_OP_SUBRS)
+            PutBytes (w, op.start, (HPDF_UINT)(op.end - op.start));
+    }
+
+    /* the local subrs follow the Private DICT. */
+    if (priv->subrs.count > 0) {
+        PutInt5 (w, priv->out_len);
+        PutOp (w, HPDF_CFF_OP_SUBRS);
+    }
+}
+
+
+/* write the subset font program. all the offsets in the DICTs are written
+ * in a fixed length, so the layout recorded by a first pass (without a
+ * buffer) is valid for the second one.
+ */
+static void
+BuildCFF  (HPDF_CFF_Font    *cff,
+           HPDF_CFF_Writer  *w)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)cff->fontdef->attr;
+    HPDF_UINT name_len = HPDF_StrLen (attr->base_font, HPDF_LIMIT_MAX_NAME_LEN);
+    HPDF_UINT registry_len = HPDF_StrLen (cff->registry, -1);
+    HPDF_UINT ordering_len = HPDF_StrLen (cff->ordering, -1);
+    HPDF_CFF_Writer counter;
+    HPDF_UINT data_len;
+    HPDF_UINT num_ranges;
+    HPDF_UINT off_size;
+    HPDF_UINT i;
+
+    /* header */
+    PutByte (w, 1);
+    PutByte (w, 0);
+    PutByte (w, 4);
+    PutByte (w, 4);
+
+    /* Name INDEX */
+    PutIndexHeader (w, 1, name_len);
+    off_size = GetOffSize (name_len + 1);
+    PutOffset (w, off_size, 1);
+    PutOffset (w, off_size, name_len + 1);
+    PutBytes (w, (const HPDF_BYTE *)attr->base_font, name_len);
+
+    /* Top DICT INDEX */
+    counter.buf = NULL;
+    counter.pos = 0;
+    PutTopDict (cff, &counter);
+
+    PutIndexHeader (w, 1, counter.pos);
+    off_size = GetOffSize (counter.pos + 1);
+    PutOffset (w, off_size, 1);
+    PutOffset (w, off_size, counter.pos + 1);
+    PutTopDict (cff, w);
+
+    /* String INDEX */
+    PutIndexHeader (w, 2, registry_len + ordering_len);
+    off_size = GetOffSize (registry_len + ordering_len + 1);
+    PutOffset (w, off_size, 1);
+    PutOffset (w, off_size, registry_len + 1);
+    PutOffset (w, off_size, registry_len + ordering_len + 1);
+    PutBytes (w, (const HPDF_BYTE *)cff->registry, registry_len);
+    PutBytes (w, (const HPDF_BYTE *)cff->ordering, ordering_len);
+
+    /* Global Subr INDEX */
+    PutSubsetIndex (w, &cff->gsubrs, NULL, cff->gsubrs_used,
+            cff->gsubrs.count);
+
+    /* charset (format 2) */
+    cff->out_charset = w->pos;
+    PutByte (w, 2);
+    for (i = 1; i < cff->num_glyphs; ) {
+        HPDF_UINT n = 0;
+
+        while (i + n + 1 < cff->num_glyphs &&
+                cff->cids[i + n + 1] == cff->cids[i] + n + 1)
+            n++;
+
+        PutOffset (w, 2, cff->cids[i]);
+        PutOffset (w, 2, n);
+        i += n + 1;
+    }
+
+    /* FDSelect (format 3) */
+    cff->out_fd_select = w->pos;
+    num_ranges = 1;
+    for (i = 1; i < cff->num_glyphs; i++) {
+        if (cff->fds[i] != cff->fds[i - 1])
+            num_ranges++;
+    }
+
+    PutByte (w, 3);
+    PutOffset (w, 2, num_ranges);
+    for (i = 0; i < cff->num_glyphs; i++) {
+        if (i == 0 || cff->fds[i] != cff->fds[i - 1]) {
+            PutOffset (w, 2, i);
+            PutByte (w, cff->fds[i]);
+        }
+    }
+    PutOffset (w, 2, cff->num_glyphs);
+
+    /* CharStrings INDEX */
+    cff->out_char_strings = w->pos;
+    PutSubsetIndex (w, &cff->char_strings, cff->gids, NULL, cff->num_glyphs);
+
+    /* Font DICT INDEX */
+    cff->out_fd_array = w->pos;
+    data_len = 0;
+    for (i = 0; i < cff->num_fds; i++) {
+        counter.pos = 0;
+        PutFontDict (cff, &counter, i);
+        data_len += counter.pos;
+    }
+
+    PutIndexHeader (w, cff->num_fds, data_len);
+    off_size = GetOffSize (data_len + 1);
+    data_len = 1;
+    PutOffset (w, off_size, data_len);
+    for (i = 0; i < cff->num_fds; i++) {
+        counter.pos = 0;
+        PutFontDict (cff, &counter, i);
+        data_len += counter.pos;
+        PutOffset (w, off_size, data_len);
+    }
+
+    for (i = 0; i < cff->num_fds; i++)
+        PutFontDict (cff, w, i);
+
+    /* Private DICTs and local subrs */
+    for (i = 0; i < cff->num_fds; i++) {
+        HPDF_CFF_Private *priv = cff->privates + i;
+
+        priv->out_offset = w->pos;
+        PutPrivateDict (w, priv);
+        priv->out_len = w->pos - priv->out_offset;
+
+        if (priv->subrs.count > 0)
+            PutSubsetIndex (w, &priv->subrs, NULL, priv->used,
+                    priv->subrs.count);
+    }
+}
@@ -172,6 +172,28 @@ CheckCompositGryph  (HPDF_FontDef   fontdef,
                      HPDF_UINT16    gid);
 
 
+static HPDF_STATUS
+CopyTableData  (HPDF_FontDef   fontdef,
+                HPDF_UINT      offset,
+                HPDF_UINT      len,
+                HPDF_Stream    stream);
+
+
+static HPDF_STATUS
+CreateSubsetGids  (HPDF_FontDef   fontdef);
+
+
+static HPDF_STATUS
+WriteSubsetGlyph  (HPDF_FontDef   fontdef,
+                   HPDF_UINT      offset,
+                   HPDF_UINT      len,
+                   HPDF_Stream    stream);
+
+
+static HPDF_STATUS
+WriteSubsetCMap  (HPDF_Stream   stream);
+
+
 /*---------------------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 
@@ -197,6 +219,14 @@ CleanFunc (HPDF_FontDef   fontdef)
     HPDF_MemSet (attr->glyph_tbl.flgs, 0,
             sizeof (HPDF_BYTE) * attr->num_glyphs);
     attr->glyph_tbl.flgs[0] = 1;
+
+    if (attr->subset_gids) {
+        HPDF_FreeMem (fontdef->mmgr, attr->subset_gids);
+        attr->subset_gids = NULL;
+    }
+
+    attr->num_subset_glyphs = 0;
+    attr->keep_gids = HPDF_FALSE;
 }
 
 
@@ -239,6 +269,9 @@ InitAttr (HPDF_FontDef  fontdef)
         if (attr->glyph_tbl.offsets)
             HPDF_FreeMem (fontdef->mmgr, attr->glyph_tbl.offsets);
 
+        if (attr->subset_gids)
+            HPDF_FreeMem (fontdef->mmgr, attr->subset_gids);
+
         if (attr->stream)
             HPDF_Stream_Free (attr->stream);
     }
@@ -445,7 +478,30 @@ LoadFontData (HPDF_FontDef  fontdef,
     if ((ret = ParseHmtx (fontdef)) != HPDF_OK)
         return ret;
 
-    if ((ret = ParseLoca (fontdef)) != HPDF_OK)
+    /* allocate glyph-flg-table.
+     * this flgs are used to judge whether glyphs should be embedded.
+     */
+    attr->glyph_tbl.flgs = HPDF_GetMem (fontdef->mmgr,
+        sizeof (HPDF_BYTE) * attr->num_glyphs);
+
+    if (!attr->glyph_tbl.flgs)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    HPDF_MemSet (attr->glyph_tbl.flgs, 0,
+        sizeof (HPDF_BYTE) * attr->num_glyphs);
+    attr->glyph_tbl.flgs[0] = 1;
+
+    /* an OpenType font has either glyf and loca tables or a CFF table. */
+    tbl = FindTable (fontdef, "CFF ");
+    if (tbl && !FindTable (fontdef, "glyf")) {
+        attr->is_cff = HPDF_TRUE;
+        attr->cff_offset = tbl->offset;
+        attr->cff_length = tbl->length;
+
+        if (embedding && (ret = HPDF_TTFontDef_ValidateCFF (fontdef)) !=
+                HPDF_OK)
+            return ret;
+    } else if ((ret = ParseLoca (fontdef)) != HPDF_OK)
         return ret;
 
     if ((ret = ParseName (fontdef)) != HPDF_OK)
@@ -454,15 +510,18 @@ LoadFontData (HPDF_FontDef  fontdef,
     if ((ret = ParseOS2 (fontdef)) != HPDF_OK)
         return ret;
 
-    tbl = FindTable (fontdef, "glyf");
-    if (!tbl)
-        return HPDF_SetError (fontdef->error, HPDF_TTF_MISSING_TABLE, 4);
+    /* the heights of a CFF font are taken from the OS/2 table. */
+    if (!attr->is_cff) {
+        tbl = FindTable (fontdef, "glyf");
+        if (!tbl)
+            return HPDF_SetError (fontdef->error, HPDF_TTF_MISSING_TABLE, 4);
 
-    attr->glyph_tbl.base_offset = tbl->offset;
-    fontdef->cap_height =
+        attr->glyph_tbl.base_offset = tbl->offset;
+        fontdef->cap_height =
                 (HPDF_UINT16)HPDF_TTFontDef_GetCharBBox (fontdef, (HPDF_UINT16)'H').top;
-    fontdef->x_height =
+        fontdef->x_height =
                 (HPDF_UINT16)HPDF_TTFontDef_GetCharBBox (fontdef, (HPDF_UINT16)'x').top;
+    }
     fontdef->missing_width = (HPDF_INT16)((HPDF_UINT32)attr->h_metric[0].advance_width * 1000 /
                 attr->header.units_per_em);
 
@@ -548,6 +607,10 @@ HPDF_TTFontDef_GetCharBBox  (HPDF_FontDef   fontdef,
         return bbox;
     }
 
+    /* there are no glyf and loca tables in a CFF font. */
+    if (attr->is_cff)
+        return bbox;
+
     if (attr->header.index_to_loc_format == 0)
         m = 2;
     else
@@ -1208,7 +1271,7 @@ HPDF_TTFontDef_GetCharWidth  (HPDF_FontDef   fontdef,
     if (!attr->glyph_tbl.flgs[gid]) {
         attr->glyph_tbl.flgs[gid] = 1;
 
-        if (attr->embedding)
+        if (attr->embedding && !attr->is_cff)
             CheckCompositGryph (fontdef, gid);
     }
 
@@ -1427,19 +1490,6 @@ ParseLoca  (HPDF_FontDef  fontdef)
     HPDF_MemSet (attr->glyph_tbl.offsets, 0,
             sizeof (HPDF_UINT32) * (attr->num_glyphs + 1));
 
-    /* allocate glyph-flg-table.
-     * this flgs are used to judge whether glyphs should be embedded.
-     */
-    attr->glyph_tbl.flgs = HPDF_GetMem (fontdef->mmgr,
-        sizeof (HPDF_BYTE) * attr->num_glyphs);
-
-    if (!attr->glyph_tbl.flgs)
-        return HPDF_Error_GetCode (fontdef->error);
-
-    HPDF_MemSet (attr->glyph_tbl.flgs, 0,
-        sizeof (HPDF_BYTE) * attr->num_glyphs);
-    attr->glyph_tbl.flgs[0] = 1;
-
     poffset = attr->glyph_tbl.offsets;
     if (attr->header.index_to_loc_format == 0) {
         /* short version */
@@ -1767,6 +1817,23 @@ ParseOS2  (HPDF_FontDef  fontdef)
             return ret;
     }
 
+    /* get fields sxHeight and sCapHeight */
+    if (version >= 2) {
+        HPDF_INT16 x_height;
+        HPDF_INT16 cap_height;
+
+        if ((ret = GetINT16 (attr->stream, &x_height)) != HPDF_OK)
+            return ret;
+
+        if ((ret = GetINT16 (attr->stream, &cap_height)) != HPDF_OK)
+            return ret;
+
+        fontdef->x_height = (HPDF_UINT16)((HPDF_INT32)x_height * 1000 /
+                attr->header.units_per_em);
+        fontdef->cap_height = (HPDF_UINT16)((HPDF_INT32)cap_height * 1000 /
+                attr->header.units_per_em);
+    }
+
     HPDF_PTRACE(("  ParseOS2 CodePageRange1=%08X CodePageRange2=%08X\n",
                 (HPDF_UINT)attr->code_page_range1,
                 (HPDF_UINT)attr->code_page_range2));
@@ -1775,6 +1842,215 @@ ParseOS2  (HPDF_FontDef  fontdef)
 }
 
 
+static HPDF_STATUS
+CopyTableData  (HPDF_FontDef   fontdef,
+                HPDF_UINT      offset,
+                HPDF_UINT      len,
+                HPDF_Stream    stream)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
+    const HPDF_BYTE *src;
+    HPDF_STATUS ret;
+
+    if (len == 0)
+        return HPDF_OK;
+
+    /* a mapped font file is copied straight from the mapping */
+    src = HPDF_MappedReader_GetBufPtr (attr->stream, offset, len);
+    if (src)
+        return HPDF_Stream_Write (stream, src, len);
+
+    if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET))
+            != HPDF_OK)
+        return ret;
+
+    while (len > 0) {
+        HPDF_UINT tmp_len =
+            (len > HPDF_STREAM_BUF_SIZ) ? HPDF_STREAM_BUF_SIZ : len;
+
+        HPDF_MemSet (buf, 0, tmp_len);
+
+        if ((ret = HPDF_Stream_Read (attr->stream, buf, &tmp_len))
+                != HPDF_OK)
+            return ret;
+
+        if ((ret = HPDF_Stream_Write (stream, buf, tmp_len)) != HPDF_OK)
+            return ret;
+
+        len -= tmp_len;
+    }
+
+    return HPDF_OK;
+}
+
+
+/*
+ * Number the used glyphs (including the components of composite glyphs,
+ * which CheckCompositGryph has already marked) consecutively, keeping
+ * their original order so that .notdef stays glyph 0.
+ */
+static HPDF_STATUS
+CreateSubsetGids  (HPDF_FontDef   fontdef)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_UINT16 num_subset_glyphs = 0;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" CreateSubsetGids\n"));
+
+    if (!attr->subset_gids) {
+        attr->subset_gids = HPDF_GetMem (fontdef->mmgr,
+                sizeof (HPDF_UINT16) * attr->num_glyphs);
+        if (!attr->subset_gids)
+            return HPDF_Error_GetCode (fontdef->error);
+    }
+
+    CheckCompositGryph (fontdef, 0);
+
+    for (i = 0; i < attr->num_glyphs; i++) {
+        if (attr->glyph_tbl.flgs[i] == 1)
+            attr->subset_gids[i] = num_subset_glyphs++;
+        else
+            attr->subset_gids[i] = 0;
+    }
+
+    attr->num_subset_glyphs = num_subset_glyphs;
+
+    HPDF_PTRACE ((" CreateSubsetGids num_glyphs=%u num_subset_glyphs=%u\n",
+                attr->num_glyphs, attr->num_subset_glyphs));
+
+    return HPDF_OK;
+}
+
+
+/*
+ * Write a glyph to the subset font. Simple glyphs are copied as-is,
+ * composite glyphs get their component glyph indices renumbered.
+ */
+static HPDF_STATUS
+WriteSubsetGlyph  (HPDF_FontDef   fontdef,
+                   HPDF_UINT      offset,
+                   HPDF_UINT      len,
+                   HPDF_Stream    stream)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    const HPDF_BYTE *src;
+    HPDF_BYTE *glyph;
+    HPDF_UINT pos = 10;
+    HPDF_UINT16 flags;
+    HPDF_STATUS ret;
+    const HPDF_UINT16 ARG_1_AND_2_ARE_WORDS = 1;
+    const HPDF_UINT16 WE_HAVE_A_SCALE  = 8;
+    const HPDF_UINT16 MORE_COMPONENTS = 32;
+    const HPDF_UINT16 WE_HAVE_AN_X_AND_Y_SCALE = 64;
+    const HPDF_UINT16 WE_HAVE_A_TWO_BY_TWO = 128;
+
+    if (len < 10)
+        return CopyTableData (fontdef, offset, len, stream);
+
+    src = HPDF_MappedReader_GetBufPtr (attr->stream, offset, len);
+    if (src) {
+        if ((src[0] & 0x80) == 0)
+            return HPDF_Stream_Write (stream, src, len);
+    } else {
+        HPDF_INT16 num_of_contours;
+
+        if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET))
+                != HPDF_OK)
+            return ret;
+
+        if ((ret = GetINT16 (attr->stream, &num_of_contours)) != HPDF_OK)
+            return ret;
+
+        if (num_of_contours >= 0)
+            return CopyTableData (fontdef, offset, len, stream);
+    }
+
+    glyph = HPDF_GetMem (fontdef->mmgr, len);
+    if (!glyph)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    if (src) {
+        HPDF_MemCpy (glyph, src, len);
+    } else {
+        HPDF_UINT siz = len;
+
+        if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET))
+                != HPDF_OK ||
+                (ret = HPDF_Stream_Read (attr->stream, glyph, &siz))
+                != HPDF_OK) {
+            HPDF_FreeMem (fontdef->mmgr, glyph);
+            return ret;
+        }
+    }
+
+    do {
+        HPDF_UINT16 gid;
+
+        if (pos + 4 > len)
+            break;
+
+        flags = (HPDF_UINT16)(glyph[pos] << 8 | glyph[pos + 1]);
+        gid = (HPDF_UINT16)(glyph[pos + 2] << 8 | glyph[pos + 3]);
+
+        if (gid < attr->num_glyphs)
+            gid = attr->subset_gids[gid];
+
+        glyph[pos + 2] = (HPDF_BYTE)(gid >> 8);
+        glyph[pos + 3] = (HPDF_BYTE)gid;
+        pos += 4;
+
+        pos += (flags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2;
+
+        if (flags & WE_HAVE_A_SCALE)
+            pos += 2;
+        else if (flags & WE_HAVE_AN_X_AND_Y_SCALE)
+            pos += 4;
+        else if (flags & WE_HAVE_A_TWO_BY_TWO)
+            pos += 8;
+    } while (flags & MORE_COMPONENTS);
+
+    ret = HPDF_Stream_Write (stream, glyph, len);
+
+    HPDF_FreeMem (fontdef->mmgr, glyph);
+
+    return ret;
+}
+
+
+/*
+ * The glyphs of a subsetted font are only addressed through the
+ * CIDToGIDMap, so the cmap is reduced to an empty (3, 1) format 4 table.
+ */
+static HPDF_STATUS
+WriteSubsetCMap  (HPDF_Stream   stream)
+{
+    HPDF_STATUS ret = HPDF_OK;
+
+    ret += WriteUINT16 (stream, 0);        /* version */
+    ret += WriteUINT16 (stream, 1);        /* numTables */
+    ret += WriteUINT16 (stream, 3);        /* platformID */
+    ret += WriteUINT16 (stream, 1);        /* encodingID */
+    ret += WriteUINT32 (stream, 12);       /* offset */
+
+    ret += WriteUINT16 (stream, 4);        /* format */
+    ret += WriteUINT16 (stream, 24);       /* length */
+    ret += WriteUINT16 (stream, 0);        /* language */
+    ret += WriteUINT16 (stream, 2);        /* segCountX2 */
+    ret += WriteUINT16 (stream, 2);        /* searchRange */
+    ret += WriteUINT16 (stream, 0);        /* entrySelector */
+    ret += WriteUINT16 (stream, 0);        /* rangeShift */
+    ret += WriteUINT16 (stream, 0xFFFF);   /* endCount */
+    ret += WriteUINT16 (stream, 0);        /* reservedPad */
+    ret += WriteUINT16 (stream, 0xFFFF);   /* startCount */
+    ret += WriteUINT16 (stream, 1);        /* idDelta */
+    ret += WriteUINT16 (stream, 0);        /* idRangeOffset */
+
+    return ret;
+}
+
+
 static HPDF_STATUS
 RecreateGLYF  (HPDF_FontDef   fontdef,
                HPDF_UINT32   *new_offsets,
@@ -1783,66 +2059,54 @@ RecreateGLYF  (HPDF_FontDef   fontdef,
     HPDF_UINT32 save_offset = 0;
     HPDF_UINT32 start_offset = stream->size;
     HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_UINT num_glyphs = attr->subset_gids ? attr->num_subset_glyphs :
+                attr->num_glyphs;
     HPDF_STATUS ret;
     HPDF_INT i;
 
     HPDF_PTRACE ((" RecreateGLYF\n"));
 
     for (i = 0; i < attr->num_glyphs; i++) {
-        HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
-
         if (attr->glyph_tbl.flgs[i] == 1) {
             HPDF_UINT offset = attr->glyph_tbl.offsets[i];
             HPDF_UINT len = attr->glyph_tbl.offsets[i + 1] - offset;
+            HPDF_UINT new_gid = attr->subset_gids ? attr->subset_gids[i] : i;
 
-            new_offsets[i] = stream->size - start_offset;
+            new_offsets[new_gid] = stream->size - start_offset;
             if (attr->header.index_to_loc_format == 0) {
-                new_offsets[i] /= 2;
+                new_offsets[new_gid] /= 2;
                 len *= 2;
             }
 
             HPDF_PTRACE((" RecreateGLYF[%u] move from [%u] to [%u]\n", i,
                         (HPDF_UINT)attr->glyph_tbl.base_offset + offset,
-                        (HPDF_UINT)new_offsets[i]));
+                        (HPDF_UINT)new_offsets[new_gid]));
 
             if (attr->header.index_to_loc_format == 0)
                 offset *= 2;
 
             offset += attr->glyph_tbl.base_offset;
 
-            if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET))
-                    != HPDF_OK)
-                return ret;
+            if (attr->subset_gids)
+                ret = WriteSubsetGlyph (fontdef, offset, len, stream);
+            else
+                ret = CopyTableData (fontdef, offset, len, stream);
 
-            while (len > 0) {
-                HPDF_UINT tmp_len =
-                    (len > HPDF_STREAM_BUF_SIZ) ? HPDF_STREAM_BUF_SIZ : len;
-
-                HPDF_MemSet (buf, 0, tmp_len);
-
-                if ((ret = HPDF_Stream_Read (attr->stream, buf, &tmp_len))
-                        != HPDF_OK)
-                    return ret;
-
-                if ((ret = HPDF_Stream_Write (stream, buf, tmp_len)) !=
-                        HPDF_OK)
-                    return ret;
-
-                len -= tmp_len;
-            }
+            if (ret != HPDF_OK)
+                return ret;
 
             save_offset = stream->size - start_offset;
             if (attr->header.index_to_loc_format == 0)
                 save_offset /= 2;
-        } else {
+        } else if (!attr->subset_gids) {
             new_offsets[i] = save_offset;
         }
     }
 
-    new_offsets[attr->num_glyphs] = save_offset;
+    new_offsets[num_glyphs] = save_offset;
 
 #ifdef DEBUG
-    for (i = 0; i <= attr->num_glyphs; i++) {
+    for (i = 0; i <= (HPDF_INT)num_glyphs; i++) {
         HPDF_PTRACE((" RecreateGLYF[%u] offset=%u\n", i, new_offsets[i]));
     }
 #endif
@@ -1879,8 +2143,6 @@ RecreateName  (HPDF_FontDef   fontdef,
     name_rec = attr->name_tbl.name_records;
     for (i = 0; i < attr->name_tbl.count; i++) {
         HPDF_UINT name_len = name_rec->length;
-        HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
-        HPDF_UINT tmp_len = name_len;
         HPDF_UINT offset = tbl->offset + attr->name_tbl.string_offset +
                 name_rec->offset;
         HPDF_UINT rec_offset = tmp_stream->size;
@@ -1905,28 +2167,15 @@ RecreateName  (HPDF_FontDef   fontdef,
         ret += WriteUINT16 (stream, (HPDF_UINT16)name_len);
         ret += WriteUINT16 (stream, (HPDF_UINT16)rec_offset);
 
-        ret += HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET);
-
         if (ret != HPDF_OK) {
             HPDF_Stream_Free (tmp_stream);
             return HPDF_Error_GetCode (fontdef->error);
         }
 
-        while (tmp_len > 0) {
-            HPDF_UINT len = (tmp_len > HPDF_STREAM_BUF_SIZ) ?
-                    HPDF_STREAM_BUF_SIZ : tmp_len;
-
-            if ((ret = HPDF_Stream_Read (attr->stream, buf, &len)) != HPDF_OK) {
-                HPDF_Stream_Free (tmp_stream);
-                return ret;
-            }
-
-            if ((ret = HPDF_Stream_Write (tmp_stream, buf, len)) != HPDF_OK) {
-                HPDF_Stream_Free (tmp_stream);
-                return ret;
-            }
-
-            tmp_len -= len;
+        if ((ret = CopyTableData (fontdef, offset, name_rec->length,
+                        tmp_stream)) != HPDF_OK) {
+            HPDF_Stream_Free (tmp_stream);
+            return ret;
         }
 
         HPDF_PTRACE((" RecreateNAME name_rec[%u] platform_id=%u "
@@ -2002,12 +2251,20 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
     HPDF_STATUS ret;
     HPDF_UINT32 offset_base;
     HPDF_UINT32 tmp_check_sum = 0xB1B0AFBA;
+    HPDF_UINT num_glyphs = attr->num_glyphs;
     HPDF_TTFTable emptyTable;
     emptyTable.length = 0;
     emptyTable.offset = 0;
 
     HPDF_PTRACE ((" SaveFontData\n"));
 
+    if (!attr->keep_gids) {
+        if ((ret = CreateSubsetGids (fontdef)) != HPDF_OK)
+            return ret;
+
+        num_glyphs = attr->num_subset_glyphs;
+    }
+
     ret = WriteUINT32 (stream, attr->offset_tbl.sfnt_version);
     ret += WriteUINT16 (stream, HPDF_REQUIRED_TAGS_COUNT);
     ret += WriteUINT16 (stream, attr->offset_tbl.search_range);
@@ -2065,28 +2322,40 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
 
             HPDF_MemSet (&value, 0, 4);
             pmetric=attr->h_metric;
-            for (j = 0; j < attr->num_h_metric; j++) {
-                // write all the used glyphs and write the last metric in the hMetrics array
-                if (attr->glyph_tbl.flgs[j] == 1 || j == (HPDF_UINT) (attr->num_h_metric - 1)) {
-                    ret += WriteUINT16 (tmp_stream, pmetric->advance_width);
-                    ret += WriteINT16 (tmp_stream, pmetric->lsb);
+
+            if (attr->subset_gids) {
+                /* a subsetted font gets a full metric for every glyph */
+                for (j = 0; j < attr->num_glyphs; j++) {
+                    if (attr->glyph_tbl.flgs[j] == 1) {
+                        ret += WriteUINT16 (tmp_stream, pmetric->advance_width);
+                        ret += WriteINT16 (tmp_stream, pmetric->lsb);
+                    }
+                    pmetric++;
                 }
-                else
-                {
-                    ret += WriteUINT16 (tmp_stream, (HPDF_UINT16) value);
-                    ret += WriteINT16 (tmp_stream, (HPDF_INT16) value);
+            } else {
+                for (j = 0; j < attr->num_h_metric; j++) {
+                    // write all the used glyphs and write the last metric in the hMetrics array
+                    if (attr->glyph_tbl.flgs[j] == 1 || j == (HPDF_UINT) (attr->num_h_metric - 1)) {
+                        ret += WriteUINT16 (tmp_stream, pmetric->advance_width);
+                        ret += WriteINT16 (tmp_stream, pmetric->lsb);
+                    }
+                    else
+                    {
+                        ret += WriteUINT16 (tmp_stream, (HPDF_UINT16) value);
+                        ret += WriteINT16 (tmp_stream, (HPDF_INT16) value);
+                    }
+                    pmetric++;
                 }
-                pmetric++;
-            }
 
-            while (j < attr->num_glyphs) {
-                if (attr->glyph_tbl.flgs[j] == 1) {
-                    ret += WriteINT16 (tmp_stream, pmetric->lsb);
+                while (j < attr->num_glyphs) {
+                    if (attr->glyph_tbl.flgs[j] == 1) {
+                        ret += WriteINT16 (tmp_stream, pmetric->lsb);
+                    }
+                    else
+                        ret += WriteINT16 (tmp_stream, (HPDF_INT16) value);
+                    pmetric++;
+                    j++;
                 }
-                else
-                    ret += WriteINT16 (tmp_stream, (HPDF_INT16) value);
-                pmetric++;
-                j++;
             }
         } else if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"loca", 4) == 0) {
             HPDF_UINT j;
@@ -2095,23 +2364,39 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
             poffset = new_offsets;
 
             if (attr->header.index_to_loc_format == 0) {
-                for (j = 0; j <= attr->num_glyphs; j++) {
+                for (j = 0; j <= num_glyphs; j++) {
                     ret += WriteUINT16 (tmp_stream, (HPDF_UINT16)*poffset);
                     poffset++;
                 }
             } else {
-                for (j = 0; j <= attr->num_glyphs; j++) {
+                for (j = 0; j <= num_glyphs; j++) {
                     ret += WriteUINT32 (tmp_stream, *poffset);
                     poffset++;
                 }
             }
         } else if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"name", 4) == 0) {
             ret = RecreateName (fontdef, tmp_stream);
+        } else if (attr->subset_gids &&
+                HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"cmap", 4) == 0) {
+            ret = WriteSubsetCMap (tmp_stream);
+        } else if (attr->subset_gids && length >= 6 &&
+                HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"maxp", 4) == 0) {
+            /* numGlyphs */
+            ret = CopyTableData (fontdef, tbl->offset, 4, tmp_stream);
+            ret += WriteUINT16 (tmp_stream, attr->num_subset_glyphs);
+            ret += CopyTableData (fontdef, tbl->offset + 6, length - 6,
+                    tmp_stream);
+        } else if (attr->subset_gids && length >= 36 &&
+                HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"hhea", 4) == 0) {
+            /* numberOfHMetrics */
+            ret = CopyTableData (fontdef, tbl->offset, 34, tmp_stream);
+            ret += WriteUINT16 (tmp_stream, attr->num_subset_glyphs);
+            ret += CopyTableData (fontdef, tbl->offset + 36, length - 36,
+                    tmp_stream);
         } else if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"post", 4) == 0) {
-            value=0x00030000;
-            ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4);
+            ret = WriteUINT32 (tmp_stream, 0x00030000); // version 3.0
             HPDF_MemSet (&value, 0, 4);
-            ret = HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // italicAngle
+            ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // italicAngle
             ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // underlinePosition + underlineThickness
             ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // isFixedPitch
             ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // minMemType42 
@@ -2119,20 +2404,7 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
             ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // minMemType1
             ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, 4); // maxMemType1 
         } else {
-            HPDF_UINT size = 4;
-
-            while (length > 4) {
-                value = 0;
-                size = 4;
-                ret = HPDF_Stream_Read (attr->stream, (HPDF_BYTE *)&value, &size);
-                ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, size);
-                length -= 4;
-            }
-
-            value = 0;
-            size = length;
-            ret += HPDF_Stream_Read (attr->stream, (HPDF_BYTE *)&value, &size);
-            ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, size);
+            ret = CopyTableData (fontdef, tbl->offset, length, tmp_stream);
         }
 
         tmp_tbl[i].offset = new_offset;
@@ -2247,6 +2519,87 @@ Exit:
     return ret;
 }
 
+/*
+ * Write the font program into the stream of a FontFile2 dictionary. When
+ * a font cache is attached to the fontdef and a previous document used
+ * the same glyphs, the (already compressed) font program is taken from
+ * the cache instead of being rebuilt.
+ */
+HPDF_STATUS
+HPDF_TTFontDef_SaveFontFile  (HPDF_FontDef   fontdef,
+                              HPDF_Dict      font_data)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_BOOL subset = !attr->keep_gids;
+    HPDF_UINT filter = font_data->filter;
+    HPDF_FontCacheEntry entry;
+    HPDF_BYTE *glyphs;
+    HPDF_UINT glyphs_len;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_SaveFontFile\n"));
+
+    if (!attr->cache)
+        return HPDF_TTFontDef_SaveFontData (fontdef, font_data->stream);
+
+    /* the glyph-usage must be complete before it is used as the key. */
+    if (subset && (ret = CreateSubsetGids (fontdef)) != HPDF_OK)
+        return ret;
+
+    glyphs_len = (attr->num_glyphs + 7) / 8;
+    glyphs = HPDF_GetMem (fontdef->mmgr, glyphs_len);
+    if (!glyphs)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    HPDF_MemSet (glyphs, 0, glyphs_len);
+    for (i = 0; i < attr->num_glyphs; i++) {
+        if (attr->glyph_tbl.flgs[i] == 1)
+            glyphs[i / 8] |= (HPDF_BYTE)(0x80 >> (i % 8));
+    }
+
+    entry = HPDF_FontCache_Find (attr->cache, fontdef, subset, filter,
+            glyphs, glyphs_len);
+
+    if (entry) {
+        HPDF_PTRACE ((" HPDF_TTFontDef_SaveFontFile cache hit len=%u\n",
+                    entry->len));
+
+        ret = HPDF_Stream_Write (font_data->stream, entry->data, entry->len);
+        attr->length1 = entry->length1;
+    } else {
+        ret = HPDF_TTFontDef_SaveFontData (fontdef, font_data->stream);
+
+        /* compress the font program here, so that it can be cached. */
+        if (ret == HPDF_OK && (filter & HPDF_STREAM_FILTER_FLATE_DECODE)) {
+            HPDF_Stream stream = HPDF_MemStream_New (fontdef->mmgr,
+                    HPDF_STREAM_BUF_SIZ);
+
+            if (!stream)
+                ret = HPDF_Error_GetCode (fontdef->error);
+            else if ((ret = HPDF_Stream_WriteToStream (font_data->stream,
+                        stream, filter, NULL)) != HPDF_OK)
+                HPDF_Stream_Free (stream);
+            else {
+                HPDF_Stream_Free (font_data->stream);
+                font_data->stream = stream;
+            }
+        }
+
+        if (ret == HPDF_OK)
+            ret = HPDF_FontCache_Add (attr->cache, fontdef, subset, filter,
+                    glyphs, glyphs_len, font_data->stream, attr->length1);
+    }
+
+    if (ret == HPDF_OK && (filter & HPDF_STREAM_FILTER_FLATE_DECODE))
+        font_data->filter |= HPDF_STREAM_FILTER_PREENCODED;
+
+    HPDF_FreeMem (fontdef->mmgr, glyphs);
+
+    return ret;
+}
+
+
 void
 HPDF_TTFontDef_SetTagName  (HPDF_FontDef   fontdef,
                             char     *tag)
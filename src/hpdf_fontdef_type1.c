@@ -37,11 +37,42 @@ LoadAfm (HPDF_FontDef  fontdef,
          HPDF_Stream   stream);
 
 
+static HPDF_STATUS
+LoadMetrics  (HPDF_FontDef  fontdef,
+              HPDF_Stream   stream);
+
+
+static HPDF_UINT16
+GetUINT16  (const HPDF_BYTE  *p);
+
+
+static HPDF_UINT32
+GetUINT32  (const HPDF_BYTE  *p);
+
+
+static void
+PutUINT16  (HPDF_BYTE    *p,
+            HPDF_UINT16  value);
+
+
+static void
+PutUINT32  (HPDF_BYTE    *p,
+            HPDF_UINT32  value);
+
+
 static HPDF_STATUS
 LoadFontData (HPDF_FontDef  fontdef,
               HPDF_Stream   stream);
 
 
+/* signature of a precompiled metrics file (see HPDF_Type1FontDef_SaveMetrics)
+ */
+static const HPDF_BYTE METRICS_SIG[8] = {'H', 'P', 'D', 'F', 'A', 'F', 'M', 1};
+
+#define METRICS_HEADER_SIZ  34
+#define METRICS_WIDTH_SIZ   6
+
+
 /*---------------------------------------------------------------------------*/
 
 static void
@@ -51,8 +82,10 @@ FreeWidth  (HPDF_FontDef  fontdef)
 
     HPDF_PTRACE ((" FreeWidth\n"));
 
-    HPDF_FreeMem (fontdef->mmgr, attr->widths);
+    if (!attr->widths_shared)
+        HPDF_FreeMem (fontdef->mmgr, attr->widths);
     attr->widths = NULL;
+    attr->widths_shared = HPDF_FALSE;
 
     fontdef->valid = HPDF_FALSE;
 }
@@ -295,6 +328,155 @@ LoadAfm (HPDF_FontDef  fontdef,
 }
 
 
+/*
+ *  LoadMetrics
+ *
+ *  Load a metrics file written by HPDF_Type1FontDef_SaveMetrics. The
+ *  signature has already been read from the stream. All values are stored
+ *  in big-endian byte order, so the file can be shared between platforms.
+ */
+static HPDF_STATUS
+LoadMetrics  (HPDF_FontDef  fontdef,
+              HPDF_Stream   stream)
+{
+    HPDF_Type1FontDefAttr attr = (HPDF_Type1FontDefAttr)fontdef->attr;
+    HPDF_BYTE buf[METRICS_HEADER_SIZ];
+    HPDF_BYTE *p;
+    HPDF_UINT len;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" LoadMetrics\n"));
+
+    len = METRICS_HEADER_SIZ;
+    if (HPDF_Stream_Read (stream, buf, &len) != HPDF_OK)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 1);
+
+    fontdef->flags = GetUINT32 (buf);
+    fontdef->ascent = (HPDF_INT16)GetUINT16 (buf + 4);
+    fontdef->descent = (HPDF_INT16)GetUINT16 (buf + 6);
+    fontdef->italic_angle = (HPDF_INT16)GetUINT16 (buf + 8);
+    fontdef->font_bbox.left = (HPDF_REAL)(HPDF_INT16)GetUINT16 (buf + 10);
+    fontdef->font_bbox.bottom = (HPDF_REAL)(HPDF_INT16)GetUINT16 (buf + 12);
+    fontdef->font_bbox.right = (HPDF_REAL)(HPDF_INT16)GetUINT16 (buf + 14);
+    fontdef->font_bbox.top = (HPDF_REAL)(HPDF_INT16)GetUINT16 (buf + 16);
+    fontdef->stemv = GetUINT16 (buf + 18);
+    fontdef->stemh = GetUINT16 (buf + 20);
+    fontdef->x_height = GetUINT16 (buf + 22);
+    fontdef->cap_height = GetUINT16 (buf + 24);
+    fontdef->missing_width = (HPDF_INT16)GetUINT16 (buf + 26);
+    attr->leading = (HPDF_INT16)GetUINT16 (buf + 28);
+    attr->widths_count = GetUINT32 (buf + 30);
+
+    /* FontName and EncodingScheme */
+    len = 1;
+    if (HPDF_Stream_Read (stream, buf, &len) != HPDF_OK ||
+            buf[0] > HPDF_LIMIT_MAX_NAME_LEN)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 2);
+
+    len = buf[0];
+    if (len > 0 && HPDF_Stream_Read (stream, (HPDF_BYTE *)fontdef->base_font,
+                &len) != HPDF_OK)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 2);
+    fontdef->base_font[len] = 0;
+
+    len = 1;
+    if (HPDF_Stream_Read (stream, buf, &len) != HPDF_OK ||
+            buf[0] > HPDF_LIMIT_MAX_NAME_LEN)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 3);
+
+    len = buf[0];
+    if (len > 0 && HPDF_Stream_Read (stream,
+                (HPDF_BYTE *)attr->encoding_scheme, &len) != HPDF_OK)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 3);
+    attr->encoding_scheme[len] = 0;
+
+    /* CharacterSet */
+    len = 2;
+    if (HPDF_Stream_Read (stream, buf, &len) != HPDF_OK)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 4);
+
+    len = GetUINT16 (buf);
+    if (len > 0) {
+        attr->char_set = HPDF_GetMem (fontdef->mmgr, len + 1);
+        if (!attr->char_set)
+            return HPDF_Error_GetCode (fontdef->error);
+
+        if (HPDF_Stream_Read (stream, (HPDF_BYTE *)attr->char_set, &len) !=
+                HPDF_OK)
+            return HPDF_SetError (fontdef->error, HPDF_INVALID_AFM_HEADER, 4);
+        attr->char_set[len] = 0;
+    }
+
+    /* CharMetrics are read in one block directly into the widths array and
+     * then converted in place. the conversion runs backwards, because an
+     * element of HPDF_CharData is never smaller than a stored record.
+     */
+    if (attr->widths_count == 0 ||
+            attr->widths_count > HPDF_LIMIT_MAX_ARRAY)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_CHAR_MATRICS_DATA,
+                1);
+
+    attr->widths = HPDF_GetMem (fontdef->mmgr,
+            sizeof(HPDF_CharData) * attr->widths_count);
+    if (!attr->widths)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    len = METRICS_WIDTH_SIZ * attr->widths_count;
+    if (HPDF_Stream_Read (stream, (HPDF_BYTE *)attr->widths, &len) != HPDF_OK)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_CHAR_MATRICS_DATA,
+                1);
+
+    p = (HPDF_BYTE *)attr->widths + len;
+    for (i = attr->widths_count; i > 0; i--) {
+        HPDF_CharData cdata;
+
+        p -= METRICS_WIDTH_SIZ;
+        cdata.char_cd = (HPDF_INT16)GetUINT16 (p);
+        cdata.unicode = GetUINT16 (p + 2);
+        cdata.width = (HPDF_INT16)GetUINT16 (p + 4);
+        attr->widths[i - 1] = cdata;
+    }
+
+    return HPDF_OK;
+}
+
+
+static HPDF_UINT16
+GetUINT16  (const HPDF_BYTE  *p)
+{
+    return (HPDF_UINT16)((p[0] << 8) | p[1]);
+}
+
+
+static HPDF_UINT32
+GetUINT32  (const HPDF_BYTE  *p)
+{
+    return ((HPDF_UINT32)p[0] << 24) | ((HPDF_UINT32)p[1] << 16) |
+            ((HPDF_UINT32)p[2] << 8) | (HPDF_UINT32)p[3];
+}
+
+
+static void
+PutUINT16  (HPDF_BYTE    *p,
+            HPDF_UINT16  value)
+{
+    p[0] = (HPDF_BYTE)(value >> 8);
+    p[1] = (HPDF_BYTE)value;
+}
+
+
+static void
+PutUINT32  (HPDF_BYTE    *p,
+            HPDF_UINT32  value)
+{
+    p[0] = (HPDF_BYTE)(value >> 24);
+    p[1] = (HPDF_BYTE)(value >> 16);
+    p[2] = (HPDF_BYTE)(value >> 8);
+    p[3] = (HPDF_BYTE)value;
+}
+
+
+
 static HPDF_STATUS
 LoadFontData (HPDF_FontDef  fontdef,
               HPDF_Stream   stream)
@@ -381,6 +563,8 @@ HPDF_Type1FontDef_Load  (HPDF_MMgr         mmgr,
                          HPDF_Stream       font_data)
 {
     HPDF_FontDef fontdef;
+    HPDF_BYTE sig[sizeof(METRICS_SIG)];
+    HPDF_UINT len = sizeof(METRICS_SIG);
     HPDF_STATUS ret;
 
     HPDF_PTRACE ((" HPDF_Type1FontDef_Load\n"));
@@ -393,7 +577,13 @@ HPDF_Type1FontDef_Load  (HPDF_MMgr         mmgr,
     if (!fontdef)
         return NULL;
 
-    ret = LoadAfm (fontdef, afm);
+    /* the metrics are either a precompiled metrics file or an AFM file. */
+    if (HPDF_Stream_Read (afm, sig, &len) == HPDF_OK &&
+            HPDF_MemCmp (sig, METRICS_SIG, sizeof(METRICS_SIG)) == 0)
+        ret = LoadMetrics (fontdef, afm);
+    else if ((ret = HPDF_Stream_Seek (afm, 0, HPDF_SEEK_SET)) == HPDF_OK)
+        ret = LoadAfm (fontdef, afm);
+
     if (ret != HPDF_OK) {
         HPDF_FontDef_Free (fontdef);
         return NULL;
@@ -411,6 +601,93 @@ HPDF_Type1FontDef_Load  (HPDF_MMgr         mmgr,
     return fontdef;
 }
 
+
+/*
+ *  HPDF_Type1FontDef_SaveMetrics
+ *
+ *  Write the metrics of a Type1 font to a binary file, which can be loaded
+ *  by HPDF_Type1FontDef_Load instead of the AFM file without parsing.
+ *
+ *  fontdef : Pointer to a Type1 HPDF_FontDef object.
+ *  stream : Pointer to a HPDF_Stream object.
+ */
+HPDF_STATUS
+HPDF_Type1FontDef_SaveMetrics  (HPDF_FontDef  fontdef,
+                                HPDF_Stream   stream)
+{
+    HPDF_Type1FontDefAttr attr = (HPDF_Type1FontDefAttr)fontdef->attr;
+    HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
+    HPDF_UINT len;
+    HPDF_UINT i;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_Type1FontDef_SaveMetrics\n"));
+
+    if (fontdef->type != HPDF_FONTDEF_TYPE_TYPE1 || !attr->widths)
+        return HPDF_SetError (fontdef->error, HPDF_INVALID_FONTDEF_TYPE, 0);
+
+    HPDF_MemCpy (buf, METRICS_SIG, sizeof(METRICS_SIG));
+    PutUINT32 (buf + 8, (HPDF_UINT32)fontdef->flags);
+    PutUINT16 (buf + 12, (HPDF_UINT16)fontdef->ascent);
+    PutUINT16 (buf + 14, (HPDF_UINT16)fontdef->descent);
+    PutUINT16 (buf + 16, (HPDF_UINT16)fontdef->italic_angle);
+    PutUINT16 (buf + 18, (HPDF_UINT16)(HPDF_INT16)fontdef->font_bbox.left);
+    PutUINT16 (buf + 20, (HPDF_UINT16)(HPDF_INT16)fontdef->font_bbox.bottom);
+    PutUINT16 (buf + 22, (HPDF_UINT16)(HPDF_INT16)fontdef->font_bbox.right);
+    PutUINT16 (buf + 24, (HPDF_UINT16)(HPDF_INT16)fontdef->font_bbox.top);
+    PutUINT16 (buf + 26, fontdef->stemv);
+    PutUINT16 (buf + 28, fontdef->stemh);
+    PutUINT16 (buf + 30, fontdef->x_height);
+    PutUINT16 (buf + 32, fontdef->cap_height);
+    PutUINT16 (buf + 34, (HPDF_UINT16)fontdef->missing_width);
+    PutUINT16 (buf + 36, (HPDF_UINT16)attr->leading);
+    PutUINT32 (buf + 38, attr->widths_count);
+    len = sizeof(METRICS_SIG) + METRICS_HEADER_SIZ;
+
+    buf[len] = (HPDF_BYTE)HPDF_StrLen (fontdef->base_font,
+            HPDF_LIMIT_MAX_NAME_LEN);
+    HPDF_MemCpy (buf + len + 1, (HPDF_BYTE *)fontdef->base_font, buf[len]);
+    len += buf[len] + 1;
+
+    buf[len] = (HPDF_BYTE)HPDF_StrLen (attr->encoding_scheme,
+            HPDF_LIMIT_MAX_NAME_LEN);
+    HPDF_MemCpy (buf + len + 1, (HPDF_BYTE *)attr->encoding_scheme, buf[len]);
+    len += buf[len] + 1;
+
+    i = attr->char_set ? HPDF_StrLen (attr->char_set,
+            HPDF_LIMIT_MAX_STRING_LEN) : 0;
+    PutUINT16 (buf + len, (HPDF_UINT16)i);
+    len += 2;
+
+    if ((ret = HPDF_Stream_Write (stream, buf, len)) != HPDF_OK)
+        return ret;
+
+    if (i > 0 && (ret = HPDF_Stream_Write (stream,
+                (HPDF_BYTE *)attr->char_set, i)) != HPDF_OK)
+        return ret;
+
+    len = 0;
+    for (i = 0; i < attr->widths_count; i++) {
+        HPDF_CharData *cdata = attr->widths + i;
+
+        PutUINT16 (buf + len, (HPDF_UINT16)cdata->char_cd);
+        PutUINT16 (buf + len + 2, cdata->unicode);
+        PutUINT16 (buf + len + 4, (HPDF_UINT16)cdata->width);
+        len += METRICS_WIDTH_SIZ;
+
+        if (len + METRICS_WIDTH_SIZ > HPDF_STREAM_BUF_SIZ) {
+            if ((ret = HPDF_Stream_Write (stream, buf, len)) != HPDF_OK)
+                return ret;
+            len = 0;
+        }
+    }
+
+    if (len > 0)
+        return HPDF_Stream_Write (stream, buf, len);
+
+    return HPDF_OK;
+}
+
 HPDF_FontDef
 HPDF_Type1FontDef_Duplicate  (HPDF_MMgr     mmgr,
                               HPDF_FontDef  src)
@@ -472,6 +749,36 @@ HPDF_Type1FontDef_SetWidths  (HPDF_FontDef          fontdef,
 }
 
 
+/* use the widths table in place instead of copying it. the table must stay
+ * valid and unchanged while the fontdef exists (e.g. the builtin tables of
+ * the base14 fonts, which are shared by all documents of the process).
+ */
+HPDF_STATUS
+HPDF_Type1FontDef_SetSharedWidths  (HPDF_FontDef          fontdef,
+                                    const HPDF_CharData*  widths)
+{
+    HPDF_Type1FontDefAttr attr = (HPDF_Type1FontDefAttr)fontdef->attr;
+    const HPDF_CharData* src = widths;
+
+    HPDF_PTRACE ((" HPDF_Type1FontDef_SetSharedWidths\n"));
+
+    FreeWidth (fontdef);
+
+    attr->widths = (HPDF_CharData*)widths;
+    attr->widths_shared = HPDF_TRUE;
+    attr->widths_count = 0;
+
+    while (src->unicode != 0xFFFF) {
+        if (src->unicode == 0x0020)
+            fontdef->missing_width = src->width;
+        src++;
+        attr->widths_count++;
+    }
+
+    return HPDF_OK;
+}
+
+
 HPDF_INT16
 HPDF_Type1FontDef_GetWidthByName  (HPDF_FontDef      fontdef,
                                    const char*  gryph_name)
@@ -516,7 +823,8 @@ FreeFunc (HPDF_FontDef  fontdef)
     if (attr->font_data)
         HPDF_Stream_Free (attr->font_data);
 
-    HPDF_FreeMem (fontdef->mmgr, attr->widths);
+    if (!attr->widths_shared)
+        HPDF_FreeMem (fontdef->mmgr, attr->widths);
     HPDF_FreeMem (fontdef->mmgr, attr);
 }
 
@@ -30,6 +30,163 @@ LoadJpegHeader (HPDF_Image   image,
 
 /*---------------------------------------------------------------------------*/
 
+typedef struct _HPDF_ImageSource_Rec  *HPDF_ImageSource;
+
+typedef struct _HPDF_ImageSource_Rec {
+    HPDF_Image_LoadDataFunc  load_fn;
+    void                     *param;
+    HPDF_UINT                param_len;
+} HPDF_ImageSource_Rec;
+
+
+static HPDF_STATUS
+DelayedLoading_BeforeWrite  (HPDF_Dict  obj)
+{
+    HPDF_ImageSource src = (HPDF_ImageSource)obj->attr;
+
+    HPDF_PTRACE ((" DelayedLoading_BeforeWrite\n"));
+
+    HPDF_MemStream_FreeData (obj->stream);
+
+    return src->load_fn (obj, src->param);
+}
+
+
+static HPDF_STATUS
+DelayedLoading_AfterWrite  (HPDF_Dict  obj)
+{
+    HPDF_PTRACE ((" DelayedLoading_AfterWrite\n"));
+
+    HPDF_MemStream_FreeData (obj->stream);
+
+    return HPDF_OK;
+}
+
+
+static void
+DelayedLoading_Free  (HPDF_Dict  obj)
+{
+    HPDF_ImageSource src = (HPDF_ImageSource)obj->attr;
+
+    HPDF_PTRACE ((" DelayedLoading_Free\n"));
+
+    if (!src)
+        return;
+
+    if (src->param)
+        HPDF_FreeMem (obj->mmgr, src->param);
+
+    HPDF_FreeMem (obj->mmgr, src);
+    obj->attr = NULL;
+}
+
+
+/*
+ *  HPDF_Image_SetDelayedLoading
+ *
+ *  The data of the image is not kept in the image object. load_fn is called
+ *  with a copy of param to write the data into the stream of the image just
+ *  before the image is written, and the data is freed again after that. So
+ *  only one image at a time holds its data while the document is saved.
+ *
+ */
+HPDF_STATUS
+HPDF_Image_SetDelayedLoading  (HPDF_Image               image,
+                               HPDF_Image_LoadDataFunc  load_fn,
+                               const void              *param,
+                               HPDF_UINT                param_len)
+{
+    HPDF_ImageSource src;
+
+    HPDF_PTRACE ((" HPDF_Image_SetDelayedLoading\n"));
+
+    /* the source of an image is set only once */
+    if (image->attr)
+        return HPDF_OK;
+
+    src = (HPDF_ImageSource)HPDF_GetMem (image->mmgr,
+            sizeof(HPDF_ImageSource_Rec));
+    if (!src)
+        return HPDF_Error_GetCode (image->error);
+
+    src->load_fn = load_fn;
+    src->param = NULL;
+    src->param_len = param_len;
+
+    if (param_len > 0) {
+        src->param = HPDF_GetMem (image->mmgr, param_len);
+        if (!src->param) {
+            HPDF_FreeMem (image->mmgr, src);
+            return HPDF_Error_GetCode (image->error);
+        }
+
+        HPDF_MemCpy ((HPDF_BYTE *)src->param, (const HPDF_BYTE *)param,
+                param_len);
+    }
+
+    HPDF_MemStream_FreeData (image->stream);
+
+    image->attr = src;
+    image->before_write_fn = DelayedLoading_BeforeWrite;
+    image->after_write_fn = DelayedLoading_AfterWrite;
+    image->free_fn = DelayedLoading_Free;
+
+    return HPDF_OK;
+}
+
+
+/* returns HPDF_FALSE if the data of the image is kept in the image object. */
+HPDF_BOOL
+HPDF_Image_GetDelayedLoading  (HPDF_Image                image,
+                               HPDF_Image_LoadDataFunc  *load_fn,
+                               const void              **param,
+                               HPDF_UINT                *param_len)
+{
+    HPDF_ImageSource src;
+
+    if (image->before_write_fn != DelayedLoading_BeforeWrite || !image->attr)
+        return HPDF_FALSE;
+
+    src = (HPDF_ImageSource)image->attr;
+    *load_fn = src->load_fn;
+    *param = src->param;
+    *param_len = src->param_len;
+
+    return HPDF_TRUE;
+}
+
+
+/*
+ * load the data of a delayed loading image to keep it in the image object,
+ * for the functions which modify the data.
+ */
+HPDF_STATUS
+HPDF_Image_LoadDelayedData  (HPDF_Image  image)
+{
+    HPDF_ImageSource src;
+    HPDF_STATUS ret;
+
+    if (image->before_write_fn != DelayedLoading_BeforeWrite || !image->attr)
+        return HPDF_OK;
+
+    src = (HPDF_ImageSource)image->attr;
+
+    HPDF_MemStream_FreeData (image->stream);
+
+    if ((ret = src->load_fn (image, src->param)) != HPDF_OK) {
+        HPDF_MemStream_FreeData (image->stream);
+        return ret;
+    }
+
+    DelayedLoading_Free (image);
+    image->before_write_fn = NULL;
+    image->after_write_fn = NULL;
+    image->free_fn = NULL;
+
+    return HPDF_OK;
+}
+
+
 static HPDF_STATUS
 LoadJpegHeader (HPDF_Image   image,
                 HPDF_Stream  stream)
@@ -167,16 +324,15 @@ LoadJpegHeader (HPDF_Image   image,
     return HPDF_OK;
 }
 
-HPDF_Image
-HPDF_Image_LoadJpegImage  (HPDF_MMgr        mmgr,
-                           HPDF_Stream      jpeg_data,
-                           HPDF_Xref        xref)
+/* create an image object with the attributes of the jpeg header. */
+static HPDF_Image
+JpegImage_New  (HPDF_MMgr        mmgr,
+                HPDF_Stream      jpeg_data,
+                HPDF_Xref        xref)
 {
     HPDF_Dict image;
     HPDF_STATUS ret = HPDF_OK;
 
-    HPDF_PTRACE ((" HPDF_Image_LoadJpegImage\n"));
-
     image = HPDF_DictStream_New (mmgr, xref);
     if (!image)
         return NULL;
@@ -193,6 +349,23 @@ HPDF_Image_LoadJpegImage  (HPDF_MMgr        mmgr,
     if (LoadJpegHeader (image, jpeg_data) != HPDF_OK)
         return NULL;
 
+    return image;
+}
+
+HPDF_Image
+HPDF_Image_LoadJpegImage  (HPDF_MMgr        mmgr,
+                           HPDF_Stream      jpeg_data,
+                           HPDF_Xref        xref)
+{
+    HPDF_Dict image;
+    HPDF_STATUS ret = HPDF_OK;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJpegImage\n"));
+
+    image = JpegImage_New (mmgr, jpeg_data, xref);
+    if (!image)
+        return NULL;
+
     if (HPDF_Stream_Seek (jpeg_data, 0, HPDF_SEEK_SET) != HPDF_OK)
         return NULL;
 
@@ -221,6 +394,39 @@ HPDF_Image_LoadJpegImage  (HPDF_MMgr        mmgr,
     return image;
 }
 
+/*
+ * the data of the file is not copied into the image, the image refers to
+ * the file and its data is read from it when the document is saved.
+ */
+HPDF_Image
+HPDF_Image_LoadJpegImageFromFile  (HPDF_MMgr    mmgr,
+                                   const char  *filename,
+                                   HPDF_Xref    xref)
+{
+    HPDF_Stream jpeg_data;
+    HPDF_Image image;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJpegImageFromFile\n"));
+
+    jpeg_data = HPDF_DeferredReader_New (mmgr, filename);
+    if (!jpeg_data)
+        return NULL;
+
+    image = JpegImage_New (mmgr, jpeg_data, xref);
+    if (!image) {
+        HPDF_Stream_Free (jpeg_data);
+        return NULL;
+    }
+
+    /* the file is opened again when the image is written */
+    HPDF_DeferredReader_Release (jpeg_data);
+
+    HPDF_Stream_Free (image->stream);
+    image->stream = jpeg_data;
+
+    return image;
+}
+
 HPDF_Image
 HPDF_Image_LoadJpegImageFromMem  (HPDF_MMgr    mmgr,
                             const HPDF_BYTE   *buf,
@@ -252,19 +458,18 @@ HPDF_Image_LoadJpegImageFromMem  (HPDF_MMgr    mmgr,
 }
 
 
-HPDF_Image
-HPDF_Image_LoadRawImage (HPDF_MMgr          mmgr,
-                         HPDF_Stream        raw_data,
-                         HPDF_Xref          xref,
-                         HPDF_UINT          width,
-                         HPDF_UINT          height,
-                         HPDF_ColorSpace    color_space)
+/* create an image object of raw data and get the expected size of it. */
+static HPDF_Image
+RawImage_New  (HPDF_MMgr          mmgr,
+               HPDF_Xref          xref,
+               HPDF_UINT          width,
+               HPDF_UINT          height,
+               HPDF_ColorSpace    color_space,
+               HPDF_UINT          bits_per_component,
+               HPDF_UINT         *size)
 {
     HPDF_Dict image;
     HPDF_STATUS ret = HPDF_OK;
-    HPDF_UINT size;
-
-    HPDF_PTRACE ((" HPDF_Image_LoadRawImage\n"));
 
     if (color_space != HPDF_CS_DEVICE_GRAY &&
             color_space != HPDF_CS_DEVICE_RGB &&
@@ -273,6 +478,12 @@ HPDF_Image_LoadRawImage (HPDF_MMgr          mmgr,
         return NULL;
     }
 
+    if (bits_per_component != 1 && bits_per_component != 2 &&
+            bits_per_component != 4 && bits_per_component != 8) {
+        HPDF_SetError (mmgr->error, HPDF_INVALID_IMAGE, 0);
+        return NULL;
+    }
+
     image = HPDF_DictStream_New (mmgr, xref);
     if (!image)
         return NULL;
@@ -283,15 +494,21 @@ HPDF_Image_LoadRawImage (HPDF_MMgr          mmgr,
     if (ret != HPDF_OK)
         return NULL;
 
-    if (color_space == HPDF_CS_DEVICE_GRAY) {
-        size = width * height;
-        ret = HPDF_Dict_AddName (image, "ColorSpace", COL_GRAY);
-	} else if (color_space == HPDF_CS_DEVICE_CMYK) {
-		size = width * height * 4;
-		ret = HPDF_Dict_AddName (image, "ColorSpace", COL_CMYK);
-    } else {
-        size = width * height * 3;
-        ret = HPDF_Dict_AddName (image, "ColorSpace", COL_RGB);
+    *size = (HPDF_UINT)((HPDF_DOUBLE)width * height / (8 / bits_per_component) + 0.876);
+
+    switch (color_space) {
+        case HPDF_CS_DEVICE_GRAY:
+            ret = HPDF_Dict_AddName (image, "ColorSpace", COL_GRAY);
+            break;
+        case HPDF_CS_DEVICE_RGB:
+            *size *= 3;
+            ret = HPDF_Dict_AddName (image, "ColorSpace", COL_RGB);
+            break;
+        case HPDF_CS_DEVICE_CMYK:
+            *size *= 4;
+            ret = HPDF_Dict_AddName (image, "ColorSpace", COL_CMYK);
+            break;
+        default:;
     }
 
     if (ret != HPDF_OK)
@@ -303,7 +520,29 @@ HPDF_Image_LoadRawImage (HPDF_MMgr          mmgr,
     if (HPDF_Dict_AddNumber (image, "Height", height) != HPDF_OK)
         return NULL;
 
-    if (HPDF_Dict_AddNumber (image, "BitsPerComponent", 8) != HPDF_OK)
+    if (HPDF_Dict_AddNumber (image, "BitsPerComponent", bits_per_component)
+            != HPDF_OK)
+        return NULL;
+
+    return image;
+}
+
+
+HPDF_Image
+HPDF_Image_LoadRawImage (HPDF_MMgr          mmgr,
+                         HPDF_Stream        raw_data,
+                         HPDF_Xref          xref,
+                         HPDF_UINT          width,
+                         HPDF_UINT          height,
+                         HPDF_ColorSpace    color_space)
+{
+    HPDF_Dict image;
+    HPDF_UINT size;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadRawImage\n"));
+
+    image = RawImage_New (mmgr, xref, width, height, color_space, 8, &size);
+    if (!image)
         return NULL;
 
     if (HPDF_Stream_WriteToStream (raw_data, image->stream, 0, NULL) != HPDF_OK)
@@ -318,6 +557,50 @@ HPDF_Image_LoadRawImage (HPDF_MMgr          mmgr,
 }
 
 
+/*
+ * like HPDF_Image_LoadJpegImageFromFile, the pixels are read from the file
+ * when the document is saved.
+ */
+HPDF_Image
+HPDF_Image_LoadRawImageFromFile  (HPDF_MMgr          mmgr,
+                                  const char        *filename,
+                                  HPDF_Xref          xref,
+                                  HPDF_UINT          width,
+                                  HPDF_UINT          height,
+                                  HPDF_ColorSpace    color_space)
+{
+    HPDF_Stream raw_data;
+    HPDF_Dict image;
+    HPDF_UINT size;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadRawImageFromFile\n"));
+
+    raw_data = HPDF_DeferredReader_New (mmgr, filename);
+    if (!raw_data)
+        return NULL;
+
+    /* the file is opened again when the image is written */
+    HPDF_DeferredReader_Release (raw_data);
+
+    image = RawImage_New (mmgr, xref, width, height, color_space, 8, &size);
+    if (!image) {
+        HPDF_Stream_Free (raw_data);
+        return NULL;
+    }
+
+    if (HPDF_Stream_Size (raw_data) != size) {
+        HPDF_Stream_Free (raw_data);
+        HPDF_SetError (image->error, HPDF_INVALID_IMAGE, 0);
+        return NULL;
+    }
+
+    HPDF_Stream_Free (image->stream);
+    image->stream = raw_data;
+
+    return image;
+}
+
+
 HPDF_Image
 HPDF_Image_LoadRawImageFromMem  (HPDF_MMgr          mmgr,
                                  const HPDF_BYTE   *buf,
@@ -328,68 +611,89 @@ HPDF_Image_LoadRawImageFromMem  (HPDF_MMgr          mmgr,
                                  HPDF_UINT          bits_per_component)
 {
     HPDF_Dict image;
-    HPDF_STATUS ret = HPDF_OK;
-    HPDF_UINT size=0;
+    HPDF_UINT size;
 
     HPDF_PTRACE ((" HPDF_Image_LoadRawImageFromMem\n"));
 
-    if (color_space != HPDF_CS_DEVICE_GRAY &&
-            color_space != HPDF_CS_DEVICE_RGB &&
-            color_space != HPDF_CS_DEVICE_CMYK) {
-        HPDF_SetError (mmgr->error, HPDF_INVALID_COLOR_SPACE, 0);
+    image = RawImage_New (mmgr, xref, width, height, color_space,
+            bits_per_component, &size);
+    if (!image)
         return NULL;
-    }
 
-    if (bits_per_component != 1 && bits_per_component != 2 &&
-            bits_per_component != 4 && bits_per_component != 8) {
-        HPDF_SetError (mmgr->error, HPDF_INVALID_IMAGE, 0);
+    if (HPDF_Stream_Write (image->stream, buf, size) != HPDF_OK)
         return NULL;
-    }
 
-    image = HPDF_DictStream_New (mmgr, xref);
-    if (!image)
-        return NULL;
+    return image;
+}
 
-    image->header.obj_class |= HPDF_OSUBCLASS_XOBJECT;
-    ret += HPDF_Dict_AddName (image, "Type", "XObject");
-    ret += HPDF_Dict_AddName (image, "Subtype", "Image");
-    if (ret != HPDF_OK)
-        return NULL;
 
-    switch (color_space) {
-        case HPDF_CS_DEVICE_GRAY:
-            size = (HPDF_UINT)((HPDF_DOUBLE)width * height / (8 / bits_per_component) + 0.876);
-            ret = HPDF_Dict_AddName (image, "ColorSpace", COL_GRAY);
-            break;
-        case HPDF_CS_DEVICE_RGB:
-            size = (HPDF_UINT)((HPDF_DOUBLE)width * height / (8 / bits_per_component) + 0.876);
-            size *= 3;
-            ret = HPDF_Dict_AddName (image, "ColorSpace", COL_RGB);
-            break;
-        case HPDF_CS_DEVICE_CMYK:
-            size = (HPDF_UINT)((HPDF_DOUBLE)width * height / (8 / bits_per_component) + 0.876);
-            size *= 4;
-            ret = HPDF_Dict_AddName (image, "ColorSpace", COL_CMYK);
-            break;
-        default:;
-    }
+/*
+ * the image borrows the buffer of the caller, the data is read from it when
+ * the document is saved. if deflated is HPDF_TRUE, the buffer holds the
+ * pixels compressed by zlib and size is the size of the compressed data.
+ * release_fn is called when the image is freed, or before this function
+ * returns if it fails.
+ */
+HPDF_Image
+HPDF_Image_LoadRawImageFromUserMem  (HPDF_MMgr           mmgr,
+                                     const HPDF_BYTE    *buf,
+                                     HPDF_UINT           size,
+                                     HPDF_Xref           xref,
+                                     HPDF_UINT           width,
+                                     HPDF_UINT           height,
+                                     HPDF_ColorSpace     color_space,
+                                     HPDF_UINT           bits_per_component,
+                                     HPDF_BOOL           deflated,
+                                     HPDF_Release_Func   release_fn,
+                                     void               *user_data)
+{
+    HPDF_Stream raw_data;
+    HPDF_Dict image;
+    HPDF_UINT raw_size;
 
-    if (ret != HPDF_OK)
-        return NULL;
+    HPDF_PTRACE ((" HPDF_Image_LoadRawImageFromUserMem\n"));
 
-    if (HPDF_Dict_AddNumber (image, "Width", width) != HPDF_OK)
+#ifndef LIBHPDF_HAVE_ZLIB
+    /* the filter of the data is not written without zlib */
+    if (deflated) {
+        if (release_fn)
+            release_fn (buf, user_data);
+        HPDF_SetError (mmgr->error, HPDF_UNSUPPORTED_FUNC, 0);
         return NULL;
+    }
+#endif /* LIBHPDF_HAVE_ZLIB */
 
-    if (HPDF_Dict_AddNumber (image, "Height", height) != HPDF_OK)
+    image = RawImage_New (mmgr, xref, width, height, color_space,
+            bits_per_component, &raw_size);
+    if (!image) {
+        if (release_fn)
+            release_fn (buf, user_data);
         return NULL;
+    }
 
-    if (HPDF_Dict_AddNumber (image, "BitsPerComponent", bits_per_component)
-            != HPDF_OK)
+    if (deflated ? size == 0 : size < raw_size) {
+        if (release_fn)
+            release_fn (buf, user_data);
+        HPDF_SetError (image->error, HPDF_INVALID_IMAGE, 0);
         return NULL;
+    }
 
-    if (HPDF_Stream_Write (image->stream, buf, size) != HPDF_OK)
+    /* the rest of the buffer (e.g. the padding for alignment) is not used */
+    if (!deflated)
+        size = raw_size;
+
+    raw_data = HPDF_BorrowedReader_New (mmgr, buf, size, release_fn,
+            user_data);
+    if (!raw_data)
         return NULL;
 
+    HPDF_Stream_Free (image->stream);
+    image->stream = raw_data;
+
+    if (deflated)
+        image->filter = HPDF_STREAM_FILTER_FLATE_DECODE |
+                HPDF_STREAM_FILTER_PREENCODED;
+
     return image;
 }
 
@@ -85,22 +85,17 @@ typedef struct {
 #define    TIFFroundup(x, y) (TIFFhowmany(x,y)*(y))
 
 
-/*
-struct _HPDF_CCITT_Encoder {
-} HPDF_CCITT_Encoder;
-*/
-
 struct _HPDF_CCITT_Data {
     HPDF_Fax3CodecState *tif_data;
+    HPDF_Fax3CodecState tif_state;
 
     HPDF_Stream  dst;
 
     tsize_t        tif_rawdatasize;/* # of bytes in raw data buffer */
     tsize_t        tif_rawcc;    /* bytes unread from raw buffer */
     tidata_t    tif_rawcp;    /* current spot in raw buffer */
-    tidata_t    tif_rawdata;    /* raw data buffer */    
-
-} HPDF_CCITT_Data;
+    tidataval_t    tif_rawdata[HPDF_STREAM_BUF_SIZ];    /* raw data buffer */
+};
 
 static HPDF_STATUS HPDF_InitCCITTFax3(struct _HPDF_CCITT_Data *pData)
 {
@@ -108,14 +103,10 @@ static HPDF_STATUS HPDF_InitCCITTFax3(struct _HPDF_CCITT_Data *pData)
     HPDF_Fax3CodecState* esp;
 
     /*
-     * Allocate state block so tag methods have storage to record values.
+     * The state block is a part of the encoder data, so that nothing has
+     * to be allocated outside of the memory manager of the stream.
      */
-    pData->tif_data = (HPDF_Fax3CodecState *)
-        malloc(sizeof (HPDF_Fax3CodecState));
-
-    if (pData->tif_data == NULL) {
-        return 1;
-    }
+    pData->tif_data = &pData->tif_state;
 
     sp = Fax3State(pData);
     /* sp->rw_mode = pData->tif_mode; */
@@ -140,20 +131,11 @@ static HPDF_STATUS HPDF_FreeCCITTFax3(struct _HPDF_CCITT_Data *pData)
     if(pData->tif_data!=NULL) {
         HPDF_Fax3CodecState* esp=pData->tif_data;
         if(esp->refline!=NULL) {
-            free(esp->refline);
+            HPDF_FreeMem(pData->dst->mmgr, esp->refline);
             esp->refline=NULL;
         }
-        if(esp->runs!=NULL) {
-            free(esp->runs);
-            esp->runs=NULL;
-        }
-        free(pData->tif_data);
         pData->tif_data=NULL;
     }
-    if(pData->tif_rawdata!=NULL) {
-        free(pData->tif_rawdata);
-        pData->tif_rawdata=NULL;
-    }
     return HPDF_OK;
 }
 
@@ -172,7 +154,7 @@ HPDF_Fax3SetupState(struct _HPDF_CCITT_Data *pData, HPDF_UINT          width,
 {
     HPDF_Fax3BaseState* sp = Fax3State(pData);
     HPDF_Fax3CodecState* esp = EncoderState(pData);
-    uint32 rowbytes, rowpixels, nruns;
+    uint32 rowbytes, rowpixels;
 
     HPDF_UNUSED (height);
 
@@ -182,22 +164,17 @@ HPDF_Fax3SetupState(struct _HPDF_CCITT_Data *pData, HPDF_UINT          width,
     sp->rowbytes = (uint32) rowbytes;
     sp->rowpixels = (uint32) rowpixels;
 
-    nruns = 2*TIFFroundup(rowpixels,32);
-    nruns += 3;
-    esp->runs = (uint32*) malloc(2*nruns * sizeof (uint32));
-    if (esp->runs == NULL)
-        return 1;
-    esp->curruns = esp->runs;
-    esp->refruns = esp->runs + nruns;
-
     /*
      * 2d encoding requires a scanline
      * buffer for the ``reference line''; the
      * scanline against which delta encoding
      * is referenced.  The reference line must
      * be initialized to be ``white'' (done elsewhere).
+     * Only the first row is encoded against this
+     * buffer, the following rows use the previous
+     * row of the image in place.
      */
-    esp->refline = (unsigned char*) malloc(rowbytes);
+    esp->refline = (unsigned char*) HPDF_GetMem(pData->dst->mmgr, rowbytes);
     if (esp->refline == NULL) {
         return 1;
     }
@@ -356,6 +333,28 @@ putspan(struct _HPDF_CCITT_Data *pData, int32 span, const tableentry* tab)
     sp->bit = bit;
 }
 
+/*
+ * Count the leading zero bits of a non-zero 64-bit word.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+
+#define    clz64(w)    __builtin_clzll(w)
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+
+#include <intrin.h>
+#pragma intrinsic(_BitScanReverse64)
+
+static int clz64(HPDF_UINT64 w)
+{
+    unsigned long ix;
+
+    _BitScanReverse64(&ix, w);
+    return 63 - (int)ix;
+}
+
+#else
+
 static const unsigned char zeroruns[256] = {
     8, 7, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4,    /* 0x00 - 0x0f */
     3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,    /* 0x10 - 0x1f */
@@ -374,145 +373,102 @@ static const unsigned char zeroruns[256] = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0xe0 - 0xef */
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0xf0 - 0xff */
 };
-static const unsigned char oneruns[256] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x00 - 0x0f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x10 - 0x1f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x20 - 0x2f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x30 - 0x3f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x40 - 0x4f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x50 - 0x5f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x60 - 0x6f */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x70 - 0x7f */
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,    /* 0x80 - 0x8f */
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,    /* 0x90 - 0x9f */
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,    /* 0xa0 - 0xaf */
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,    /* 0xb0 - 0xbf */
-    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,    /* 0xc0 - 0xcf */
-    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,    /* 0xd0 - 0xdf */
-    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,    /* 0xe0 - 0xef */
-    4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 7, 8,    /* 0xf0 - 0xff */
-};
+static int clz64(HPDF_UINT64 w)
+{
+    int n = 0;
+
+    while (!(w & ((HPDF_UINT64)0xff << 56))) {
+        n += 8;
+        w <<= 8;
+    }
+    return n + zeroruns[(unsigned char)(w >> 56)];
+}
+
+#endif
 
 /*
- * Find a span of ones or zeros using the supplied
- * table.  The ``base'' of the bit string is supplied
- * along with the start+end bit indices.
+ * Read up to 8 bytes as a big-endian word, the missing
+ * bytes at the end of the row are read as zeros.
  */
-static /*inline*/ int32 find0span(unsigned char* bp, int32 bs, int32 be)
+static HPDF_UINT64 load64(const unsigned char* bp, int32 n)
 {
-    int32 bits = be - bs;
-    int32 n, span;
+    HPDF_UINT64 w = 0;
+    int32 i;
+
+    if (n >= 8)
+        return ((HPDF_UINT64)bp[0] << 56) | ((HPDF_UINT64)bp[1] << 48) |
+               ((HPDF_UINT64)bp[2] << 40) | ((HPDF_UINT64)bp[3] << 32) |
+               ((HPDF_UINT64)bp[4] << 24) | ((HPDF_UINT64)bp[5] << 16) |
+               ((HPDF_UINT64)bp[6] << 8) | (HPDF_UINT64)bp[7];
+
+    for (i = 0; i < 8; i++) {
+        w <<= 8;
+        if (i < n)
+            w |= bp[i];
+    }
+    return w;
+}
 
-    bp += bs>>3;
-    /*
-     * Check partial byte on lhs.
-     */
-    if (bits > 0 && (n = (bs & 7))) {
-        span = zeroruns[(*bp << n) & 0xff];
-        if (span > 8-n)        /* table value too generous */
-            span = 8-n;
-        if (span > bits)    /* constrain span to bit range */
-            span = bits;
-        if (n+span < 8)        /* doesn't extend to edge of byte */
-            return (span);
-        bits -= span;
-        bp++;
-    } else
-        span = 0;
-    if (bits >= (int32)(2 * 8 * sizeof(long))) {
-        long* lp;
-        /*
-         * Align to longword boundary and check longwords.
-         */
-        while (!isAligned(bp, long)) {
-            if (*bp != 0x00)
-                return (span + zeroruns[*bp]);
-            span += 8, bits -= 8;
-            bp++;
-        }
-        lp = (long*) bp;
-        while ((bits >= (int32)(8 * sizeof(long))) && (0 == *lp)) {
-            span += 8*sizeof (long), bits -= 8*sizeof (long);
-            lp++;
+/*
+ * Find a span of ones or zeros.  The ``base'' of the
+ * bit string is supplied along with the start+end bit
+ * indices.  The bits are read 64 at a time and the
+ * span in a word is the count of its leading zeros
+ * (of the inverted word for a span of ones).
+ */
+static int32
+findspan_words(const unsigned char* bp, int32 bs, int32 be, int color)
+{
+    int32 nbytes = (int32)TIFFhowmany8(be);
+    int32 span = 0;
+    int32 pos = bs;
+
+    while (pos < be) {
+        int32 n = nbytes - (pos>>3);
+        int32 valid = (n >= 8 ? 64 : 8*n) - (pos & 7);
+        HPDF_UINT64 w = load64(bp + (pos>>3), n);
+
+        if (color)
+            w = ~w;
+        w <<= (pos & 7);
+        if (w != 0) {
+            int32 zeros = clz64(w);
+
+            if (zeros < valid) {
+                span += zeros;
+                break;
+            }
         }
-        bp = (unsigned char*) lp;
-    }
-    /*
-     * Scan full bytes for all 0's.
-     */
-    while (bits >= 8) {
-        if (*bp != 0x00)    /* end of run */
-            return (span + zeroruns[*bp]);
-        span += 8, bits -= 8;
-        bp++;
+        span += valid;
+        pos += valid;
     }
-    /*
-     * Check partial byte on rhs.
-     */
-    if (bits > 0) {
-        n = zeroruns[*bp];
-        span += (n > bits ? bits : n);
-    }
-    return (span);
+
+    /* constrain span to bit range */
+    return (span > be - bs ? be - bs : span);
 }
 
-static /*inline*/ int32
-find1span(unsigned char* bp, int32 bs, int32 be)
+/*
+ * Most spans end in the first word, this part is
+ * kept small so that it is inlined by the compiler.
+ */
+static int32
+findspan(const unsigned char* bp, int32 bs, int32 be, int color)
 {
-    int32 bits = be - bs;
-    int32 n, span;
+    HPDF_UINT64 w;
 
-    bp += bs>>3;
-    /*
-     * Check partial byte on lhs.
-     */
-    if (bits > 0 && (n = (bs & 7))) {
-        span = oneruns[(*bp << n) & 0xff];
-        if (span > 8-n)        /* table value too generous */
-            span = 8-n;
-        if (span > bits)    /* constrain span to bit range */
-            span = bits;
-        if (n+span < 8)        /* doesn't extend to edge of byte */
-            return (span);
-        bits -= span;
-        bp++;
-    } else
-        span = 0;
-    if (bits >= (int32)(2 * 8 * sizeof(long))) {
-        long* lp;
-        /*
-         * Align to longword boundary and check longwords.
-         */
-        while (!isAligned(bp, long)) {
-            if (*bp != 0xff)
-                return (span + oneruns[*bp]);
-            span += 8, bits -= 8;
-            bp++;
-        }
-        lp = (long*) bp;
-        while ((bits >= (int32)(8 * sizeof(long))) && (~0 == *lp)) {
-            span += 8*sizeof (long), bits -= 8*sizeof (long);
-            lp++;
-        }
-        bp = (unsigned char*) lp;
-    }
-    /*
-     * Scan full bytes for all 1's.
-     */
-    while (bits >= 8) {
-        if (*bp != 0xff)    /* end of run */
-            return (span + oneruns[*bp]);
-        span += 8, bits -= 8;
-        bp++;
-    }
-    /*
-     * Check partial byte on rhs.
-     */
-    if (bits > 0) {
-        n = oneruns[*bp];
-        span += (n > bits ? bits : n);
-    }
-    return (span);
+    if (bs >= be)
+        return 0;
+    if ((int32)TIFFhowmany8(be) - (bs>>3) < 8)
+        return findspan_words(bp, bs, be, color);
+
+    w = load64(bp + (bs>>3), 8);
+    if (color)
+        w = ~w;
+    w <<= (bs & 7);
+    if (w != 0 && clz64(w) < 64 - (bs & 7) && clz64(w) <= be - bs)
+        return clz64(w);
+
+    return findspan_words(bp, bs, be, color);
 }
 
 /*
@@ -522,7 +478,7 @@ find1span(unsigned char* bp, int32 bs, int32 be)
  * exists.
  */
 #define    finddiff(_cp, _bs, _be, _color)    \
-    (_bs + (_color ? find1span(_cp,_bs,_be) : find0span(_cp,_bs,_be)))
+    (_bs + findspan(_cp,_bs,_be,_color))
 /*
  * Like finddiff, but also check the starting bit
  * against the end in case start > end.
@@ -561,7 +517,7 @@ static const tableentry vcodes[7] = {
  * documentation for the algorithm.
  */
 static HPDF_STATUS 
-HPDF_Fax3Encode2DRow(struct _HPDF_CCITT_Data *pData, unsigned char* bp, unsigned char* rp, uint32 bits)
+HPDF_Fax3Encode2DRow(struct _HPDF_CCITT_Data *pData, const unsigned char* bp, const unsigned char* rp, uint32 bits)
 {
 #define    PIXEL(buf,ix)    ((((buf)[(ix)>>3]) >> (7-((ix)&7))) & 1)
         uint32 a0 = 0;
@@ -603,35 +559,33 @@ HPDF_Fax3Encode2DRow(struct _HPDF_CCITT_Data *pData, unsigned char* bp, unsigned
 }
 
 /*
- * Encode the requested amount of data.
+ * Encode a row against its reference line.  The rows are
+ * encoded from the buffer of the caller, so that the
+ * reference line does not have to be copied.
  */
 static HPDF_STATUS 
-HPDF_Fax4Encode(struct _HPDF_CCITT_Data *pData, tidata_t bp, tsize_t cc/*, tsample_t s*/)
+HPDF_Fax4Encode(struct _HPDF_CCITT_Data *pData, const unsigned char* bp, const unsigned char* rp)
 {
     HPDF_Fax3CodecState *sp = EncoderState(pData);
 
-    /* (void) s; */
-    while ((long)cc > 0) {
-        if (HPDF_Fax3Encode2DRow(pData, bp, sp->refline, sp->b.rowpixels)!=HPDF_OK)
-            return 1;
-        memcpy(sp->refline, bp, sp->b.rowbytes);
-        bp += sp->b.rowbytes;
-        cc -= sp->b.rowbytes;
-    }
+    if (HPDF_Fax3Encode2DRow(pData, bp, rp, sp->b.rowpixels)!=HPDF_OK)
+        return 1;
     return HPDF_OK;
 }
 
 static void
 HPDF_Fax4PostEncode(struct _HPDF_CCITT_Data *pData)
 {
-    /* HPDF_Fax3CodecState *sp = EncoderState(pData); */
+    HPDF_Fax3CodecState *sp = EncoderState(pData);
 
     /* terminate strip w/ EOFB */
     HPDF_Fax3PutBits(pData, EOL, 12);
     HPDF_Fax3PutBits(pData, EOL, 12);
-    /*if (sp->bit != 8)
-        HPDF_Fax3FlushBits(pData, sp);    
-        */
+
+    /* the last bits of the EOFB are lost unless the last byte is flushed */
+    if (sp->bit != 8)
+        HPDF_Fax3FlushBits(pData, sp);
+
     HPDF_CCITT_FlushData(pData);
 }
 
@@ -648,6 +602,7 @@ HPDF_Stream_CcittToStream( const HPDF_BYTE   *buf,
 {
     const HPDF_BYTE   *pBufPos;
     const HPDF_BYTE   *pBufEnd; /* end marker */
+    const HPDF_BYTE   *refline;
     int lineIncrement;
     struct _HPDF_CCITT_Data data;
 
@@ -666,8 +621,7 @@ HPDF_Stream_CcittToStream( const HPDF_BYTE   *buf,
 
     memset(&data, 0, sizeof(struct _HPDF_CCITT_Data));
     data.dst = dst;
-    data.tif_rawdata = (tidata_t) malloc( 16384 ); /*  16 kb buffer */
-    data.tif_rawdatasize = 16384;
+    data.tif_rawdatasize = HPDF_STREAM_BUF_SIZ;
     data.tif_rawcc = 0;
     data.tif_rawcp = data.tif_rawdata;
 
@@ -686,10 +640,12 @@ HPDF_Stream_CcittToStream( const HPDF_BYTE   *buf,
         return 1;
     }
 
-    /*  encode data */
+    /*  encode data, each row is the reference line of the next one */
+    refline = data.tif_data->refline;
     while(pBufEnd!=pBufPos)
     {
-        HPDF_Fax4Encode(&data, (tidata_t)pBufPos, line_width);
+        HPDF_Fax4Encode(&data, pBufPos, refline);
+        refline = pBufPos;
         pBufPos+=lineIncrement;
     }
 
@@ -700,6 +656,29 @@ HPDF_Stream_CcittToStream( const HPDF_BYTE   *buf,
     return HPDF_OK;
 }
 
+typedef struct _HPDF_1BitImageParam_Rec {
+    const HPDF_BYTE   *buf;
+    HPDF_UINT          width;
+    HPDF_UINT          height;
+    HPDF_UINT          line_width;
+    HPDF_BOOL          top_is_first;
+} HPDF_1BitImageParam_Rec;
+
+
+/* encode the data of a delayed loading image from the buffer of the caller. */
+static HPDF_STATUS
+Load1BitImageData  (HPDF_Image  image,
+                    void        *param)
+{
+    HPDF_1BitImageParam_Rec *p = (HPDF_1BitImageParam_Rec *)param;
+
+    HPDF_PTRACE ((" Load1BitImageData\n"));
+
+    return HPDF_Stream_CcittToStream (p->buf, image->stream, NULL, p->width,
+            p->height, p->line_width, p->top_is_first);
+}
+
+
 HPDF_Image
 HPDF_Image_Load1BitImageFromMem  (HPDF_MMgr        mmgr,
                           const HPDF_BYTE   *buf,
@@ -707,7 +686,9 @@ HPDF_Image_Load1BitImageFromMem  (HPDF_MMgr        mmgr,
                           HPDF_UINT          width,
                           HPDF_UINT          height,
                           HPDF_UINT          line_width,
-                          HPDF_BOOL             top_is_first
+                          HPDF_BOOL          black_is1,
+                          HPDF_BOOL             top_is_first,
+                          HPDF_BOOL          delayed_loading
                           )
 {
     HPDF_Dict image;
@@ -740,12 +721,78 @@ HPDF_Image_Load1BitImageFromMem  (HPDF_MMgr        mmgr,
     if (HPDF_Dict_AddNumber (image, "BitsPerComponent", 1) != HPDF_OK)
         return NULL;
 
-    if (HPDF_Stream_CcittToStream (buf, image->stream, NULL, width, height, line_width, top_is_first) != HPDF_OK)
+    /* the data is always encoded, so the filter does not depend on the
+     * compression mode of the document.
+     */
+    image->filter = HPDF_STREAM_FILTER_CCITT_DECODE;
+    image->filterParams = HPDF_Dict_New (mmgr);
+    if (!image->filterParams)
+        return NULL;
+
+    /* pure 2D encoding, default is 0 */
+    ret += HPDF_Dict_AddNumber (image->filterParams, "K", -1);
+    /* default is 1728 */
+    ret += HPDF_Dict_AddNumber (image->filterParams, "Columns", width);
+    /* default is 0 */
+    ret += HPDF_Dict_AddNumber (image->filterParams, "Rows", height);
+    ret += HPDF_Dict_AddBoolean (image->filterParams, "BlackIs1", black_is1);
+    if (ret != HPDF_OK)
+        return NULL;
+
+    /* if delayed_loading is HPDF_TRUE, the data is encoded when the image
+     * is written, so buf must be valid until the document is saved.
+     */
+    if (delayed_loading) {
+        HPDF_1BitImageParam_Rec param;
+
+        /* the parameters are compared by HPDF_Doc_DedupImage() */
+        HPDF_MemSet (&param, 0, sizeof(param));
+        param.buf = buf;
+        param.width = width;
+        param.height = height;
+        param.line_width = line_width;
+        param.top_is_first = top_is_first;
+
+        if (HPDF_Image_SetDelayedLoading (image, Load1BitImageData, &param,
+                    sizeof(param)) != HPDF_OK)
+            return NULL;
+    } else if (HPDF_Stream_CcittToStream (buf, image->stream, NULL, width,
+                height, line_width, top_is_first) != HPDF_OK)
         return NULL;
 
     return image;
 }
 
+
+static HPDF_Image
+LoadRaw1BitImageFromMem  (HPDF_Doc           pdf,
+                          const HPDF_BYTE   *buf,
+                          HPDF_UINT          width,
+                          HPDF_UINT          height,
+                          HPDF_UINT          line_width,
+                          HPDF_BOOL          black_is1,
+                          HPDF_BOOL          top_is_first,
+                          HPDF_BOOL          delayed_loading)
+{
+    HPDF_Image image;
+    HPDF_UINT obj_count;
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    obj_count = pdf->xref->entries->count;
+
+    image = HPDF_Image_Load1BitImageFromMem(pdf->mmgr, buf, pdf->xref, width,
+                height, line_width, black_is1, top_is_first, delayed_loading);
+
+    if (!image) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    return HPDF_Doc_DedupImage (pdf, image, obj_count);
+}
+
 /*
  * Load image from buffer
  * line_width - width of the line in bytes
@@ -762,35 +809,27 @@ HPDF_Image_LoadRaw1BitImageFromMem  (HPDF_Doc           pdf,
                           HPDF_BOOL          black_is1,
                           HPDF_BOOL             top_is_first)
 {
-    HPDF_Image image;
-
     HPDF_PTRACE ((" HPDF_Image_Load1BitImageFromMem\n"));
 
-    if (!HPDF_HasDoc (pdf))
-        return NULL;
-
-    image = HPDF_Image_Load1BitImageFromMem(pdf->mmgr, buf, pdf->xref, width,
-                height, line_width, top_is_first);
-
-    if (!image)
-        HPDF_CheckError (&pdf->error);
+    return LoadRaw1BitImageFromMem (pdf, buf, width, height, line_width,
+            black_is1, top_is_first, HPDF_FALSE);
+}
 
-    if (pdf->compression_mode & HPDF_COMP_IMAGE)
-    {
-        image->filter = HPDF_STREAM_FILTER_CCITT_DECODE;
-        image->filterParams = HPDF_Dict_New(pdf->mmgr);
-        if(image->filterParams==NULL) {
-            return NULL;
-        }
-        
-        /* pure 2D encoding, default is 0 */
-        HPDF_Dict_AddNumber (image->filterParams, "K", -1);
-        /* default is 1728 */
-        HPDF_Dict_AddNumber (image->filterParams, "Columns", width);
-        /* default is 0 */
-        HPDF_Dict_AddNumber (image->filterParams, "Rows", height);
-        HPDF_Dict_AddBoolean (image->filterParams, "BlackIs1", black_is1);
-    }
+/*
+ * same as HPDF_Image_LoadRaw1BitImageFromMem, but the image is encoded when
+ * the document is saved. buf must be valid until then.
+ */
+HPDF_EXPORT(HPDF_Image)
+HPDF_Image_LoadRaw1BitImageFromMem2  (HPDF_Doc           pdf,
+                           const HPDF_BYTE   *buf,
+                          HPDF_UINT          width,
+                          HPDF_UINT          height,
+                          HPDF_UINT          line_width,
+                          HPDF_BOOL          black_is1,
+                          HPDF_BOOL          top_is_first)
+{
+    HPDF_PTRACE ((" HPDF_Image_Load1BitImageFromMem2\n"));
 
-    return image;
+    return LoadRaw1BitImageFromMem (pdf, buf, width, height, line_width,
+            black_is1, top_is_first, HPDF_TRUE);
 }
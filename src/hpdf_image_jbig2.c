@@ -0,0 +1,419 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_image_jbig2.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_image.h"
+#include "hpdf.h"
+
+/*
+ *  JBIG2 images are embedded with the JBIG2Decode filter. The input is
+ *  either a JBIG2 file (sequential or random-access organization) or a
+ *  sequence of segments without the file header, as written by encoders
+ *  for PDF. The segments are copied as they are: the segments of the first
+ *  page go into the image stream and the global segments (page 0) into the
+ *  JBIG2Globals stream. The file header, end of page and end of file
+ *  segments are not used in PDF and are dropped.
+ */
+
+static const HPDF_BYTE JBIG2_SIGNATURE[8] = {
+    0x97, 0x4A, 0x42, 0x32, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+#define JBIG2_SEG_PAGE_INFO     48
+#define JBIG2_SEG_END_OF_PAGE   49
+#define JBIG2_SEG_END_OF_STRIPE 50
+#define JBIG2_SEG_END_OF_FILE   51
+
+typedef struct _HPDF_JBIG2Segment_Rec {
+    const HPDF_BYTE  *header;
+    HPDF_UINT         header_len;
+    const HPDF_BYTE  *data;
+    HPDF_UINT         data_len;
+    HPDF_UINT         type;
+    HPDF_UINT32       page;
+} HPDF_JBIG2Segment_Rec;
+
+typedef struct _HPDF_JBIG2Reader_Rec {
+    const HPDF_BYTE  *buf;
+    HPDF_UINT         size;
+    HPDF_UINT         pos;        /* position of the next segment header */
+    HPDF_UINT         data_pos;   /* position of the next data in the
+                                   * random-access organization, or 0 */
+} HPDF_JBIG2Reader_Rec;
+
+
+static HPDF_UINT32
+GetUInt32  (const HPDF_BYTE  *p)
+{
+    return ((HPDF_UINT32)p[0] << 24) | ((HPDF_UINT32)p[1] << 16) |
+            ((HPDF_UINT32)p[2] << 8) | p[3];
+}
+
+
+/* parse a segment header at pos, returns HPDF_FALSE if it is broken. */
+static HPDF_BOOL
+ParseSegmentHeader  (const HPDF_BYTE         *buf,
+                     HPDF_UINT                size,
+                     HPDF_UINT                pos,
+                     HPDF_JBIG2Segment_Rec   *seg)
+{
+    HPDF_UINT start = pos;
+    HPDF_UINT32 number;
+    HPDF_UINT32 count;
+    HPDF_UINT ref_size;
+    HPDF_BYTE flags;
+
+    if (size - pos < 6)
+        return HPDF_FALSE;
+
+    number = GetUInt32 (buf + pos);
+    flags = buf[pos + 4];
+    pos += 5;
+
+    /* the count of the referred-to segments and their retention flags */
+    count = buf[pos] >> 5;
+    if (count <= 4) {
+        pos++;
+    } else if (count == 7) {
+        if (size - pos < 4)
+            return HPDF_FALSE;
+
+        count = GetUInt32 (buf + pos) & 0x1FFFFFFF;
+        pos += 4;
+        if (size - pos < (count + 8) / 8)
+            return HPDF_FALSE;
+        pos += (count + 8) / 8;
+    } else
+        return HPDF_FALSE;
+
+    ref_size = (number <= 256) ? 1 : (number <= 65536) ? 2 : 4;
+    if ((size - pos) / ref_size < count)
+        return HPDF_FALSE;
+    pos += count * ref_size;
+
+    if (flags & 0x40) {
+        if (size - pos < 4)
+            return HPDF_FALSE;
+        seg->page = GetUInt32 (buf + pos);
+        pos += 4;
+    } else {
+        if (size - pos < 1)
+            return HPDF_FALSE;
+        seg->page = buf[pos];
+        pos++;
+    }
+
+    if (size - pos < 4)
+        return HPDF_FALSE;
+
+    /* the length of an immediate generic region may be unknown, which
+     * is not supported.
+     */
+    seg->data_len = GetUInt32 (buf + pos);
+    pos += 4;
+    if (seg->data_len == 0xFFFFFFFF)
+        return HPDF_FALSE;
+
+    seg->type = flags & 0x3F;
+    seg->header = buf + start;
+    seg->header_len = pos - start;
+
+    return HPDF_TRUE;
+}
+
+
+static HPDF_STATUS
+Reader_Init  (HPDF_JBIG2Reader_Rec  *reader,
+              const HPDF_BYTE       *buf,
+              HPDF_UINT              size)
+{
+    reader->buf = buf;
+    reader->size = size;
+    reader->pos = 0;
+    reader->data_pos = 0;
+
+    if (size < 9 || HPDF_MemCmp (buf, JBIG2_SIGNATURE, 8) != 0)
+        return HPDF_OK;
+
+    /* the number of the pages follows the flags if it is known */
+    reader->pos = (buf[8] & 0x02) ? 9 : 13;
+    if (reader->pos > size)
+        return HPDF_INVALID_JBIG2_DATA;
+
+    /* in the random-access organization the data of the segments follows
+     * all the segment headers, which end with the end of file segment.
+     */
+    if (!(buf[8] & 0x01)) {
+        HPDF_JBIG2Segment_Rec seg;
+        HPDF_UINT pos = reader->pos;
+
+        for (;;) {
+            if (!ParseSegmentHeader (buf, size, pos, &seg))
+                return HPDF_INVALID_JBIG2_DATA;
+
+            pos += seg.header_len;
+            if (seg.type == JBIG2_SEG_END_OF_FILE)
+                break;
+        }
+
+        reader->data_pos = pos;
+    }
+
+    return HPDF_OK;
+}
+
+
+/* returns HPDF_STREAM_EOF after the last segment */
+static HPDF_STATUS
+Reader_Next  (HPDF_JBIG2Reader_Rec   *reader,
+              HPDF_JBIG2Segment_Rec  *seg)
+{
+    HPDF_UINT data_pos;
+
+    if (reader->pos >= reader->size)
+        return HPDF_STREAM_EOF;
+
+    if (!ParseSegmentHeader (reader->buf, reader->size, reader->pos, seg))
+        return HPDF_INVALID_JBIG2_DATA;
+
+    reader->pos += seg->header_len;
+    data_pos = reader->data_pos ? reader->data_pos : reader->pos;
+
+    if (reader->size - data_pos < seg->data_len)
+        return HPDF_INVALID_JBIG2_DATA;
+
+    seg->data = reader->buf + data_pos;
+
+    if (reader->data_pos)
+        reader->data_pos += seg->data_len;
+    else
+        reader->pos += seg->data_len;
+
+    if (seg->type == JBIG2_SEG_END_OF_FILE)
+        reader->pos = reader->size;
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+WriteSegment  (HPDF_Stream             stream,
+               HPDF_JBIG2Segment_Rec  *seg)
+{
+    HPDF_STATUS ret;
+
+    if ((ret = HPDF_Stream_Write (stream, seg->header, seg->header_len)) !=
+            HPDF_OK)
+        return ret;
+
+    return HPDF_Stream_Write (stream, seg->data, seg->data_len);
+}
+
+
+static HPDF_STATUS
+LoadJbig2Data  (HPDF_Image        image,
+                HPDF_Xref         xref,
+                const HPDF_BYTE  *buf,
+                HPDF_UINT         size)
+{
+    HPDF_JBIG2Reader_Rec reader;
+    HPDF_JBIG2Segment_Rec seg;
+    HPDF_Dict globals = NULL;
+    HPDF_BOOL has_page = HPDF_FALSE;
+    HPDF_UINT32 page = 0;
+    HPDF_UINT32 width = 0;
+    HPDF_UINT32 height = 0;
+    HPDF_UINT32 stripe_height = 0;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJbig2Data\n"));
+
+    if ((ret = Reader_Init (&reader, buf, size)) != HPDF_OK)
+        return HPDF_SetError (image->error, ret, 0);
+
+    while ((ret = Reader_Next (&reader, &seg)) == HPDF_OK) {
+        if (seg.type == JBIG2_SEG_END_OF_PAGE ||
+                seg.type == JBIG2_SEG_END_OF_FILE)
+            continue;
+
+        if (seg.page == 0) {
+            if (!globals) {
+                globals = HPDF_DictStream_New (image->mmgr, xref);
+                if (!globals)
+                    return HPDF_Error_GetCode (image->error);
+            }
+
+            if ((ret = WriteSegment (globals->stream, &seg)) != HPDF_OK)
+                return ret;
+
+            continue;
+        }
+
+        /* the page information segment is the first segment of a page,
+         * only the first page of a file is loaded.
+         */
+        if (!has_page) {
+            if (seg.type != JBIG2_SEG_PAGE_INFO || seg.data_len < 19)
+                return HPDF_SetError (image->error,
+                        HPDF_INVALID_JBIG2_DATA, 0);
+
+            page = seg.page;
+            width = GetUInt32 (seg.data);
+            height = GetUInt32 (seg.data + 4);
+            has_page = HPDF_TRUE;
+        } else if (seg.page != page)
+            continue;
+
+        /* the height of a striped page may be unknown until its end */
+        if (seg.type == JBIG2_SEG_END_OF_STRIPE && seg.data_len >= 4 &&
+                GetUInt32 (seg.data) >= stripe_height)
+            stripe_height = GetUInt32 (seg.data) + 1;
+
+        if ((ret = WriteSegment (image->stream, &seg)) != HPDF_OK)
+            return ret;
+    }
+
+    if (ret != HPDF_STREAM_EOF)
+        return HPDF_SetError (image->error, ret, 0);
+
+    if (height == 0xFFFFFFFF)
+        height = stripe_height;
+
+    if (!has_page || width == 0 || height == 0 || width > HPDF_LIMIT_MAX_INT ||
+            height > HPDF_LIMIT_MAX_INT)
+        return HPDF_SetError (image->error, HPDF_INVALID_JBIG2_DATA, 0);
+
+    if (HPDF_Dict_AddNumber (image, "Width", width) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    if (HPDF_Dict_AddNumber (image, "Height", height) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    if (HPDF_Dict_AddName (image, "ColorSpace", "DeviceGray") != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    if (HPDF_Dict_AddNumber (image, "BitsPerComponent", 1) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    if (globals) {
+        image->filterParams = HPDF_Dict_New (image->mmgr);
+        if (!image->filterParams)
+            return HPDF_Error_GetCode (image->error);
+
+        if (HPDF_Dict_Add (image->filterParams, "JBIG2Globals", globals) !=
+                HPDF_OK)
+            return HPDF_Error_GetCode (image->error);
+    }
+
+    return HPDF_OK;
+}
+
+
+static HPDF_Image
+Jbig2Image_New  (HPDF_MMgr          mmgr,
+                 const HPDF_BYTE   *buf,
+                 HPDF_UINT          size,
+                 HPDF_Xref          xref)
+{
+    HPDF_Dict image;
+    HPDF_STATUS ret = HPDF_OK;
+
+    image = HPDF_DictStream_New (mmgr, xref);
+    if (!image)
+        return NULL;
+
+    image->header.obj_class |= HPDF_OSUBCLASS_XOBJECT;
+
+    image->filter = HPDF_STREAM_FILTER_JBIG2_DECODE;
+    ret += HPDF_Dict_AddName (image, "Type", "XObject");
+    ret += HPDF_Dict_AddName (image, "Subtype", "Image");
+    if (ret != HPDF_OK)
+        return NULL;
+
+    if (LoadJbig2Data (image, xref, buf, size) != HPDF_OK)
+        return NULL;
+
+    return image;
+}
+
+
+HPDF_Image
+HPDF_Image_LoadJbig2ImageFromMem  (HPDF_MMgr          mmgr,
+                                   const HPDF_BYTE   *buf,
+                                   HPDF_UINT          size,
+                                   HPDF_Xref          xref)
+{
+    HPDF_PTRACE ((" HPDF_Image_LoadJbig2ImageFromMem\n"));
+
+    return Jbig2Image_New (mmgr, buf, size, xref);
+}
+
+
+HPDF_Image
+HPDF_Image_LoadJbig2ImageFromFile  (HPDF_MMgr        mmgr,
+                                    const char      *filename,
+                                    HPDF_Xref        xref)
+{
+    HPDF_Stream jbig2_data;
+    HPDF_Image image = NULL;
+    const HPDF_BYTE *buf;
+    HPDF_BYTE *tmp = NULL;
+    HPDF_UINT size;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJbig2ImageFromFile\n"));
+
+    jbig2_data = HPDF_MappedReader_New (mmgr, filename);
+    if (!jbig2_data)
+        return NULL;
+
+    size = HPDF_Stream_Size (jbig2_data);
+
+    /* the file is read into memory if it cannot be mapped */
+    buf = HPDF_MappedReader_GetBufPtr (jbig2_data, 0, size);
+    if (!buf && size > 0) {
+        HPDF_UINT len = size;
+        HPDF_STATUS ret;
+
+        tmp = (HPDF_BYTE *)HPDF_GetMem (mmgr, size);
+        if (!tmp) {
+            HPDF_Stream_Free (jbig2_data);
+            return NULL;
+        }
+
+        ret = HPDF_Stream_Read (jbig2_data, tmp, &len);
+        if ((ret != HPDF_OK && ret != HPDF_STREAM_EOF) || len != size) {
+            HPDF_SetError (mmgr->error, HPDF_FILE_IO_ERROR, 0);
+            HPDF_FreeMem (mmgr, tmp);
+            HPDF_Stream_Free (jbig2_data);
+            return NULL;
+        }
+
+        buf = tmp;
+    }
+
+    if (buf)
+        image = Jbig2Image_New (mmgr, buf, size, xref);
+    else
+        HPDF_SetError (mmgr->error, HPDF_INVALID_JBIG2_DATA, 0);
+
+    if (tmp)
+        HPDF_FreeMem (mmgr, tmp);
+    HPDF_Stream_Free (jbig2_data);
+
+    return image;
+}
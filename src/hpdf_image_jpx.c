@@ -0,0 +1,473 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_image_jpx.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_image.h"
+#include "hpdf.h"
+
+/*
+ *  JPEG 2000 images are embedded as they are with the JPXDecode filter,
+ *  either as JP2 files or as bare codestreams. Only the header boxes of a
+ *  JP2 file or the SIZ marker segment of a codestream are read to get the
+ *  attributes of the image.
+ */
+
+static const HPDF_BYTE JP2_SIGNATURE[12] = {
+    0x00, 0x00, 0x00, 0x0C, 0x6A, 0x50, 0x20, 0x20, 0x0D, 0x0A, 0x87, 0x0A
+};
+
+#define JPX_BOX_JP2H   0x6A703268  /* 'jp2h' */
+#define JPX_BOX_IHDR   0x69686472  /* 'ihdr' */
+#define JPX_BOX_COLR   0x636F6C72  /* 'colr' */
+#define JPX_BOX_PCLR   0x70636C72  /* 'pclr' */
+#define JPX_BOX_CDEF   0x63646566  /* 'cdef' */
+#define JPX_BOX_JP2C   0x6A703263  /* 'jp2c' */
+
+#define JPX_CS_CMYK    12
+#define JPX_CS_SRGB    16
+#define JPX_CS_GRAY    17
+
+typedef struct _HPDF_JpxInfo_Rec {
+    HPDF_UINT32  width;
+    HPDF_UINT32  height;
+    HPDF_UINT    num_components;
+    HPDF_UINT    bits_per_component;   /* 0 if the components differ */
+    HPDF_UINT    num_alpha;
+    HPDF_BOOL    has_palette;
+    HPDF_UINT    color_method;         /* 0 if no colr box was found */
+    HPDF_UINT32  enum_cs;
+} HPDF_JpxInfo_Rec;
+
+
+static HPDF_STATUS
+ReadBytes  (HPDF_Image   image,
+            HPDF_Stream  stream,
+            HPDF_BYTE   *buf,
+            HPDF_UINT    len)
+{
+    HPDF_UINT size = len;
+    HPDF_STATUS ret = HPDF_Stream_Read (stream, buf, &size);
+
+    if (ret == HPDF_OK || (ret == HPDF_STREAM_EOF && size == len))
+        return HPDF_OK;
+
+    if (ret == HPDF_STREAM_EOF)
+        return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+    return ret;
+}
+
+
+static HPDF_UINT32
+GetUInt32  (const HPDF_BYTE  *p)
+{
+    return ((HPDF_UINT32)p[0] << 24) | ((HPDF_UINT32)p[1] << 16) |
+            ((HPDF_UINT32)p[2] << 8) | p[3];
+}
+
+
+static HPDF_UINT
+GetUInt16  (const HPDF_BYTE  *p)
+{
+    return ((HPDF_UINT)p[0] << 8) | p[1];
+}
+
+
+/* read the header of a box, returns the size of the contents of the box. */
+static HPDF_STATUS
+ReadBoxHeader  (HPDF_Image    image,
+                HPDF_Stream   stream,
+                HPDF_UINT32  *type,
+                HPDF_UINT32  *len)
+{
+    HPDF_BYTE buf[8];
+    HPDF_UINT32 box_len;
+    HPDF_STATUS ret;
+
+    if ((ret = ReadBytes (image, stream, buf, 8)) != HPDF_OK)
+        return ret;
+
+    box_len = GetUInt32 (buf);
+    *type = GetUInt32 (buf + 4);
+
+    if (box_len == 1) {
+        /* the boxes which are read are never larger than 4GB */
+        if ((ret = ReadBytes (image, stream, buf, 8)) != HPDF_OK)
+            return ret;
+
+        if (GetUInt32 (buf) != 0 || GetUInt32 (buf + 4) < 16)
+            return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+        *len = GetUInt32 (buf + 4) - 16;
+    } else if (box_len == 0) {
+        /* the last box of the file */
+        *len = 0xFFFFFFFF;
+    } else {
+        if (box_len < 8)
+            return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+        *len = box_len - 8;
+    }
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+SkipBytes  (HPDF_Image   image,
+            HPDF_Stream  stream,
+            HPDF_UINT32  len)
+{
+    if (len > 0x7FFFFFFF)
+        return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+    return HPDF_Stream_Seek (stream, (HPDF_INT)len, HPDF_SEEK_CUR);
+}
+
+
+/* the SIZ marker segment follows the SOC marker of a codestream. */
+static HPDF_STATUS
+ReadCodestreamHeader  (HPDF_Image     image,
+                       HPDF_Stream    stream,
+                       HPDF_JpxInfo_Rec  *info)
+{
+    HPDF_BYTE buf[42];
+    HPDF_UINT i;
+    HPDF_STATUS ret;
+
+    if ((ret = ReadBytes (image, stream, buf, 42)) != HPDF_OK)
+        return ret;
+
+    if (buf[0] != 0xFF || buf[1] != 0x4F || buf[2] != 0xFF || buf[3] != 0x51)
+        return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+    /* Xsiz - XOsiz and Ysiz - YOsiz */
+    if (GetUInt32 (buf + 8) <= GetUInt32 (buf + 16) ||
+            GetUInt32 (buf + 12) <= GetUInt32 (buf + 20))
+        return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+    info->width = GetUInt32 (buf + 8) - GetUInt32 (buf + 16);
+    info->height = GetUInt32 (buf + 12) - GetUInt32 (buf + 20);
+    info->num_components = GetUInt16 (buf + 40);
+
+    if (info->num_components == 0)
+        return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+    for (i = 0; i < info->num_components; i++) {
+        HPDF_UINT bits;
+
+        if ((ret = ReadBytes (image, stream, buf, 3)) != HPDF_OK)
+            return ret;
+
+        bits = (buf[0] & 0x7F) + 1;
+        if (i == 0)
+            info->bits_per_component = bits;
+        else if (info->bits_per_component != bits)
+            info->bits_per_component = 0;
+    }
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+ReadJp2Header  (HPDF_Image     image,
+                HPDF_Stream    stream,
+                HPDF_UINT32    len,
+                HPDF_JpxInfo_Rec  *info)
+{
+    HPDF_BOOL has_ihdr = HPDF_FALSE;
+    HPDF_STATUS ret;
+
+    while (len >= 8) {
+        HPDF_BYTE buf[14];
+        HPDF_UINT32 type;
+        HPDF_UINT32 box_len;
+        HPDF_UINT32 header_len;
+        HPDF_UINT32 pos = HPDF_Stream_Tell (stream);
+
+        if ((ret = ReadBoxHeader (image, stream, &type, &box_len)) != HPDF_OK)
+            return ret;
+
+        /* an extended header of 16 bytes may not fit in the superbox */
+        header_len = HPDF_Stream_Tell (stream) - pos;
+        if (header_len > len)
+            return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+        len -= header_len;
+
+        if (box_len > len)
+            return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+        len -= box_len;
+
+        if (type == JPX_BOX_IHDR && box_len >= 14) {
+            if ((ret = ReadBytes (image, stream, buf, 14)) != HPDF_OK)
+                return ret;
+            box_len -= 14;
+
+            info->height = GetUInt32 (buf);
+            info->width = GetUInt32 (buf + 4);
+            info->num_components = GetUInt16 (buf + 8);
+            info->bits_per_component = (buf[10] == 0xFF) ? 0 :
+                    (HPDF_UINT)(buf[10] & 0x7F) + 1;
+            has_ihdr = HPDF_TRUE;
+        } else if (type == JPX_BOX_COLR && box_len >= 3 &&
+                info->color_method == 0) {
+            if ((ret = ReadBytes (image, stream, buf, 3)) != HPDF_OK)
+                return ret;
+            box_len -= 3;
+
+            info->color_method = buf[0];
+            if (info->color_method == 1 && box_len >= 4) {
+                if ((ret = ReadBytes (image, stream, buf, 4)) != HPDF_OK)
+                    return ret;
+                box_len -= 4;
+
+                info->enum_cs = GetUInt32 (buf);
+            }
+        } else if (type == JPX_BOX_PCLR) {
+            info->has_palette = HPDF_TRUE;
+        } else if (type == JPX_BOX_CDEF && box_len >= 2) {
+            HPDF_UINT count;
+            HPDF_UINT i;
+
+            if ((ret = ReadBytes (image, stream, buf, 2)) != HPDF_OK)
+                return ret;
+            box_len -= 2;
+
+            count = GetUInt16 (buf);
+            for (i = 0; i < count && box_len >= 6; i++) {
+                HPDF_UINT channel_type;
+
+                if ((ret = ReadBytes (image, stream, buf, 6)) != HPDF_OK)
+                    return ret;
+                box_len -= 6;
+
+                /* opacity and premultiplied opacity */
+                channel_type = GetUInt16 (buf + 2);
+                if (channel_type == 1 || channel_type == 2)
+                    info->num_alpha++;
+            }
+        }
+
+        if (box_len > 0 && (ret = SkipBytes (image, stream, box_len)) !=
+                HPDF_OK)
+            return ret;
+    }
+
+    if (!has_ihdr || info->width == 0 || info->height == 0 ||
+            info->num_components == 0)
+        return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+LoadJpxHeader  (HPDF_Image   image,
+                HPDF_Stream  stream)
+{
+    HPDF_JpxInfo_Rec info;
+    HPDF_BYTE sig[12];
+    const char *color_space_name = NULL;
+    HPDF_UINT num_colors;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJpxHeader\n"));
+
+    HPDF_MemSet (&info, 0, sizeof(HPDF_JpxInfo_Rec));
+
+    if ((ret = ReadBytes (image, stream, sig, 12)) != HPDF_OK)
+        return ret;
+
+    if (HPDF_MemCmp (sig, JP2_SIGNATURE, 12) == 0) {
+        /* the header box comes before the codestream */
+        for (;;) {
+            HPDF_UINT32 type;
+            HPDF_UINT32 len;
+
+            if ((ret = ReadBoxHeader (image, stream, &type, &len)) != HPDF_OK)
+                return ret;
+
+            if (type == JPX_BOX_JP2H) {
+                if ((ret = ReadJp2Header (image, stream, len, &info)) !=
+                        HPDF_OK)
+                    return ret;
+                break;
+            }
+
+            if (type == JPX_BOX_JP2C || len == 0xFFFFFFFF)
+                return HPDF_SetError (image->error, HPDF_INVALID_JPX_DATA, 0);
+
+            if ((ret = SkipBytes (image, stream, len)) != HPDF_OK)
+                return ret;
+        }
+    } else {
+        if ((ret = HPDF_Stream_Seek (stream, 0, HPDF_SEEK_SET)) != HPDF_OK)
+            return ret;
+
+        if ((ret = ReadCodestreamHeader (image, stream, &info)) != HPDF_OK)
+            return ret;
+    }
+
+    if (HPDF_Dict_AddNumber (image, "Width", info.width) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    if (HPDF_Dict_AddNumber (image, "Height", info.height) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    /* the color space of the image is used unless it is overridden here.
+     * only the plain color spaces are given, the others (ICC profiles,
+     * palettes, YCC) are left to the decoder.
+     */
+    num_colors = info.num_components - info.num_alpha;
+
+    if (!info.has_palette) {
+        if (info.color_method == 0) {
+            if (num_colors == 1)
+                color_space_name = "DeviceGray";
+            else if (num_colors == 3)
+                color_space_name = "DeviceRGB";
+            else if (num_colors == 4)
+                color_space_name = "DeviceCMYK";
+        } else if (info.color_method == 1) {
+            if (num_colors == 1 && info.enum_cs == JPX_CS_GRAY)
+                color_space_name = "DeviceGray";
+            else if (num_colors == 3 && info.enum_cs == JPX_CS_SRGB)
+                color_space_name = "DeviceRGB";
+            else if (num_colors == 4 && info.enum_cs == JPX_CS_CMYK)
+                color_space_name = "DeviceCMYK";
+        }
+    }
+
+    if (color_space_name &&
+            HPDF_Dict_AddName (image, "ColorSpace", color_space_name) !=
+            HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    /* the entry is ignored by the readers, it is kept for the functions
+     * which ask the image.
+     */
+    if ((info.bits_per_component == 1 || info.bits_per_component == 2 ||
+            info.bits_per_component == 4 || info.bits_per_component == 8 ||
+            info.bits_per_component == 16) &&
+            HPDF_Dict_AddNumber (image, "BitsPerComponent",
+            info.bits_per_component) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    if (info.num_alpha > 0 &&
+            HPDF_Dict_AddNumber (image, "SMaskInData", 1) != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    return HPDF_OK;
+}
+
+
+/* create an image object with the attributes of the jpx header. */
+static HPDF_Image
+JpxImage_New  (HPDF_MMgr        mmgr,
+               HPDF_Stream      jpx_data,
+               HPDF_Xref        xref)
+{
+    HPDF_Dict image;
+    HPDF_STATUS ret = HPDF_OK;
+
+    image = HPDF_DictStream_New (mmgr, xref);
+    if (!image)
+        return NULL;
+
+    image->header.obj_class |= HPDF_OSUBCLASS_XOBJECT;
+
+    image->filter = HPDF_STREAM_FILTER_JPX_DECODE;
+    ret += HPDF_Dict_AddName (image, "Type", "XObject");
+    ret += HPDF_Dict_AddName (image, "Subtype", "Image");
+    if (ret != HPDF_OK)
+        return NULL;
+
+    if (LoadJpxHeader (image, jpx_data) != HPDF_OK)
+        return NULL;
+
+    return image;
+}
+
+
+/*
+ * like HPDF_Image_LoadJpegImageFromFile, the data is read from the file
+ * when the document is saved.
+ */
+HPDF_Image
+HPDF_Image_LoadJpxImageFromFile  (HPDF_MMgr        mmgr,
+                                  const char      *filename,
+                                  HPDF_Xref        xref)
+{
+    HPDF_Stream jpx_data;
+    HPDF_Image image;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJpxImageFromFile\n"));
+
+    jpx_data = HPDF_DeferredReader_New (mmgr, filename);
+    if (!jpx_data)
+        return NULL;
+
+    image = JpxImage_New (mmgr, jpx_data, xref);
+    if (!image) {
+        HPDF_Stream_Free (jpx_data);
+        return NULL;
+    }
+
+    /* the file is opened again when the image is written */
+    HPDF_DeferredReader_Release (jpx_data);
+
+    HPDF_Stream_Free (image->stream);
+    image->stream = jpx_data;
+
+    return image;
+}
+
+
+HPDF_Image
+HPDF_Image_LoadJpxImageFromMem  (HPDF_MMgr          mmgr,
+                                 const HPDF_BYTE   *buf,
+                                 HPDF_UINT          size,
+                                 HPDF_Xref          xref)
+{
+    HPDF_Stream jpx_data;
+    HPDF_Image image;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadJpxImageFromMem\n"));
+
+    jpx_data = HPDF_MemStream_New (mmgr, HPDF_STREAM_BUF_SIZ);
+    if (!jpx_data)
+        return NULL;
+
+    if (HPDF_Stream_Write (jpx_data, buf, size) != HPDF_OK ||
+            HPDF_Stream_Seek (jpx_data, 0, HPDF_SEEK_SET) != HPDF_OK) {
+        HPDF_Stream_Free (jpx_data);
+        return NULL;
+    }
+
+    image = JpxImage_New (mmgr, jpx_data, xref);
+    if (!image) {
+        HPDF_Stream_Free (jpx_data);
+        return NULL;
+    }
+
+    HPDF_Stream_Free (image->stream);
+    image->stream = jpx_data;
+
+    return image;
+}
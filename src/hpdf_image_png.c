@@ -18,11 +18,16 @@
 #include "hpdf_conf.h"
 #include "hpdf_utils.h"
 #include "hpdf_image.h"
+#include "hpdf.h"
 
 #ifdef LIBHPDF_HAVE_LIBPNG
 #include <png.h>
 #include <string.h>
 
+#ifdef LIBHPDF_HAVE_ZLIB
+#include <zlib.h>
+#endif /* LIBHPDF_HAVE_ZLIB */
+
 static void
 PngErrorFunc  (png_structp       png_ptr,
                const char  *msg);
@@ -71,11 +76,8 @@ CreatePallet (HPDF_Dict    image,
 
 
 static HPDF_STATUS
-PngBeforeWrite  (HPDF_Dict obj);
-
-
-static HPDF_STATUS
-PngAfterWrite  (HPDF_Dict obj);
+PngLoadData  (HPDF_Image  image,
+              void        *param);
 
 
 /*---------------------------------------------------------------------------*/
@@ -174,61 +176,407 @@ ReadPngData  (HPDF_Dict    image,
     return image->error->error_no;
 }
 
+#ifdef LIBHPDF_HAVE_ZLIB
+/*
+ * copy the zlib stream of the IDAT chunks of the png into the image as it
+ * is. the rows of the image are decoded by the PNG predictor of FlateDecode,
+ * so the data does not have to be inflated and deflated again.
+ */
+static HPDF_STATUS
+ReadPngIdatData  (HPDF_Dict     image,
+                  HPDF_Stream   png_data)
+{
+    HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
+    HPDF_BOOL idat_found = HPDF_FALSE;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" ReadPngIdatData\n"));
+
+    if ((ret = HPDF_Stream_Seek (png_data, 8, HPDF_SEEK_SET)) != HPDF_OK)
+        return ret;
+
+    for (;;) {
+        HPDF_UINT32 chunk_len;
+        HPDF_UINT32 crc;
+        HPDF_UINT len = 8;
+
+        if (HPDF_Stream_Read (png_data, buf, &len) != HPDF_OK)
+            return HPDF_SetError (image->error, HPDF_INVALID_PNG_IMAGE, 0);
+
+        chunk_len = ((HPDF_UINT32)buf[0] << 24) | ((HPDF_UINT32)buf[1] << 16) |
+                ((HPDF_UINT32)buf[2] << 8) | (HPDF_UINT32)buf[3];
+        if (chunk_len > 0x7FFFFFFF)
+            return HPDF_SetError (image->error, HPDF_INVALID_PNG_IMAGE, 0);
+
+        if (HPDF_MemCmp (buf + 4, (const HPDF_BYTE *)"IDAT", 4) != 0) {
+            /* the IDAT chunks are consecutive */
+            if (idat_found || HPDF_MemCmp (buf + 4,
+                        (const HPDF_BYTE *)"IEND", 4) == 0)
+                break;
+
+            ret = HPDF_Stream_Seek (png_data, (HPDF_INT)chunk_len + 4,
+                    HPDF_SEEK_CUR);
+            if (ret != HPDF_OK)
+                return ret;
+
+            continue;
+        }
+
+        idat_found = HPDF_TRUE;
+        crc = crc32 (0L, buf + 4, 4);
+
+        while (chunk_len > 0) {
+            len = (chunk_len < HPDF_STREAM_BUF_SIZ) ? chunk_len :
+                    HPDF_STREAM_BUF_SIZ;
+
+            if (HPDF_Stream_Read (png_data, buf, &len) != HPDF_OK)
+                return HPDF_SetError (image->error, HPDF_INVALID_PNG_IMAGE, 0);
+
+            crc = crc32 (crc, buf, len);
+
+            if ((ret = HPDF_Stream_Write (image->stream, buf, len)) != HPDF_OK)
+                return ret;
+
+            chunk_len -= len;
+        }
+
+        len = 4;
+        if (HPDF_Stream_Read (png_data, buf, &len) != HPDF_OK ||
+                crc != (((HPDF_UINT32)buf[0] << 24) |
+                ((HPDF_UINT32)buf[1] << 16) | ((HPDF_UINT32)buf[2] << 8) |
+                (HPDF_UINT32)buf[3]))
+            return HPDF_SetError (image->error, HPDF_INVALID_PNG_IMAGE, 0);
+    }
+
+    if (!idat_found)
+        return HPDF_SetError (image->error, HPDF_INVALID_PNG_IMAGE, 0);
+
+    return HPDF_OK;
+}
+
+
+/* set the filter of an image whose data is the zlib stream of the png */
+static HPDF_STATUS
+SetPngIdatFilter  (HPDF_Dict     image,
+                   int           color_type,
+                   int           bit_depth,
+                   png_uint_32   width)
+{
+    HPDF_Array array;
+    HPDF_Dict parms;
+    HPDF_STATUS ret = HPDF_OK;
+
+    array = HPDF_Array_New (image->mmgr);
+    if (!array)
+        return HPDF_Error_GetCode (image->error);
+
+    if ((ret = HPDF_Dict_Add (image, "DecodeParms", array)) != HPDF_OK)
+        return ret;
+
+    parms = HPDF_Dict_New (image->mmgr);
+    if (!parms)
+        return HPDF_Error_GetCode (image->error);
+
+    if ((ret = HPDF_Array_Add (array, parms)) != HPDF_OK)
+        return ret;
+
+    ret += HPDF_Dict_AddNumber (parms, "Predictor", 15);
+    ret += HPDF_Dict_AddNumber (parms, "Colors",
+            (color_type == PNG_COLOR_TYPE_RGB) ? 3 : 1);
+    ret += HPDF_Dict_AddNumber (parms, "BitsPerComponent", bit_depth);
+    ret += HPDF_Dict_AddNumber (parms, "Columns", (HPDF_INT32)width);
+    if (ret != HPDF_OK)
+        return HPDF_Error_GetCode (image->error);
+
+    image->filter = HPDF_STREAM_FILTER_FLATE_DECODE |
+            HPDF_STREAM_FILTER_PREENCODED;
+
+    return HPDF_OK;
+}
+#endif /* LIBHPDF_HAVE_ZLIB */
+
+
+/* allocate the rows of the whole image for interlaced images, which can only
+ * be read at once. non-interlaced images are read one row at a time.
+ */
+static png_bytep *
+AllocPngRows  (HPDF_MMgr    mmgr,
+               png_uint_32  height,
+               png_uint_32  len)
+{
+	png_bytep *row_ptr;
+	HPDF_UINT i;
+
+	row_ptr = HPDF_GetMem (mmgr, height * sizeof(png_bytep));
+	if (!row_ptr)
+		return NULL;
+
+	for (i = 0; i < (HPDF_UINT)height; i++) {
+		row_ptr[i] = HPDF_GetMem(mmgr, len);
+		if (!row_ptr[i]) {
+			while (i > 0)
+				HPDF_FreeMem (mmgr, row_ptr[--i]);
+			HPDF_FreeMem (mmgr, row_ptr);
+			return NULL;
+		}
+	}
+
+	return row_ptr;
+}
+
+
+static void
+FreePngRows  (HPDF_MMgr    mmgr,
+              png_bytep    *row_ptr,
+              png_uint_32  height)
+{
+	HPDF_UINT i;
+
+	for (i = 0; i < (HPDF_UINT)height; i++)
+		HPDF_FreeMem (mmgr, row_ptr[i]);
+
+	HPDF_FreeMem (mmgr, row_ptr);
+}
+
+
+/* the rows with an alpha channel are split 16 pixels at a time with SSSE3
+ * (when the processor has it) or NEON. the remaining pixels are split by
+ * SplitAlphaRow.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+		(defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define HPDF_PNG_SSSE3
+#define HPDF_PNG_SSSE3_FUNC     __attribute__((target("ssse3")))
+#define HasSSSE3()              __builtin_cpu_supports ("ssse3")
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <tmmintrin.h>
+#define HPDF_PNG_SSSE3
+#define HPDF_PNG_SSSE3_FUNC
+
+static int
+HasSSSE3  (void)
+{
+	int info[4];
+
+	__cpuid (info, 1);
+	return (info[2] >> 9) & 1;
+}
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define HPDF_PNG_NEON
+#endif
+
+
+#ifdef HPDF_PNG_SSSE3
+HPDF_PNG_SSSE3_FUNC static png_uint_32
+SplitAlphaRowSSSE3  (const png_byte  *row,
+                     png_bytep       color,
+                     png_bytep       alpha,
+                     png_uint_32     width,
+                     png_byte        color_type)
+{
+	png_uint_32 i = 0;
+
+	if (color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+		const __m128i rgb = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10,
+				12, 13, 14, -1, -1, -1, -1);
+		const __m128i a = _mm_setr_epi8 (3, 7, 11, 15, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1);
+
+		for (; i + 16 <= width; i += 16) {
+			const __m128i *src = (const __m128i *)(row + 4 * i);
+			__m128i p0 = _mm_loadu_si128 (src);
+			__m128i p1 = _mm_loadu_si128 (src + 1);
+			__m128i p2 = _mm_loadu_si128 (src + 2);
+			__m128i p3 = _mm_loadu_si128 (src + 3);
+			__m128i c0 = _mm_shuffle_epi8 (p0, rgb);
+			__m128i c1 = _mm_shuffle_epi8 (p1, rgb);
+			__m128i c2 = _mm_shuffle_epi8 (p2, rgb);
+			__m128i c3 = _mm_shuffle_epi8 (p3, rgb);
+			__m128i *dst = (__m128i *)(color + 3 * i);
+
+			/* 4 x 12 bytes of color into 3 x 16 bytes */
+			_mm_storeu_si128 (dst, _mm_or_si128 (c0,
+					_mm_slli_si128 (c1, 12)));
+			_mm_storeu_si128 (dst + 1, _mm_or_si128 (_mm_srli_si128 (c1, 4),
+					_mm_slli_si128 (c2, 8)));
+			_mm_storeu_si128 (dst + 2, _mm_or_si128 (_mm_srli_si128 (c2, 8),
+					_mm_slli_si128 (c3, 4)));
+
+			_mm_storeu_si128 ((__m128i *)(alpha + i), _mm_unpacklo_epi64 (
+					_mm_unpacklo_epi32 (_mm_shuffle_epi8 (p0, a),
+						_mm_shuffle_epi8 (p1, a)),
+					_mm_unpacklo_epi32 (_mm_shuffle_epi8 (p2, a),
+						_mm_shuffle_epi8 (p3, a))));
+		}
+	} else {
+		const __m128i low = _mm_set1_epi16 (0x00FF);
+
+		for (; i + 16 <= width; i += 16) {
+			const __m128i *src = (const __m128i *)(row + 2 * i);
+			__m128i p0 = _mm_loadu_si128 (src);
+			__m128i p1 = _mm_loadu_si128 (src + 1);
+
+			_mm_storeu_si128 ((__m128i *)(color + i), _mm_packus_epi16 (
+					_mm_and_si128 (p0, low), _mm_and_si128 (p1, low)));
+			_mm_storeu_si128 ((__m128i *)(alpha + i), _mm_packus_epi16 (
+					_mm_srli_epi16 (p0, 8), _mm_srli_epi16 (p1, 8)));
+		}
+	}
+
+	return i;
+}
+#endif /* HPDF_PNG_SSSE3 */
+
+
+#ifdef HPDF_PNG_NEON
+static png_uint_32
+SplitAlphaRowNEON  (const png_byte  *row,
+                    png_bytep       color,
+                    png_bytep       alpha,
+                    png_uint_32     width,
+                    png_byte        color_type)
+{
+	png_uint_32 i = 0;
+
+	if (color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+		for (; i + 16 <= width; i += 16) {
+			uint8x16x4_t p = vld4q_u8 (row + 4 * i);
+			uint8x16x3_t c;
+
+			c.val[0] = p.val[0];
+			c.val[1] = p.val[1];
+			c.val[2] = p.val[2];
+			vst3q_u8 (color + 3 * i, c);
+			vst1q_u8 (alpha + i, p.val[3]);
+		}
+	} else {
+		for (; i + 16 <= width; i += 16) {
+			uint8x16x2_t p = vld2q_u8 (row + 2 * i);
+
+			vst1q_u8 (color + i, p.val[0]);
+			vst1q_u8 (alpha + i, p.val[1]);
+		}
+	}
+
+	return i;
+}
+#endif /* HPDF_PNG_NEON */
+
+
+/* split a row of pixels with alpha channel into the color and the alpha
+ * planes.
+ */
+static void
+SplitAlphaRow  (const png_byte * HPDF_RESTRICT  row,
+                png_bytep HPDF_RESTRICT         color,
+                png_bytep HPDF_RESTRICT         alpha,
+                png_uint_32                     width,
+                png_byte                        color_type)
+{
+	png_uint_32 i = 0;
+
+#if defined(HPDF_PNG_SSSE3)
+	if (HasSSSE3 ())
+		i = SplitAlphaRowSSSE3 (row, color, alpha, width, color_type);
+#elif defined(HPDF_PNG_NEON)
+	i = SplitAlphaRowNEON (row, color, alpha, width, color_type);
+#endif
+
+	/* the indexes are size_t, so that they can not wrap around and the
+	 * loops can be vectorized as well.
+	 */
+	if (color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+		size_t n;
+
+		for (n = i; n < width; n++) {
+			color[3 * n] = row[4 * n];
+			color[3 * n + 1] = row[4 * n + 1];
+			color[3 * n + 2] = row[4 * n + 2];
+			alpha[n] = row[4 * n + 3];
+		}
+	} else {
+		size_t n;
+
+		for (n = i; n < width; n++) {
+			color[n] = row[2 * n];
+			alpha[n] = row[2 * n + 1];
+		}
+	}
+}
+
+
 static HPDF_STATUS
 ReadTransparentPaletteData  (HPDF_Dict    image,
                              png_structp  png_ptr,
                              png_infop    info_ptr,
-                             png_bytep    smask_data,
+                             HPDF_Dict    smask,
                              png_bytep    trans,
                              int          num_trans)
 {
 	HPDF_STATUS ret = HPDF_OK;
 	HPDF_UINT i, j;
-	png_bytep *row_ptr;
+	png_bytep *row_ptr = NULL;
+	png_bytep row = NULL;
+	png_bytep smask_row;
 	png_uint_32 height = png_get_image_height(png_ptr, info_ptr);
 	png_uint_32 width = png_get_image_width(png_ptr, info_ptr);
+	png_uint_32 len = png_get_rowbytes(png_ptr, info_ptr);
+	png_byte alpha[256];
+
+	for (i = 0; i < 256; i++)
+		alpha[i] = ((int)i < num_trans) ? trans[i] : 0xFF;
 
-	row_ptr = HPDF_GetMem (image->mmgr, height * sizeof(png_bytep));
-	if (!row_ptr) {
+	smask_row = HPDF_GetMem (image->mmgr, width);
+	if (!smask_row)
 		return HPDF_FAILD_TO_ALLOC_MEM;
-	} else {
-		png_uint_32 len = png_get_rowbytes(png_ptr, info_ptr);
-
-		for (i = 0; i < (HPDF_UINT)height; i++) {
-			row_ptr[i] = HPDF_GetMem(image->mmgr, len);
-			if (!row_ptr[i]) {
-				for (; i > 0; i--) {
-					HPDF_FreeMem (image->mmgr, row_ptr[i]);
-				}
-				HPDF_FreeMem (image->mmgr, row_ptr);
-				return HPDF_FAILD_TO_ALLOC_MEM;
-			}
+
+	if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE) {
+		row_ptr = AllocPngRows (image->mmgr, height, len);
+		if (!row_ptr) {
+			ret = HPDF_FAILD_TO_ALLOC_MEM;
+			goto Error;
 		}
-	}
 
-	png_read_image(png_ptr, row_ptr);
-	if (image->error->error_no != HPDF_OK) {
-		ret = HPDF_INVALID_PNG_IMAGE;
-		goto Error;
+		png_read_image(png_ptr, row_ptr);
+	} else {
+		row = HPDF_GetMem (image->mmgr, len);
+		if (!row) {
+			ret = HPDF_FAILD_TO_ALLOC_MEM;
+			goto Error;
+		}
 	}
 
 	for (j = 0; j < height; j++) {
-		for (i = 0; i < width; i++) {
-			smask_data[width * j + i] = (row_ptr[j][i] < num_trans) ? trans[row_ptr[j][i]] : 0xFF;
+		if (row_ptr)
+			row = row_ptr[j];
+		else
+			png_read_rows(png_ptr, (png_byte**)&row, NULL, 1);
+
+		if (image->error->error_no != HPDF_OK) {
+			ret = HPDF_INVALID_PNG_IMAGE;
+			goto Error;
 		}
 
-		if (HPDF_Stream_Write (image->stream, row_ptr[j], width) != HPDF_OK) {
+		for (i = 0; i < width; i++)
+			smask_row[i] = alpha[row[i]];
+
+		if (HPDF_Stream_Write (image->stream, row, width) != HPDF_OK ||
+				HPDF_Stream_Write (smask->stream, smask_row, width) != HPDF_OK) {
 			ret = HPDF_FILE_IO_ERROR;
 			goto Error;
 		}
 	}
 
 Error:
-	for (i = 0; i < (HPDF_UINT)height; i++) {
-		HPDF_FreeMem (image->mmgr, row_ptr[i]);
-	}
+	if (row_ptr)
+		FreePngRows (image->mmgr, row_ptr, height);
+	else if (row)
+		HPDF_FreeMem (image->mmgr, row);
 
-	HPDF_FreeMem (image->mmgr, row_ptr);
+	HPDF_FreeMem (image->mmgr, smask_row);
 	return ret;
 }
 
@@ -236,88 +584,78 @@ static HPDF_STATUS
 ReadTransparentPngData  (HPDF_Dict    image,
                          png_structp  png_ptr,
                          png_infop    info_ptr,
-                         png_bytep    smask_data)
+                         HPDF_Dict    smask)
 {
 	HPDF_STATUS ret = HPDF_OK;
-	HPDF_INT row_len;
-	HPDF_UINT i, j;
-	png_bytep *row_ptr, row;
+	HPDF_UINT j;
+	png_bytep *row_ptr = NULL;
+	png_bytep row = NULL;
+	png_bytep color_row;
 	png_byte color_type;
 	png_uint_32 height = png_get_image_height(png_ptr, info_ptr);
 	png_uint_32 width = png_get_image_width(png_ptr, info_ptr);
+	png_uint_32 len = png_get_rowbytes(png_ptr, info_ptr);
+	png_uint_32 color_len;
 
 	color_type = png_get_color_type(png_ptr, info_ptr);
 
-	if (!(color_type & PNG_COLOR_MASK_ALPHA)) {
+	if (color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+		color_len = 3 * width;
+	else if (color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+		color_len = width;
+	else
 		return HPDF_INVALID_PNG_IMAGE;
-	}
 
-	row_ptr = HPDF_GetMem (image->mmgr, height * sizeof(png_bytep));
-	if (!row_ptr) {
+	/* the color plane and the alpha plane of a row are kept in one buffer */
+	color_row = HPDF_GetMem (image->mmgr, color_len + width);
+	if (!color_row)
 		return HPDF_FAILD_TO_ALLOC_MEM;
+
+	if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE) {
+		row_ptr = AllocPngRows (image->mmgr, height, len);
+		if (!row_ptr) {
+			ret = HPDF_FAILD_TO_ALLOC_MEM;
+			goto Error;
+		}
+
+		png_read_image(png_ptr, row_ptr);
 	} else {
-		png_uint_32 len = png_get_rowbytes(png_ptr, info_ptr);
-
-		for (i = 0; i < (HPDF_UINT)height; i++) {
-			row_ptr[i] = HPDF_GetMem(image->mmgr, len);
-			if (!row_ptr[i]) {
-				for (; i > 0; i--) {
-					HPDF_FreeMem (image->mmgr, row_ptr[i]);
-				}
-				HPDF_FreeMem (image->mmgr, row_ptr);
-				return HPDF_FAILD_TO_ALLOC_MEM;
-			}
+		row = HPDF_GetMem (image->mmgr, len);
+		if (!row) {
+			ret = HPDF_FAILD_TO_ALLOC_MEM;
+			goto Error;
 		}
 	}
 
-	png_read_image(png_ptr, row_ptr);
-	if (image->error->error_no != HPDF_OK) {
-		ret = HPDF_INVALID_PNG_IMAGE;
-		goto Error;
-	}
+	for (j = 0; j < height; j++) {
+		if (row_ptr)
+			row = row_ptr[j];
+		else
+			png_read_rows(png_ptr, (png_byte**)&row, NULL, 1);
 
-	switch (color_type) {
-		case PNG_COLOR_TYPE_RGB_ALPHA:
-			row_len = 3 * width * sizeof(png_byte);
-			for (j = 0; j < height; j++) {
-				row = row_ptr[j];
-				for (i = 0; i < width; i++) {
-					memmove(row + (3 * i), row + (4*i), 3);
-					smask_data[width * j + i] = row[4 * i + 3];
-				}
-
-				if (HPDF_Stream_Write (image->stream, row, row_len) != HPDF_OK) {
-					ret = HPDF_FILE_IO_ERROR;
-					goto Error;
-				}
-			}
-			break;
-		case PNG_COLOR_TYPE_GRAY_ALPHA:
-			row_len = width * sizeof(png_byte);
-			for (j = 0; j < height; j++) {
-				row = row_ptr[j];
-				for (i = 0; i < width; i++) {
-					row[i] = row[2 * i];
-					smask_data[width * j + i] = row[2 * i + 1];
-				}
-
-				if (HPDF_Stream_Write (image->stream, row, row_len) != HPDF_OK) {
-					ret = HPDF_FILE_IO_ERROR;
-					goto Error;
-				}
-			}
-			break;
-		default:
+		if (image->error->error_no != HPDF_OK) {
 			ret = HPDF_INVALID_PNG_IMAGE;
 			goto Error;
+		}
+
+		SplitAlphaRow (row, color_row, color_row + color_len, width,
+				color_type);
+
+		if (HPDF_Stream_Write (image->stream, color_row, color_len) != HPDF_OK ||
+				HPDF_Stream_Write (smask->stream, color_row + color_len,
+				width) != HPDF_OK) {
+			ret = HPDF_FILE_IO_ERROR;
+			goto Error;
+		}
 	}
 
 Error:
-	for (i = 0; i < (HPDF_UINT)height; i++) {
-		HPDF_FreeMem (image->mmgr, row_ptr[i]);
-	}
+	if (row_ptr)
+		FreePngRows (image->mmgr, row_ptr, height);
+	else if (row)
+		HPDF_FreeMem (image->mmgr, row);
 
-	HPDF_FreeMem (image->mmgr, row_ptr);
+	HPDF_FreeMem (image->mmgr, color_row);
 	return ret;
 }
 
@@ -426,6 +764,7 @@ LoadPngData  (HPDF_Dict     image,
 	int bit_depth, color_type;
 	png_structp png_ptr = NULL;
 	png_infop info_ptr = NULL;
+	HPDF_BOOL idat = HPDF_FALSE;
 
 	HPDF_PTRACE ((" HPDF_Image_LoadPngImage\n"));
 
@@ -457,12 +796,27 @@ LoadPngData  (HPDF_Dict     image,
 
 	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, NULL, NULL, NULL);
 
+#ifdef LIBHPDF_HAVE_ZLIB
+	/* the data of non-interlaced images without alpha channel can be
+	 * embedded without decoding it.
+	 */
+	if (bit_depth != 16 && !(color_type & PNG_COLOR_MASK_ALPHA) &&
+			png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE)
+		idat = HPDF_TRUE;
+#endif /* LIBHPDF_HAVE_ZLIB */
+
 	/* 16bit images are not supported. */
 	if (bit_depth == 16) {
 		png_set_strip_16(png_ptr);
 		bit_depth = 8;
 	}
 
+	/* interlaced images are read by png_read_image, which needs the
+	 * interlace handling to be set up before the info is updated.
+	 */
+	if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE)
+		png_set_interlace_handling(png_ptr);
+
 	png_read_update_info(png_ptr, info_ptr);
 	if (image->error->error_no != HPDF_OK) {
 		goto Exit;
@@ -473,13 +827,15 @@ LoadPngData  (HPDF_Dict     image,
 		png_bytep trans;
 		int num_trans;
 		HPDF_Dict smask;
-		png_bytep smask_data;
 
 		if (!png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) ||
 			!png_get_tRNS(png_ptr, info_ptr, &trans, &num_trans, NULL)) {
 			goto no_transparent_color_in_palette;
 		}
 
+		/* the mask is owned by the xref from here on, so it must not be
+		 * freed on errors.
+		 */
 		smask = HPDF_DictStream_New (image->mmgr, xref);
 		if (!smask) {
 			ret = HPDF_FAILD_TO_ALLOC_MEM;
@@ -495,33 +851,18 @@ LoadPngData  (HPDF_Dict     image,
 		ret += HPDF_Dict_AddNumber (smask, "BitsPerComponent", (HPDF_UINT)bit_depth);
 
 		if (ret != HPDF_OK) {
-			HPDF_Dict_Free(smask);
 			ret = HPDF_INVALID_PNG_IMAGE;
 			goto Exit;
 		}
 
-		smask_data = HPDF_GetMem(image->mmgr, width * height);
-		if (!smask_data) {
-			HPDF_Dict_Free(smask);
-			ret = HPDF_FAILD_TO_ALLOC_MEM;
-			goto Exit;
-		}
-
-		if (ReadTransparentPaletteData(image, png_ptr, info_ptr, smask_data, trans, num_trans) != HPDF_OK) {
-			HPDF_FreeMem(image->mmgr, smask_data);
-			HPDF_Dict_Free(smask);
+		/* the rows of the image and of the mask are written to their streams
+		 * as they are decoded.
+		 */
+		if (ReadTransparentPaletteData(image, png_ptr, info_ptr, smask, trans, num_trans) != HPDF_OK) {
 			ret = HPDF_INVALID_PNG_IMAGE;
 			goto Exit;
 		}
 
-		if (HPDF_Stream_Write(smask->stream, smask_data, width * height) != HPDF_OK) {
-			HPDF_FreeMem(image->mmgr, smask_data);
-			HPDF_Dict_Free(smask);
-			ret = HPDF_FILE_IO_ERROR;
-			goto Exit;
-		}
-		HPDF_FreeMem(image->mmgr, smask_data);
-
 
 		ret += CreatePallet(image, png_ptr, info_ptr);
 		ret += HPDF_Dict_AddNumber (image, "Width", (HPDF_UINT)width);
@@ -539,7 +880,6 @@ no_transparent_color_in_palette:
 	   we have to do this because image transparent mask must be added to the Xref */
 	if (xref && PNG_COLOR_MASK_ALPHA & color_type) {
 		HPDF_Dict smask;
-		png_bytep smask_data;
 
 		smask = HPDF_DictStream_New (image->mmgr, xref);
 		if (!smask) {
@@ -558,33 +898,18 @@ no_transparent_color_in_palette:
 		ret += HPDF_Dict_AddNumber (smask, "BitsPerComponent", (HPDF_UINT)bit_depth);
 
 		if (ret != HPDF_OK) {
-			HPDF_Dict_Free(smask);
 			ret = HPDF_INVALID_PNG_IMAGE;
 			goto Exit;
 		}
 
-		smask_data = HPDF_GetMem(image->mmgr, width * height);
-		if (!smask_data) {
-			HPDF_Dict_Free(smask);
-			ret = HPDF_FAILD_TO_ALLOC_MEM;
-			goto Exit;
-		}
-
-		if (ReadTransparentPngData(image, png_ptr, info_ptr, smask_data) != HPDF_OK) {
-			HPDF_FreeMem(image->mmgr, smask_data);
-			HPDF_Dict_Free(smask);
+		/* the rows of the image and of the mask are written to their streams
+		 * as they are decoded.
+		 */
+		if (ReadTransparentPngData(image, png_ptr, info_ptr, smask) != HPDF_OK) {
 			ret = HPDF_INVALID_PNG_IMAGE;
 			goto Exit;
 		}
 
-		if (HPDF_Stream_Write(smask->stream, smask_data, width * height) != HPDF_OK) {
-			HPDF_FreeMem(image->mmgr, smask_data);
-			HPDF_Dict_Free(smask);
-			ret = HPDF_FILE_IO_ERROR;
-			goto Exit;
-		}
-		HPDF_FreeMem(image->mmgr, smask_data);
-
 		if (color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
 			ret += HPDF_Dict_AddName (image, "ColorSpace", "DeviceGray");
 		} else {
@@ -612,14 +937,28 @@ no_transparent_color_in_palette:
 	if (ret != HPDF_OK)
 		goto Exit;
 
+#ifdef LIBHPDF_HAVE_ZLIB
+	if (idat) {
+		ret = SetPngIdatFilter(image, color_type, bit_depth, width);
+		if (ret != HPDF_OK)
+			goto Exit;
+	}
+#endif /* LIBHPDF_HAVE_ZLIB */
+
 	/* read image-data
 	 * if the image is interlaced, read whole image at once.
 	 * if delayed_loading is HPDF_TRUE, the data does not load this phase.
 	 */
 	if (delayed_loading) {
-		image->before_write_fn = PngBeforeWrite;
-		image->after_write_fn = PngAfterWrite;
+		ret = HPDF_Image_SetDelayedLoading (image, PngLoadData, NULL, 0);
+		if (ret != HPDF_OK)
+			goto Exit;
 	} else {
+#ifdef LIBHPDF_HAVE_ZLIB
+		if (idat)
+			ret = ReadPngIdatData(image, png_data);
+		else
+#endif /* LIBHPDF_HAVE_ZLIB */
 		if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE)
 			ret = ReadPngData_Interlaced(image, png_ptr, info_ptr);
 		else
@@ -657,8 +996,10 @@ Exit:
 }
 
 
+/* load the data of a delayed loading image from the file. */
 static HPDF_STATUS
-PngBeforeWrite  (HPDF_Dict obj)
+PngLoadData  (HPDF_Image  obj,
+              void        *param)
 {
     HPDF_STATUS ret;
     png_byte header[HPDF_PNG_BYTES_TO_CHECK];
@@ -666,9 +1007,9 @@ PngBeforeWrite  (HPDF_Dict obj)
     HPDF_Stream png_data;
     HPDF_String s;
 
-    HPDF_PTRACE ((" PngBeforeWrite\n"));
+    HPDF_PTRACE ((" PngLoadData\n"));
 
-    HPDF_MemStream_FreeData(obj->stream);
+    HPDF_UNUSED (param);
 
     s = HPDF_Dict_GetItem (obj, "_FILE_NAME", HPDF_OCLASS_STRING);
     if (!s)
@@ -697,15 +1038,4 @@ PngBeforeWrite  (HPDF_Dict obj)
 }
 
 
-static HPDF_STATUS
-PngAfterWrite  (HPDF_Dict obj)
-{
-   HPDF_PTRACE ((" PngAfterWrite\n"));
-
-   HPDF_MemStream_FreeData(obj->stream);
-
-   return HPDF_OK;
-}
-
-
 #endif /* LIBHPDF_HAVE_PNGLIB */
@@ -0,0 +1,535 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_image_prepared.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_image.h"
+#include "hpdf.h"
+
+/*
+ *  A prepared image is an image object which is loaded outside of any
+ *  document. It has its own memory manager, error object and xref, so
+ *  that images can be decoded (and compressed) on any thread while the
+ *  document is used on another one. HPDF_AttachPreparedImage copies the
+ *  objects of the image, and the data of their streams, into a document:
+ *  the decoding is done once, the copy is done for each document.
+ */
+
+static HPDF_PreparedImage
+PreparedImage_New  (HPDF_Error_Handler   user_error_fn,
+                    void                *user_data);
+
+
+static HPDF_PreparedImage
+PreparedImage_Done  (HPDF_PreparedImage  prep,
+                     HPDF_Image          image);
+
+
+static void*
+CopyObject  (HPDF_MMgr   mmgr,
+             HPDF_Xref   xref,
+             void        *obj);
+
+
+static HPDF_PreparedImage
+PreparedImage_New  (HPDF_Error_Handler   user_error_fn,
+                    void                *user_data)
+{
+    HPDF_PreparedImage prep;
+    HPDF_MMgr mmgr;
+    HPDF_Error_Rec tmp_error;
+
+    HPDF_PTRACE ((" PreparedImage_New\n"));
+
+    /* initialize temporary-error object */
+    HPDF_Error_Init (&tmp_error, user_data);
+
+    mmgr = HPDF_MMgr_New (&tmp_error, 0, NULL, NULL);
+    if (!mmgr) {
+        HPDF_CheckError (&tmp_error);
+        return NULL;
+    }
+
+    prep = HPDF_GetMem (mmgr, sizeof(HPDF_PreparedImage_Rec));
+    if (!prep) {
+        HPDF_MMgr_Free (mmgr);
+        HPDF_CheckError (&tmp_error);
+        return NULL;
+    }
+
+    HPDF_MemSet (prep, 0, sizeof(HPDF_PreparedImage_Rec));
+    prep->sig_bytes = HPDF_PREPARED_IMAGE_SIG_BYTES;
+    prep->mmgr = mmgr;
+    prep->error = tmp_error;
+    prep->error.error_fn = user_error_fn;
+
+    mmgr->error = &prep->error;
+
+    prep->xref = HPDF_Xref_New (mmgr, 0);
+    if (!prep->xref) {
+        HPDF_CheckError (&prep->error);
+        HPDF_FreePreparedImage (prep);
+        return NULL;
+    }
+
+    return prep;
+}
+
+
+static HPDF_PreparedImage
+PreparedImage_Done  (HPDF_PreparedImage  prep,
+                     HPDF_Image          image)
+{
+    if (!image) {
+        HPDF_CheckError (&prep->error);
+        HPDF_FreePreparedImage (prep);
+        return NULL;
+    }
+
+    prep->image = image;
+
+    return prep;
+}
+
+
+#ifdef LIBHPDF_HAVE_ZLIB
+/* replace the data of a stream object with its deflated data */
+static HPDF_STATUS
+DeflateImageData  (HPDF_Dict  obj)
+{
+    HPDF_Stream stream;
+    HPDF_STATUS ret;
+
+    if (obj->filter & (HPDF_STREAM_FILTER_PREENCODED |
+                HPDF_STREAM_FILTER_DCT_DECODE))
+        return HPDF_OK;
+
+    stream = HPDF_MemStream_New (obj->mmgr, HPDF_STREAM_BUF_SIZ);
+    if (!stream)
+        return HPDF_Error_GetCode (obj->error);
+
+    ret = HPDF_Stream_WriteToStream (obj->stream, stream,
+            HPDF_STREAM_FILTER_FLATE_DECODE, NULL);
+    if (ret != HPDF_OK) {
+        HPDF_Stream_Free (stream);
+        return ret;
+    }
+
+    HPDF_Stream_Free (obj->stream);
+    obj->stream = stream;
+    obj->filter = HPDF_STREAM_FILTER_FLATE_DECODE |
+            HPDF_STREAM_FILTER_PREENCODED;
+
+    return HPDF_OK;
+}
+#endif /* LIBHPDF_HAVE_ZLIB */
+
+
+HPDF_EXPORT(HPDF_PreparedImage)
+HPDF_PreparePngImageFromFile  (const char          *filename,
+                               HPDF_BOOL            compress,
+                               HPDF_Error_Handler   user_error_fn,
+                               void                *user_data)
+{
+    HPDF_PreparedImage prep;
+    HPDF_Image image = NULL;
+
+    HPDF_PTRACE ((" HPDF_PreparePngImageFromFile\n"));
+
+    prep = PreparedImage_New (user_error_fn, user_data);
+    if (!prep)
+        return NULL;
+
+#ifdef LIBHPDF_HAVE_LIBPNG
+    {
+        HPDF_Stream imagedata = HPDF_FileReader_New (prep->mmgr, filename);
+
+        if (HPDF_Stream_Validate (imagedata))
+            image = HPDF_Image_LoadPngImage (prep->mmgr, imagedata,
+                    prep->xref, HPDF_FALSE);
+
+        if (imagedata)
+            HPDF_Stream_Free (imagedata);
+    }
+
+#ifdef LIBHPDF_HAVE_ZLIB
+    if (image && compress) {
+        HPDF_Dict smask = HPDF_Dict_GetItem (image, "SMask", HPDF_OCLASS_DICT);
+
+        if (DeflateImageData (image) != HPDF_OK ||
+                (smask && DeflateImageData (smask) != HPDF_OK))
+            image = NULL;
+    }
+#endif /* LIBHPDF_HAVE_ZLIB */
+#else
+    HPDF_SetError (&prep->error, HPDF_UNSUPPORTED_FUNC, 0);
+    HPDF_UNUSED (filename);
+#endif /* LIBHPDF_HAVE_LIBPNG */
+    HPDF_UNUSED (compress);
+
+    return PreparedImage_Done (prep, image);
+}
+
+
+HPDF_EXPORT(HPDF_PreparedImage)
+HPDF_PrepareJpegImageFromFile  (const char          *filename,
+                                HPDF_Error_Handler   user_error_fn,
+                                void                *user_data)
+{
+    HPDF_PreparedImage prep;
+    HPDF_Stream imagedata;
+    HPDF_Image image = NULL;
+
+    HPDF_PTRACE ((" HPDF_PrepareJpegImageFromFile\n"));
+
+    prep = PreparedImage_New (user_error_fn, user_data);
+    if (!prep)
+        return NULL;
+
+    /* the data is read here, the prepared image does not keep the file. */
+    imagedata = HPDF_FileReader_New (prep->mmgr, filename);
+
+    if (HPDF_Stream_Validate (imagedata))
+        image = HPDF_Image_LoadJpegImage (prep->mmgr, imagedata, prep->xref);
+
+    if (imagedata)
+        HPDF_Stream_Free (imagedata);
+
+    return PreparedImage_Done (prep, image);
+}
+
+
+/*
+ *  the data is encoded right away, so buf does not have to be valid after
+ *  this function returns. pages of a scan can be encoded on several threads
+ *  with this function.
+ */
+HPDF_EXPORT(HPDF_PreparedImage)
+HPDF_PrepareRaw1BitImageFromMem  (const HPDF_BYTE     *buf,
+                                  HPDF_UINT            width,
+                                  HPDF_UINT            height,
+                                  HPDF_UINT            line_width,
+                                  HPDF_BOOL            black_is1,
+                                  HPDF_BOOL            top_is_first,
+                                  HPDF_Error_Handler   user_error_fn,
+                                  void                *user_data)
+{
+    HPDF_PreparedImage prep;
+    HPDF_Image image;
+
+    HPDF_PTRACE ((" HPDF_PrepareRaw1BitImageFromMem\n"));
+
+    prep = PreparedImage_New (user_error_fn, user_data);
+    if (!prep)
+        return NULL;
+
+    image = HPDF_Image_Load1BitImageFromMem (prep->mmgr, buf, prep->xref,
+            width, height, line_width, black_is1, top_is_first, HPDF_FALSE);
+
+    return PreparedImage_Done (prep, image);
+}
+
+
+/*
+ *  HPDF_PreparedImage_Downsample
+ *
+ *  Reduces the pixels of a prepared raw or PNG image with
+ *  HPDF_Image_Downsample, so that the documents it is attached to get the
+ *  smaller data. The data which was deflated while preparing is deflated
+ *  again. It must not be called while the image is attached on another
+ *  thread.
+ *
+ */
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_PreparedImage_Downsample  (HPDF_PreparedImage    image,
+                                HPDF_UINT             width,
+                                HPDF_UINT             height,
+                                HPDF_ResampleFilter   filter)
+{
+    HPDF_BOOL compressed;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_PreparedImage_Downsample\n"));
+
+    if (!image || image->sig_bytes != HPDF_PREPARED_IMAGE_SIG_BYTES ||
+            !image->image)
+        return HPDF_INVALID_IMAGE;
+
+    compressed = (image->image->filter & HPDF_STREAM_FILTER_PREENCODED) &&
+            !(image->image->filter & (HPDF_STREAM_FILTER_DCT_DECODE |
+                                      HPDF_STREAM_FILTER_CCITT_DECODE));
+
+    if ((ret = HPDF_Image_Downsample (image->image, width, height, filter)) !=
+            HPDF_OK)
+        return ret;
+
+#ifdef LIBHPDF_HAVE_ZLIB
+    if (compressed) {
+        HPDF_Dict smask = HPDF_Dict_GetItem (image->image, "SMask",
+                HPDF_OCLASS_DICT);
+
+        if (DeflateImageData (image->image) != HPDF_OK ||
+                (smask && DeflateImageData (smask) != HPDF_OK))
+            return HPDF_CheckError (&image->error);
+    }
+#else
+    HPDF_UNUSED (compressed);
+#endif /* LIBHPDF_HAVE_ZLIB */
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  HPDF_AttachPreparedImage
+ *
+ *  Copies the objects of a prepared image into the document. The prepared
+ *  image is not modified, so that it can be attached to more than one
+ *  document, and must be freed by HPDF_FreePreparedImage.
+ *
+ */
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_AttachPreparedImage  (HPDF_Doc             pdf,
+                           HPDF_PreparedImage   image)
+{
+    HPDF_Image obj;
+    HPDF_UINT obj_count;
+
+    HPDF_PTRACE ((" HPDF_AttachPreparedImage\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    if (!image || image->sig_bytes != HPDF_PREPARED_IMAGE_SIG_BYTES ||
+            !image->image) {
+        HPDF_RaiseError (&pdf->error, HPDF_INVALID_IMAGE, 0);
+        return NULL;
+    }
+
+    obj_count = pdf->xref->entries->count;
+
+    obj = CopyObject (pdf->mmgr, pdf->xref, image->image);
+    if (!obj) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    if (pdf->compression_mode & HPDF_COMP_IMAGE) {
+        HPDF_Dict smask = HPDF_Dict_GetItem (obj, "SMask", HPDF_OCLASS_DICT);
+
+        if (!(obj->filter & (HPDF_STREAM_FILTER_DCT_DECODE |
+                        HPDF_STREAM_FILTER_CCITT_DECODE)))
+            obj->filter |= HPDF_STREAM_FILTER_FLATE_DECODE;
+
+        if (smask)
+            smask->filter |= HPDF_STREAM_FILTER_FLATE_DECODE;
+    }
+
+    return HPDF_Doc_DedupImage (pdf, obj, obj_count);
+}
+
+
+HPDF_EXPORT(void)
+HPDF_FreePreparedImage  (HPDF_PreparedImage  image)
+{
+    HPDF_MMgr mmgr;
+
+    HPDF_PTRACE ((" HPDF_FreePreparedImage\n"));
+
+    if (!image || image->sig_bytes != HPDF_PREPARED_IMAGE_SIG_BYTES)
+        return;
+
+    mmgr = image->mmgr;
+
+    if (image->xref)
+        HPDF_Xref_Free (image->xref);
+
+    image->sig_bytes = 0;
+    HPDF_FreeMem (mmgr, image);
+    HPDF_MMgr_Free (mmgr);
+}
+
+
+/* copy the data of a stream without moving the position of the source. */
+static HPDF_STATUS
+CopyStreamData  (HPDF_Stream  src,
+                 HPDF_Stream  dst)
+{
+    HPDF_UINT count = HPDF_MemStream_GetBufCount (src);
+    HPDF_UINT i;
+
+    if (src->type != HPDF_STREAM_MEMORY)
+        return HPDF_SetError (dst->error, HPDF_INVALID_STREAM, 0);
+
+    for (i = 0; i < count; i++) {
+        HPDF_UINT len;
+        HPDF_BYTE *buf = HPDF_MemStream_GetBufPtr (src, i, &len);
+        HPDF_STATUS ret;
+
+        if (!buf)
+            return HPDF_SetError (dst->error, HPDF_INVALID_STREAM, 0);
+
+        if ((ret = HPDF_Stream_Write (dst, buf, len)) != HPDF_OK)
+            return ret;
+    }
+
+    return HPDF_OK;
+}
+
+
+static HPDF_Dict
+CopyDict  (HPDF_MMgr   mmgr,
+           HPDF_Xref   xref,
+           HPDF_Dict   src)
+{
+    HPDF_Dict dict;
+    HPDF_UINT i;
+
+    if (src->stream) {
+        dict = HPDF_DictStream_New (mmgr, xref);
+        if (!dict)
+            return NULL;
+
+        dict->filter = src->filter;
+        if (CopyStreamData (src->stream, dict->stream) != HPDF_OK)
+            return NULL;
+    } else {
+        dict = HPDF_Dict_New (mmgr);
+        if (!dict)
+            return NULL;
+    }
+
+    dict->header.obj_class = src->header.obj_class;
+
+    if (src->filterParams) {
+        dict->filterParams = CopyDict (mmgr, xref, src->filterParams);
+        if (!dict->filterParams)
+            goto Fail;
+    }
+
+    for (i = 0; i < src->list->count; i++) {
+        HPDF_DictElement element =
+                (HPDF_DictElement)HPDF_List_ItemAt (src->list, i);
+        void *value;
+
+        /* the length object is created by HPDF_DictStream_New */
+        if (src->stream && HPDF_StrCmp (element->key, "Length") == 0)
+            continue;
+
+        value = CopyObject (mmgr, xref, element->value);
+        if (!value || HPDF_Dict_Add (dict, element->key, value) != HPDF_OK)
+            goto Fail;
+    }
+
+    return dict;
+
+Fail:
+    if (!src->stream)
+        HPDF_Dict_Free (dict);
+
+    return NULL;
+}
+
+
+static HPDF_Array
+CopyArray  (HPDF_MMgr    mmgr,
+            HPDF_Xref    xref,
+            HPDF_Array   src)
+{
+    HPDF_Array array = HPDF_Array_New (mmgr);
+    HPDF_UINT i;
+
+    if (!array)
+        return NULL;
+
+    for (i = 0; i < src->list->count; i++) {
+        void *value = CopyObject (mmgr, xref, HPDF_List_ItemAt (src->list, i));
+
+        if (!value || HPDF_Array_Add (array, value) != HPDF_OK) {
+            HPDF_Array_Free (array);
+            return NULL;
+        }
+    }
+
+    return array;
+}
+
+
+/* copy an object (and the objects referred by it) into xref. */
+static void*
+CopyObject  (HPDF_MMgr   mmgr,
+             HPDF_Xref   xref,
+             void        *obj)
+{
+    HPDF_Obj_Header *header = (HPDF_Obj_Header *)obj;
+    HPDF_Obj_Header *new_header;
+    void *new_obj;
+
+    if ((header->obj_class & HPDF_OCLASS_ANY) == HPDF_OCLASS_PROXY)
+        return CopyObject (mmgr, xref, ((HPDF_Proxy)obj)->obj);
+
+    switch (header->obj_class & HPDF_OCLASS_ANY) {
+        case HPDF_OCLASS_NULL:
+            new_obj = HPDF_Null_New (mmgr);
+            break;
+        case HPDF_OCLASS_BOOLEAN:
+            new_obj = HPDF_Boolean_New (mmgr, ((HPDF_Boolean)obj)->value);
+            break;
+        case HPDF_OCLASS_NUMBER:
+            new_obj = HPDF_Number_New (mmgr, ((HPDF_Number)obj)->value);
+            break;
+        case HPDF_OCLASS_REAL:
+            new_obj = HPDF_Real_New (mmgr, ((HPDF_Real)obj)->value);
+            break;
+        case HPDF_OCLASS_NAME:
+            new_obj = HPDF_Name_New (mmgr, ((HPDF_Name)obj)->value);
+            break;
+        case HPDF_OCLASS_STRING:
+            new_obj = HPDF_String_New (mmgr,
+                    (const char *)((HPDF_String)obj)->value, NULL);
+            break;
+        case HPDF_OCLASS_BINARY:
+            new_obj = HPDF_Binary_New (mmgr, ((HPDF_Binary)obj)->value,
+                    ((HPDF_Binary)obj)->len);
+            break;
+        case HPDF_OCLASS_ARRAY:
+            new_obj = CopyArray (mmgr, xref, (HPDF_Array)obj);
+            break;
+        case HPDF_OCLASS_DICT:
+            new_obj = CopyDict (mmgr, xref, (HPDF_Dict)obj);
+            break;
+        default:
+            HPDF_SetError (mmgr->error, HPDF_INVALID_OBJECT, 0);
+            return NULL;
+    }
+
+    if (!new_obj)
+        return NULL;
+
+    new_header = (HPDF_Obj_Header *)new_obj;
+    new_header->obj_id |= header->obj_id & HPDF_OTYPE_HIDDEN;
+
+    /* stream objects are added to xref by HPDF_DictStream_New */
+    if ((header->obj_id & HPDF_OTYPE_INDIRECT) &&
+            !(new_header->obj_id & HPDF_OTYPE_INDIRECT) &&
+            HPDF_Xref_Add (xref, new_obj) != HPDF_OK)
+        return NULL;
+
+    return new_obj;
+}
@@ -0,0 +1,1056 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_image_resample.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "hpdf_conf.h"
+#include "hpdf_utils.h"
+#include "hpdf_image.h"
+#include "hpdf.h"
+#include <math.h>
+
+#ifdef LIBHPDF_HAVE_ZLIB
+#include <zlib.h>
+#endif /* LIBHPDF_HAVE_ZLIB */
+
+#ifndef M_PI
+#define M_PI       3.14159265358979323846
+#endif
+
+static const char *COL_CMYK = "DeviceCMYK";
+static const char *COL_RGB = "DeviceRGB";
+static const char *COL_GRAY = "DeviceGray";
+
+/*
+ *  Images are downsampled in two passes. The rows are scaled horizontally
+ *  as they are read from the stream of the image, then the columns of the
+ *  result are scaled vertically. Only the rows in the support of the
+ *  vertical filter are kept. The weights of the filters are fixed point
+ *  numbers with RESAMPLE_PRECISION bits, which leaves room for the sums of
+ *  8 bit samples in 32 bit integers.
+ */
+
+#define RESAMPLE_PRECISION  22
+
+typedef struct _HPDF_Resampler_Rec {
+    HPDF_UINT    out_size;
+    HPDF_UINT    taps;       /* max count of the weights of a sample */
+    HPDF_UINT   *first;      /* first input sample of each output sample */
+    HPDF_UINT   *count;      /* count of the weights of each output sample */
+    HPDF_INT32  *weights;    /* taps weights for each output sample */
+} HPDF_Resampler_Rec;
+
+
+/* the source of the pixels of an image */
+typedef struct _HPDF_ImageReader_Rec {
+    HPDF_Stream   stream;
+    HPDF_UINT     width;
+    HPDF_UINT     colors;     /* components in the stream */
+    HPDF_UINT     bpc;
+    HPDF_UINT     channels;   /* components after the palette is applied */
+    HPDF_BYTE    *palette;
+    HPDF_UINT     palette_len;
+    HPDF_UINT     rowbytes;
+    HPDF_BYTE    *row;
+    HPDF_BYTE    *prev_row;   /* the previous row for the PNG predictor */
+    HPDF_UINT     pixel_bytes;
+    HPDF_BOOL     predictor;
+#ifdef LIBHPDF_HAVE_ZLIB
+    HPDF_BOOL     inflate;
+    z_stream      zs;
+    HPDF_BYTE     in_buf[HPDF_STREAM_BUF_SIZ];
+#endif /* LIBHPDF_HAVE_ZLIB */
+} HPDF_ImageReader_Rec;
+
+
+static HPDF_DOUBLE
+BoxFilter  (HPDF_DOUBLE  x)
+{
+    return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+}
+
+
+static HPDF_DOUBLE
+TriangleFilter  (HPDF_DOUBLE  x)
+{
+    if (x < 0.0)
+        x = -x;
+
+    return (x < 1.0) ? 1.0 - x : 0.0;
+}
+
+
+static HPDF_DOUBLE
+Sinc  (HPDF_DOUBLE  x)
+{
+    if (x == 0.0)
+        return 1.0;
+
+    x *= M_PI;
+    return sin (x) / x;
+}
+
+
+static HPDF_DOUBLE
+LanczosFilter  (HPDF_DOUBLE  x)
+{
+    if (x <= -3.0 || x >= 3.0)
+        return 0.0;
+
+    return Sinc (x) * Sinc (x / 3.0);
+}
+
+
+static void
+Resampler_Free  (HPDF_MMgr            mmgr,
+                 HPDF_Resampler_Rec  *rs)
+{
+    if (rs->first)
+        HPDF_FreeMem (mmgr, rs->first);
+    if (rs->count)
+        HPDF_FreeMem (mmgr, rs->count);
+    if (rs->weights)
+        HPDF_FreeMem (mmgr, rs->weights);
+}
+
+
+/* compute the weights of the input samples of each output sample. */
+static HPDF_STATUS
+Resampler_Init  (HPDF_MMgr             mmgr,
+                 HPDF_Resampler_Rec   *rs,
+                 HPDF_UINT             in_size,
+                 HPDF_UINT             out_size,
+                 HPDF_ResampleFilter   filter)
+{
+    HPDF_DOUBLE (*filter_fn)(HPDF_DOUBLE);
+    HPDF_DOUBLE scale = (HPDF_DOUBLE)in_size / out_size;
+    HPDF_DOUBLE support;
+    HPDF_DOUBLE *w;
+    HPDF_UINT i;
+
+    HPDF_MemSet (rs, 0, sizeof(HPDF_Resampler_Rec));
+
+    switch (filter) {
+        case HPDF_RESAMPLE_BILINEAR:
+            filter_fn = TriangleFilter;
+            support = 1.0;
+            break;
+        case HPDF_RESAMPLE_LANCZOS:
+            filter_fn = LanczosFilter;
+            support = 3.0;
+            break;
+        default:
+            filter_fn = BoxFilter;
+            support = 0.5;
+    }
+
+    /* the filters are stretched by the scale, images are only reduced */
+    if (scale < 1.0)
+        scale = 1.0;
+    support *= scale;
+
+    rs->out_size = out_size;
+    rs->taps = (HPDF_UINT)ceil (support) * 2 + 1;
+    rs->first = HPDF_GetMem (mmgr, out_size * sizeof(HPDF_UINT));
+    rs->count = HPDF_GetMem (mmgr, out_size * sizeof(HPDF_UINT));
+    rs->weights = HPDF_GetMem (mmgr, out_size * rs->taps * sizeof(HPDF_INT32));
+    w = HPDF_GetMem (mmgr, rs->taps * sizeof(HPDF_DOUBLE));
+
+    if (!rs->first || !rs->count || !rs->weights || !w) {
+        Resampler_Free (mmgr, rs);
+        if (w)
+            HPDF_FreeMem (mmgr, w);
+        return HPDF_Error_GetCode (mmgr->error);
+    }
+
+    for (i = 0; i < out_size; i++) {
+        HPDF_DOUBLE center = (i + 0.5) * in_size / out_size;
+        HPDF_DOUBLE total = 0.0;
+        HPDF_INT xmin = (HPDF_INT)(center - support + 0.5);
+        HPDF_INT xmax = (HPDF_INT)(center + support + 0.5);
+        HPDF_INT32 *fixed = rs->weights + i * rs->taps;
+        HPDF_UINT n, j;
+
+        if (xmin < 0)
+            xmin = 0;
+        if (xmax > (HPDF_INT)in_size)
+            xmax = (HPDF_INT)in_size;
+
+        n = (HPDF_UINT)(xmax - xmin);
+        if (n > rs->taps)
+            n = rs->taps;
+
+        for (j = 0; j < n; j++) {
+            w[j] = filter_fn ((j + xmin - center + 0.5) / scale);
+            total += w[j];
+        }
+
+        for (j = 0; j < n; j++) {
+            HPDF_DOUBLE v = (total != 0.0) ? w[j] / total : 0.0;
+
+            v *= (1 << RESAMPLE_PRECISION);
+            fixed[j] = (HPDF_INT32)(v < 0.0 ? v - 0.5 : v + 0.5);
+        }
+
+        rs->first[i] = (HPDF_UINT)xmin;
+        rs->count[i] = n;
+    }
+
+    HPDF_FreeMem (mmgr, w);
+
+    return HPDF_OK;
+}
+
+
+static HPDF_BYTE
+Clip8  (HPDF_INT32  v)
+{
+    if (v < 0)
+        return 0;
+
+    v >>= RESAMPLE_PRECISION;
+    return (v > 255) ? 255 : (HPDF_BYTE)v;
+}
+
+
+/* scale a row of pixels with 'channels' samples per pixel. the samples of
+ * a pixel are summed in separate variables for the usual counts of
+ * channels, so that the loops over the weights read the row contiguously.
+ * gcc -O3 vectorizes the loops of 1 and 4 channels, not the one of 3.
+ */
+static void
+ResampleRow  (const HPDF_Resampler_Rec        *rs,
+              const HPDF_BYTE * HPDF_RESTRICT  src,
+              HPDF_BYTE * HPDF_RESTRICT        dst,
+              HPDF_UINT                        channels)
+{
+    const HPDF_INT32 half = 1 << (RESAMPLE_PRECISION - 1);
+    HPDF_UINT i, j, c;
+
+    switch (channels) {
+        case 1:
+            for (i = 0; i < rs->out_size; i++) {
+                const HPDF_INT32 *w = rs->weights + i * rs->taps;
+                const HPDF_BYTE *p = src + rs->first[i];
+                HPDF_UINT n = rs->count[i];
+                HPDF_INT32 acc = half;
+
+                for (j = 0; j < n; j++)
+                    acc += p[j] * w[j];
+
+                *dst++ = Clip8 (acc);
+            }
+            break;
+        case 3:
+            for (i = 0; i < rs->out_size; i++) {
+                const HPDF_INT32 *w = rs->weights + i * rs->taps;
+                const HPDF_BYTE *p = src + rs->first[i] * 3;
+                HPDF_UINT n = rs->count[i];
+                HPDF_INT32 acc0 = half;
+                HPDF_INT32 acc1 = half;
+                HPDF_INT32 acc2 = half;
+
+                for (j = 0; j < n; j++, p += 3) {
+                    acc0 += p[0] * w[j];
+                    acc1 += p[1] * w[j];
+                    acc2 += p[2] * w[j];
+                }
+
+                *dst++ = Clip8 (acc0);
+                *dst++ = Clip8 (acc1);
+                *dst++ = Clip8 (acc2);
+            }
+            break;
+        case 4:
+            for (i = 0; i < rs->out_size; i++) {
+                const HPDF_INT32 *w = rs->weights + i * rs->taps;
+                const HPDF_BYTE *p = src + rs->first[i] * 4;
+                HPDF_UINT n = rs->count[i];
+                HPDF_INT32 acc0 = half;
+                HPDF_INT32 acc1 = half;
+                HPDF_INT32 acc2 = half;
+                HPDF_INT32 acc3 = half;
+
+                for (j = 0; j < n; j++, p += 4) {
+                    acc0 += p[0] * w[j];
+                    acc1 += p[1] * w[j];
+                    acc2 += p[2] * w[j];
+                    acc3 += p[3] * w[j];
+                }
+
+                *dst++ = Clip8 (acc0);
+                *dst++ = Clip8 (acc1);
+                *dst++ = Clip8 (acc2);
+                *dst++ = Clip8 (acc3);
+            }
+            break;
+        default:
+            for (i = 0; i < rs->out_size; i++) {
+                const HPDF_INT32 *w = rs->weights + i * rs->taps;
+                const HPDF_BYTE *p = src + rs->first[i] * channels;
+
+                for (c = 0; c < channels; c++) {
+                    HPDF_INT32 acc = half;
+
+                    for (j = 0; j < rs->count[i]; j++)
+                        acc += p[j * channels + c] * w[j];
+
+                    *dst++ = Clip8 (acc);
+                }
+            }
+    }
+}
+
+
+/* scale the rows of the ring which are used by an output row. the ring
+ * keeps the last 'taps' rows scaled horizontally.
+ */
+static void
+ResampleColumns  (const HPDF_Resampler_Rec   *rs,
+                  HPDF_UINT                   i,
+                  const HPDF_BYTE            *ring,
+                  HPDF_INT32 * HPDF_RESTRICT  acc,
+                  HPDF_BYTE * HPDF_RESTRICT   dst,
+                  HPDF_UINT                   row_len)
+{
+    const HPDF_INT32 *w = rs->weights + i * rs->taps;
+    HPDF_UINT j, k;
+
+    for (j = 0; j < row_len; j++)
+        acc[j] = 1 << (RESAMPLE_PRECISION - 1);
+
+    for (k = 0; k < rs->count[i]; k++) {
+        const HPDF_BYTE * HPDF_RESTRICT p = ring +
+                ((rs->first[i] + k) % rs->taps) * row_len;
+        HPDF_INT32 wk = w[k];
+
+        for (j = 0; j < row_len; j++)
+            acc[j] += p[j] * wk;
+    }
+
+    for (j = 0; j < row_len; j++)
+        dst[j] = Clip8 (acc[j]);
+}
+
+
+/* the colors of a RGB result. when there are no more than 256 of them,
+ * the image is written as an indexed image.
+ */
+#define COLOR_HASH_SIZ      1024
+#define COLOR_TABLE_FULL    257
+
+typedef struct _HPDF_ColorTable_Rec {
+    HPDF_UINT     count;
+    HPDF_UINT32   keys[COLOR_HASH_SIZ];     /* the color + 1, 0 if empty */
+    HPDF_BYTE     index[COLOR_HASH_SIZ];
+    HPDF_BYTE     palette[256 * 3];
+} HPDF_ColorTable_Rec;
+
+
+/* the slot of a color, or the empty slot where it goes. */
+static HPDF_UINT
+ColorTable_Slot  (const HPDF_ColorTable_Rec  *t,
+                  HPDF_UINT32                 key)
+{
+    HPDF_UINT h = (HPDF_UINT)((key * 2654435761u) >> 22) & (COLOR_HASH_SIZ - 1);
+
+    while (t->keys[h] != 0 && t->keys[h] != key)
+        h = (h + 1) & (COLOR_HASH_SIZ - 1);
+
+    return h;
+}
+
+
+static void
+ColorTable_Add  (HPDF_ColorTable_Rec  *t,
+                 const HPDF_BYTE      *row,
+                 HPDF_UINT             width)
+{
+    HPDF_UINT i;
+
+    for (i = 0; i < width && t->count < COLOR_TABLE_FULL; i++, row += 3) {
+        HPDF_UINT32 key = (((HPDF_UINT32)row[0] << 16) | (row[1] << 8) |
+                row[2]) + 1;
+        HPDF_UINT h = ColorTable_Slot (t, key);
+
+        if (t->keys[h] != 0)
+            continue;
+
+        if (t->count == 256) {
+            t->count = COLOR_TABLE_FULL;
+            break;
+        }
+
+        t->keys[h] = key;
+        t->index[h] = (HPDF_BYTE)t->count;
+        HPDF_MemCpy (t->palette + t->count * 3, row, 3);
+        t->count++;
+    }
+}
+
+
+/* replace the RGB rows of stream with the indexes of their colors, packed
+ * in 'bits' bits.
+ */
+static HPDF_STATUS
+ColorTable_WriteIndexes  (const HPDF_ColorTable_Rec  *t,
+                          HPDF_MMgr                   mmgr,
+                          HPDF_Stream                *stream,
+                          HPDF_BYTE                  *row,
+                          HPDF_UINT                   width,
+                          HPDF_UINT                   height,
+                          HPDF_UINT                   bits)
+{
+    HPDF_UINT out_len = (width * bits + 7) / 8;
+    HPDF_BYTE *out;
+    HPDF_Stream dst;
+    HPDF_UINT i, j;
+    HPDF_STATUS ret = HPDF_OK;
+
+    out = HPDF_GetMem (mmgr, out_len);
+    dst = HPDF_MemStream_New (mmgr, HPDF_STREAM_BUF_SIZ);
+
+    if (!out || !dst ||
+            (ret = HPDF_Stream_Seek (*stream, 0, HPDF_SEEK_SET)) != HPDF_OK) {
+        ret = HPDF_Error_GetCode (mmgr->error);
+        goto Exit;
+    }
+
+    for (i = 0; i < height; i++) {
+        HPDF_UINT size = width * 3;
+        const HPDF_BYTE *p = row;
+
+        ret = HPDF_Stream_Read (*stream, row, &size);
+        if ((ret != HPDF_OK && ret != HPDF_STREAM_EOF) || size != width * 3) {
+            ret = HPDF_SetError (mmgr->error, HPDF_INVALID_STREAM, 0);
+            goto Exit;
+        }
+
+        HPDF_MemSet (out, 0, out_len);
+
+        for (j = 0; j < width; j++, p += 3) {
+            HPDF_UINT32 key = (((HPDF_UINT32)p[0] << 16) | (p[1] << 8) |
+                    p[2]) + 1;
+            HPDF_UINT bit = j * bits;
+
+            out[bit >> 3] |= (HPDF_BYTE)(t->index[ColorTable_Slot (t, key)] <<
+                    (8 - bits - (bit & 7)));
+        }
+
+        if ((ret = HPDF_Stream_Write (dst, out, out_len)) != HPDF_OK)
+            goto Exit;
+    }
+
+    HPDF_Stream_Free (*stream);
+    *stream = dst;
+    dst = NULL;
+
+Exit:
+    if (out)
+        HPDF_FreeMem (mmgr, out);
+    if (dst)
+        HPDF_Stream_Free (dst);
+
+    return ret;
+}
+
+
+/* undo the PNG predictor of a row, the filter type is in row[0]. */
+static HPDF_STATUS
+UnfilterRow  (HPDF_BYTE        *row,
+              const HPDF_BYTE  *prev,
+              HPDF_UINT         len,
+              HPDF_UINT         bpp)
+{
+    HPDF_BYTE *p = row + 1;
+    HPDF_UINT i;
+
+    switch (row[0]) {
+        case 0:
+            break;
+        case 1:
+            for (i = bpp; i < len; i++)
+                p[i] = (HPDF_BYTE)(p[i] + p[i - bpp]);
+            break;
+        case 2:
+            for (i = 0; i < len; i++)
+                p[i] = (HPDF_BYTE)(p[i] + prev[i]);
+            break;
+        case 3:
+            for (i = 0; i < len; i++) {
+                HPDF_UINT left = (i >= bpp) ? p[i - bpp] : 0;
+
+                p[i] = (HPDF_BYTE)(p[i] + ((left + prev[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (i = 0; i < len; i++) {
+                HPDF_INT a = (i >= bpp) ? p[i - bpp] : 0;
+                HPDF_INT b = prev[i];
+                HPDF_INT c = (i >= bpp) ? prev[i - bpp] : 0;
+                HPDF_INT pa = b - c;
+                HPDF_INT pb = a - c;
+                HPDF_INT pc = pa + pb;
+
+                if (pa < 0) pa = -pa;
+                if (pb < 0) pb = -pb;
+                if (pc < 0) pc = -pc;
+
+                if (pa <= pb && pa <= pc)
+                    p[i] = (HPDF_BYTE)(p[i] + a);
+                else if (pb <= pc)
+                    p[i] = (HPDF_BYTE)(p[i] + b);
+                else
+                    p[i] = (HPDF_BYTE)(p[i] + c);
+            }
+            break;
+        default:
+            return HPDF_INVALID_IMAGE;
+    }
+
+    return HPDF_OK;
+}
+
+
+/* read exactly len bytes of the (inflated) data of the image. */
+static HPDF_STATUS
+ImageReader_Read  (HPDF_ImageReader_Rec  *r,
+                   HPDF_BYTE             *buf,
+                   HPDF_UINT              len)
+{
+    HPDF_STATUS ret;
+
+#ifdef LIBHPDF_HAVE_ZLIB
+    if (r->inflate) {
+        r->zs.next_out = buf;
+        r->zs.avail_out = len;
+
+        while (r->zs.avail_out > 0) {
+            int zret;
+
+            if (r->zs.avail_in == 0) {
+                HPDF_UINT size = HPDF_STREAM_BUF_SIZ;
+
+                ret = HPDF_Stream_Read (r->stream, r->in_buf, &size);
+                if (ret != HPDF_OK && ret != HPDF_STREAM_EOF)
+                    return ret;
+                if (size == 0)
+                    return HPDF_INVALID_IMAGE;
+
+                r->zs.next_in = r->in_buf;
+                r->zs.avail_in = size;
+            }
+
+            zret = inflate (&r->zs, Z_NO_FLUSH);
+            if (zret == Z_STREAM_END && r->zs.avail_out > 0)
+                return HPDF_INVALID_IMAGE;
+            if (zret != Z_OK && zret != Z_STREAM_END)
+                return HPDF_INVALID_IMAGE;
+        }
+
+        return HPDF_OK;
+    }
+#endif /* LIBHPDF_HAVE_ZLIB */
+
+    {
+        HPDF_UINT size = len;
+
+        ret = HPDF_Stream_Read (r->stream, buf, &size);
+        if (ret != HPDF_OK && ret != HPDF_STREAM_EOF)
+            return ret;
+
+        return (size == len) ? HPDF_OK : HPDF_INVALID_IMAGE;
+    }
+}
+
+
+/* read a row of the image and convert it to 8 bit samples. */
+static HPDF_STATUS
+ImageReader_ReadRow  (HPDF_ImageReader_Rec  *r,
+                      HPDF_BYTE             *dst)
+{
+    const HPDF_BYTE *src;
+    HPDF_UINT samples = r->width * r->colors;
+    HPDF_UINT max = (1 << r->bpc) - 1;
+    HPDF_UINT i;
+    HPDF_STATUS ret;
+
+    if (r->predictor) {
+        HPDF_BYTE *tmp;
+
+        if ((ret = ImageReader_Read (r, r->row, r->rowbytes + 1)) != HPDF_OK)
+            return ret;
+
+        if ((ret = UnfilterRow (r->row, r->prev_row + 1, r->rowbytes,
+                        r->pixel_bytes)) != HPDF_OK)
+            return ret;
+
+        src = r->row + 1;
+
+        /* the current row is the previous row of the next one */
+        tmp = r->prev_row;
+        r->prev_row = r->row;
+        r->row = tmp;
+    } else {
+        if ((ret = ImageReader_Read (r, r->row, r->rowbytes)) != HPDF_OK)
+            return ret;
+
+        src = r->row;
+    }
+
+    if (r->bpc == 8 && !r->palette) {
+        HPDF_MemCpy (dst, src, samples);
+        return HPDF_OK;
+    }
+
+    for (i = 0; i < samples; i++) {
+        HPDF_UINT v;
+
+        switch (r->bpc) {
+            case 8:
+                v = src[i];
+                break;
+            case 16:
+                /* only the high byte of a sample is used */
+                v = src[i * 2];
+                break;
+            default:
+                v = (src[(i * r->bpc) >> 3] >>
+                        (8 - r->bpc - ((i * r->bpc) & 7))) & max;
+        }
+
+        if (r->palette) {
+            if (v >= r->palette_len)
+                v = r->palette_len - 1;
+            *dst++ = r->palette[v * 3];
+            *dst++ = r->palette[v * 3 + 1];
+            *dst++ = r->palette[v * 3 + 2];
+        } else if (r->bpc < 8) {
+            *dst++ = (HPDF_BYTE)(v * 255 / max);
+        } else {
+            *dst++ = (HPDF_BYTE)v;
+        }
+    }
+
+    return HPDF_OK;
+}
+
+
+static void
+ImageReader_Free  (HPDF_MMgr              mmgr,
+                   HPDF_ImageReader_Rec  *r)
+{
+#ifdef LIBHPDF_HAVE_ZLIB
+    if (r->inflate)
+        inflateEnd (&r->zs);
+#endif /* LIBHPDF_HAVE_ZLIB */
+
+    if (r->row)
+        HPDF_FreeMem (mmgr, r->row);
+    if (r->prev_row)
+        HPDF_FreeMem (mmgr, r->prev_row);
+    HPDF_FreeMem (mmgr, r);
+}
+
+
+/* the parameters of the PNG predictor of a pre-encoded image. */
+static HPDF_Dict
+GetDecodeParms  (HPDF_Image  image)
+{
+    HPDF_Array array;
+    HPDF_Dict parms;
+
+    array = HPDF_Dict_GetItem (image, "DecodeParms", HPDF_OCLASS_ARRAY);
+    if (array)
+        return HPDF_Array_GetItem (array, 0, HPDF_OCLASS_DICT);
+
+    HPDF_Error_Reset (image->error);
+    parms = HPDF_Dict_GetItem (image, "DecodeParms", HPDF_OCLASS_DICT);
+    HPDF_Error_Reset (image->error);
+
+    return parms;
+}
+
+
+static HPDF_ImageReader_Rec*
+ImageReader_New  (HPDF_Image  image,
+                  HPDF_UINT   width)
+{
+    HPDF_ImageReader_Rec *r;
+    HPDF_Name name;
+    HPDF_Number bpc;
+
+    r = HPDF_GetMem (image->mmgr, sizeof(HPDF_ImageReader_Rec));
+    if (!r)
+        return NULL;
+
+    HPDF_MemSet (r, 0, sizeof(HPDF_ImageReader_Rec));
+    r->stream = image->stream;
+    r->width = width;
+
+    bpc = HPDF_Dict_GetItem (image, "BitsPerComponent", HPDF_OCLASS_NUMBER);
+    if (bpc)
+        r->bpc = (HPDF_UINT)bpc->value;
+
+    /* the color space is a name or an indexed color space */
+    name = HPDF_Dict_GetItem (image, "ColorSpace", HPDF_OCLASS_NAME);
+    if (!name) {
+        HPDF_Array array;
+
+        HPDF_Error_Reset (image->error);
+        array = HPDF_Dict_GetItem (image, "ColorSpace", HPDF_OCLASS_ARRAY);
+        HPDF_Error_Reset (image->error);
+
+        if (array && array->list->count == 4) {
+            HPDF_Name type = HPDF_Array_GetItem (array, 0, HPDF_OCLASS_NAME);
+            HPDF_Name base = HPDF_Array_GetItem (array, 1, HPDF_OCLASS_NAME);
+            HPDF_Binary lookup = HPDF_Array_GetItem (array, 3,
+                    HPDF_OCLASS_BINARY);
+
+            if (type && base && lookup &&
+                    HPDF_StrCmp (type->value, "Indexed") == 0 &&
+                    HPDF_StrCmp (base->value, COL_RGB) == 0 &&
+                    HPDF_Binary_GetLen (lookup) >= 3) {
+                r->colors = 1;
+                r->channels = 3;
+                r->palette = HPDF_Binary_GetValue (lookup);
+                r->palette_len = HPDF_Binary_GetLen (lookup) / 3;
+            }
+        }
+        HPDF_Error_Reset (image->error);
+    } else if (HPDF_StrCmp (name->value, COL_GRAY) == 0) {
+        r->colors = r->channels = 1;
+    } else if (HPDF_StrCmp (name->value, COL_RGB) == 0) {
+        r->colors = r->channels = 3;
+    } else if (HPDF_StrCmp (name->value, COL_CMYK) == 0) {
+        r->colors = r->channels = 4;
+    }
+
+    if (r->colors == 0 || (r->bpc != 1 && r->bpc != 2 && r->bpc != 4 &&
+                r->bpc != 8 && r->bpc != 16)) {
+        HPDF_SetError (image->error, HPDF_INVALID_OPERATION, 0);
+        HPDF_FreeMem (image->mmgr, r);
+        return NULL;
+    }
+
+    r->rowbytes = (width * r->colors * r->bpc + 7) / 8;
+    r->pixel_bytes = (r->colors * r->bpc + 7) / 8;
+
+    if (image->filter & HPDF_STREAM_FILTER_PREENCODED) {
+#ifdef LIBHPDF_HAVE_ZLIB
+        HPDF_Dict parms = GetDecodeParms (image);
+
+        if (parms) {
+            HPDF_Number predictor = HPDF_Dict_GetItem (parms, "Predictor",
+                    HPDF_OCLASS_NUMBER);
+
+            if (predictor && predictor->value >= 10)
+                r->predictor = HPDF_TRUE;
+            else if (predictor && predictor->value > 1) {
+                HPDF_SetError (image->error, HPDF_INVALID_OPERATION, 0);
+                HPDF_FreeMem (image->mmgr, r);
+                return NULL;
+            }
+        }
+
+        if (inflateInit (&r->zs) != Z_OK) {
+            HPDF_SetError (image->error, HPDF_ZLIB_ERROR, 0);
+            HPDF_FreeMem (image->mmgr, r);
+            return NULL;
+        }
+        r->inflate = HPDF_TRUE;
+#else
+        HPDF_SetError (image->error, HPDF_INVALID_OPERATION, 0);
+        HPDF_FreeMem (image->mmgr, r);
+        return NULL;
+#endif /* LIBHPDF_HAVE_ZLIB */
+    }
+
+    r->row = HPDF_GetMem (image->mmgr, r->rowbytes + 1);
+    if (r->row && r->predictor) {
+        r->prev_row = HPDF_GetMem (image->mmgr, r->rowbytes + 1);
+        if (r->prev_row)
+            HPDF_MemSet (r->prev_row, 0, r->rowbytes + 1);
+    }
+
+    if (!r->row || (r->predictor && !r->prev_row)) {
+        ImageReader_Free (image->mmgr, r);
+        return NULL;
+    }
+
+    return r;
+}
+
+
+static HPDF_STATUS
+DownsampleImage  (HPDF_Image           image,
+                  HPDF_UINT            width,
+                  HPDF_UINT            height,
+                  HPDF_ResampleFilter  filter)
+{
+    HPDF_MMgr mmgr = image->mmgr;
+    HPDF_Resampler_Rec hrs;
+    HPDF_Resampler_Rec vrs;
+    HPDF_ImageReader_Rec *reader = NULL;
+    HPDF_Stream stream = NULL;
+    HPDF_BYTE *src_row = NULL;
+    HPDF_BYTE *ring = NULL;
+    HPDF_BYTE *dst_row = NULL;
+    HPDF_INT32 *acc = NULL;
+    HPDF_ColorTable_Rec *colors = NULL;
+    HPDF_UINT src_width = HPDF_Image_GetWidth (image);
+    HPDF_UINT src_height = HPDF_Image_GetHeight (image);
+    HPDF_UINT channels;
+    HPDF_UINT row_len;
+    HPDF_UINT read_rows = 0;
+    HPDF_UINT bits = 8;
+    HPDF_UINT i;
+    HPDF_Boolean image_mask;
+    HPDF_Dict smask;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" DownsampleImage\n"));
+
+    if (width > src_width)
+        width = src_width;
+    if (height > src_height)
+        height = src_height;
+
+    /* the images are never enlarged */
+    if (width == src_width && height == src_height)
+        return HPDF_OK;
+
+    /* the samples of masks and of color keyed or encoded images can not be
+     * interpolated.
+     */
+    image_mask = HPDF_Dict_GetItem (image, "ImageMask", HPDF_OCLASS_BOOLEAN);
+    if ((image_mask && image_mask->value) ||
+            (image->filter & (HPDF_STREAM_FILTER_DCT_DECODE |
+                              HPDF_STREAM_FILTER_CCITT_DECODE |
+                              HPDF_STREAM_FILTER_JPX_DECODE |
+                              HPDF_STREAM_FILTER_JBIG2_DECODE)) ||
+            HPDF_Dict_GetItem (image, "Mask", HPDF_OCLASS_ARRAY))
+        return HPDF_SetError (image->error, HPDF_INVALID_OPERATION, 0);
+    HPDF_Error_Reset (image->error);
+
+    /* the data of the image is needed now */
+    if ((ret = HPDF_Image_LoadDelayedData (image)) != HPDF_OK)
+        return ret;
+
+    HPDF_MemSet (&hrs, 0, sizeof(hrs));
+    HPDF_MemSet (&vrs, 0, sizeof(vrs));
+
+    reader = ImageReader_New (image, src_width);
+    if (!reader)
+        return HPDF_Error_GetCode (image->error);
+
+    channels = reader->channels;
+    row_len = width * channels;
+
+    if ((ret = Resampler_Init (mmgr, &hrs, src_width, width, filter)) !=
+            HPDF_OK ||
+            (ret = Resampler_Init (mmgr, &vrs, src_height, height, filter)) !=
+            HPDF_OK)
+        goto Exit;
+
+    src_row = HPDF_GetMem (mmgr, src_width * channels);
+    ring = HPDF_GetMem (mmgr, row_len * vrs.taps);
+    dst_row = HPDF_GetMem (mmgr, row_len);
+    acc = HPDF_GetMem (mmgr, row_len * sizeof(HPDF_INT32));
+    stream = HPDF_MemStream_New (mmgr, HPDF_STREAM_BUF_SIZ);
+
+    if (channels == 3) {
+        colors = HPDF_GetMem (mmgr, sizeof(HPDF_ColorTable_Rec));
+        if (colors)
+            HPDF_MemSet (colors, 0, sizeof(HPDF_ColorTable_Rec));
+    }
+
+    if (!src_row || !ring || !dst_row || !acc || !stream ||
+            (channels == 3 && !colors)) {
+        ret = HPDF_Error_GetCode (image->error);
+        goto Exit;
+    }
+
+    if ((ret = HPDF_Stream_Seek (image->stream, 0, HPDF_SEEK_SET)) != HPDF_OK)
+        goto Exit;
+
+    /* the rows are scaled horizontally as they are read, into a ring of the
+     * rows used by the next output row, then the columns of the ring are
+     * scaled into the output row.
+     */
+    for (i = 0; i < height; i++) {
+        HPDF_UINT last = vrs.first[i] + vrs.count[i];
+
+        for (; read_rows < last; read_rows++) {
+            if ((ret = ImageReader_ReadRow (reader, src_row)) != HPDF_OK) {
+                ret = HPDF_SetError (image->error, ret, 0);
+                goto Exit;
+            }
+
+            ResampleRow (&hrs, src_row, ring + (read_rows % vrs.taps) *
+                    row_len, channels);
+        }
+
+        ResampleColumns (&vrs, i, ring, acc, dst_row, row_len);
+
+        if (colors)
+            ColorTable_Add (colors, dst_row, width);
+
+        if ((ret = HPDF_Stream_Write (stream, dst_row, row_len)) != HPDF_OK)
+            goto Exit;
+    }
+
+    /* a RGB result with a few colors is written as an indexed image, with
+     * as few bits per index as possible.
+     */
+    if (colors && colors->count < COLOR_TABLE_FULL) {
+        while (bits > 1 && colors->count <= (1U << (bits / 2)))
+            bits /= 2;
+
+        if ((ret = ColorTable_WriteIndexes (colors, mmgr, &stream, src_row,
+                        width, height, bits)) != HPDF_OK)
+            goto Exit;
+    }
+
+    /* replace the data and the attributes of the image */
+    HPDF_Stream_Free (image->stream);
+    image->stream = stream;
+    stream = NULL;
+
+    ret += HPDF_Dict_AddNumber (image, "Width", width);
+    ret += HPDF_Dict_AddNumber (image, "Height", height);
+    ret += HPDF_Dict_AddNumber (image, "BitsPerComponent", bits);
+    if (colors && colors->count < COLOR_TABLE_FULL) {
+        HPDF_Array array = HPDF_Array_New (mmgr);
+
+        if (array) {
+            ret += HPDF_Dict_Add (image, "ColorSpace", array);
+            ret += HPDF_Array_AddName (array, "Indexed");
+            ret += HPDF_Array_AddName (array, COL_RGB);
+            ret += HPDF_Array_AddNumber (array, colors->count - 1);
+            ret += HPDF_Array_Add (array, HPDF_Binary_New (mmgr,
+                    colors->palette, colors->count * 3));
+        } else
+            ret = HPDF_Error_GetCode (image->error);
+    } else if (reader->palette)
+        ret += HPDF_Dict_AddName (image, "ColorSpace", COL_RGB);
+    if (ret != HPDF_OK) {
+        ret = HPDF_Error_GetCode (image->error);
+        goto Exit;
+    }
+
+    /* the data is compressed again when the image is written */
+    if (image->filter & HPDF_STREAM_FILTER_PREENCODED) {
+        image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
+        HPDF_Dict_RemoveElement (image, "DecodeParms");
+    }
+
+    /* the soft mask is reduced to the same size */
+    smask = HPDF_Dict_GetItem (image, "SMask", HPDF_OCLASS_DICT);
+    HPDF_Error_Reset (image->error);
+    if (smask)
+        ret = DownsampleImage (smask, width, height, filter);
+
+Exit:
+    Resampler_Free (mmgr, &hrs);
+    Resampler_Free (mmgr, &vrs);
+    ImageReader_Free (mmgr, reader);
+
+    if (src_row)
+        HPDF_FreeMem (mmgr, src_row);
+    if (ring)
+        HPDF_FreeMem (mmgr, ring);
+    if (dst_row)
+        HPDF_FreeMem (mmgr, dst_row);
+    if (acc)
+        HPDF_FreeMem (mmgr, acc);
+    if (colors)
+        HPDF_FreeMem (mmgr, colors);
+    if (stream)
+        HPDF_Stream_Free (stream);
+
+    return ret;
+}
+
+
+/*
+ *  HPDF_Image_Downsample
+ *
+ *  Reduces the pixels of a raw or PNG image (and of its soft mask) to
+ *  width x height with the given filter. The dimensions of the image which
+ *  are smaller than that are kept. The samples are converted to 8 bits,
+ *  and the RGB and indexed images are written as indexed images when they
+ *  have no more than 256 colors after scaling, and as DeviceRGB otherwise.
+ *
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Image_Downsample  (HPDF_Image            image,
+                        HPDF_UINT             width,
+                        HPDF_UINT             height,
+                        HPDF_ResampleFilter   filter)
+{
+    HPDF_PTRACE ((" HPDF_Image_Downsample\n"));
+
+    if (!HPDF_Image_Validate (image))
+        return HPDF_INVALID_IMAGE;
+
+    if (width == 0 || height == 0 || filter < 0 ||
+            filter >= HPDF_RESAMPLE_EOF)
+        return HPDF_RaiseError (image->error, HPDF_INVALID_PARAMETER, 0);
+
+    if (DownsampleImage (image, width, height, filter) != HPDF_OK)
+        return HPDF_CheckError (image->error);
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  HPDF_Image_DownsampleToDPI
+ *
+ *  Same as HPDF_Image_Downsample, the size is the count of pixels which
+ *  fill a box of box_width x box_height points at max_dpi.
+ *
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Image_DownsampleToDPI  (HPDF_Image            image,
+                             HPDF_REAL             box_width,
+                             HPDF_REAL             box_height,
+                             HPDF_REAL             max_dpi,
+                             HPDF_ResampleFilter   filter)
+{
+    HPDF_DOUBLE width;
+    HPDF_DOUBLE height;
+
+    HPDF_PTRACE ((" HPDF_Image_DownsampleToDPI\n"));
+
+    if (!HPDF_Image_Validate (image))
+        return HPDF_INVALID_IMAGE;
+
+    if (box_width <= 0 || box_height <= 0 || max_dpi <= 0)
+        return HPDF_RaiseError (image->error, HPDF_INVALID_PARAMETER, 0);
+
+    /* 72 points per inch */
+    width = ceil ((HPDF_DOUBLE)box_width * max_dpi / 72);
+    height = ceil ((HPDF_DOUBLE)box_height * max_dpi / 72);
+
+    if (width > HPDF_LIMIT_MAX_INT)
+        width = HPDF_LIMIT_MAX_INT;
+    if (height > HPDF_LIMIT_MAX_INT)
+        height = HPDF_LIMIT_MAX_INT;
+
+    return HPDF_Image_Downsample (image, (HPDF_UINT)width, (HPDF_UINT)height,
+            filter);
+}
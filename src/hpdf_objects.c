@@ -79,7 +79,7 @@ HPDF_Obj_ForceFree  (HPDF_MMgr    mmgr,
 HPDF_STATUS
 HPDF_Obj_Write  (void          *obj,
                  HPDF_Stream   stream,
-                 HPDF_Encrypt  e)
+                 HPDF_CryptCtx e)
 {
     HPDF_Obj_Header *header = (HPDF_Obj_Header *)obj;
 
@@ -112,7 +112,7 @@ HPDF_Obj_Write  (void          *obj,
 HPDF_STATUS
 HPDF_Obj_WriteValue  (void          *obj,
                       HPDF_Stream   stream,
-                      HPDF_Encrypt  e)
+                      HPDF_CryptCtx e)
 {
     HPDF_Obj_Header *header;
     HPDF_STATUS ret;
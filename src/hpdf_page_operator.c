@@ -287,7 +287,7 @@ HPDF_Page_SetExtGState  (HPDF_Page        page,
     if (!HPDF_ExtGState_Validate (ext_gstate))
         return HPDF_RaiseError (page->error, HPDF_INVALID_OBJECT, 0);
 
-    if (page->mmgr != ext_gstate->mmgr)
+    if (HPDF_Page_GetDocMMgr (page) != ext_gstate->mmgr)
         return HPDF_RaiseError (page->error, HPDF_INVALID_EXT_GSTATE, 0);
 
     attr = (HPDF_PageAttr)page->attr;
@@ -302,8 +302,12 @@ HPDF_Page_SetExtGState  (HPDF_Page        page,
     if (HPDF_Stream_WriteStr (attr->stream, " gs\012") != HPDF_OK)
         return HPDF_CheckError (page->error);
 
-    /* change objct class to read only. */
-    ext_gstate->header.obj_class = (HPDF_OSUBCLASS_EXT_GSTATE_R | HPDF_OCLASS_DICT);
+    /* change objct class to read only. the extgstates of concurrent pages
+     * are changed when the document is saved.
+     */
+    if (!attr->arena)
+        ext_gstate->header.obj_class = (HPDF_OSUBCLASS_EXT_GSTATE_R |
+                HPDF_OCLASS_DICT);
 
     return ret;
 }
@@ -322,7 +326,7 @@ HPDF_Page_SetShading  (HPDF_Page    page,
     if (ret != HPDF_OK)
         return ret;
 
-    if (page->mmgr != shading->mmgr)
+    if (HPDF_Page_GetDocMMgr (page) != shading->mmgr)
         return HPDF_RaiseError (page->error, HPDF_INVALID_OBJECT, 0);
 
     attr = (HPDF_PageAttr)page->attr;
@@ -1189,7 +1193,7 @@ HPDF_Page_SetFontAndSize  (HPDF_Page  page,
         return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_FONT_SIZE, 
            (HPDF_STATUS) size);
 
-    if (page->mmgr != font->mmgr)
+    if (HPDF_Page_GetDocMMgr (page) != font->mmgr)
         return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_FONT, 0);
 
     attr = (HPDF_PageAttr)page->attr;
@@ -1897,7 +1901,7 @@ HPDF_Page_ExecuteXObject  (HPDF_Page     page,
             HPDF_OCLASS_DICT))
         return HPDF_RaiseError (page->error, HPDF_INVALID_OBJECT, 0);
 
-    if (page->mmgr != obj->mmgr)
+    if (HPDF_Page_GetDocMMgr (page) != obj->mmgr)
         return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_XOBJECT, 0);
 
     attr = (HPDF_PageAttr)page->attr;
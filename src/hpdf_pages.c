@@ -382,6 +382,73 @@ Page_OnFree  (HPDF_Dict  obj)
 }
 
 
+/* the mmgr of the document which the page belongs to. */
+HPDF_MMgr
+HPDF_Page_GetDocMMgr  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr = (HPDF_PageAttr)page->attr;
+
+    return attr->arena ? attr->arena->doc_mmgr : page->mmgr;
+}
+
+
+/*
+ *  HPDF_Page_GetFontUsed
+ *
+ *  A concurrent page must not mark the characters it uses in the font,
+ *  which is shared with the pages built on other threads. The characters
+ *  are marked in a bitmap of the page instead, and the bitmap is merged
+ *  into the font when the page is merged into the document.
+ *
+ *  *used is set to NULL when the font is to be marked directly.
+ *
+ */
+
+HPDF_STATUS
+HPDF_Page_GetFontUsed  (HPDF_Page    page,
+                        HPDF_Font    font,
+                        HPDF_BYTE  **used)
+{
+    HPDF_PageAttr attr = (HPDF_PageAttr)page->attr;
+    HPDF_FontAttr font_attr = (HPDF_FontAttr)font->attr;
+    HPDF_PageArena arena = attr->arena;
+    HPDF_PageFontUsed rec;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    *used = NULL;
+
+    if (!arena || arena->merged || font_attr->used_size == 0)
+        return HPDF_OK;
+
+    for (i = 0; i < arena->fonts_used->count; i++) {
+        rec = (HPDF_PageFontUsed)HPDF_List_ItemAt (arena->fonts_used, i);
+        if (rec->font == font) {
+            *used = rec->used;
+            return HPDF_OK;
+        }
+    }
+
+    rec = HPDF_GetMem (page->mmgr, sizeof(HPDF_PageFontUsed_Rec) +
+            font_attr->used_size);
+    if (!rec)
+        return HPDF_Error_GetCode (page->error);
+
+    rec->font = font;
+    rec->used = (HPDF_BYTE *)(rec + 1);
+    HPDF_MemSet (rec->used, 0, font_attr->used_size);
+
+    if ((ret = HPDF_List_Add (arena->fonts_used, rec)) != HPDF_OK) {
+        HPDF_FreeMem (page->mmgr, rec);
+        return ret;
+    }
+
+    *used = rec->used;
+
+    return HPDF_OK;
+}
+
+
 HPDF_STATUS
 HPDF_Page_CheckState  (HPDF_Page  page,
                        HPDF_UINT  mode)
@@ -1013,6 +1080,7 @@ HPDF_Page_TextWidth  (HPDF_Page        page,
     HPDF_TextWidth tw;
     HPDF_REAL ret = 0;
     HPDF_UINT len = HPDF_StrLen(text, HPDF_LIMIT_MAX_STRING_LEN + 1);
+    HPDF_BYTE *used;
 
     HPDF_PTRACE((" HPDF_Page_TextWidth\n"));
 
@@ -1027,7 +1095,13 @@ HPDF_Page_TextWidth  (HPDF_Page        page,
         return 0;
     }
 
-    tw = HPDF_Font_TextWidth (attr->gstate->font, (HPDF_BYTE *)text, len);
+    if (HPDF_Page_GetFontUsed (page, attr->gstate->font, &used) != HPDF_OK) {
+        HPDF_CheckError (page->error);
+        return 0;
+    }
+
+    tw = HPDF_Font_TextWidthEx (attr->gstate->font, (HPDF_BYTE *)text, len,
+            used, page->error);
 
     ret += attr->gstate->word_space * tw.numspace;
     ret += tw.width * attr->gstate->font_size  / 1000;
@@ -1049,6 +1123,7 @@ HPDF_Page_MeasureText  (HPDF_Page          page,
     HPDF_PageAttr attr;
     HPDF_UINT len = HPDF_StrLen(text, HPDF_LIMIT_MAX_STRING_LEN + 1);
     HPDF_UINT ret;
+    HPDF_BYTE *used;
 
     if (!HPDF_Page_Validate (page) || len == 0)
         return 0;
@@ -1063,9 +1138,14 @@ HPDF_Page_MeasureText  (HPDF_Page          page,
         return 0;
     }
 
-    ret = HPDF_Font_MeasureText (attr->gstate->font, (HPDF_BYTE *)text, len, width,
+    if (HPDF_Page_GetFontUsed (page, attr->gstate->font, &used) != HPDF_OK) {
+        HPDF_CheckError (page->error);
+        return 0;
+    }
+
+    ret = HPDF_Font_MeasureTextEx (attr->gstate->font, (HPDF_BYTE *)text, len, width,
         attr->gstate->font_size, attr->gstate->char_space,
-        attr->gstate->word_space, wordwrap, real_width);
+        attr->gstate->word_space, wordwrap, real_width, used, page->error);
 
     HPDF_CheckError (page->error);
 
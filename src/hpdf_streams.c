@@ -35,6 +35,38 @@
 #include <zconf.h>
 #endif /* LIBHPDF_HAVE_ZLIB */
 
+#ifdef LIBHPDF_HAVE_SYS_MMAN_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* LIBHPDF_HAVE_SYS_MMAN_H */
+
+#ifdef LIBHPDF_HAVE_SYS_SENDFILE_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#endif /* LIBHPDF_HAVE_SYS_SENDFILE_H */
+
+typedef struct _HPDF_DeferredStreamAttr_Rec  *HPDF_DeferredStreamAttr;
+
+typedef struct _HPDF_DeferredStreamAttr_Rec {
+    char        *fname;
+    HPDF_FILEP  fp;
+    HPDF_UINT   size;
+    HPDF_UINT   r_pos;
+} HPDF_DeferredStreamAttr_Rec;
+
+/* the data of a borrowed stream is read by the functions of HPDF_MappedReader */
+typedef struct _HPDF_BorrowedStreamAttr_Rec  *HPDF_BorrowedStreamAttr;
+
+typedef struct _HPDF_BorrowedStreamAttr_Rec {
+    HPDF_MappedStreamAttr_Rec  data;
+    HPDF_Release_Func          release_fn;
+    void                       *user_data;
+} HPDF_BorrowedStreamAttr_Rec;
+
 HPDF_STATUS
 HPDF_MemStream_WriteFunc  (HPDF_Stream      stream,
                            const HPDF_BYTE  *ptr,
@@ -72,7 +104,7 @@ HPDF_MemStream_InWrite  (HPDF_Stream      stream,
 HPDF_STATUS
 HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
                                        HPDF_Stream  dst,
-                                       HPDF_Encrypt  e);
+                                       HPDF_CryptCtx e);
 
 
 HPDF_STATUS
@@ -104,6 +136,105 @@ void
 HPDF_FileStream_FreeFunc  (HPDF_Stream  stream);
 
 
+HPDF_STATUS
+HPDF_MappedReader_ReadFunc  (HPDF_Stream  stream,
+                             HPDF_BYTE    *ptr,
+                             HPDF_UINT    *siz);
+
+
+HPDF_STATUS
+HPDF_MappedReader_SeekFunc  (HPDF_Stream      stream,
+                             HPDF_INT         pos,
+                             HPDF_WhenceMode  mode);
+
+
+HPDF_INT32
+HPDF_MappedReader_TellFunc  (HPDF_Stream  stream);
+
+
+HPDF_UINT32
+HPDF_MappedReader_SizeFunc  (HPDF_Stream  stream);
+
+
+void
+HPDF_MappedReader_FreeFunc  (HPDF_Stream  stream);
+
+
+void
+HPDF_BorrowedReader_FreeFunc  (HPDF_Stream  stream);
+
+
+/* returns the data of the streams which are kept in one buffer. */
+static const HPDF_BYTE*
+Stream_GetBufPtr  (HPDF_Stream  stream)
+{
+    if (stream->type == HPDF_STREAM_MAPPED ||
+            stream->type == HPDF_STREAM_BORROWED)
+        return ((HPDF_MappedStreamAttr)stream->attr)->buf;
+
+    return NULL;
+}
+
+
+/* writes the padding block which ends the data encrypted with AES. */
+static HPDF_STATUS
+Stream_WriteCryptFinal  (HPDF_Stream   stream,
+                         HPDF_CryptCtx e)
+{
+    HPDF_BYTE ebuf[HPDF_ENCRYPT_OVERHEAD];
+    HPDF_UINT len = HPDF_CryptCtx_CryptFinal (e, ebuf);
+
+    if (len == 0)
+        return HPDF_OK;
+
+    return HPDF_Stream_Write (stream, ebuf, len);
+}
+
+
+const char*
+HPDF_DeferredReader_GetFileName  (HPDF_Stream  stream)
+{
+    HPDF_PTRACE((" HPDF_DeferredReader_GetFileName\n"));
+
+    if (!stream || stream->type != HPDF_STREAM_DEFERRED)
+        return NULL;
+
+    return ((HPDF_DeferredStreamAttr)stream->attr)->fname;
+}
+
+
+HPDF_STATUS
+HPDF_DeferredReader_ReadFunc  (HPDF_Stream  stream,
+                               HPDF_BYTE    *ptr,
+                               HPDF_UINT    *siz);
+
+
+HPDF_STATUS
+HPDF_DeferredReader_SeekFunc  (HPDF_Stream      stream,
+                               HPDF_INT         pos,
+                               HPDF_WhenceMode  mode);
+
+
+HPDF_INT32
+HPDF_DeferredReader_TellFunc  (HPDF_Stream  stream);
+
+
+HPDF_UINT32
+HPDF_DeferredReader_SizeFunc  (HPDF_Stream  stream);
+
+
+void
+HPDF_DeferredReader_FreeFunc  (HPDF_Stream  stream);
+
+
+#ifdef LIBHPDF_HAVE_SYS_SENDFILE_H
+static HPDF_STATUS
+DeferredReader_SendFile  (HPDF_Stream  src,
+                          HPDF_Stream  dst,
+                          HPDF_BOOL    *done);
+#endif /* LIBHPDF_HAVE_SYS_SENDFILE_H */
+
+
 
 /*
  *  HPDF_Stream_Read
@@ -492,10 +623,10 @@ HPDF_STATUS
 HPDF_Stream_WriteBinary  (HPDF_Stream      stream,
                           const HPDF_BYTE  *data,
                           HPDF_UINT        len,
-                          HPDF_Encrypt     e)
+                          HPDF_CryptCtx    e)
 {
     char buf[HPDF_TEXT_DEFAULT_LEN];
-    HPDF_BYTE ebuf[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_BYTE ebuf[HPDF_TEXT_DEFAULT_LEN + HPDF_ENCRYPT_OVERHEAD];
     HPDF_BYTE *pbuf = NULL;
     HPDF_BOOL flg = HPDF_FALSE;
     HPDF_UINT idx = 0;
@@ -509,11 +640,14 @@ HPDF_Stream_WriteBinary  (HPDF_Stream      stream,
         if (len <= HPDF_TEXT_DEFAULT_LEN)
             pbuf = ebuf;
         else {
-            pbuf = (HPDF_BYTE *)HPDF_GetMem (stream->mmgr, len);
+            pbuf = (HPDF_BYTE *)HPDF_GetMem (stream->mmgr,
+                    len + HPDF_ENCRYPT_OVERHEAD);
+            if (!pbuf)
+                return HPDF_Error_GetCode (stream->error);
             flg = HPDF_TRUE;
         }
 
-        HPDF_Encrypt_CryptBuf (e, data, pbuf, len);
+        len = HPDF_CryptCtx_CryptBuf (e, data, pbuf, len);
         p = pbuf;
     } else {
         p = data;
@@ -557,10 +691,27 @@ HPDF_Stream_WriteBinary  (HPDF_Stream      stream,
 }
 
 
+/* write the last block of an encrypted string, if the cipher has one */
+HPDF_STATUS
+HPDF_Stream_WriteBinaryFinal  (HPDF_Stream   stream,
+                               HPDF_CryptCtx e)
+{
+    HPDF_BYTE ebuf[HPDF_ENCRYPT_OVERHEAD];
+    HPDF_UINT len = HPDF_CryptCtx_CryptFinal (e, ebuf);
+
+    HPDF_PTRACE((" HPDF_Stream_WriteBinaryFinal\n"));
+
+    if (len == 0)
+        return HPDF_OK;
+
+    return HPDF_Stream_WriteBinary (stream, ebuf, len, NULL);
+}
+
+
 HPDF_STATUS
 HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
                                        HPDF_Stream  dst,
-                                       HPDF_Encrypt  e)
+                                       HPDF_CryptCtx e)
 {
 #ifdef LIBHPDF_HAVE_ZLIB
 
@@ -568,11 +719,12 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
 
     HPDF_STATUS ret;
     HPDF_BOOL flg;
+    const HPDF_BYTE *src_buf;
 
     z_stream strm;
     Bytef inbuf[HPDF_STREAM_BUF_SIZ];
     Bytef otbuf[DEFLATE_BUF_SIZ];
-    HPDF_BYTE ebuf[DEFLATE_BUF_SIZ];
+    HPDF_BYTE ebuf[DEFLATE_BUF_SIZ + HPDF_ENCRYPT_OVERHEAD];
 
     HPDF_PTRACE((" HPDF_Stream_WriteToStreamWithDeflate\n"));
 
@@ -594,23 +746,32 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
     strm.next_in = inbuf;
     strm.avail_in = 0;
 
+    src_buf = Stream_GetBufPtr (src);
+
     flg = HPDF_FALSE;
     for (;;) {
         HPDF_UINT size = HPDF_STREAM_BUF_SIZ;
 
-        ret = HPDF_Stream_Read (src, inbuf, &size);
+        if (src_buf) {
+            /* the whole buffer is compressed without copying it */
+            strm.next_in = (Bytef *)src_buf;
+            strm.avail_in = HPDF_Stream_Size (src);
+            flg = HPDF_TRUE;
+        } else {
+            ret = HPDF_Stream_Read (src, inbuf, &size);
 
-        strm.next_in = inbuf;
-        strm.avail_in = size;
+            strm.next_in = inbuf;
+            strm.avail_in = size;
 
-        if (ret != HPDF_OK) {
-            if (ret == HPDF_STREAM_EOF) {
-                flg = HPDF_TRUE;
-                if (size == 0)
-                    break;
-            } else {
-                deflateEnd(&strm);
-                return ret;
+            if (ret != HPDF_OK) {
+                if (ret == HPDF_STREAM_EOF) {
+                    flg = HPDF_TRUE;
+                    if (size == 0)
+                        break;
+                } else {
+                    deflateEnd(&strm);
+                    return ret;
+                }
             }
         }
 
@@ -623,8 +784,9 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
 
             if (strm.avail_out == 0) {
                 if (e) {
-                    HPDF_Encrypt_CryptBuf (e, otbuf, ebuf, DEFLATE_BUF_SIZ);
-                    ret = HPDF_Stream_Write(dst, ebuf, DEFLATE_BUF_SIZ);
+                    HPDF_UINT esize = HPDF_CryptCtx_CryptBuf (e, otbuf, ebuf,
+                            DEFLATE_BUF_SIZ);
+                    ret = HPDF_Stream_Write(dst, ebuf, esize);
                 } else
                     ret = HPDF_Stream_Write (dst, otbuf, DEFLATE_BUF_SIZ);
 
@@ -656,7 +818,7 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
         if (strm.avail_out < DEFLATE_BUF_SIZ) {
             HPDF_UINT osize = DEFLATE_BUF_SIZ - strm.avail_out;
             if (e) {
-                HPDF_Encrypt_CryptBuf (e, otbuf, ebuf, osize);
+                osize = HPDF_CryptCtx_CryptBuf (e, otbuf, ebuf, osize);
                 ret = HPDF_Stream_Write(dst, ebuf, osize);
             } else
                 ret = HPDF_Stream_Write (dst, otbuf, osize);
@@ -675,6 +837,10 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
     }
 
     deflateEnd(&strm);
+
+    if (e)
+        return Stream_WriteCryptFinal (dst, e);
+
     return HPDF_OK;
 #else /* LIBHPDF_HAVE_ZLIB */
     HPDF_UNUSED (e);
@@ -688,12 +854,13 @@ HPDF_STATUS
 HPDF_Stream_WriteToStream  (HPDF_Stream  src,
                             HPDF_Stream  dst,
                             HPDF_UINT    filter,
-                            HPDF_Encrypt  e)
+                            HPDF_CryptCtx e)
 {
     HPDF_STATUS ret;
     HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
-    HPDF_BYTE ebuf[HPDF_STREAM_BUF_SIZ];
+    HPDF_BYTE ebuf[HPDF_STREAM_BUF_SIZ + HPDF_ENCRYPT_OVERHEAD];
     HPDF_BOOL flg;
+    const HPDF_BYTE *src_buf;
 
     HPDF_PTRACE((" HPDF_Stream_WriteToStream\n"));
     HPDF_UNUSED (filter);
@@ -709,13 +876,49 @@ HPDF_Stream_WriteToStream  (HPDF_Stream  src,
 
     /* initialize input stream */
     if (HPDF_Stream_Size (src) == 0)
-        return HPDF_OK;
+        return e ? Stream_WriteCryptFinal (dst, e) : HPDF_OK;
 
 #ifdef LIBHPDF_HAVE_ZLIB
-    if (filter & HPDF_STREAM_FILTER_FLATE_DECODE)
+    /* the data of a pre-encoded stream is already compressed */
+    if ((filter & HPDF_STREAM_FILTER_FLATE_DECODE) &&
+            !(filter & HPDF_STREAM_FILTER_PREENCODED))
         return HPDF_Stream_WriteToStreamWithDeflate (src, dst, e);
 #endif /* LIBHPDF_HAVE_ZLIB */
 
+#ifdef LIBHPDF_HAVE_SYS_SENDFILE_H
+    /* copy the data of a source file into the output file in the kernel */
+    if (!e && src->type == HPDF_STREAM_DEFERRED &&
+            dst->type == HPDF_STREAM_FILE) {
+        ret = DeferredReader_SendFile (src, dst, &flg);
+        if (ret != HPDF_OK || flg)
+            return ret;
+    }
+#endif /* LIBHPDF_HAVE_SYS_SENDFILE_H */
+
+    /* the data of a buffer is written from the buffer itself */
+    src_buf = Stream_GetBufPtr (src);
+    if (src_buf) {
+        HPDF_UINT len = HPDF_Stream_Size (src);
+
+        if (!e)
+            return HPDF_Stream_Write (dst, src_buf, len);
+
+        while (len > 0) {
+            HPDF_UINT size = (len > HPDF_STREAM_BUF_SIZ) ?
+                    HPDF_STREAM_BUF_SIZ : len;
+
+            ret = HPDF_Stream_Write (dst, ebuf,
+                    HPDF_CryptCtx_CryptBuf (e, src_buf, ebuf, size));
+            if (ret != HPDF_OK)
+                return ret;
+
+            src_buf += size;
+            len -= size;
+        }
+
+        return Stream_WriteCryptFinal (dst, e);
+    }
+
     ret = HPDF_Stream_Seek (src, 0, HPDF_SEEK_SET);
     if (ret != HPDF_OK)
         return ret;
@@ -737,7 +940,7 @@ HPDF_Stream_WriteToStream  (HPDF_Stream  src,
         }
 
         if (e) {
-            HPDF_Encrypt_CryptBuf (e, buf, ebuf, size);
+            size = HPDF_CryptCtx_CryptBuf (e, buf, ebuf, size);
             ret = HPDF_Stream_Write(dst, ebuf, size);
         } else {
             ret = HPDF_Stream_Write(dst, buf, size);
@@ -750,6 +953,9 @@ HPDF_Stream_WriteToStream  (HPDF_Stream  src,
             break;
     }
 
+    if (e)
+        return Stream_WriteCryptFinal (dst, e);
+
     return HPDF_OK;
 }
 
@@ -1076,6 +1282,589 @@ HPDF_FileStream_FreeFunc  (HPDF_Stream  stream)
     stream->attr = NULL;
 }
 
+/*
+ *  HPDF_MappedReader_New
+ *
+ *  Constructor for HPDF_MappedReader. The file is mapped read-only into
+ *  memory, so that seeking and reading do not cause any system calls and
+ *  callers can access the contents directly with
+ *  HPDF_MappedReader_GetBufPtr().
+ *
+ *  mmgr : Pointer to a HPDF_MMgr object.
+ *  fname : Name of the file to be mapped.
+ *
+ *  return: If success, It returns pointer to new HPDF_Stream object,
+ *          otherwise, it returns NULL. If the platform does not support
+ *          memory mapping or the file cannot be mapped, a HPDF_FileReader
+ *          is returned instead.
+ *
+ */
+
+HPDF_Stream
+HPDF_MappedReader_New  (HPDF_MMgr   mmgr,
+                        const char  *fname)
+{
+#ifdef LIBHPDF_HAVE_SYS_MMAN_H
+    HPDF_Stream stream;
+    HPDF_MappedStreamAttr attr;
+    struct stat st;
+    void *buf;
+    int fd;
+
+    HPDF_PTRACE((" HPDF_MappedReader_New\n"));
+
+    fd = open (fname, O_RDONLY);
+    if (fd < 0)
+        return HPDF_FileReader_New (mmgr, fname);
+
+    /* empty or huge files cannot be mapped; leave them to HPDF_FileReader */
+    if (fstat (fd, &st) != 0 || st.st_size <= 0 || st.st_size > 0x7FFFFFFF) {
+        close (fd);
+        return HPDF_FileReader_New (mmgr, fname);
+    }
+
+    buf = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* the mapping stays valid after the descriptor is closed */
+    close (fd);
+
+    if (buf == MAP_FAILED)
+        return HPDF_FileReader_New (mmgr, fname);
+
+    stream = (HPDF_Stream)HPDF_GetMem (mmgr, sizeof(HPDF_Stream_Rec));
+    if (!stream) {
+        munmap (buf, (size_t)st.st_size);
+        return NULL;
+    }
+
+    attr = (HPDF_MappedStreamAttr)HPDF_GetMem (mmgr,
+            sizeof(HPDF_MappedStreamAttr_Rec));
+    if (!attr) {
+        HPDF_FreeMem (mmgr, stream);
+        munmap (buf, (size_t)st.st_size);
+        return NULL;
+    }
+
+    HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
+    attr->buf = (HPDF_BYTE *)buf;
+    attr->buf_siz = (HPDF_UINT)st.st_size;
+    attr->r_pos = 0;
+
+    stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+    stream->type = HPDF_STREAM_MAPPED;
+    stream->error = mmgr->error;
+    stream->mmgr = mmgr;
+    stream->read_fn = HPDF_MappedReader_ReadFunc;
+    stream->seek_fn = HPDF_MappedReader_SeekFunc;
+    stream->tell_fn = HPDF_MappedReader_TellFunc;
+    stream->size_fn = HPDF_MappedReader_SizeFunc;
+    stream->free_fn = HPDF_MappedReader_FreeFunc;
+    stream->attr = attr;
+
+    return stream;
+#else /* LIBHPDF_HAVE_SYS_MMAN_H */
+    HPDF_PTRACE((" HPDF_MappedReader_New\n"));
+
+    return HPDF_FileReader_New (mmgr, fname);
+#endif /* LIBHPDF_HAVE_SYS_MMAN_H */
+}
+
+
+HPDF_STATUS
+HPDF_MappedReader_ReadFunc  (HPDF_Stream  stream,
+                             HPDF_BYTE    *ptr,
+                             HPDF_UINT    *siz)
+{
+    HPDF_MappedStreamAttr attr = (HPDF_MappedStreamAttr)stream->attr;
+    HPDF_UINT rsiz = attr->buf_siz - attr->r_pos;
+
+    HPDF_PTRACE((" HPDF_MappedReader_ReadFunc\n"));
+
+    if (rsiz >= *siz) {
+        HPDF_MemCpy (ptr, attr->buf + attr->r_pos, *siz);
+        attr->r_pos += *siz;
+
+        return HPDF_OK;
+    }
+
+    HPDF_MemCpy (ptr, attr->buf + attr->r_pos, rsiz);
+    attr->r_pos += rsiz;
+    *siz = rsiz;
+
+    return HPDF_STREAM_EOF;
+}
+
+
+HPDF_STATUS
+HPDF_MappedReader_SeekFunc  (HPDF_Stream      stream,
+                             HPDF_INT         pos,
+                             HPDF_WhenceMode  mode)
+{
+    HPDF_MappedStreamAttr attr = (HPDF_MappedStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_MappedReader_SeekFunc\n"));
+
+    if (mode == HPDF_SEEK_CUR)
+        pos += (HPDF_INT)attr->r_pos;
+    else if (mode == HPDF_SEEK_END)
+        pos += (HPDF_INT)attr->buf_siz;
+
+    if (pos < 0 || pos > (HPDF_INT)attr->buf_siz)
+        return HPDF_SetError (stream->error, HPDF_FILE_IO_ERROR, 0);
+
+    attr->r_pos = (HPDF_UINT)pos;
+
+    return HPDF_OK;
+}
+
+
+HPDF_INT32
+HPDF_MappedReader_TellFunc  (HPDF_Stream  stream)
+{
+    HPDF_MappedStreamAttr attr = (HPDF_MappedStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_MappedReader_TellFunc\n"));
+
+    return (HPDF_INT32)attr->r_pos;
+}
+
+
+HPDF_UINT32
+HPDF_MappedReader_SizeFunc  (HPDF_Stream  stream)
+{
+    HPDF_MappedStreamAttr attr = (HPDF_MappedStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_MappedReader_SizeFunc\n"));
+
+    return attr->buf_siz;
+}
+
+
+void
+HPDF_MappedReader_FreeFunc  (HPDF_Stream  stream)
+{
+    HPDF_MappedStreamAttr attr = (HPDF_MappedStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_MappedReader_FreeFunc\n"));
+
+    if (!attr)
+        return;
+
+#ifdef LIBHPDF_HAVE_SYS_MMAN_H
+    if (attr->buf)
+        munmap (attr->buf, attr->buf_siz);
+#endif /* LIBHPDF_HAVE_SYS_MMAN_H */
+
+    HPDF_FreeMem (stream->mmgr, attr);
+    stream->attr = NULL;
+}
+
+
+const HPDF_BYTE*
+HPDF_MappedReader_GetBufPtr  (HPDF_Stream  stream,
+                              HPDF_UINT    offset,
+                              HPDF_UINT    len)
+{
+    HPDF_MappedStreamAttr attr;
+
+    if (!stream || stream->type != HPDF_STREAM_MAPPED)
+        return NULL;
+
+    attr = (HPDF_MappedStreamAttr)stream->attr;
+
+    if (offset > attr->buf_siz || len > attr->buf_siz - offset)
+        return NULL;
+
+    return attr->buf + offset;
+}
+
+
+/*
+ *  HPDF_BorrowedReader_New
+ *
+ *  Constructor for HPDF_BorrowedReader. The stream reads the buffer of the
+ *  caller without copying it, the buffer must stay valid until the stream
+ *  is freed. release_fn is called with the buffer and user_data when the
+ *  stream is freed, or before this function returns if it fails.
+ *
+ *  mmgr : Pointer to a HPDF_MMgr object.
+ *  buf : The data of the stream.
+ *  size : The size of the data.
+ *  release_fn : The function to release the buffer, or NULL.
+ *  user_data : The data passed to release_fn.
+ *
+ *  return: If success, It returns pointer to new HPDF_Stream object,
+ *          otherwise, it returns NULL.
+ *
+ */
+
+HPDF_Stream
+HPDF_BorrowedReader_New  (HPDF_MMgr           mmgr,
+                          const HPDF_BYTE    *buf,
+                          HPDF_UINT           size,
+                          HPDF_Release_Func   release_fn,
+                          void               *user_data)
+{
+    HPDF_Stream stream;
+    HPDF_BorrowedStreamAttr attr;
+
+    HPDF_PTRACE((" HPDF_BorrowedReader_New\n"));
+
+    stream = (HPDF_Stream)HPDF_GetMem (mmgr, sizeof(HPDF_Stream_Rec));
+    attr = (HPDF_BorrowedStreamAttr)HPDF_GetMem (mmgr,
+            sizeof(HPDF_BorrowedStreamAttr_Rec));
+
+    if (!stream || !attr) {
+        if (stream)
+            HPDF_FreeMem (mmgr, stream);
+        if (attr)
+            HPDF_FreeMem (mmgr, attr);
+        if (release_fn)
+            release_fn (buf, user_data);
+        return NULL;
+    }
+
+    HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
+    attr->data.buf = (HPDF_BYTE *)buf;
+    attr->data.buf_siz = size;
+    attr->data.r_pos = 0;
+    attr->release_fn = release_fn;
+    attr->user_data = user_data;
+
+    stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+    stream->type = HPDF_STREAM_BORROWED;
+    stream->error = mmgr->error;
+    stream->mmgr = mmgr;
+    stream->read_fn = HPDF_MappedReader_ReadFunc;
+    stream->seek_fn = HPDF_MappedReader_SeekFunc;
+    stream->tell_fn = HPDF_MappedReader_TellFunc;
+    stream->size_fn = HPDF_MappedReader_SizeFunc;
+    stream->free_fn = HPDF_BorrowedReader_FreeFunc;
+    stream->attr = attr;
+
+    return stream;
+}
+
+
+void
+HPDF_BorrowedReader_FreeFunc  (HPDF_Stream  stream)
+{
+    HPDF_BorrowedStreamAttr attr = (HPDF_BorrowedStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_BorrowedReader_FreeFunc\n"));
+
+    if (!attr)
+        return;
+
+    if (attr->release_fn)
+        attr->release_fn (attr->data.buf, attr->user_data);
+
+    HPDF_FreeMem (stream->mmgr, attr);
+    stream->attr = NULL;
+}
+
+
+/*
+ *  HPDF_DeferredReader_New
+ *
+ *  Constructor for HPDF_DeferredReader. Only the name and the size of the
+ *  file are kept, the file is opened when the stream is read and closed
+ *  again when the end of the data is reached or HPDF_DeferredReader_Release()
+ *  is called. So a document can refer to many source files (e.g. jpeg
+ *  images) without holding their contents or their file descriptors until
+ *  it is saved.
+ *
+ *  mmgr : Pointer to a HPDF_MMgr object.
+ *  fname : Name of the file to be read.
+ *
+ *  return: If success, It returns pointer to new HPDF_Stream object,
+ *          otherwise, it returns NULL.
+ *
+ */
+
+HPDF_Stream
+HPDF_DeferredReader_New  (HPDF_MMgr   mmgr,
+                          const char  *fname)
+{
+    HPDF_Stream stream;
+    HPDF_DeferredStreamAttr attr;
+    HPDF_UINT len = HPDF_StrLen (fname, -1);
+    HPDF_FILEP fp;
+    long size;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_New\n"));
+
+    fp = HPDF_FOPEN (fname, "rb");
+    if (!fp) {
+#ifdef UNDER_CE
+        HPDF_SetError (mmgr->error, HPDF_FILE_OPEN_ERROR, GetLastError());
+#else
+        HPDF_SetError (mmgr->error, HPDF_FILE_OPEN_ERROR, errno);
+#endif
+        return NULL;
+    }
+
+    if (HPDF_FSEEK (fp, 0, SEEK_END) != 0 || (size = HPDF_FTELL (fp)) < 0 ||
+            size > 0x7FFFFFFF || HPDF_FSEEK (fp, 0, SEEK_SET) != 0) {
+        HPDF_SetError (mmgr->error, HPDF_FILE_IO_ERROR, HPDF_FERROR(fp));
+        HPDF_FCLOSE (fp);
+        return NULL;
+    }
+
+    stream = (HPDF_Stream)HPDF_GetMem (mmgr, sizeof(HPDF_Stream_Rec));
+    attr = (HPDF_DeferredStreamAttr)HPDF_GetMem (mmgr,
+            sizeof(HPDF_DeferredStreamAttr_Rec));
+    if (!stream || !attr) {
+        HPDF_FCLOSE (fp);
+        if (stream)
+            HPDF_FreeMem (mmgr, stream);
+        if (attr)
+            HPDF_FreeMem (mmgr, attr);
+        return NULL;
+    }
+
+    attr->fname = (char *)HPDF_GetMem (mmgr, len + 1);
+    if (!attr->fname) {
+        HPDF_FCLOSE (fp);
+        HPDF_FreeMem (mmgr, attr);
+        HPDF_FreeMem (mmgr, stream);
+        return NULL;
+    }
+
+    HPDF_MemCpy ((HPDF_BYTE *)attr->fname, (const HPDF_BYTE *)fname, len + 1);
+    attr->fp = fp;
+    attr->size = (HPDF_UINT)size;
+    attr->r_pos = 0;
+
+    HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
+    stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+    stream->type = HPDF_STREAM_DEFERRED;
+    stream->error = mmgr->error;
+    stream->mmgr = mmgr;
+    stream->read_fn = HPDF_DeferredReader_ReadFunc;
+    stream->seek_fn = HPDF_DeferredReader_SeekFunc;
+    stream->tell_fn = HPDF_DeferredReader_TellFunc;
+    stream->size_fn = HPDF_DeferredReader_SizeFunc;
+    stream->free_fn = HPDF_DeferredReader_FreeFunc;
+    stream->attr = attr;
+
+    return stream;
+}
+
+
+/* reopen the file and check that it was not changed since it was loaded. */
+static HPDF_STATUS
+DeferredReader_Open  (HPDF_Stream  stream)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)stream->attr;
+    HPDF_FILEP fp;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_Open\n"));
+
+    fp = HPDF_FOPEN (attr->fname, "rb");
+    if (!fp)
+#ifdef UNDER_CE
+        return HPDF_SetError (stream->error, HPDF_FILE_OPEN_ERROR,
+                GetLastError());
+#else
+        return HPDF_SetError (stream->error, HPDF_FILE_OPEN_ERROR, errno);
+#endif
+
+    if (HPDF_FSEEK (fp, 0, SEEK_END) != 0 ||
+            HPDF_FTELL (fp) != (long)attr->size ||
+            HPDF_FSEEK (fp, (long)attr->r_pos, SEEK_SET) != 0) {
+        HPDF_FCLOSE (fp);
+        return HPDF_SetError (stream->error, HPDF_FILE_IO_ERROR, 0);
+    }
+
+    attr->fp = fp;
+
+    return HPDF_OK;
+}
+
+
+void
+HPDF_DeferredReader_Release  (HPDF_Stream  stream)
+{
+    HPDF_DeferredStreamAttr attr;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_Release\n"));
+
+    if (!stream || stream->type != HPDF_STREAM_DEFERRED)
+        return;
+
+    attr = (HPDF_DeferredStreamAttr)stream->attr;
+    if (attr->fp) {
+        HPDF_FCLOSE (attr->fp);
+        attr->fp = NULL;
+    }
+}
+
+
+HPDF_STATUS
+HPDF_DeferredReader_ReadFunc  (HPDF_Stream  stream,
+                               HPDF_BYTE    *ptr,
+                               HPDF_UINT    *siz)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)stream->attr;
+    HPDF_UINT rsiz = attr->size - attr->r_pos;
+    HPDF_STATUS ret = HPDF_OK;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_ReadFunc\n"));
+
+    if (rsiz >= *siz)
+        rsiz = *siz;
+    else
+        ret = HPDF_STREAM_EOF;
+
+    if (rsiz > 0) {
+        if (!attr->fp && DeferredReader_Open (stream) != HPDF_OK)
+            return HPDF_Error_GetCode (stream->error);
+
+        if (HPDF_FREAD (ptr, 1, rsiz, attr->fp) != rsiz)
+            return HPDF_SetError (stream->error, HPDF_FILE_IO_ERROR,
+                    HPDF_FERROR(attr->fp));
+
+        attr->r_pos += rsiz;
+    }
+
+    /* the whole data was read, do not hold the file any longer. */
+    if (ret == HPDF_STREAM_EOF)
+        HPDF_DeferredReader_Release (stream);
+
+    *siz = rsiz;
+
+    return ret;
+}
+
+
+HPDF_STATUS
+HPDF_DeferredReader_SeekFunc  (HPDF_Stream      stream,
+                               HPDF_INT         pos,
+                               HPDF_WhenceMode  mode)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_SeekFunc\n"));
+
+    if (mode == HPDF_SEEK_CUR)
+        pos += (HPDF_INT)attr->r_pos;
+    else if (mode == HPDF_SEEK_END)
+        pos += (HPDF_INT)attr->size;
+
+    if (pos < 0 || pos > (HPDF_INT)attr->size)
+        return HPDF_SetError (stream->error, HPDF_FILE_IO_ERROR, 0);
+
+    /* a closed file is positioned when it is opened again. */
+    if (attr->fp && HPDF_FSEEK (attr->fp, pos, SEEK_SET) != 0)
+        return HPDF_SetError (stream->error, HPDF_FILE_IO_ERROR,
+                HPDF_FERROR(attr->fp));
+
+    attr->r_pos = (HPDF_UINT)pos;
+
+    return HPDF_OK;
+}
+
+
+HPDF_INT32
+HPDF_DeferredReader_TellFunc  (HPDF_Stream  stream)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_TellFunc\n"));
+
+    return (HPDF_INT32)attr->r_pos;
+}
+
+
+HPDF_UINT32
+HPDF_DeferredReader_SizeFunc  (HPDF_Stream  stream)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_SizeFunc\n"));
+
+    return attr->size;
+}
+
+
+void
+HPDF_DeferredReader_FreeFunc  (HPDF_Stream  stream)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_DeferredReader_FreeFunc\n"));
+
+    if (!attr)
+        return;
+
+    if (attr->fp)
+        HPDF_FCLOSE (attr->fp);
+
+    HPDF_FreeMem (stream->mmgr, attr->fname);
+    HPDF_FreeMem (stream->mmgr, attr);
+    stream->attr = NULL;
+}
+
+
+#ifdef LIBHPDF_HAVE_SYS_SENDFILE_H
+/*
+ * copy the whole data of a HPDF_DeferredReader into a HPDF_FileWriter with
+ * sendfile(). done is set to HPDF_FALSE when sendfile() cannot be used for
+ * these files, then the caller has to copy the data by itself.
+ */
+static HPDF_STATUS
+DeferredReader_SendFile  (HPDF_Stream  src,
+                          HPDF_Stream  dst,
+                          HPDF_BOOL    *done)
+{
+    HPDF_DeferredStreamAttr attr = (HPDF_DeferredStreamAttr)src->attr;
+    HPDF_FILEP fp = (HPDF_FILEP)dst->attr;
+    struct stat st;
+    off_t offset = 0;
+
+    HPDF_PTRACE((" DeferredReader_SendFile\n"));
+
+    *done = HPDF_FALSE;
+
+    /* the output stream is positioned at the end of the file afterwards */
+    if (fstat (fileno (fp), &st) != 0 || !S_ISREG (st.st_mode))
+        return HPDF_OK;
+
+    if (!attr->fp && DeferredReader_Open (src) != HPDF_OK)
+        return HPDF_Error_GetCode (src->error);
+
+    if (HPDF_FFLUSH (fp) != 0)
+        return HPDF_SetError (dst->error, HPDF_FILE_IO_ERROR, HPDF_FERROR(fp));
+
+    while (offset < (off_t)attr->size) {
+        ssize_t n = sendfile (fileno (fp), fileno (attr->fp), &offset,
+                (size_t)(attr->size - offset));
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0 && offset == 0 && (errno == EINVAL || errno == ENOSYS))
+            return HPDF_OK;
+
+        if (n <= 0)
+            return HPDF_SetError (dst->error, HPDF_FILE_IO_ERROR, errno);
+    }
+
+    if (HPDF_FSEEK (fp, 0, SEEK_END) != 0)
+        return HPDF_SetError (dst->error, HPDF_FILE_IO_ERROR, HPDF_FERROR(fp));
+
+    dst->size += attr->size;
+    attr->r_pos = attr->size;
+    HPDF_DeferredReader_Release (src);
+
+    *done = HPDF_TRUE;
+
+    return HPDF_OK;
+}
+#endif /* LIBHPDF_HAVE_SYS_SENDFILE_H */
+
+
 HPDF_STATUS
 HPDF_MemStream_InWrite  (HPDF_Stream      stream,
                          const HPDF_BYTE  **ptr,
@@ -139,7 +139,7 @@ HPDF_String_Free  (HPDF_String  obj)
 HPDF_STATUS
 HPDF_String_Write  (HPDF_String   obj,
                     HPDF_Stream   stream,
-                    HPDF_Encrypt  e)
+                    HPDF_CryptCtx e)
 {
     HPDF_STATUS ret;
 
@@ -151,7 +151,7 @@ HPDF_String_Write  (HPDF_String   obj,
     HPDF_PTRACE((" HPDF_String_Write\n"));
 
     if (e)
-        HPDF_Encrypt_Reset (e);
+        HPDF_CryptCtx_Reset (e);
 
     if (obj->encoder == NULL) {
         if (e) {
@@ -162,6 +162,9 @@ HPDF_String_Write  (HPDF_String   obj,
                     HPDF_StrLen ((char *)obj->value, -1), e)) != HPDF_OK)
                 return ret;
 
+            if ((ret = HPDF_Stream_WriteBinaryFinal (stream, e)) != HPDF_OK)
+                return ret;
+
             return HPDF_Stream_WriteChar (stream, '>');
         } else {
             return HPDF_Stream_WriteEscapeText (stream, (char *)obj->value);
@@ -204,10 +207,11 @@ HPDF_String_Write  (HPDF_String   obj,
                     HPDF_BYTE b2 = src[i + 1];
                     HPDF_UINT16 char_code = (HPDF_UINT16)((HPDF_UINT) b * 256 + b2);
 
-                    tmp_unicode = HPDF_Encoder_ToUnicode (obj->encoder,
-                                char_code);
+                    tmp_unicode = HPDF_Encoder_ParsedToUnicode (obj->encoder,
+                                &parse_state, char_code);
                 } else {
-                    tmp_unicode = HPDF_Encoder_ToUnicode (obj->encoder, b);
+                    tmp_unicode = HPDF_Encoder_ParsedToUnicode (obj->encoder,
+                                &parse_state, b);
                 }
 
                 HPDF_UInt16Swap (&tmp_unicode);
@@ -223,6 +227,9 @@ HPDF_String_Write  (HPDF_String   obj,
                 return ret;
         }
 
+        if (e && (ret = HPDF_Stream_WriteBinaryFinal (stream, e)) != HPDF_OK)
+            return ret;
+
         if ((ret = HPDF_Stream_WriteChar (stream, '>')) != HPDF_OK)
             return ret;
     }
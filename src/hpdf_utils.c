@@ -20,6 +20,12 @@
 #include "hpdf_utils.h"
 #include "hpdf_consts.h"
 
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
 /*---------------------------------------------------------------------------*/
 
 HPDF_INT
@@ -451,3 +457,38 @@ HPDF_UInt16Swap  (HPDF_UINT16  *value)
     *value = (HPDF_UINT16)((HPDF_UINT16)u[0] << 8 | (HPDF_UINT16)u[1]);
 }
 
+
+/*
+ *  HPDF_GlobalLock, HPDF_GlobalUnlock
+ *
+ *  Serialize access to the data which is shared between all documents of
+ *  the process (e.g. the tables of the builtin CMap encoders). The lock is
+ *  only held while such data is looked up or published.
+ */
+
+#if defined(WIN32)
+static SRWLOCK global_lock = SRWLOCK_INIT;
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void
+HPDF_GlobalLock  (void)
+{
+#if defined(WIN32)
+    AcquireSRWLockExclusive (&global_lock);
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+    pthread_mutex_lock (&global_lock);
+#endif
+}
+
+
+void
+HPDF_GlobalUnlock  (void)
+{
+#if defined(WIN32)
+    ReleaseSRWLockExclusive (&global_lock);
+#elif defined(LIBHPDF_HAVE_PTHREAD)
+    pthread_mutex_unlock (&global_lock);
+#endif
+}
@@ -174,6 +174,81 @@ Fail:
     return HPDF_Error_GetCode (xref->error);
 }
 
+/* free the objects which were added after the first count entries. */
+void
+HPDF_Xref_Truncate  (HPDF_Xref  xref,
+                     HPDF_UINT  count)
+{
+    HPDF_PTRACE((" HPDF_Xref_Truncate\n"));
+
+    while (xref->entries->count > count) {
+        HPDF_XrefEntry entry = (HPDF_XrefEntry)HPDF_List_RemoveByIndex
+                (xref->entries, xref->entries->count - 1);
+
+        if (entry->obj)
+            HPDF_Obj_ForceFree (xref->mmgr, entry->obj);
+        HPDF_FreeMem (xref->mmgr, entry);
+    }
+}
+
+
+/* move the objects of src to the end of xref. the objects are renumbered,
+ * the references to them are written with the new numbers.
+ */
+HPDF_STATUS
+HPDF_Xref_Merge  (HPDF_Xref  xref,
+                  HPDF_Xref  src)
+{
+    HPDF_UINT count = xref->entries->count;
+    HPDF_UINT i;
+
+    HPDF_PTRACE((" HPDF_Xref_Merge\n"));
+
+    if (count + src->entries->count > HPDF_LIMIT_MAX_XREF_ELEMENT)
+        return HPDF_SetError (xref->error, HPDF_XREF_COUNT_ERR, 0);
+
+    for (i = 0; i < src->entries->count; i++) {
+        HPDF_XrefEntry entry = HPDF_Xref_GetEntry (src, i);
+        HPDF_XrefEntry new_entry;
+
+        new_entry = (HPDF_XrefEntry)HPDF_GetMem (xref->mmgr,
+                sizeof(HPDF_XrefEntry_Rec));
+        if (!new_entry)
+            goto Fail;
+
+        if (HPDF_List_Add (xref->entries, new_entry) != HPDF_OK) {
+            HPDF_FreeMem (xref->mmgr, new_entry);
+            goto Fail;
+        }
+
+        *new_entry = *entry;
+    }
+
+    for (i = 0; i < src->entries->count; i++) {
+        HPDF_XrefEntry entry = HPDF_Xref_GetEntry (src, i);
+        HPDF_Obj_Header *header = (HPDF_Obj_Header *)entry->obj;
+
+        if (header)
+            header->obj_id = xref->start_offset + count + i +
+                    HPDF_OTYPE_INDIRECT;
+
+        HPDF_FreeMem (src->mmgr, entry);
+    }
+
+    HPDF_List_Clear (src->entries);
+
+    return HPDF_OK;
+
+Fail:
+    /* the objects still belong to src. */
+    while (xref->entries->count > count)
+        HPDF_FreeMem (xref->mmgr, HPDF_List_RemoveByIndex (xref->entries,
+                    xref->entries->count - 1));
+
+    return HPDF_Error_GetCode (xref->error);
+}
+
+
 HPDF_XrefEntry
 HPDF_Xref_GetEntry  (HPDF_Xref  xref,
                      HPDF_UINT  index)
@@ -228,7 +303,9 @@ HPDF_Xref_WriteToStream  (HPDF_Xref    xref,
     char* pbuf;
     char* eptr = buf + HPDF_SHORT_BUF_SIZ - 1;
     HPDF_UINT str_idx;
+    HPDF_UINT next_free;
     HPDF_Xref tmp_xref = xref;
+    HPDF_CryptCtx_Rec ctx;
 
     /* write each objects of xref to the specified stream */
 
@@ -246,6 +323,10 @@ HPDF_Xref_WriteToStream  (HPDF_Xref    xref,
             HPDF_UINT obj_id = tmp_xref->start_offset + i;
             HPDF_UINT16 gen_no = entry->gen_no;
 
+            /* the object is not written, see HPDF_Doc_MarkDuplicates() */
+            if (entry->entry_typ == HPDF_FREE_ENTRY)
+                continue;
+
             entry->byte_offset = stream->size;
 
             pbuf = buf;
@@ -258,9 +339,10 @@ HPDF_Xref_WriteToStream  (HPDF_Xref    xref,
                return ret;
 
             if (e)
-                HPDF_Encrypt_InitKey (e, obj_id, gen_no);
+                HPDF_CryptCtx_Init (&ctx, e, obj_id, gen_no);
 
-            if ((ret = HPDF_Obj_WriteValue (entry->obj, stream, e)) != HPDF_OK)
+            if ((ret = HPDF_Obj_WriteValue (entry->obj, stream,
+                            e ? &ctx : NULL)) != HPDF_OK)
                 return ret;
 
             if ((ret = HPDF_Stream_WriteStr (stream, "\012endobj\012"))
@@ -288,14 +370,31 @@ HPDF_Xref_WriteToStream  (HPDF_Xref    xref,
         if (ret != HPDF_OK)
             return ret;
 
+        /* free entries are linked by the object number of the next one. */
+        next_free = 0;
+        for (i = tmp_xref->entries->count; i > 0; i--) {
+            HPDF_XrefEntry entry = HPDF_Xref_GetEntry(tmp_xref, i - 1);
+
+            if (entry->entry_typ == HPDF_FREE_ENTRY) {
+                entry->byte_offset = next_free;
+                next_free = tmp_xref->start_offset + i - 1;
+            }
+        }
+
         for (i = 0; i < tmp_xref->entries->count; i++) {
             HPDF_XrefEntry entry = HPDF_Xref_GetEntry(tmp_xref, i);
+            HPDF_UINT16 gen_no = entry->gen_no;
+
+            /* the generation number to use when the entry is used again. */
+            if (entry->entry_typ == HPDF_FREE_ENTRY &&
+                    gen_no < HPDF_MAX_GENERATION_NUM)
+                gen_no++;
 
             pbuf = buf;
             pbuf = HPDF_IToA2 (pbuf, entry->byte_offset, HPDF_BYTE_OFFSET_LEN +
                     1);
             *pbuf++ = ' ';
-            pbuf = HPDF_IToA2 (pbuf, entry->gen_no, HPDF_GEN_NO_LEN + 1);
+            pbuf = HPDF_IToA2 (pbuf, gen_no, HPDF_GEN_NO_LEN + 1);
             *pbuf++ = ' ';
             *pbuf++ = entry->entry_typ;
             HPDF_StrCpy (pbuf, "\015\012", eptr); /* Acrobat 8.15 requires both \r and \n here */
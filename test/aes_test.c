@@ -0,0 +1,207 @@
+/*
+ * << Haru Free PDF Library >> -- aes_test.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+/*
+ *  Checks the AES block cipher of the library against the known answers of
+ *  FIPS-197 (appendix C) and NIST SP 800-38A (CBC mode), with the tables and,
+ *  when the processor has them, with the AES instructions (AES-NI or the
+ *  ARMv8 crypto extension). Then both must give the same result for random
+ *  keys and data.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hpdf.h"
+#include "hpdf_encrypt.h"
+
+#define RANDOM_KEYS     200
+#define RANDOM_BLOCKS   64
+
+typedef struct _KnownAnswer {
+    const char  *name;
+    const char  *key;
+    const char  *iv;
+    const char  *plain;
+    const char  *cipher;
+} KnownAnswer;
+
+static const KnownAnswer ANSWERS[] = {
+    {"FIPS-197 C.1 AES-128",
+     "000102030405060708090a0b0c0d0e0f",
+     NULL,
+     "00112233445566778899aabbccddeeff",
+     "69c4e0d86a7b0430d8cdb78070b4c55a"},
+    {"FIPS-197 C.3 AES-256",
+     "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+     NULL,
+     "00112233445566778899aabbccddeeff",
+     "8ea2b7ca516745bfeafc49904b496089"},
+    {"SP 800-38A F.2.1 CBC-AES128",
+     "2b7e151628aed2a6abf7158809cf4f3c",
+     "000102030405060708090a0b0c0d0e0f",
+     "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+     "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+     "7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2"
+     "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7"},
+    {"SP 800-38A F.2.5 CBC-AES256",
+     "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+     "000102030405060708090a0b0c0d0e0f",
+     "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+     "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+     "f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+     "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b"}
+};
+
+#define NUM_ANSWERS     (int)(sizeof(ANSWERS) / sizeof(ANSWERS[0]))
+
+
+static HPDF_UINT
+ParseHex  (const char  *hex,
+           HPDF_BYTE   *buf)
+{
+    HPDF_UINT len = 0;
+    unsigned int b;
+
+    while (*hex && sscanf (hex, "%2x", &b) == 1) {
+        buf[len++] = (HPDF_BYTE)b;
+        hex += 2;
+    }
+
+    return len;
+}
+
+
+static int
+CheckAnswer  (const KnownAnswer  *answer,
+              HPDF_BOOL           hw)
+{
+    HPDF_AES_Ctx_Rec ctx;
+    HPDF_BYTE key[32];
+    HPDF_BYTE iv[HPDF_AES_BLOCK_LEN];
+    HPDF_BYTE plain[64];
+    HPDF_BYTE cipher[64];
+    HPDF_BYTE out[64];
+    HPDF_UINT key_len = ParseHex (answer->key, key);
+    HPDF_UINT len = ParseHex (answer->plain, plain);
+    const char *path = hw ? "instructions" : "tables";
+    int errors = 0;
+
+    ParseHex (answer->cipher, cipher);
+
+    HPDF_AES_KeyExpand (&ctx, key, key_len);
+    ctx.hw = hw;
+
+    if (!answer->iv) {
+        HPDF_AES_EncryptBlock (&ctx, plain, out);
+        if (memcmp (out, cipher, HPDF_AES_BLOCK_LEN) != 0) {
+            printf ("%s (%s): wrong cipher text\n", answer->name, path);
+            errors++;
+        }
+
+        return errors;
+    }
+
+    ParseHex (answer->iv, iv);
+
+    HPDF_AES_EncryptCBC (&ctx, iv, plain, out, len);
+    if (memcmp (out, cipher, len) != 0) {
+        printf ("%s (%s): wrong cipher text\n", answer->name, path);
+        errors++;
+    }
+
+    /* in place */
+    HPDF_AES_EncryptCBC (&ctx, iv, plain, plain, len);
+    if (memcmp (plain, cipher, len) != 0) {
+        printf ("%s (%s): wrong cipher text in place\n", answer->name, path);
+        errors++;
+    }
+
+    return errors;
+}
+
+
+/* the instructions and the tables must give the same result */
+static int
+ComparePaths  (void)
+{
+    static HPDF_BYTE plain[RANDOM_BLOCKS * HPDF_AES_BLOCK_LEN];
+    static HPDF_BYTE out_hw[RANDOM_BLOCKS * HPDF_AES_BLOCK_LEN];
+    static HPDF_BYTE out_table[RANDOM_BLOCKS * HPDF_AES_BLOCK_LEN];
+    HPDF_AES_Ctx_Rec ctx;
+    HPDF_BYTE key[32];
+    HPDF_BYTE iv[HPDF_AES_BLOCK_LEN];
+    int errors = 0;
+    int n;
+    HPDF_UINT i;
+
+    srand (1);
+
+    for (n = 0; n < RANDOM_KEYS; n++) {
+        HPDF_UINT key_len = (n & 1) ? 32 : 16;
+
+        for (i = 0; i < sizeof(key); i++)
+            key[i] = (HPDF_BYTE)rand ();
+        for (i = 0; i < sizeof(iv); i++)
+            iv[i] = (HPDF_BYTE)rand ();
+        for (i = 0; i < sizeof(plain); i++)
+            plain[i] = (HPDF_BYTE)rand ();
+
+        HPDF_AES_KeyExpand (&ctx, key, key_len);
+        HPDF_AES_EncryptCBC (&ctx, iv, plain, out_hw, sizeof(plain));
+        ctx.hw = HPDF_FALSE;
+        HPDF_AES_EncryptCBC (&ctx, iv, plain, out_table, sizeof(plain));
+
+        if (memcmp (out_hw, out_table, sizeof(plain)) != 0) {
+            printf ("key %d: the instructions and the tables differ\n", n);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+
+int main (int argc, char **argv)
+{
+    HPDF_AES_Ctx_Rec ctx;
+    HPDF_BYTE key[16];
+    HPDF_BOOL hw;
+    int failed = 0;
+    int i;
+
+    HPDF_UNUSED (argc);
+    HPDF_UNUSED (argv);
+
+    /* the path chosen by the library for this processor */
+    memset (key, 0, sizeof(key));
+    HPDF_AES_KeyExpand (&ctx, key, sizeof(key));
+    hw = ctx.hw;
+
+    printf ("AES instructions: %s\n", hw ? "used" : "not available");
+
+    for (i = 0; i < NUM_ANSWERS; i++) {
+        failed += CheckAnswer (&ANSWERS[i], HPDF_FALSE);
+        if (hw)
+            failed += CheckAnswer (&ANSWERS[i], HPDF_TRUE);
+    }
+
+    if (hw)
+        failed += ComparePaths ();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * << Haru Free PDF Library >> -- batch_test.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+/*
+ *  Runs jobs through HPDF_Batch with one worker and with several workers.
+ *  Some jobs fail in fill_fn and some in write_fn. done_fn must be called
+ *  once for each job with the status of the job, the statistics returned by
+ *  HPDF_Batch_Wait must add up to the jobs and the bytes written, and
+ *  HPDF_Batch_Free must finish the jobs which are still queued.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hpdf.h"
+
+#define NUM_JOBS        600
+#define NUM_ROUNDS      2
+#define NUM_LEFT        200
+
+typedef struct _Job {
+    int           id;
+    int           done_count;
+    HPDF_STATUS   status;
+    HPDF_UINT     bytes;
+    HPDF_BYTE     head[5];
+    HPDF_BYTE     tail[6];
+} Job;
+
+static Job jobs[NUM_JOBS];
+
+
+static int
+FillFails  (int  id)
+{
+    return id % 37 == 5;
+}
+
+
+static int
+WriteFails  (int  id)
+{
+    return id % 53 == 7;
+}
+
+
+static void HPDF_STDCALL
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    /* the errors of the failing jobs are expected */
+    HPDF_UNUSED (error_no);
+    HPDF_UNUSED (detail_no);
+    HPDF_UNUSED (user_data);
+}
+
+
+static HPDF_STATUS HPDF_STDCALL
+Setup  (HPDF_Doc   pdf,
+        void      *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    return HPDF_SetCompressionMode (pdf, HPDF_COMP_ALL);
+}
+
+
+static HPDF_STATUS HPDF_STDCALL
+Fill  (HPDF_Doc   pdf,
+       void      *job_data)
+{
+    Job *job = (Job *)job_data;
+    HPDF_Page page;
+    HPDF_Font font;
+    char buf[64];
+
+    if (FillFails (job->id))
+        return HPDF_INVALID_PARAMETER;
+
+    page = HPDF_AddPage (pdf);
+    font = HPDF_GetFont (pdf, "Helvetica", NULL);
+    if (!page || !font)
+        return HPDF_GetError (pdf);
+
+    sprintf (buf, "job %d", job->id);
+
+    HPDF_Page_BeginText (page);
+    HPDF_Page_SetFontAndSize (page, font, 12 + job->id % 10);
+    HPDF_Page_TextOut (page, 50, 700, buf);
+    HPDF_Page_EndText (page);
+
+    return HPDF_GetError (pdf);
+}
+
+
+static HPDF_STATUS HPDF_STDCALL
+Write  (const HPDF_BYTE  *buf,
+        HPDF_UINT         siz,
+        void             *job_data)
+{
+    Job *job = (Job *)job_data;
+    HPDF_UINT i;
+
+    /* fail after the header has been written */
+    if (WriteFails (job->id) && job->bytes > 0)
+        return HPDF_FILE_IO_ERROR;
+
+    for (i = 0; i < siz; i++) {
+        if (job->bytes + i < sizeof(job->head))
+            job->head[job->bytes + i] = buf[i];
+
+        /* the last bytes written */
+        memmove (job->tail, job->tail + 1, sizeof(job->tail) - 1);
+        job->tail[sizeof(job->tail) - 1] = buf[i];
+    }
+
+    job->bytes += siz;
+
+    return HPDF_OK;
+}
+
+
+static void HPDF_STDCALL
+Done  (HPDF_STATUS   status,
+       void         *job_data)
+{
+    Job *job = (Job *)job_data;
+
+    job->done_count++;
+    job->status = status;
+}
+
+
+static int
+SubmitJobs  (HPDF_Batch  batch,
+             int         count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        memset (&jobs[i], 0, sizeof(Job));
+        jobs[i].id = i;
+
+        if (HPDF_Batch_Submit (batch, Fill, Write, &jobs[i]) != HPDF_OK) {
+            printf ("job %d: cannot submit\n", i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* check the jobs, return the number of errors and set the number of the
+ * failed jobs and the bytes written.
+ */
+static int
+CheckJobs  (int          count,
+            HPDF_UINT   *failed,
+            HPDF_UINT64 *bytes)
+{
+    int errors = 0;
+    int i;
+
+    *failed = 0;
+    *bytes = 0;
+
+    for (i = 0; i < count; i++) {
+        Job *job = &jobs[i];
+        int fails = FillFails (i) || WriteFails (i);
+
+        if (job->done_count != 1) {
+            printf ("job %d: done_fn was called %d times\n", i,
+                    job->done_count);
+            errors++;
+        }
+
+        if (fails) {
+            (*failed)++;
+            if (job->status == HPDF_OK) {
+                printf ("job %d: the failure was not reported\n", i);
+                errors++;
+            }
+        } else if (job->status != HPDF_OK) {
+            printf ("job %d: failed with %04X\n", i, (HPDF_UINT)job->status);
+            errors++;
+        } else if (memcmp (job->head, "%PDF-", 5) != 0 ||
+                memcmp (job->tail, "%%EOF\n", 6) != 0) {
+            printf ("job %d: the output is not a complete document\n", i);
+            errors++;
+        }
+
+        *bytes += job->bytes;
+    }
+
+    return errors;
+}
+
+
+static int
+RunBatch  (HPDF_UINT  num_workers)
+{
+    HPDF_Batch batch;
+    HPDF_BatchStats stats;
+    HPDF_UINT failed;
+    HPDF_UINT64 bytes;
+    int errors = 0;
+    int round;
+
+    batch = HPDF_Batch_New (num_workers, Setup, Done, error_handler, NULL);
+    if (!batch) {
+        printf ("%u workers: cannot create the batch\n", num_workers);
+        return 1;
+    }
+
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        if (SubmitJobs (batch, NUM_JOBS) != 0) {
+            HPDF_Batch_Free (batch);
+            return 1;
+        }
+
+        if (HPDF_Batch_Wait (batch, &stats) != HPDF_OK) {
+            printf ("%u workers: HPDF_Batch_Wait failed\n", num_workers);
+            errors++;
+        }
+
+        errors += CheckJobs (NUM_JOBS, &failed, &bytes);
+
+        if (stats.jobs != NUM_JOBS || stats.failed != failed ||
+                stats.bytes != bytes) {
+            printf ("%u workers, round %d: the statistics are %u jobs, %u "
+                    "failed, %lu bytes instead of %u, %u, %lu\n",
+                    num_workers, round, stats.jobs, stats.failed,
+                    (unsigned long)stats.bytes, NUM_JOBS, failed,
+                    (unsigned long)bytes);
+            errors++;
+        }
+
+        if (stats.min_latency > stats.avg_latency ||
+                stats.avg_latency > stats.max_latency) {
+            printf ("%u workers, round %d: the latencies are not ordered\n",
+                    num_workers, round);
+            errors++;
+        }
+    }
+
+    /* the jobs which are queued when the batch is freed are finished */
+    if (SubmitJobs (batch, NUM_LEFT) != 0) {
+        HPDF_Batch_Free (batch);
+        return 1;
+    }
+
+    HPDF_Batch_Free (batch);
+
+    errors += CheckJobs (NUM_LEFT, &failed, &bytes);
+
+    return errors;
+}
+
+
+int main (int argc, char **argv)
+{
+    int failed = 0;
+
+    HPDF_UNUSED (argc);
+    HPDF_UNUSED (argv);
+
+    failed += RunBatch (1);
+    failed += RunBatch (4);
+
+    HPDF_FreeGlobalCaches ();
+
+    return failed ? 1 : 0;
+}
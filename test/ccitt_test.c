@@ -0,0 +1,470 @@
+/*
+ * << Haru Free PDF Library >> -- ccitt_test.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+/*
+ *  Encodes 1-bit images of every width from 1 to 260 (including widths 9
+ *  and 100, which are not multiples of 8 and end inside a byte) with the
+ *  CCITT G4 encoder of the library, and decodes the result with the
+ *  decoder below, which follows ITU-T T.6 independently of the encoder.
+ *  The decoded pixels must be the pixels of the image.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hpdf.h"
+
+#define MAX_WIDTH   260
+#define HEIGHT      24
+
+typedef struct _RunCode {
+    const char  *bits;
+    int          run;
+} RunCode;
+
+static const RunCode WHITE_CODES[] = {
+    {"00110101", 0}, {"000111", 1}, {"0111", 2}, {"1000", 3},
+    {"1011", 4}, {"1100", 5}, {"1110", 6}, {"1111", 7},
+    {"10011", 8}, {"10100", 9}, {"00111", 10}, {"01000", 11},
+    {"001000", 12}, {"000011", 13}, {"110100", 14}, {"110101", 15},
+    {"101010", 16}, {"101011", 17}, {"0100111", 18}, {"0001100", 19},
+    {"0001000", 20}, {"0010111", 21}, {"0000011", 22}, {"0000100", 23},
+    {"0101000", 24}, {"0101011", 25}, {"0010011", 26}, {"0100100", 27},
+    {"0011000", 28}, {"00000010", 29}, {"00000011", 30}, {"00011010", 31},
+    {"00011011", 32}, {"00010010", 33}, {"00010011", 34}, {"00010100", 35},
+    {"00010101", 36}, {"00010110", 37}, {"00010111", 38}, {"00101000", 39},
+    {"00101001", 40}, {"00101010", 41}, {"00101011", 42}, {"00101100", 43},
+    {"00101101", 44}, {"00000100", 45}, {"00000101", 46}, {"00001010", 47},
+    {"00001011", 48}, {"01010010", 49}, {"01010011", 50}, {"01010100", 51},
+    {"01010101", 52}, {"00100100", 53}, {"00100101", 54}, {"01011000", 55},
+    {"01011001", 56}, {"01011010", 57}, {"01011011", 58}, {"01001010", 59},
+    {"01001011", 60}, {"00110010", 61}, {"00110011", 62}, {"00110100", 63},
+    {"11011", 64}, {"10010", 128}, {"010111", 192}, {"0110111", 256},
+    {"00110110", 320}, {"00110111", 384}, {"01100100", 448},
+    {"01100101", 512}, {"01101000", 576}, {"01100111", 640},
+    {"011001100", 704}, {"011001101", 768}, {"011010010", 832},
+    {"011010011", 896}, {"011010100", 960}, {"011010101", 1024},
+    {"011010110", 1088}, {"011010111", 1152}, {"011011000", 1216},
+    {"011011001", 1280}, {"011011010", 1344}, {"011011011", 1408},
+    {"010011000", 1472}, {"010011001", 1536}, {"010011010", 1600},
+    {"011000", 1664}, {"010011011", 1728},
+    {NULL, 0}
+};
+
+static const RunCode BLACK_CODES[] = {
+    {"0000110111", 0}, {"010", 1}, {"11", 2}, {"10", 3},
+    {"011", 4}, {"0011", 5}, {"0010", 6}, {"00011", 7},
+    {"000101", 8}, {"000100", 9}, {"0000100", 10}, {"0000101", 11},
+    {"0000111", 12}, {"00000100", 13}, {"00000111", 14},
+    {"000011000", 15}, {"0000010111", 16}, {"0000011000", 17},
+    {"0000001000", 18}, {"00001100111", 19}, {"00001101000", 20},
+    {"00001101100", 21}, {"00000110111", 22}, {"00000101000", 23},
+    {"00000010111", 24}, {"00000011000", 25}, {"000011001010", 26},
+    {"000011001011", 27}, {"000011001100", 28}, {"000011001101", 29},
+    {"000001101000", 30}, {"000001101001", 31}, {"000001101010", 32},
+    {"000001101011", 33}, {"000011010010", 34}, {"000011010011", 35},
+    {"000011010100", 36}, {"000011010101", 37}, {"000011010110", 38},
+    {"000011010111", 39}, {"000001101100", 40}, {"000001101101", 41},
+    {"000011011010", 42}, {"000011011011", 43}, {"000001010100", 44},
+    {"000001010101", 45}, {"000001010110", 46}, {"000001010111", 47},
+    {"000001100100", 48}, {"000001100101", 49}, {"000001010010", 50},
+    {"000001010011", 51}, {"000000100100", 52}, {"000000110111", 53},
+    {"000000111000", 54}, {"000000100111", 55}, {"000000101000", 56},
+    {"000001011000", 57}, {"000001011001", 58}, {"000000101011", 59},
+    {"000000101100", 60}, {"000001011010", 61}, {"000001100110", 62},
+    {"000001100111", 63},
+    {"0000001111", 64}, {"000011001000", 128}, {"000011001001", 192},
+    {"000001011011", 256}, {"000000110011", 320}, {"000000110100", 384},
+    {"000000110101", 448}, {"0000001101100", 512}, {"0000001101101", 576},
+    {"0000001001010", 640}, {"0000001001011", 704}, {"0000001001100", 768},
+    {"0000001001101", 832}, {"0000001110010", 896}, {"0000001110011", 960},
+    {"0000001110100", 1024}, {"0000001110101", 1088},
+    {"0000001110110", 1152}, {"0000001110111", 1216},
+    {"0000001010010", 1280}, {"0000001010011", 1344},
+    {"0000001010100", 1408}, {"0000001010101", 1472},
+    {"0000001011010", 1536}, {"0000001011011", 1600},
+    {"0000001100100", 1664}, {"0000001100101", 1728},
+    {NULL, 0}
+};
+
+typedef enum _Mode {
+    MODE_PASS,
+    MODE_HORIZONTAL,
+    MODE_V0,
+    MODE_VR1,
+    MODE_VR2,
+    MODE_VR3,
+    MODE_VL1,
+    MODE_VL2,
+    MODE_VL3,
+    MODE_EOL
+} Mode;
+
+static const RunCode MODE_CODES[] = {
+    {"0001", MODE_PASS}, {"001", MODE_HORIZONTAL}, {"1", MODE_V0},
+    {"011", MODE_VR1}, {"000011", MODE_VR2}, {"0000011", MODE_VR3},
+    {"010", MODE_VL1}, {"000010", MODE_VL2}, {"0000010", MODE_VL3},
+    {"000000000001", MODE_EOL},
+    {NULL, 0}
+};
+
+
+typedef struct _BitReader {
+    const HPDF_BYTE  *buf;
+    HPDF_UINT         size;
+    HPDF_UINT         pos;
+} BitReader;
+
+
+/* returns the run or mode of the next code, or -1 if no code matches. */
+static int
+ReadCode  (BitReader      *r,
+           const RunCode  *codes)
+{
+    char bits[16];
+    int len;
+
+    for (len = 0; len < 13; len++) {
+        const RunCode *c;
+
+        if (r->pos >= r->size * 8)
+            return -1;
+
+        bits[len] = (r->buf[r->pos / 8] & (0x80 >> (r->pos % 8))) ? '1' : '0';
+        bits[len + 1] = 0;
+        r->pos++;
+
+        for (c = codes; c->bits; c++)
+            if (strcmp (c->bits, bits) == 0)
+                return c->run;
+    }
+
+    return -1;
+}
+
+
+static int
+ReadRun  (BitReader  *r,
+          int         black)
+{
+    int total = 0;
+
+    for (;;) {
+        int run = ReadCode (r, black ? BLACK_CODES : WHITE_CODES);
+
+        if (run < 0)
+            return -1;
+
+        total += run;
+        if (run < 64)
+            return total;
+    }
+}
+
+
+static int
+GetPixel  (const HPDF_BYTE  *row,
+           int               x)
+{
+    if (x < 0)
+        return 0;
+
+    return (row[x / 8] & (0x80 >> (x % 8))) ? 1 : 0;
+}
+
+
+static void
+Fill  (HPDF_BYTE  *row,
+       int         from,
+       int         to,
+       int         black)
+{
+    int x;
+
+    for (x = from < 0 ? 0 : from; x < to; x++)
+        if (black)
+            row[x / 8] |= (HPDF_BYTE)(0x80 >> (x % 8));
+}
+
+
+/* the first changing element of ref after a0 whose color is not color. */
+static int
+FindB1  (const HPDF_BYTE  *ref,
+         int               width,
+         int               a0,
+         int               color)
+{
+    int x;
+
+    for (x = a0 + 1; x < width; x++)
+        if (GetPixel (ref, x) != GetPixel (ref, x - 1) &&
+                GetPixel (ref, x) != color)
+            return x;
+
+    return width;
+}
+
+
+static int
+NextChange  (const HPDF_BYTE  *ref,
+             int               width,
+             int               x)
+{
+    for (x++; x < width; x++)
+        if (GetPixel (ref, x) != GetPixel (ref, x - 1))
+            return x;
+
+    return width;
+}
+
+
+/* decodes a G4 image into rows of line_width bytes, black is 1. */
+static int
+DecodeG4  (const HPDF_BYTE  *data,
+           HPDF_UINT         size,
+           int               width,
+           int               height,
+           int               line_width,
+           HPDF_BYTE        *out)
+{
+    BitReader r;
+    HPDF_BYTE *white = calloc (line_width, 1);
+    const HPDF_BYTE *ref = white;
+    int y;
+
+    r.buf = data;
+    r.size = size;
+    r.pos = 0;
+
+    memset (out, 0, line_width * height);
+
+    for (y = 0; y < height; y++) {
+        HPDF_BYTE *row = out + y * line_width;
+        int a0 = -1;
+        int color = 0;
+
+        while (a0 < width) {
+            int b1 = FindB1 (ref, width, a0, color);
+            int b2 = NextChange (ref, width, b1);
+            int mode = ReadCode (&r, MODE_CODES);
+            int a1;
+
+            switch (mode) {
+                case MODE_PASS:
+                    Fill (row, a0, b2, color);
+                    a0 = b2;
+                    break;
+                case MODE_HORIZONTAL: {
+                    int run1 = ReadRun (&r, color);
+                    int run2 = ReadRun (&r, !color);
+                    int start = a0 < 0 ? 0 : a0;
+
+                    if (run1 < 0 || run2 < 0 ||
+                            start + run1 + run2 > width)
+                        goto Fail;
+
+                    Fill (row, start, start + run1, color);
+                    Fill (row, start + run1, start + run1 + run2, !color);
+                    a0 = start + run1 + run2;
+                    break;
+                }
+                case MODE_V0:
+                case MODE_VR1:
+                case MODE_VR2:
+                case MODE_VR3:
+                case MODE_VL1:
+                case MODE_VL2:
+                case MODE_VL3:
+                    if (mode <= MODE_VR3)
+                        a1 = b1 + (mode - MODE_V0);
+                    else
+                        a1 = b1 - (mode - MODE_VR3);
+
+                    if (a1 < 0 || a1 > width || a1 < a0)
+                        goto Fail;
+
+                    Fill (row, a0, a1, color);
+                    a0 = a1;
+                    color = !color;
+                    break;
+                default:
+                    goto Fail;
+            }
+        }
+
+        ref = row;
+    }
+
+    /* EOFB */
+    if (ReadCode (&r, MODE_CODES) != MODE_EOL ||
+            ReadCode (&r, MODE_CODES) != MODE_EOL)
+        goto Fail;
+
+    free (white);
+    return 0;
+
+Fail:
+    free (white);
+    return -1;
+}
+
+
+static int
+CheckImage  (HPDF_Doc          pdf,
+             const HPDF_BYTE  *pixels,
+             int               width,
+             int               line_width,
+             HPDF_BOOL         top_is_first)
+{
+    HPDF_Image image;
+    HPDF_Stream stream;
+    HPDF_BYTE *data;
+    HPDF_BYTE *decoded;
+    HPDF_UINT size;
+    int y;
+    int x;
+    int ret = 0;
+
+    image = HPDF_Image_LoadRaw1BitImageFromMem (pdf, pixels, width, HEIGHT,
+            line_width, HPDF_TRUE, top_is_first);
+    if (!image)
+        return -1;
+
+    stream = image->stream;
+    size = HPDF_Stream_Size (stream);
+    data = malloc (size + 1);
+    decoded = malloc (line_width * HEIGHT);
+
+    HPDF_Stream_Seek (stream, 0, HPDF_SEEK_SET);
+    if (HPDF_Stream_Read (stream, data, &size) != HPDF_OK ||
+            DecodeG4 (data, size, width, HEIGHT, line_width, decoded) != 0)
+        ret = -1;
+
+    for (y = 0; ret == 0 && y < HEIGHT; y++) {
+        const HPDF_BYTE *src = pixels + (top_is_first ? y :
+                HEIGHT - 1 - y) * line_width;
+
+        for (x = 0; x < width; x++)
+            if (GetPixel (src, x) != GetPixel (decoded + y * line_width, x)) {
+                ret = -1;
+                break;
+            }
+    }
+
+    free (decoded);
+    free (data);
+
+    return ret;
+}
+
+
+/* rows of runs of random lengths, some rows repeat the previous one. */
+static void
+MakePixels  (HPDF_BYTE  *pixels,
+             int         line_width,
+             int         max_run,
+             unsigned   *seed)
+{
+    int run = 0;
+    int color = 0;
+    int y;
+    int x;
+
+    memset (pixels, 0, line_width * HEIGHT);
+
+    for (y = 0; y < HEIGHT; y++) {
+        HPDF_BYTE *row = pixels + y * line_width;
+
+        *seed = *seed * 1103515245 + 12345;
+        if (y > 0 && (*seed >> 16) % 4 == 0) {
+            memcpy (row, row - line_width, line_width);
+            continue;
+        }
+
+        /* the bits after the last pixel are set too */
+        for (x = 0; x < line_width * 8; x++) {
+            if (run == 0) {
+                *seed = *seed * 1103515245 + 12345;
+                run = 1 + (*seed >> 16) % max_run;
+                color = !color;
+            }
+
+            run--;
+            if (color)
+                row[x / 8] |= (HPDF_BYTE)(0x80 >> (x % 8));
+        }
+    }
+}
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+                (HPDF_UINT)detail_no);
+}
+
+
+int main (int argc, char **argv)
+{
+    static const int max_runs[] = {1, 3, 12, 80, 300};
+    HPDF_Doc pdf;
+    HPDF_BYTE *pixels;
+    unsigned seed = 1;
+    int failed = 0;
+    int width;
+
+    HPDF_UNUSED (argc);
+    HPDF_UNUSED (argv);
+
+    pdf = HPDF_New (error_handler, NULL);
+    if (!pdf)
+        return 1;
+
+    pixels = malloc ((MAX_WIDTH / 8 + 4) * HEIGHT);
+
+    for (width = 1; width <= MAX_WIDTH; width++) {
+        int i;
+
+        for (i = 0; i < 10; i++) {
+            int line_width = (width + 7) / 8 + (i & 1);
+            HPDF_BOOL top_is_first = (i & 2) ? HPDF_FALSE : HPDF_TRUE;
+
+            MakePixels (pixels, line_width, max_runs[i % 5], &seed);
+
+            if (CheckImage (pdf, pixels, width, line_width,
+                        top_is_first) != 0) {
+                printf ("width %d, line width %d, pass %d: the decoded "
+                        "image differs\n", width, line_width, i);
+                failed++;
+            }
+        }
+
+        /* the images are freed with the document */
+        if (width % 20 == 0)
+            HPDF_NewDoc (pdf);
+    }
+
+    free (pixels);
+    HPDF_Free (pdf);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * << Haru Free PDF Library >> -- thread_test.c
+ *
+ * URL: http://libharu.org
+ *
+ * Copyright (c) 1999-2006 Takeshi Kanno <takeshi_kanno@est.hi-ho.ne.jp>
+ * Copyright (c) 2007-2009 Antony Dovgal <tony@daylessday.org>
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+/*
+ *  Builds documents on several threads at the same time. The threads are
+ *  started together, so that the builtin data shared by all documents (the
+ *  maps of the single-byte encoders, the tables of the CMap encoders and
+ *  the metrics of the base14 fonts) is first used concurrently, under
+ *  HPDF_GlobalLock. Then the pages of one document are filled by several
+ *  threads (HPDF_SetConcurrentPages).
+ *
+ *  The widths of the texts must be the same on every thread. The test is
+ *  meant to be run with ThreadSanitizer (cmake -DLIBHPDF_TSAN=ON), which
+ *  makes it fail on a data race.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "hpdf.h"
+
+#define NUM_THREADS     8
+#define NUM_DOCS        6
+#define NUM_PAGES       64
+
+typedef struct _FontSpec {
+    const char  *font_name;
+    const char  *encoding_name;
+    const char  *text;
+} FontSpec;
+
+static const FontSpec FONTS[] = {
+    {"Helvetica", "StandardEncoding", "Haru \xa1\xa7\xe1"},
+    {"Helvetica-Bold", "WinAnsiEncoding", "Haru \xc0\xe9\xf1"},
+    {"Times-Roman", "MacRomanEncoding", "Haru \x80\xa5\xd0"},
+    {"Times-Italic", "ISO8859-2", "Haru \xa3\xb9\xea"},
+    {"Courier", "ISO8859-5", "Haru \xb0\xd5\xef"},
+    {"Courier-BoldOblique", "ISO8859-7", "Haru \xc1\xe1\xf9"},
+    {"Helvetica-Oblique", "ISO8859-15", "Haru \xa4\xbd\xbe"},
+    {"Times-BoldItalic", "CP1250", "Haru \x8a\x9a\xb3"},
+    {"Courier-Oblique", "CP1251", "Haru \xc0\xe0\xff"},
+    {"Times-Bold", "CP1253", "Haru \xc1\xe1\xf9"},
+    {"Helvetica-BoldOblique", "CP1257", "Haru \xc0\xe0\xfe"},
+    {"Courier-Bold", "KOI8-R", "Haru \xc1\xe1\xff"},
+    {"Symbol", NULL, "abgd"},
+    {"ZapfDingbats", NULL, "3456"},
+    {"MS-Mincho", "90ms-RKSJ-H", "Haru \x82\xa0\x88\x9f"},
+    {"MS-Gothic", "EUC-H", "Haru \xa4\xa2\xb0\xa1"},
+    {"MingLiU", "ETen-B5-H", "Haru \xa4\x40\xa4\x41"},
+    {"SimSun", "GBK-EUC-H", "Haru \xb0\xa1\xc4\xe3"},
+    {"DotumChe", "KSC-EUC-H", "Haru \xb0\xa1\xb3\xaa"}
+};
+
+#define NUM_FONTS   (int)(sizeof(FONTS) / sizeof(FONTS[0]))
+
+typedef struct _ThreadData {
+    int         id;
+    int         errors;
+    HPDF_REAL   widths[NUM_DOCS][NUM_FONTS];
+} ThreadData;
+
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static ThreadData threads_data[NUM_THREADS];
+
+static HPDF_Doc shared_pdf;
+static HPDF_Page shared_pages[NUM_PAGES];
+static HPDF_Font shared_fonts[NUM_FONTS];
+static HPDF_REAL page_widths[NUM_PAGES][NUM_FONTS];
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    ThreadData *data = (ThreadData *)user_data;
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+                (HPDF_UINT)detail_no);
+
+    if (data)
+        data->errors++;
+}
+
+
+static void
+UseCJK  (HPDF_Doc  pdf,
+         int       first)
+{
+    int i;
+
+    /* each thread loads the CJK data in another order */
+    for (i = 0; i < 4; i++) {
+        switch ((first + i) % 4) {
+            case 0:
+                HPDF_UseJPEncodings (pdf);
+                HPDF_UseJPFonts (pdf);
+                break;
+            case 1:
+                HPDF_UseCNTEncodings (pdf);
+                HPDF_UseCNTFonts (pdf);
+                break;
+            case 2:
+                HPDF_UseCNSEncodings (pdf);
+                HPDF_UseCNSFonts (pdf);
+                break;
+            default:
+                HPDF_UseKREncodings (pdf);
+                HPDF_UseKRFonts (pdf);
+        }
+    }
+}
+
+
+static int
+BuildDocument  (ThreadData  *data,
+                int          n)
+{
+    HPDF_Doc pdf;
+    HPDF_Page page;
+    int i;
+
+    pdf = HPDF_New (error_handler, data);
+    if (!pdf)
+        return -1;
+
+    UseCJK (pdf, data->id + n);
+    HPDF_UseUTFEncodings (pdf);
+    HPDF_SetCompressionMode (pdf, HPDF_COMP_ALL);
+
+    if (n % 3 == 1) {
+        HPDF_SetPassword (pdf, "owner", "user");
+        HPDF_SetEncryptionMode (pdf, (n & 1) ? HPDF_ENCRYPT_R6 :
+                HPDF_ENCRYPT_R4, 0);
+    }
+
+    page = HPDF_AddPage (pdf);
+    HPDF_Page_BeginText (page);
+    HPDF_Page_MoveTextPos (page, 40, 800);
+
+    /* each thread uses the fonts in another order */
+    for (i = 0; i < NUM_FONTS; i++) {
+        int j = (data->id * 5 + n + i) % NUM_FONTS;
+        HPDF_Font font = HPDF_GetFont (pdf, FONTS[j].font_name,
+                FONTS[j].encoding_name);
+
+        HPDF_Page_SetFontAndSize (page, font, 12);
+        HPDF_Page_MoveTextPos (page, 0, -20);
+        HPDF_Page_ShowText (page, FONTS[j].text);
+        data->widths[n][j] = HPDF_Page_TextWidth (page, FONTS[j].text);
+    }
+
+    HPDF_Page_EndText (page);
+
+    if (HPDF_SaveToStream (pdf) != HPDF_OK || HPDF_GetStreamSize (pdf) == 0)
+        data->errors++;
+
+    HPDF_Free (pdf);
+
+    return 0;
+}
+
+
+static void*
+DocumentThread  (void  *arg)
+{
+    ThreadData *data = (ThreadData *)arg;
+    int n;
+
+    /* wait until every thread is started */
+    pthread_mutex_lock (&start_lock);
+    pthread_mutex_unlock (&start_lock);
+
+    for (n = 0; n < NUM_DOCS; n++)
+        if (BuildDocument (data, n) != 0)
+            data->errors++;
+
+    return NULL;
+}
+
+
+static void*
+PageThread  (void  *arg)
+{
+    ThreadData *data = (ThreadData *)arg;
+    int i;
+
+    for (i = data->id; i < NUM_PAGES; i += NUM_THREADS) {
+        HPDF_Page page = shared_pages[i];
+        int j;
+
+        HPDF_Page_BeginText (page);
+        HPDF_Page_MoveTextPos (page, 40, 800);
+
+        for (j = 0; j < NUM_FONTS; j++) {
+            int k = (i + j) % NUM_FONTS;
+
+            HPDF_Page_SetFontAndSize (page, shared_fonts[k], 12);
+            HPDF_Page_MoveTextPos (page, 0, -20);
+            HPDF_Page_ShowText (page, FONTS[k].text);
+            page_widths[i][k] = HPDF_Page_TextWidth (page, FONTS[k].text);
+        }
+
+        HPDF_Page_EndText (page);
+    }
+
+    return NULL;
+}
+
+
+static int
+RunThreads  (void*  (*fn)(void *))
+{
+    pthread_t threads[NUM_THREADS];
+    int i;
+
+    pthread_mutex_lock (&start_lock);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        threads_data[i].id = i;
+        if (pthread_create (&threads[i], NULL, fn, &threads_data[i]) != 0) {
+            pthread_mutex_unlock (&start_lock);
+            return -1;
+        }
+    }
+
+    pthread_mutex_unlock (&start_lock);
+
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_join (threads[i], NULL);
+
+    return 0;
+}
+
+
+int main (int argc, char **argv)
+{
+    ThreadData main_data;
+    int failed = 0;
+    int i, j;
+
+    HPDF_UNUSED (argc);
+    HPDF_UNUSED (argv);
+
+    /* documents built on several threads */
+    if (RunThreads (DocumentThread) != 0)
+        return 1;
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        int n;
+
+        failed += threads_data[i].errors;
+
+        for (n = 0; n < NUM_DOCS; n++)
+            for (j = 0; j < NUM_FONTS; j++)
+                if (threads_data[i].widths[n][j] !=
+                        threads_data[0].widths[0][j]) {
+                    printf ("thread %d, document %d: the width of the text "
+                            "of %s is %g instead of %g\n", i, n,
+                            FONTS[j].font_name,
+                            threads_data[i].widths[n][j],
+                            threads_data[0].widths[0][j]);
+                    failed++;
+                }
+    }
+
+    /* the pages of one document filled on several threads */
+    memset (&main_data, 0, sizeof(main_data));
+    shared_pdf = HPDF_New (error_handler, &main_data);
+    if (!shared_pdf)
+        return 1;
+
+    UseCJK (shared_pdf, 0);
+    for (j = 0; j < NUM_FONTS; j++)
+        shared_fonts[j] = HPDF_GetFont (shared_pdf, FONTS[j].font_name,
+                FONTS[j].encoding_name);
+
+    HPDF_SetConcurrentPages (shared_pdf, HPDF_TRUE);
+    for (i = 0; i < NUM_PAGES; i++)
+        shared_pages[i] = HPDF_AddPage (shared_pdf);
+
+    if (RunThreads (PageThread) != 0)
+        return 1;
+
+    for (i = 0; i < NUM_PAGES; i++)
+        for (j = 0; j < NUM_FONTS; j++)
+            if (page_widths[i][j] != threads_data[0].widths[0][j]) {
+                printf ("page %d: the width of the text of %s is %g "
+                        "instead of %g\n", i, FONTS[j].font_name,
+                        page_widths[i][j], threads_data[0].widths[0][j]);
+                failed++;
+            }
+
+    if (HPDF_SaveToStream (shared_pdf) != HPDF_OK)
+        failed++;
+
+    failed += main_data.errors;
+    HPDF_Free (shared_pdf);
+
+    /* the tables shared by the documents are freed with the last one */
+    HPDF_FreeGlobalCaches ();
+
+    return failed ? 1 : 0;
+}